@@ -0,0 +1,363 @@
+#include "asset_cooker.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "model.hpp"
+#include "texture.hpp"
+#include "shader.hpp"
+
+AssetCooker::AssetCooker() {
+    mChanged = false;
+}
+
+bool
+AssetCooker::LoadManifest() {
+    mManifest.clear();
+    std::ifstream In(COOKER_MANIFEST_PATH);
+    std::string Tag;
+    unsigned Version = 0;
+    if (!In) {
+        std::cout << "[Cook] No manifest, cooking everything" << std::endl;
+        return false;
+    }
+    if (!(In >> Tag >> Version) || Tag != "cooker") {
+        std::cerr << "[Err] Malformed manifest " << COOKER_MANIFEST_PATH << ", cooking everything" << std::endl;
+        return false;
+    }
+    // Everything cooked by another version is rebuilt
+    if (Version != COOKED_VERSION) {
+        std::cout << "[Cook] Cooked format changed, cooking everything" << std::endl;
+        return false;
+    }
+
+    while (In >> Tag) {
+        Asset Entry;
+        int Type = 0;
+        int Written = 0;
+        unsigned DependencyCount = 0;
+        if (Tag != "asset" || !(In >> Type >> Written >> DependencyCount) || Type < MODEL_ASSET || Type > SHADER_ASSET) {
+            break;
+        }
+        In.get();
+        std::getline(In, Entry.Source);
+        Entry.Type = (EAssetType)Type;
+        Entry.Written = Written != 0;
+        for (unsigned DependencyIdx = 0; DependencyIdx < DependencyCount && In; ++DependencyIdx) {
+            Dependency CurrDependency;
+            In >> std::hex >> CurrDependency.Hash >> std::dec;
+            In.get();
+            std::getline(In, CurrDependency.Path);
+            Entry.Dependencies.push_back(CurrDependency);
+        }
+        if (!In) {
+            break;
+        }
+        mManifest[Entry.Source] = Entry;
+    }
+
+    if (!In.eof()) {
+        std::cerr << "[Err] Malformed manifest " << COOKER_MANIFEST_PATH << ", cooking everything" << std::endl;
+        mManifest.clear();
+        return false;
+    }
+    return true;
+}
+
+void
+AssetCooker::AddSourceDirectory(const std::string& directory) {
+    std::error_code Error;
+    std::filesystem::recursive_directory_iterator It(directory, Error);
+    if (Error) {
+        std::cerr << "[Err] Failed to open source directory " << directory << ": " << Error.message() << std::endl;
+        return;
+    }
+
+    for (; It != std::filesystem::recursive_directory_iterator(); It.increment(Error)) {
+        if (Error) {
+            std::cerr << "[Err] Failed to walk " << directory << ": " << Error.message() << std::endl;
+            break;
+        }
+        if (!It->is_regular_file()) {
+            continue;
+        }
+
+        // Forward slashes, the way the runtime names its assets
+        Asset Found;
+        Found.Source = It->path().generic_string();
+        Found.Written = false;
+        if (getAssetType(Found.Source, Found.Type)) {
+            mAssets.push_back(Found);
+        }
+    }
+
+    std::sort(mAssets.begin(), mAssets.end(), [](const Asset& a, const Asset& b) {
+        return a.Source < b.Source;
+    });
+}
+
+unsigned
+AssetCooker::Cook(JobSystem& jobs, bool force) {
+    typedef std::chrono::high_resolution_clock Clock;
+    Clock::time_point Start = Clock::now();
+
+    // Checking the previous cook hashes every dependency, so it runs on the workers too
+    std::vector<char> Current(mAssets.size(), 0);
+    if (!force) {
+        jobs.ParallelFor(mAssets.size(), 1, [this, &Current](unsigned begin, unsigned end) {
+            for (unsigned AssetIdx = begin; AssetIdx < end; ++AssetIdx) {
+                std::map<std::string, Asset>::const_iterator Previous = mManifest.find(mAssets[AssetIdx].Source);
+                Current[AssetIdx] = Previous != mManifest.end() && isCurrent(mAssets[AssetIdx], Previous->second);
+            }
+        });
+    }
+
+    std::vector<unsigned> Dirty;
+    for (unsigned AssetIdx = 0; AssetIdx < mAssets.size(); ++AssetIdx) {
+        if (Current[AssetIdx]) {
+            mAssets[AssetIdx] = mManifest[mAssets[AssetIdx].Source];
+            continue;
+        }
+
+        // Directories are created up front, workers would race creating the same ones
+        std::error_code Error;
+        std::filesystem::create_directories(std::filesystem::path(getCookedPath(mAssets[AssetIdx])).parent_path(), Error);
+        Dirty.push_back(AssetIdx);
+    }
+
+    std::vector<char> Failed(mAssets.size(), 0);
+    jobs.ParallelFor(Dirty.size(), 1, [this, &Dirty, &Failed](unsigned begin, unsigned end) {
+        for (unsigned DirtyIdx = begin; DirtyIdx < end; ++DirtyIdx) {
+            Failed[Dirty[DirtyIdx]] = !cookAsset(mAssets[Dirty[DirtyIdx]]);
+        }
+    });
+
+    // Cooked files of sources that are gone would never be read again
+    unsigned Removed = 0;
+    for (const std::pair<const std::string, Asset>& Previous : mManifest) {
+        bool Found = std::binary_search(mAssets.begin(), mAssets.end(), Previous.second, [](const Asset& a, const Asset& b) {
+            return a.Source < b.Source;
+        });
+        std::error_code Error;
+        if (!Found && Previous.second.Written && std::filesystem::remove(getCookedPath(Previous.second), Error)) {
+            ++Removed;
+        }
+    }
+
+    unsigned FailedCount = 0;
+    std::vector<Asset> Cooked;
+    Cooked.reserve(mAssets.size());
+    for (unsigned AssetIdx = 0; AssetIdx < mAssets.size(); ++AssetIdx) {
+        if (Failed[AssetIdx]) {
+            ++FailedCount;
+        } else {
+            Cooked.push_back(mAssets[AssetIdx]);
+        }
+    }
+    mAssets.swap(Cooked);
+    mChanged = Dirty.size() > FailedCount || Removed > 0;
+
+    float Milliseconds = std::chrono::duration<float, std::milli>(Clock::now() - Start).count();
+    std::cout << "[Cook] " << Dirty.size() - FailedCount << " cooked, " << mAssets.size() + FailedCount - Dirty.size() << " up to date, "
+        << FailedCount << " failed, " << Removed << " removed in " << Milliseconds << " ms on " << jobs.GetThreadCount() << " threads" << std::endl;
+    return FailedCount;
+}
+
+bool
+AssetCooker::SaveManifest() const {
+    std::ofstream Out(COOKER_MANIFEST_PATH, std::ios::trunc);
+    if (!Out) {
+        std::cerr << "[Err] Failed to write manifest " << COOKER_MANIFEST_PATH << std::endl;
+        return false;
+    }
+
+    Out << "cooker " << COOKED_VERSION << "\n";
+    for (const Asset& CurrAsset : mAssets) {
+        Out << "asset " << CurrAsset.Type << " " << (CurrAsset.Written ? 1 : 0) << " " << CurrAsset.Dependencies.size() << " " << CurrAsset.Source << "\n";
+        for (const Dependency& CurrDependency : CurrAsset.Dependencies) {
+            Out << std::hex << std::setw(16) << std::setfill('0') << CurrDependency.Hash << std::dec << " " << CurrDependency.Path << "\n";
+        }
+    }
+    return (bool)Out;
+}
+
+bool
+AssetCooker::WritePack() const {
+    std::error_code Error;
+    bool Stale = mChanged || !std::filesystem::exists(COOKED_PACK_PATH, Error);
+    std::vector<std::string> Names;
+    for (const Asset& CurrAsset : mAssets) {
+        if (!CurrAsset.Written) {
+            continue;
+        }
+        Names.push_back(getCookedPath(CurrAsset));
+        // Touched outputs are newer too, the pack has to follow so the runtime doesn't take it for stale
+        Stale = Stale || std::filesystem::last_write_time(Names.back(), Error) > std::filesystem::last_write_time(COOKED_PACK_PATH, Error);
+    }
+    if (!Stale) {
+        return true;
+    }
+
+    // Cooked files are named by the same path the runtime looks them up by
+    if (!AssetPack::Write(COOKED_PACK_PATH, Names, Names)) {
+        std::filesystem::remove(COOKED_PACK_PATH, Error);
+        return false;
+    }
+    std::cout << "[Cook] Packed " << Names.size() << " assets into " << COOKED_PACK_PATH << std::endl;
+    return true;
+}
+
+bool
+AssetCooker::isCurrent(const Asset& asset, const Asset& previous) const {
+    const std::string CookedPath = getCookedPath(asset);
+    std::error_code Error;
+    if (previous.Type != asset.Type || (previous.Written && !std::filesystem::exists(CookedPath, Error))) {
+        return false;
+    }
+
+    // Added or removed dependencies also show up here, the source lists the new ones
+    std::vector<std::string> Paths = findDependencies(asset);
+    if (Paths.size() != previous.Dependencies.size()) {
+        return false;
+    }
+    bool Touched = false;
+    for (unsigned DependencyIdx = 0; DependencyIdx < Paths.size(); ++DependencyIdx) {
+        const Dependency& Recorded = previous.Dependencies[DependencyIdx];
+        unsigned long long Hash = 0;
+        hashFile(Recorded.Path, Hash);
+        if (Paths[DependencyIdx] != Recorded.Path || Hash != Recorded.Hash) {
+            return false;
+        }
+        if (previous.Written && std::filesystem::last_write_time(Recorded.Path, Error) > std::filesystem::last_write_time(CookedPath, Error)) {
+            Touched = true;
+        }
+    }
+
+    // Same contents with a newer time, e.g. after a checkout. CookedFile would take the cooked file for stale
+    if (Touched) {
+        std::filesystem::last_write_time(CookedPath, std::filesystem::file_time_type::clock::now(), Error);
+    }
+    return true;
+}
+
+bool
+AssetCooker::cookAsset(Asset& asset) {
+    // Hashed before cooking, so an edit made while cooking is picked up by the next run
+    asset.Dependencies.clear();
+    for (const std::string& Path : findDependencies(asset)) {
+        Dependency CurrDependency = { Path, 0 };
+        hashFile(Path, CurrDependency.Hash);
+        asset.Dependencies.push_back(CurrDependency);
+    }
+
+    const std::string CookedPath = getCookedPath(asset);
+    std::error_code Error;
+    std::filesystem::remove(CookedPath, Error);
+    bool Success = false;
+    switch (asset.Type) {
+    case MODEL_ASSET: Success = Model::Cook(asset.Source); break;
+    case TEXTURE_ASSET: Success = Texture::CookImage(asset.Source); break;
+    case SHADER_ASSET: Success = Shader::Cook(asset.Source); break;
+    }
+
+    // Rigged models cook successfully without writing anything
+    asset.Written = Success && std::filesystem::exists(CookedPath, Error);
+    if (Success) {
+        std::cout << "[Cook] " << asset.Source << (asset.Written ? " -> " + CookedPath : std::string(" left to the runtime")) << std::endl;
+    } else {
+        std::filesystem::remove(CookedPath, Error);
+        std::cerr << "[Err] Failed to cook " << asset.Source << std::endl;
+    }
+    return Success;
+}
+
+bool
+AssetCooker::getAssetType(const std::string& path, EAssetType& type) {
+    std::string Extension = std::filesystem::path(path).extension().string();
+    std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](unsigned char c) {
+        return (char)std::tolower(c);
+    });
+
+    const char* const ModelExtensions[] = { ".obj", ".fbx", ".dae", ".3ds" };
+    const char* const TextureExtensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tga" };
+    const char* const ShaderExtensions[] = { ".vert", ".frag", ".geom" };
+    for (const char* ModelExtension : ModelExtensions) {
+        if (Extension == ModelExtension) {
+            type = MODEL_ASSET;
+            return true;
+        }
+    }
+    for (const char* TextureExtension : TextureExtensions) {
+        if (Extension == TextureExtension) {
+            type = TEXTURE_ASSET;
+            return true;
+        }
+    }
+    for (const char* ShaderExtension : ShaderExtensions) {
+        if (Extension == ShaderExtension) {
+            type = SHADER_ASSET;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string
+AssetCooker::getCookedPath(const Asset& asset) {
+    switch (asset.Type) {
+    case MODEL_ASSET: return CookedFile::GetPath(asset.Source, COOKED_MODEL_EXTENSION);
+    case TEXTURE_ASSET: return CookedFile::GetPath(asset.Source, COOKED_TEXTURE_EXTENSION);
+    default: return CookedFile::GetPath(asset.Source, COOKED_SHADER_EXTENSION);
+    }
+}
+
+std::vector<std::string>
+AssetCooker::findDependencies(const Asset& asset) {
+    std::vector<std::string> Paths(1, asset.Source);
+    std::string Extension = std::filesystem::path(asset.Source).extension().string();
+    if (asset.Type != MODEL_ASSET || (Extension != ".obj" && Extension != ".OBJ")) {
+        return Paths;
+    }
+
+    // Materials live in separate files next to the OBJ. Missing ones are kept with hash 0,
+    // so adding them later cooks the model again
+    const std::string Directory = asset.Source.substr(0, asset.Source.find_last_of('/') + 1);
+    std::ifstream In(asset.Source);
+    std::string Line;
+    while (std::getline(In, Line)) {
+        if (Line.compare(0, 7, "mtllib ") != 0) {
+            continue;
+        }
+        size_t Begin = Line.find_first_not_of(" \t", 7);
+        size_t End = Line.find_last_not_of(" \t\r");
+        if (Begin != std::string::npos && End >= Begin) {
+            Paths.push_back(Directory + Line.substr(Begin, End - Begin + 1));
+        }
+    }
+    return Paths;
+}
+
+bool
+AssetCooker::hashFile(const std::string& path, unsigned long long& hash) {
+    hash = 0;
+    std::ifstream In(path, std::ios::binary);
+    if (!In) {
+        return false;
+    }
+
+    std::vector<char> Block(COOKER_HASH_BLOCK_SIZE);
+    unsigned long long Hash = 14695981039346656037ull;
+    while (In) {
+        In.read(Block.data(), Block.size());
+        std::streamsize Read = In.gcount();
+        for (std::streamsize Idx = 0; Idx < Read; ++Idx) {
+            Hash ^= (unsigned char)Block[Idx];
+            Hash *= 1099511628211ull;
+        }
+    }
+    hash = Hash;
+    return true;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include "job_system.hpp"
+#include "cooked.hpp"
+
+// Dependency graph of the last cook, kept next to the cooked files
+#define COOKER_MANIFEST_PATH COOKED_DIRECTORY "manifest.txt"
+// Bytes read at once while hashing
+#define COOKER_HASH_BLOCK_SIZE (64 * 1024)
+
+enum EAssetType {
+    MODEL_ASSET = 0,
+    TEXTURE_ASSET = 1,
+    SHADER_ASSET = 2,
+};
+
+/**
+ * @brief Cooks source assets into the formats read by CookedFile users. Every cooked asset records the
+ * files it was built from with a content hash in the manifest, and the next run only cooks assets with
+ * a changed, added or removed dependency. Hashing and cooking both run on the job system
+ */
+class AssetCooker {
+public:
+    AssetCooker();
+
+    /**
+     * @brief Reads the manifest of the previous run. A missing or outdated manifest cooks everything
+     *
+     * @returns false if there was no usable manifest
+     */
+    bool LoadManifest();
+
+    /**
+     * @brief Finds the assets under a source directory, recursively
+     *
+     * @param directory Directory relative to the working directory, e.g. res
+     */
+    void AddSourceDirectory(const std::string& directory);
+
+    /**
+     * @brief Cooks assets whose dependencies changed since the previous run and deletes cooked
+     * files of sources that no longer exist
+     *
+     * @param jobs Job system assets are hashed and cooked on
+     * @param force Cooks every asset
+     *
+     * @returns Number of assets that failed to cook
+     */
+    unsigned Cook(JobSystem& jobs, bool force);
+
+    /**
+     * @brief Writes the manifest. Failed assets are left out, so the next run tries them again
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool SaveManifest() const;
+
+    /**
+     * @brief Packs every cooked file into COOKED_PACK_PATH. The pack is only rewritten if this run
+     * cooked or removed something, or a cooked file is newer than it
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool WritePack() const;
+
+private:
+    struct Dependency {
+        std::string Path;
+        unsigned long long Hash;
+    };
+
+    struct Asset {
+        std::string Source;
+        EAssetType Type;
+        // Files the cooked output is built from, the source first
+        std::vector<Dependency> Dependencies;
+        // False for assets left to the runtime importer, e.g. rigged models
+        bool Written;
+    };
+
+    // Assets found this run, sorted by source path
+    std::vector<Asset> mAssets;
+    // Assets cooked by the previous run, by source path
+    std::map<std::string, Asset> mManifest;
+    // Set by Cook if a cooked file was written or removed
+    bool mChanged;
+
+    /**
+     * @brief Returns true if the previous cook of an asset is still valid and refreshes
+     * the cooked file's time, so the runtime doesn't take it for stale
+     */
+    bool isCurrent(const Asset& asset, const Asset& previous) const;
+
+    /**
+     * @brief Hashes the dependencies of an asset and cooks it
+     *
+     * @returns true - Success, false - Failure
+     */
+    static bool cookAsset(Asset& asset);
+
+    /**
+     * @brief Returns the asset type of a file by its extension
+     *
+     * @returns false for files that aren't cooked
+     */
+    static bool getAssetType(const std::string& path, EAssetType& type);
+
+    static std::string getCookedPath(const Asset& asset);
+
+    /**
+     * @brief Returns the files an asset is built from, the source first. OBJ models also read their MTL libraries
+     */
+    static std::vector<std::string> findDependencies(const Asset& asset);
+
+    /**
+     * @brief Computes the 64 bit FNV-1a hash of a file's contents
+     *
+     * @returns false if the file can't be read
+     */
+    static bool hashFile(const std::string& path, unsigned long long& hash);
+};
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "job_system.hpp"
+#include "asset_cooker.hpp"
+
+/**
+ * Offline asset cooker. Runs from the Phong directory before every build and writes the cooked
+ * assets Phong loads instead of its sources. Only assets whose dependencies changed are cooked again.
+ *
+ * Usage: Cooker [--force] [source directories...], res and shaders by default
+ */
+int main(int argc, char** argv) {
+    bool Force = false;
+    std::vector<std::string> SourceDirectories;
+    for (int ArgIdx = 1; ArgIdx < argc; ++ArgIdx) {
+        if (!strcmp(argv[ArgIdx], "--force")) {
+            Force = true;
+        } else {
+            SourceDirectories.push_back(argv[ArgIdx]);
+        }
+    }
+    if (SourceDirectories.empty()) {
+        SourceDirectories.push_back("res");
+        SourceDirectories.push_back("shaders");
+    }
+
+    JobSystem Jobs;
+    AssetCooker Cooker;
+    if (!Force) {
+        Cooker.LoadManifest();
+    }
+    for (const std::string& SourceDirectory : SourceDirectories) {
+        Cooker.AddSourceDirectory(SourceDirectory);
+    }
+
+    unsigned Failed = Cooker.Cook(Jobs, Force);
+    if (!Cooker.SaveManifest() || !Cooker.WritePack()) {
+        return -1;
+    }
+    return Failed ? -1 : 0;
+}
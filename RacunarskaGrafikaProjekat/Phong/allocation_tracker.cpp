@@ -0,0 +1,93 @@
+#include "allocation_tracker.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if ALLOCATION_TRACKING
+static std::atomic<unsigned long long> AllocationCount(0);
+static std::atomic<unsigned long long> AllocationBytes(0);
+
+/**
+ * @brief Counts and performs one allocation
+ *
+ * @returns Memory, 0 if the system is out of it
+ */
+static void*
+trackedAllocate(size_t size) {
+    AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    AllocationBytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void*
+operator new(size_t size) {
+    void* Memory = trackedAllocate(size);
+    if (!Memory) {
+        throw std::bad_alloc();
+    }
+    return Memory;
+}
+
+void*
+operator new[](size_t size) {
+    return operator new(size);
+}
+
+void*
+operator new(size_t size, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size);
+}
+
+void*
+operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size);
+}
+
+void
+operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+#endif
+
+unsigned long long
+AllocationTracker::GetCount() {
+#if ALLOCATION_TRACKING
+    return AllocationCount.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+unsigned long long
+AllocationTracker::GetBytes() {
+#if ALLOCATION_TRACKING
+    return AllocationBytes.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
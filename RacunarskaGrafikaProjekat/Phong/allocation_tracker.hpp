@@ -0,0 +1,22 @@
+#pragma once
+
+// Replaces the global operator new and delete to count heap allocations. Costs two relaxed atomic adds per allocation
+#define ALLOCATION_TRACKING 1
+
+/**
+ * @brief Totals of heap allocations made through operator new on all threads since startup.
+ * Sampling the count around a frame gives its allocations, which should stay zero once the
+ * scene has warmed up
+ */
+class AllocationTracker {
+public:
+    /**
+     * @brief Returns the number of allocations, 0 without ALLOCATION_TRACKING
+     */
+    static unsigned long long GetCount();
+
+    /**
+     * @brief Returns the number of bytes requested, 0 without ALLOCATION_TRACKING
+     */
+    static unsigned long long GetBytes();
+};
@@ -0,0 +1,614 @@
+#include "animation.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <set>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Channel of the first rotation, translation and scale component
+static const unsigned ROTATION_CHANNEL = 0;
+static const unsigned TRANSLATION_CHANNEL = 4;
+static const unsigned SCALE_CHANNEL = 7;
+static const float QUANTIZATION_LEVELS = 65535.0f;
+
+/**
+ * @brief Converts a row major Assimp matrix to a column major glm one
+ */
+static glm::mat4
+toGlm(const aiMatrix4x4& m) {
+    return glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+}
+
+/**
+ * @brief Splits an affine matrix without shear into rotation, translation and scale channels
+ *
+ * @param m Local transform
+ * @param out ANIMATION_CHANNELS floats
+ */
+static void
+decomposeLocal(const glm::mat4& m, float* out) {
+    glm::vec3 Scale(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+    glm::mat3 Rotation(glm::vec3(m[0]) / Scale.x, glm::vec3(m[1]) / Scale.y, glm::vec3(m[2]) / Scale.z);
+    glm::quat Quat = glm::normalize(glm::quat_cast(Rotation));
+    const float Channels[ANIMATION_CHANNELS] = { Quat.x, Quat.y, Quat.z, Quat.w, m[3].x, m[3].y, m[3].z, Scale.x, Scale.y, Scale.z };
+    std::copy(Channels, Channels + ANIMATION_CHANNELS, out);
+}
+
+/**
+ * @brief Linearly interpolates Assimp vector keys at a time in ticks
+ */
+static aiVector3D
+interpolateKeys(const aiVectorKey* keys, unsigned count, double time) {
+    if (count == 1 || time <= keys[0].mTime) {
+        return keys[0].mValue;
+    }
+
+    for (unsigned Key = 0; Key + 1 < count; ++Key) {
+        if (time < keys[Key + 1].mTime) {
+            float T = (float)((time - keys[Key].mTime) / (keys[Key + 1].mTime - keys[Key].mTime));
+            return keys[Key].mValue + (keys[Key + 1].mValue - keys[Key].mValue) * T;
+        }
+    }
+    return keys[count - 1].mValue;
+}
+
+/**
+ * @brief Spherically interpolates Assimp rotation keys at a time in ticks
+ */
+static aiQuaternion
+interpolateKeys(const aiQuatKey* keys, unsigned count, double time) {
+    if (count == 1 || time <= keys[0].mTime) {
+        return keys[0].mValue;
+    }
+
+    for (unsigned Key = 0; Key + 1 < count; ++Key) {
+        if (time < keys[Key + 1].mTime) {
+            float T = (float)((time - keys[Key].mTime) / (keys[Key + 1].mTime - keys[Key].mTime));
+            aiQuaternion Result;
+            aiQuaternion::Interpolate(Result, keys[Key].mValue, keys[Key + 1].mValue, T);
+            return Result;
+        }
+    }
+    return keys[count - 1].mValue;
+}
+
+/**
+ * @brief Marks a node and all its ancestors as part of the skeleton
+ */
+static void
+markWithAncestors(const aiNode* node, std::set<const aiNode*>& marked) {
+    for (; node && !marked.count(node); node = node->mParent) {
+        marked.insert(node);
+    }
+}
+
+/**
+ * @brief Adds marked nodes depth first, so parents come before children
+ */
+static void
+addBones(const aiNode* node, int parent, const std::set<const aiNode*>& marked, Skeleton& skeleton) {
+    if (!marked.count(node)) {
+        return;
+    }
+
+    int Index = skeleton.Names.size();
+    skeleton.Names.push_back(node->mName.data);
+    skeleton.Parents.push_back(parent);
+    skeleton.InverseBind.push_back(glm::mat4(1.0f));
+    skeleton.RestLocal.push_back(toGlm(node->mTransformation));
+    for (unsigned Child = 0; Child < node->mNumChildren; ++Child) {
+        addBones(node->mChildren[Child], Index, marked, skeleton);
+    }
+}
+
+Skeleton
+Skeleton::FromScene(const aiScene* scene) {
+    Skeleton Result;
+    std::set<const aiNode*> Marked;
+    for (unsigned MeshIdx = 0; MeshIdx < scene->mNumMeshes; ++MeshIdx) {
+        const aiMesh* CurrMesh = scene->mMeshes[MeshIdx];
+        for (unsigned BoneIdx = 0; BoneIdx < CurrMesh->mNumBones; ++BoneIdx) {
+            markWithAncestors(scene->mRootNode->FindNode(CurrMesh->mBones[BoneIdx]->mName), Marked);
+        }
+    }
+    if (Marked.empty()) {
+        return Result;
+    }
+
+    addBones(scene->mRootNode, -1, Marked, Result);
+    if (Result.GetCount() > ANIMATION_MAX_BONES) {
+        std::cerr << "[Err] Skeleton has " << Result.GetCount() << " bones, only " << ANIMATION_MAX_BONES << " are supported" << std::endl;
+        return Skeleton();
+    }
+
+    for (unsigned MeshIdx = 0; MeshIdx < scene->mNumMeshes; ++MeshIdx) {
+        const aiMesh* CurrMesh = scene->mMeshes[MeshIdx];
+        for (unsigned BoneIdx = 0; BoneIdx < CurrMesh->mNumBones; ++BoneIdx) {
+            const aiBone* Bone = CurrMesh->mBones[BoneIdx];
+            int Index = Result.Find(Bone->mName.data);
+            if (Index < 0) {
+                std::cerr << "[Err] Bone " << Bone->mName.data << " of mesh " << CurrMesh->mName.data << " has no node in the hierarchy" << std::endl;
+                continue;
+            }
+            Result.InverseBind[Index] = toGlm(Bone->mOffsetMatrix);
+        }
+    }
+    return Result;
+}
+
+int
+Skeleton::Find(const std::string& name) const {
+    std::vector<std::string>::const_iterator It = std::find(Names.begin(), Names.end(), name);
+    return It == Names.end() ? -1 : (int)(It - Names.begin());
+}
+
+unsigned
+Skeleton::GetCount() const {
+    return Names.size();
+}
+
+AnimationPose::AnimationPose() {
+    mBoneCount = 0;
+    mStride = 0;
+}
+
+AnimationPose::AnimationPose(unsigned boneCount) {
+    mBoneCount = boneCount;
+    // Padding bones are identities too, so normalizing them never divides by zero
+    mStride = SimdPadCount(boneCount ? boneCount : 1);
+    mChannels.assign(mStride * ANIMATION_CHANNELS, 0.0f);
+    std::fill(&mChannels[(ROTATION_CHANNEL + 3) * mStride], &mChannels[(ROTATION_CHANNEL + 4) * mStride], 1.0f);
+    std::fill(&mChannels[SCALE_CHANNEL * mStride], mChannels.data() + mChannels.size(), 1.0f);
+}
+
+float*
+AnimationPose::GetChannel(unsigned channel) {
+    return &mChannels[channel * mStride];
+}
+
+const float*
+AnimationPose::GetChannel(unsigned channel) const {
+    return &mChannels[channel * mStride];
+}
+
+unsigned
+AnimationPose::GetBoneCount() const {
+    return mBoneCount;
+}
+
+unsigned
+AnimationPose::GetStride() const {
+    return mStride;
+}
+
+void
+AnimationPose::Blend(const AnimationPose& a, const AnimationPose& b, float weight, AnimationPose& out) {
+#if SIMD_SSE
+    const unsigned Stride = a.mStride;
+    const __m128 Weight = _mm_set1_ps(weight);
+    const __m128 SignMask = _mm_set1_ps(-0.0f);
+    for (unsigned Bone = 0; Bone < Stride; Bone += SIMD_WIDTH) {
+        __m128 A[4];
+        __m128 B[4];
+        for (unsigned Component = 0; Component < 4; ++Component) {
+            A[Component] = _mm_loadu_ps(&a.mChannels[(ROTATION_CHANNEL + Component) * Stride + Bone]);
+            B[Component] = _mm_loadu_ps(&b.mChannels[(ROTATION_CHANNEL + Component) * Stride + Bone]);
+        }
+        // q and -q are the same rotation, flipping b when they point apart blends along the shorter arc
+        __m128 Dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(A[0], B[0]), _mm_mul_ps(A[1], B[1])), _mm_add_ps(_mm_mul_ps(A[2], B[2]), _mm_mul_ps(A[3], B[3])));
+        __m128 Flip = _mm_and_ps(Dot, SignMask);
+        __m128 LengthSquared = _mm_setzero_ps();
+        for (unsigned Component = 0; Component < 4; ++Component) {
+            A[Component] = _mm_add_ps(A[Component], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(B[Component], Flip), A[Component]), Weight));
+            LengthSquared = _mm_add_ps(LengthSquared, _mm_mul_ps(A[Component], A[Component]));
+        }
+        __m128 InverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(LengthSquared));
+        for (unsigned Component = 0; Component < 4; ++Component) {
+            _mm_storeu_ps(&out.mChannels[(ROTATION_CHANNEL + Component) * Stride + Bone], _mm_mul_ps(A[Component], InverseLength));
+        }
+    }
+
+    for (unsigned Idx = TRANSLATION_CHANNEL * Stride; Idx < ANIMATION_CHANNELS * Stride; Idx += SIMD_WIDTH) {
+        __m128 A = _mm_loadu_ps(&a.mChannels[Idx]);
+        __m128 B = _mm_loadu_ps(&b.mChannels[Idx]);
+        _mm_storeu_ps(&out.mChannels[Idx], _mm_add_ps(A, _mm_mul_ps(_mm_sub_ps(B, A), Weight)));
+    }
+#else
+    blendScalar(a, b, weight, out);
+#endif
+}
+
+void
+AnimationPose::blendScalar(const AnimationPose& a, const AnimationPose& b, float weight, AnimationPose& out) {
+    const unsigned Stride = a.mStride;
+    for (unsigned Bone = 0; Bone < Stride; ++Bone) {
+        const float* A = &a.mChannels[ROTATION_CHANNEL * Stride + Bone];
+        const float* B = &b.mChannels[ROTATION_CHANNEL * Stride + Bone];
+        float Dot = A[0] * B[0] + A[Stride] * B[Stride] + A[2 * Stride] * B[2 * Stride] + A[3 * Stride] * B[3 * Stride];
+        float Sign = Dot < 0.0f ? -1.0f : 1.0f;
+        float Blended[4];
+        float LengthSquared = 0.0f;
+        for (unsigned Component = 0; Component < 4; ++Component) {
+            Blended[Component] = A[Component * Stride] + (B[Component * Stride] * Sign - A[Component * Stride]) * weight;
+            LengthSquared += Blended[Component] * Blended[Component];
+        }
+        float InverseLength = 1.0f / std::sqrt(LengthSquared);
+        for (unsigned Component = 0; Component < 4; ++Component) {
+            out.mChannels[(ROTATION_CHANNEL + Component) * Stride + Bone] = Blended[Component] * InverseLength;
+        }
+    }
+
+    for (unsigned Idx = TRANSLATION_CHANNEL * Stride; Idx < ANIMATION_CHANNELS * Stride; ++Idx) {
+        out.mChannels[Idx] = a.mChannels[Idx] + (b.mChannels[Idx] - a.mChannels[Idx]) * weight;
+    }
+}
+
+void
+AnimationPose::ComputeSkinning(const Skeleton& skeleton, const glm::mat4& model, float* out) const {
+    glm::mat4 Globals[ANIMATION_MAX_BONES];
+    const float* X = GetChannel(ROTATION_CHANNEL);
+    const float* Y = GetChannel(ROTATION_CHANNEL + 1);
+    const float* Z = GetChannel(ROTATION_CHANNEL + 2);
+    const float* W = GetChannel(ROTATION_CHANNEL + 3);
+    for (unsigned Bone = 0; Bone < mBoneCount; ++Bone) {
+        // Same T * R * S composition as TransformBatch, without building the rotation and scale matrices
+        float XX = X[Bone] * X[Bone], YY = Y[Bone] * Y[Bone], ZZ = Z[Bone] * Z[Bone];
+        float XY = X[Bone] * Y[Bone], XZ = X[Bone] * Z[Bone], YZ = Y[Bone] * Z[Bone];
+        float WX = W[Bone] * X[Bone], WY = W[Bone] * Y[Bone], WZ = W[Bone] * Z[Bone];
+        float SX = GetChannel(SCALE_CHANNEL)[Bone];
+        float SY = GetChannel(SCALE_CHANNEL + 1)[Bone];
+        float SZ = GetChannel(SCALE_CHANNEL + 2)[Bone];
+        glm::mat4 Local(
+            (1.0f - 2.0f * (YY + ZZ)) * SX, 2.0f * (XY + WZ) * SX, 2.0f * (XZ - WY) * SX, 0.0f,
+            2.0f * (XY - WZ) * SY, (1.0f - 2.0f * (XX + ZZ)) * SY, 2.0f * (YZ + WX) * SY, 0.0f,
+            2.0f * (XZ + WY) * SZ, 2.0f * (YZ - WX) * SZ, (1.0f - 2.0f * (XX + YY)) * SZ, 0.0f,
+            GetChannel(TRANSLATION_CHANNEL)[Bone], GetChannel(TRANSLATION_CHANNEL + 1)[Bone], GetChannel(TRANSLATION_CHANNEL + 2)[Bone], 1.0f);
+        int Parent = skeleton.Parents[Bone];
+        Globals[Bone] = (Parent < 0 ? model : Globals[Parent]) * Local;
+
+        // Rows of the affine part, the shader rebuilds the matrix from three texels
+        glm::mat4 Skin = Globals[Bone] * skeleton.InverseBind[Bone];
+        float* Out = out + Bone * ANIMATION_MATRIX_FLOATS;
+        for (unsigned Row = 0; Row < 3; ++Row) {
+            Out[Row * 4] = Skin[0][Row];
+            Out[Row * 4 + 1] = Skin[1][Row];
+            Out[Row * 4 + 2] = Skin[2][Row];
+            Out[Row * 4 + 3] = Skin[3][Row];
+        }
+    }
+}
+
+AnimationClip::AnimationClip() {
+    mBoneCount = 0;
+    mFrameCount = 0;
+}
+
+AnimationClip::AnimationClip(const std::string& name, unsigned boneCount, unsigned frameCount, const std::vector<float>& frames)
+    : mBase(boneCount) {
+    mName = name;
+    mBoneCount = boneCount;
+    mFrameCount = std::max(frameCount, 1u);
+    const unsigned Stride = mBase.GetStride();
+    std::vector<float> Source(frames);
+    Source.resize(mFrameCount * boneCount * ANIMATION_CHANNELS, 0.0f);
+
+    // Consecutive keys in the same hemisphere, so interpolating quantized components doesn't swing through zero
+    for (unsigned Frame = 1; Frame < mFrameCount; ++Frame) {
+        for (unsigned Bone = 0; Bone < boneCount; ++Bone) {
+            float* Previous = &Source[((Frame - 1) * boneCount + Bone) * ANIMATION_CHANNELS + ROTATION_CHANNEL];
+            float* Current = &Source[(Frame * boneCount + Bone) * ANIMATION_CHANNELS + ROTATION_CHANNEL];
+            if (Previous[0] * Current[0] + Previous[1] * Current[1] + Previous[2] * Current[2] + Previous[3] * Current[3] < 0.0f) {
+                for (unsigned Component = 0; Component < 4; ++Component) {
+                    Current[Component] = -Current[Component];
+                }
+            }
+        }
+    }
+
+    for (unsigned Channel = 0; Channel < ANIMATION_CHANNELS; ++Channel) {
+        for (unsigned Bone = 0; Bone < boneCount; ++Bone) {
+            float Min = Source[Bone * ANIMATION_CHANNELS + Channel];
+            float Max = Min;
+            for (unsigned Frame = 1; Frame < mFrameCount; ++Frame) {
+                float Value = Source[(Frame * boneCount + Bone) * ANIMATION_CHANNELS + Channel];
+                Min = std::min(Min, Value);
+                Max = std::max(Max, Value);
+            }
+            mBase.GetChannel(Channel)[Bone] = Source[Bone * ANIMATION_CHANNELS + Channel];
+            if (Max - Min > ANIMATION_CONSTANT_EPSILON) {
+                mTracks.push_back(Channel * Stride + Bone);
+                mTrackMin.push_back(Min);
+                mTrackScale.push_back((Max - Min) / QUANTIZATION_LEVELS);
+            }
+        }
+    }
+
+    const unsigned TrackCount = mTracks.size();
+    const unsigned PaddedCount = SimdPadCount(TrackCount);
+    for (unsigned Track = TrackCount; Track < PaddedCount; ++Track) {
+        mTracks.push_back(mTracks.back());
+        mTrackMin.push_back(mTrackMin.back());
+        mTrackScale.push_back(mTrackScale.back());
+    }
+    mKeys.resize(mFrameCount * PaddedCount);
+    for (unsigned Frame = 0; Frame < mFrameCount; ++Frame) {
+        for (unsigned Track = 0; Track < PaddedCount; ++Track) {
+            unsigned Channel = mTracks[Track] / Stride;
+            unsigned Bone = mTracks[Track] % Stride;
+            float Value = Source[(Frame * boneCount + Bone) * ANIMATION_CHANNELS + Channel];
+            float Level = (Value - mTrackMin[Track]) / mTrackScale[Track];
+            mKeys[Frame * PaddedCount + Track] = (unsigned short)std::min(std::max(Level + 0.5f, 0.0f), QUANTIZATION_LEVELS);
+        }
+    }
+}
+
+AnimationClip
+AnimationClip::FromAssimp(const aiAnimation* animation, const Skeleton& skeleton) {
+    const double TicksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+    const float Duration = (float)(animation->mDuration / TicksPerSecond);
+    const unsigned BoneCount = skeleton.GetCount();
+    const unsigned FrameCount = std::max((unsigned)std::floor(Duration * ANIMATION_SAMPLE_RATE + 0.5f), 1u);
+
+    std::vector<const aiNodeAnim*> Channels(BoneCount, (const aiNodeAnim*)0);
+    for (unsigned ChannelIdx = 0; ChannelIdx < animation->mNumChannels; ++ChannelIdx) {
+        int Bone = skeleton.Find(animation->mChannels[ChannelIdx]->mNodeName.data);
+        if (Bone >= 0) {
+            Channels[Bone] = animation->mChannels[ChannelIdx];
+        }
+    }
+
+    std::vector<float> Frames(FrameCount * BoneCount * ANIMATION_CHANNELS);
+    for (unsigned Frame = 0; Frame < FrameCount; ++Frame) {
+        double Time = Frame / ANIMATION_SAMPLE_RATE * TicksPerSecond;
+        for (unsigned Bone = 0; Bone < BoneCount; ++Bone) {
+            float* Out = &Frames[(Frame * BoneCount + Bone) * ANIMATION_CHANNELS];
+            decomposeLocal(skeleton.RestLocal[Bone], Out);
+            const aiNodeAnim* Channel = Channels[Bone];
+            if (!Channel) {
+                continue;
+            }
+
+            if (Channel->mNumRotationKeys) {
+                aiQuaternion Rotation = interpolateKeys(Channel->mRotationKeys, Channel->mNumRotationKeys, Time);
+                Rotation.Normalize();
+                const float Quat[4] = { Rotation.x, Rotation.y, Rotation.z, Rotation.w };
+                std::copy(Quat, Quat + 4, Out + ROTATION_CHANNEL);
+            }
+            if (Channel->mNumPositionKeys) {
+                aiVector3D Position = interpolateKeys(Channel->mPositionKeys, Channel->mNumPositionKeys, Time);
+                const float Translation[3] = { Position.x, Position.y, Position.z };
+                std::copy(Translation, Translation + 3, Out + TRANSLATION_CHANNEL);
+            }
+            if (Channel->mNumScalingKeys) {
+                aiVector3D Scaling = interpolateKeys(Channel->mScalingKeys, Channel->mNumScalingKeys, Time);
+                const float Scale[3] = { Scaling.x, Scaling.y, Scaling.z };
+                std::copy(Scale, Scale + 3, Out + SCALE_CHANNEL);
+            }
+        }
+    }
+    return AnimationClip(animation->mName.data, BoneCount, FrameCount, Frames);
+}
+
+void
+AnimationClip::Sample(float time, AnimationPose& pose) const {
+#if SIMD_SSE
+    unsigned First;
+    unsigned Second;
+    float Weight;
+    frameAt(time, First, Second, Weight);
+    pose.mChannels = mBase.mChannels;
+    // A clip with no animated channels has no keys to index
+    if (mTracks.empty()) {
+        return;
+    }
+
+    const unsigned TrackCount = mTracks.size();
+    const unsigned short* FirstKeys = &mKeys[First * TrackCount];
+    const unsigned short* SecondKeys = &mKeys[Second * TrackCount];
+    const __m128i Zero = _mm_setzero_si128();
+    const __m128 WeightV = _mm_set1_ps(Weight);
+    float* Channels = pose.mChannels.data();
+    for (unsigned Track = 0; Track < TrackCount; Track += SIMD_WIDTH) {
+        __m128 A = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)&FirstKeys[Track]), Zero));
+        __m128 B = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)&SecondKeys[Track]), Zero));
+        __m128 Level = _mm_add_ps(A, _mm_mul_ps(_mm_sub_ps(B, A), WeightV));
+        __m128 Value = _mm_add_ps(_mm_loadu_ps(&mTrackMin[Track]), _mm_mul_ps(Level, _mm_loadu_ps(&mTrackScale[Track])));
+        // Tracks are spread over the channel arrays, the scatter stays scalar
+        alignas(16) float Values[SIMD_WIDTH];
+        _mm_store_ps(Values, Value);
+        Channels[mTracks[Track]] = Values[0];
+        Channels[mTracks[Track + 1]] = Values[1];
+        Channels[mTracks[Track + 2]] = Values[2];
+        Channels[mTracks[Track + 3]] = Values[3];
+    }
+
+    const unsigned Stride = pose.mStride;
+    float* X = pose.GetChannel(ROTATION_CHANNEL);
+    float* Y = pose.GetChannel(ROTATION_CHANNEL + 1);
+    float* Z = pose.GetChannel(ROTATION_CHANNEL + 2);
+    float* W = pose.GetChannel(ROTATION_CHANNEL + 3);
+    for (unsigned Bone = 0; Bone < Stride; Bone += SIMD_WIDTH) {
+        __m128 QX = _mm_loadu_ps(&X[Bone]);
+        __m128 QY = _mm_loadu_ps(&Y[Bone]);
+        __m128 QZ = _mm_loadu_ps(&Z[Bone]);
+        __m128 QW = _mm_loadu_ps(&W[Bone]);
+        __m128 LengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(QX, QX), _mm_mul_ps(QY, QY)), _mm_add_ps(_mm_mul_ps(QZ, QZ), _mm_mul_ps(QW, QW)));
+        __m128 InverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(LengthSquared));
+        _mm_storeu_ps(&X[Bone], _mm_mul_ps(QX, InverseLength));
+        _mm_storeu_ps(&Y[Bone], _mm_mul_ps(QY, InverseLength));
+        _mm_storeu_ps(&Z[Bone], _mm_mul_ps(QZ, InverseLength));
+        _mm_storeu_ps(&W[Bone], _mm_mul_ps(QW, InverseLength));
+    }
+#else
+    sampleScalar(time, pose);
+#endif
+}
+
+void
+AnimationClip::sampleScalar(float time, AnimationPose& pose) const {
+    unsigned First;
+    unsigned Second;
+    float Weight;
+    frameAt(time, First, Second, Weight);
+    pose.mChannels = mBase.mChannels;
+    if (mTracks.empty()) {
+        return;
+    }
+
+    const unsigned TrackCount = mTracks.size();
+    for (unsigned Track = 0; Track < TrackCount; ++Track) {
+        float A = mKeys[First * TrackCount + Track];
+        float B = mKeys[Second * TrackCount + Track];
+        pose.mChannels[mTracks[Track]] = mTrackMin[Track] + (A + (B - A) * Weight) * mTrackScale[Track];
+    }
+
+    const unsigned Stride = pose.mStride;
+    for (unsigned Bone = 0; Bone < Stride; ++Bone) {
+        float* Quat = pose.GetChannel(ROTATION_CHANNEL) + Bone;
+        float InverseLength = 1.0f / std::sqrt(Quat[0] * Quat[0] + Quat[Stride] * Quat[Stride] + Quat[2 * Stride] * Quat[2 * Stride] + Quat[3 * Stride] * Quat[3 * Stride]);
+        for (unsigned Component = 0; Component < 4; ++Component) {
+            Quat[Component * Stride] *= InverseLength;
+        }
+    }
+}
+
+void
+AnimationClip::frameAt(float time, unsigned& first, unsigned& second, float& weight) const {
+    float Frame = std::fmod(time * ANIMATION_SAMPLE_RATE, (float)mFrameCount);
+    if (Frame < 0.0f) {
+        Frame += mFrameCount;
+    }
+    first = std::min((unsigned)Frame, mFrameCount - 1);
+    second = first + 1 < mFrameCount ? first + 1 : 0;
+    weight = Frame - first;
+}
+
+float
+AnimationClip::GetDuration() const {
+    return mFrameCount / ANIMATION_SAMPLE_RATE;
+}
+
+unsigned
+AnimationClip::GetBoneCount() const {
+    return mBoneCount;
+}
+
+unsigned
+AnimationClip::GetSizeInBytes() const {
+    return mBase.mChannels.size() * sizeof(float) + mTracks.size() * (sizeof(unsigned) + 2 * sizeof(float)) + mKeys.size() * sizeof(unsigned short);
+}
+
+void
+AnimationClip::RunBenchmark(unsigned instanceCount, JobSystem& jobs) {
+    const unsigned Iterations = 50;
+    const unsigned BoneCount = 64;
+    const float DT = 1.0f / 60.0f;
+
+    // Binary tree of bones a short step apart, rest pose is the bind pose
+    Skeleton Bones;
+    std::vector<glm::mat4> RestGlobals(BoneCount);
+    for (unsigned Bone = 0; Bone < BoneCount; ++Bone) {
+        int Parent = Bone ? (int)(Bone - 1) / 2 : -1;
+        glm::mat4 Local = glm::translate(glm::mat4(1.0f), glm::vec3(Bone % 2 ? 0.1f : -0.1f, 0.2f, 0.0f));
+        RestGlobals[Bone] = Parent < 0 ? Local : RestGlobals[Parent] * Local;
+        Bones.Names.push_back("Bone" + std::to_string(Bone));
+        Bones.Parents.push_back(Parent);
+        Bones.RestLocal.push_back(Local);
+        Bones.InverseBind.push_back(glm::inverse(RestGlobals[Bone]));
+    }
+
+    // Two gaits: every bone swings around its own axis, the root also bobs. Scales stay constant
+    std::vector<AnimationClip> Clips;
+    std::vector<std::vector<float> > RawFrames;
+    const float Speeds[] = { 1.0f, 1.6f };
+    for (float Speed : Speeds) {
+        unsigned FrameCount = (unsigned)(ANIMATION_SAMPLE_RATE / Speed);
+        std::vector<float> Frames(FrameCount * BoneCount * ANIMATION_CHANNELS);
+        for (unsigned Frame = 0; Frame < FrameCount; ++Frame) {
+            float Phase = 6.28318531f * Frame / FrameCount;
+            for (unsigned Bone = 0; Bone < BoneCount; ++Bone) {
+                glm::vec3 Axis = glm::normalize(glm::vec3(std::sin(Bone * 1.3f), std::cos(Bone * 0.7f), 0.5f));
+                glm::quat Rotation = glm::angleAxis(0.4f * std::sin(Phase + Bone * 0.2f), Axis);
+                float Bob = Bone ? 0.0f : 0.05f * std::sin(2.0f * Phase);
+                const float Channels[ANIMATION_CHANNELS] = { Rotation.x, Rotation.y, Rotation.z, Rotation.w, Bone % 2 ? 0.1f : -0.1f, 0.2f + Bob, 0.0f, 1.0f, 1.0f, 1.0f };
+                std::copy(Channels, Channels + ANIMATION_CHANNELS, &Frames[(Frame * BoneCount + Bone) * ANIMATION_CHANNELS]);
+            }
+        }
+        Clips.push_back(AnimationClip(Speed > 1.0f ? "Run" : "Walk", BoneCount, FrameCount, Frames));
+        RawFrames.push_back(Frames);
+    }
+
+    // Quantization error against the source keys
+    float MaxError = 0.0f;
+    AnimationPose Decoded(BoneCount);
+    for (unsigned Frame = 0; Frame < Clips[0].mFrameCount; ++Frame) {
+        Clips[0].Sample(Frame / ANIMATION_SAMPLE_RATE, Decoded);
+        for (unsigned Bone = 0; Bone < BoneCount; ++Bone) {
+            const float* Source = &RawFrames[0][(Frame * BoneCount + Bone) * ANIMATION_CHANNELS];
+            float Dot = 0.0f;
+            for (unsigned Component = 0; Component < 4; ++Component) {
+                Dot += Source[Component] * Decoded.GetChannel(ROTATION_CHANNEL + Component)[Bone];
+            }
+            for (unsigned Channel = 0; Channel < ANIMATION_CHANNELS; ++Channel) {
+                float Sign = Channel < TRANSLATION_CHANNEL && Dot < 0.0f ? -1.0f : 1.0f;
+                MaxError = std::max(MaxError, std::abs(Source[Channel] * Sign - Decoded.GetChannel(Channel)[Bone]));
+            }
+        }
+    }
+    unsigned RawSize = RawFrames[0].size() * sizeof(float);
+    std::cout << "Animation benchmark: " << instanceCount << " instances, " << BoneCount << " bones, 2 blended clips, " << Iterations << " steps" << std::endl;
+    std::cout << "  clip " << RawSize << " -> " << Clips[0].GetSizeInBytes() << " bytes, " << Clips[0].mTracks.size() << " of " << BoneCount * ANIMATION_CHANNELS
+        << " tracks animated, max error " << MaxError << std::endl;
+
+    std::vector<AnimationPose> Walks(instanceCount, AnimationPose(BoneCount));
+    std::vector<AnimationPose> Runs(instanceCount, AnimationPose(BoneCount));
+    std::vector<float> Skinning(instanceCount * BoneCount * ANIMATION_MATRIX_FLOATS);
+    std::vector<float> ReferenceSkinning(Skinning.size());
+    auto Animate = [&](unsigned begin, unsigned end, float time, bool scalar, float* out) {
+        for (unsigned Instance = begin; Instance < end; ++Instance) {
+            float InstanceTime = time + Instance * 0.37f;
+            float Weight = 0.5f + 0.5f * std::sin(InstanceTime * 0.5f);
+            glm::mat4 Model = glm::translate(glm::mat4(1.0f), glm::vec3((float)(Instance % 32), 0.0f, (float)(Instance / 32)));
+            if (scalar) {
+                Clips[0].sampleScalar(InstanceTime, Walks[Instance]);
+                Clips[1].sampleScalar(InstanceTime, Runs[Instance]);
+                AnimationPose::blendScalar(Walks[Instance], Runs[Instance], Weight, Walks[Instance]);
+            } else {
+                Clips[0].Sample(InstanceTime, Walks[Instance]);
+                Clips[1].Sample(InstanceTime, Runs[Instance]);
+                AnimationPose::Blend(Walks[Instance], Runs[Instance], Weight, Walks[Instance]);
+            }
+            Walks[Instance].ComputeSkinning(Bones, Model, out + Instance * BoneCount * ANIMATION_MATRIX_FLOATS);
+        }
+    };
+
+    typedef std::chrono::high_resolution_clock Clock;
+    Clock::time_point Start = Clock::now();
+    for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration) {
+        Animate(0, instanceCount, Iteration * DT, true, ReferenceSkinning.data());
+    }
+    double ScalarTime = std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / Iterations;
+    std::cout << "  scalar: " << ScalarTime << " ms" << std::endl;
+
+    Start = Clock::now();
+    for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration) {
+        Animate(0, instanceCount, Iteration * DT, false, Skinning.data());
+    }
+    double SimdTime = std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / Iterations;
+    float SkinningError = 0.0f;
+    for (unsigned Idx = 0; Idx < Skinning.size(); ++Idx) {
+        SkinningError = std::max(SkinningError, std::abs(Skinning[Idx] - ReferenceSkinning[Idx]));
+    }
+    std::cout << "  " << (SIMD_SSE ? "SSE" : "scalar") << ": " << SimdTime << " ms, " << ScalarTime / SimdTime << "x, max error " << SkinningError << std::endl;
+
+    Start = Clock::now();
+    for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration) {
+        float Time = Iteration * DT;
+        jobs.ParallelFor(instanceCount, ANIMATION_JOB_SIZE, [&](unsigned begin, unsigned end) {
+            Animate(begin, end, Time, false, Skinning.data());
+        });
+    }
+    double ThreadedTime = std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / Iterations;
+    std::cout << "  " << (SIMD_SSE ? "SSE" : "scalar") << " x" << jobs.GetThreadCount() << " threads: " << ThreadedTime << " ms, " << ScalarTime / ThreadedTime << "x" << std::endl;
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <iostream>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <assimp/scene.h>
+#include "simd.hpp"
+#include "job_system.hpp"
+
+// Bones per skeleton. Vertices store bone indices as floats, the shader reads them as ints
+#define ANIMATION_MAX_BONES 128
+// Bones influencing one vertex, the weakest ones are dropped and the rest renormalized
+#define ANIMATION_BONES_PER_VERTEX 4
+// Clips are resampled to uniform keys at this rate, so sampling is two key lookups per frame
+#define ANIMATION_SAMPLE_RATE 30.0f
+// Channels of a local bone transform: rotation quaternion XYZW, translation XYZ, scale XYZ
+#define ANIMATION_CHANNELS 10
+// Floats per skinning matrix, the top three rows of the affine bone transform
+#define ANIMATION_MATRIX_FLOATS 12
+// Animated instances per job
+#define ANIMATION_JOB_SIZE 16
+// Tracks that vary less than this over the clip are stored as a single value
+#define ANIMATION_CONSTANT_EPSILON 1e-5f
+
+/**
+ * @brief Bone hierarchy of a rigged model. Parents always come before their children, so
+ * model space transforms are composed in one pass over the bones
+ */
+struct Skeleton {
+    std::vector<std::string> Names;
+    // -1 for roots
+    std::vector<int> Parents;
+    // Model space to bone space in the bind pose
+    std::vector<glm::mat4> InverseBind;
+    // Local transforms used for bones a clip doesn't animate
+    std::vector<glm::mat4> RestLocal;
+
+    /**
+     * @brief Builds the skeleton from the nodes referenced by mesh bones and their ancestors
+     *
+     * @param scene Assimp scene
+     *
+     * @returns Skeleton, empty if no mesh has bones
+     */
+    static Skeleton FromScene(const aiScene* scene);
+
+    /**
+     * @brief Returns bone index, -1 if there is no bone with that name
+     */
+    int Find(const std::string& name) const;
+
+    /**
+     * @brief Returns number of bones
+     */
+    unsigned GetCount() const;
+};
+
+/**
+ * @brief Local transforms of all bones, stored SoA: ANIMATION_CHANNELS arrays of
+ * GetStride() floats, each padded to SIMD_WIDTH
+ */
+class AnimationPose {
+public:
+    AnimationPose();
+
+    /**
+     * @brief Ctor - identity transforms
+     *
+     * @param boneCount Number of bones
+     */
+    AnimationPose(unsigned boneCount);
+
+    float* GetChannel(unsigned channel);
+    const float* GetChannel(unsigned channel) const;
+    unsigned GetBoneCount() const;
+    unsigned GetStride() const;
+
+    /**
+     * @brief Blends two poses of the same skeleton. Rotations take the shorter way and are renormalized
+     *
+     * @param a Pose at weight 0
+     * @param b Pose at weight 1
+     * @param weight Weight of b
+     * @param out Result, can be a or b
+     */
+    static void Blend(const AnimationPose& a, const AnimationPose& b, float weight, AnimationPose& out);
+
+    /**
+     * @brief Composes model space transforms and writes skinning matrices in the
+     * ANIMATION_MATRIX_FLOATS layout read by shaders/skinned.vert
+     *
+     * @param skeleton Skeleton of the pose
+     * @param model Model matrix, folded into the skinning matrices
+     * @param out skeleton.GetCount() * ANIMATION_MATRIX_FLOATS floats
+     */
+    void ComputeSkinning(const Skeleton& skeleton, const glm::mat4& model, float* out) const;
+
+private:
+    unsigned mBoneCount;
+    unsigned mStride;
+    std::vector<float> mChannels;
+
+    friend class AnimationClip;
+    static void blendScalar(const AnimationPose& a, const AnimationPose& b, float weight, AnimationPose& out);
+};
+
+/**
+ * @brief Looping skeletal animation. Keys are resampled at ANIMATION_SAMPLE_RATE and every
+ * track that changes over the clip is quantized to 16 bits within its own range. Constant
+ * tracks (most scales and many translations) keep one value in the base pose and no keys.
+ * Keys of one frame are stored together, so sampling decodes two frames SIMD_WIDTH tracks at
+ * a time and interpolates between them. Doesn't touch OpenGL
+ */
+class AnimationClip {
+public:
+    std::string mName;
+
+    AnimationClip();
+
+    /**
+     * @brief Ctor - compresses uniformly sampled local transforms
+     *
+     * @param name Clip name
+     * @param boneCount Number of bones
+     * @param frameCount Number of frames, the clip loops from the last one back to the first
+     * @param frames frameCount * boneCount * ANIMATION_CHANNELS floats, frame major
+     */
+    AnimationClip(const std::string& name, unsigned boneCount, unsigned frameCount, const std::vector<float>& frames);
+
+    /**
+     * @brief Resamples and compresses an Assimp animation. Bones without a channel keep their rest transform
+     *
+     * @param animation Assimp animation
+     * @param skeleton Skeleton the channels are matched to by name
+     *
+     * @returns Clip
+     */
+    static AnimationClip FromAssimp(const aiAnimation* animation, const Skeleton& skeleton);
+
+    /**
+     * @brief Samples the clip
+     *
+     * @param time Time in seconds, wraps around the clip
+     * @param pose Result, has to have the clip's bone count
+     */
+    void Sample(float time, AnimationPose& pose) const;
+
+    float GetDuration() const;
+    unsigned GetBoneCount() const;
+
+    /**
+     * @brief Returns compressed size in bytes
+     */
+    unsigned GetSizeInBytes() const;
+
+    /**
+     * @brief Times sampling, blending and skinning of many instances with a synthetic
+     * skeleton, compares the SIMD path against a scalar one and prints the results
+     *
+     * @param instanceCount Number of animated instances
+     * @param jobs Job system for the threaded run
+     */
+    static void RunBenchmark(unsigned instanceCount, JobSystem& jobs);
+
+private:
+    unsigned mBoneCount;
+    unsigned mFrameCount;
+    // Constant tracks and the starting values of the animated ones
+    AnimationPose mBase;
+    // Animated tracks as offsets into the pose channel arrays, padded to SIMD_WIDTH with a repeat of the last one
+    std::vector<unsigned> mTracks;
+    std::vector<float> mTrackMin;
+    std::vector<float> mTrackScale;
+    // mFrameCount rows of mTracks.size() quantized values
+    std::vector<unsigned short> mKeys;
+
+    void sampleScalar(float time, AnimationPose& pose) const;
+    void frameAt(float time, unsigned& first, unsigned& second, float& weight) const;
+};
@@ -0,0 +1,227 @@
+#include "asset_pack.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+AssetPack::AssetPack() {
+    mData = 0;
+    mSize = 0;
+    mEntries = 0;
+    mEntryCount = 0;
+    mModificationTime = 0;
+    mFile = 0;
+    mMapping = 0;
+}
+
+AssetPack::~AssetPack() {
+    Close();
+}
+
+bool
+AssetPack::Open(const std::string& path) {
+    Close();
+#ifdef _WIN32
+    HANDLE File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (File == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER FileSize;
+    FILETIME WriteTime;
+    HANDLE Mapping = 0;
+    if (GetFileSizeEx(File, &FileSize) && GetFileTime(File, NULL, NULL, &WriteTime) && FileSize.QuadPart > 0) {
+        Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    const void* View = Mapping ? MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+    if (!View) {
+        if (Mapping) {
+            CloseHandle(Mapping);
+        }
+        CloseHandle(File);
+        std::cerr << "[Err] Failed to map asset pack " << path << std::endl;
+        return false;
+    }
+    mFile = File;
+    mMapping = Mapping;
+    mData = (const unsigned char*)View;
+    mSize = (size_t)FileSize.QuadPart;
+    // Same epoch and unit as stat, so it compares with source times
+    ULARGE_INTEGER Time;
+    Time.LowPart = WriteTime.dwLowDateTime;
+    Time.HighPart = WriteTime.dwHighDateTime;
+    mModificationTime = (long long)(Time.QuadPart / 10000000ull) - 11644473600ll;
+#else
+    int File = open(path.c_str(), O_RDONLY);
+    if (File < 0) {
+        return false;
+    }
+    struct stat Info;
+    void* View = MAP_FAILED;
+    if (!fstat(File, &Info) && Info.st_size > 0) {
+        View = mmap(0, Info.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+    }
+    // The mapping keeps the file alive
+    close(File);
+    if (View == MAP_FAILED) {
+        std::cerr << "[Err] Failed to map asset pack " << path << std::endl;
+        return false;
+    }
+    mMapping = View;
+    mData = (const unsigned char*)View;
+    mSize = Info.st_size;
+    mModificationTime = (long long)Info.st_mtime;
+#endif
+
+    Header PackHeader;
+    bool Valid = mSize >= sizeof(Header);
+    if (Valid) {
+        PackHeader = *(const Header*)mData;
+        Valid = PackHeader.Magic == ASSET_PACK_MAGIC && PackHeader.Version == ASSET_PACK_VERSION && PackHeader.TocOffset % sizeof(unsigned long long) == 0
+            && PackHeader.TocOffset <= mSize && (mSize - PackHeader.TocOffset) / sizeof(Entry) >= PackHeader.EntryCount;
+    }
+    if (!Valid) {
+        std::cerr << "[Err] Asset pack " << path << " is malformed or from another version" << std::endl;
+        Close();
+        return false;
+    }
+
+    mEntries = (const Entry*)(mData + PackHeader.TocOffset);
+    mEntryCount = PackHeader.EntryCount;
+    for (unsigned EntryIdx = 0; EntryIdx < mEntryCount; ++EntryIdx) {
+        if (mEntries[EntryIdx].Offset > mSize || mEntries[EntryIdx].Size > mSize - mEntries[EntryIdx].Offset) {
+            std::cerr << "[Err] Asset pack " << path << " has an entry outside the file" << std::endl;
+            Close();
+            return false;
+        }
+    }
+    std::cout << "Mapped asset pack " << path << ": " << mEntryCount << " assets, " << mSize / (1024 * 1024) << " MB" << std::endl;
+    return true;
+}
+
+void
+AssetPack::Close() {
+#ifdef _WIN32
+    if (mData) {
+        UnmapViewOfFile(mData);
+    }
+    if (mMapping) {
+        CloseHandle((HANDLE)mMapping);
+    }
+    if (mFile) {
+        CloseHandle((HANDLE)mFile);
+    }
+#else
+    if (mMapping) {
+        munmap(mMapping, mSize);
+    }
+#endif
+    mData = 0;
+    mSize = 0;
+    mEntries = 0;
+    mEntryCount = 0;
+    mFile = 0;
+    mMapping = 0;
+}
+
+bool
+AssetPack::IsOpen() const {
+    return mData != 0;
+}
+
+bool
+AssetPack::Find(const std::string& name, AssetSpan& span) const {
+    const unsigned long long Hash = HashName(name);
+    const Entry* End = mEntries + mEntryCount;
+    const Entry* Found = std::lower_bound(mEntries, End, Hash, [](const Entry& entry, unsigned long long hash) {
+        return entry.NameHash < hash;
+    });
+    if (Found == End || Found->NameHash != Hash) {
+        return false;
+    }
+
+    span.Data = mData + Found->Offset;
+    span.Size = (size_t)Found->Size;
+    return true;
+}
+
+unsigned
+AssetPack::GetCount() const {
+    return mEntryCount;
+}
+
+long long
+AssetPack::GetModificationTime() const {
+    return mModificationTime;
+}
+
+bool
+AssetPack::Write(const std::string& path, const std::vector<std::string>& names, const std::vector<std::string>& files) {
+    std::ofstream Out(path, std::ios::binary | std::ios::trunc);
+    if (!Out) {
+        std::cerr << "[Err] Failed to create asset pack " << path << std::endl;
+        return false;
+    }
+
+    // Header is rewritten once the table offset is known
+    Header PackHeader = { ASSET_PACK_MAGIC, ASSET_PACK_VERSION, (unsigned)names.size(), 0, 0 };
+    Out.write((const char*)&PackHeader, sizeof(Header));
+    unsigned long long Offset = sizeof(Header);
+    const char Padding[ASSET_PACK_ALIGNMENT] = {};
+    std::vector<Entry> Entries;
+    Entries.reserve(names.size());
+    for (unsigned FileIdx = 0; FileIdx < names.size(); ++FileIdx) {
+        std::ifstream In(files[FileIdx], std::ios::binary);
+        if (!In) {
+            std::cerr << "[Err] Failed to read " << files[FileIdx] << " into the asset pack" << std::endl;
+            return false;
+        }
+        std::vector<char> Data((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+
+        unsigned long long Aligned = (Offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+        Out.write(Padding, Aligned - Offset);
+        Out.write(Data.data(), Data.size());
+        Entry CurrEntry = { HashName(names[FileIdx]), Aligned, Data.size() };
+        Entries.push_back(CurrEntry);
+        Offset = Aligned + Data.size();
+    }
+
+    std::sort(Entries.begin(), Entries.end(), [](const Entry& a, const Entry& b) {
+        return a.NameHash < b.NameHash;
+    });
+    for (unsigned EntryIdx = 1; EntryIdx < Entries.size(); ++EntryIdx) {
+        if (Entries[EntryIdx].NameHash == Entries[EntryIdx - 1].NameHash) {
+            std::cerr << "[Err] Two assets share a name hash, the asset pack can't tell them apart" << std::endl;
+            return false;
+        }
+    }
+
+    unsigned long long TocOffset = (Offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+    Out.write(Padding, TocOffset - Offset);
+    if (!Entries.empty()) {
+        Out.write((const char*)Entries.data(), Entries.size() * sizeof(Entry));
+    }
+    PackHeader.TocOffset = TocOffset;
+    Out.seekp(0);
+    Out.write((const char*)&PackHeader, sizeof(Header));
+    return (bool)Out;
+}
+
+unsigned long long
+AssetPack::HashName(const std::string& name) {
+    unsigned long long Hash = 14695981039346656037ull;
+    for (unsigned char Char : name) {
+        Hash ^= Char;
+        Hash *= 1099511628211ull;
+    }
+    return Hash;
+}
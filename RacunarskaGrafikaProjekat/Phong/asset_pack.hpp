@@ -0,0 +1,107 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Magic number of pack files, "PACK" in the file
+#define ASSET_PACK_MAGIC 0x4B434150
+#define ASSET_PACK_VERSION 1
+// Blob alignment in the pack. Cache line sized, so data read straight from the mapping is aligned for SIMD loads and uploads
+#define ASSET_PACK_ALIGNMENT 64
+
+/**
+ * @brief Bytes of one asset inside a mapped pack
+ */
+struct AssetSpan {
+    const unsigned char* Data = 0;
+    size_t Size = 0;
+};
+
+/**
+ * @brief Read-only archive of many assets in one file. Blobs are aligned to ASSET_PACK_ALIGNMENT and
+ * followed by a table of contents sorted by the 64 bit FNV-1a hash of each asset name. The file is
+ * memory mapped once, lookups binary search the table and return spans into the mapping, so nothing
+ * is opened or copied per asset and the OS pages blobs in when they are first touched
+ */
+class AssetPack {
+public:
+    AssetPack();
+
+    /**
+     * @brief Dtor - unmaps the pack. Spans returned by Find are invalid afterwards
+     */
+    ~AssetPack();
+
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    /**
+     * @brief Maps a pack file and checks its header and table of contents
+     *
+     * @param path Pack file path
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Open(const std::string& path);
+
+    void Close();
+
+    bool IsOpen() const;
+
+    /**
+     * @brief Finds an asset by name
+     *
+     * @param name Asset name the pack was written with
+     * @param span Output bytes, pointing into the mapping
+     *
+     * @returns false if the pack has no such asset
+     */
+    bool Find(const std::string& name, AssetSpan& span) const;
+
+    unsigned GetCount() const;
+
+    /**
+     * @brief Returns the pack file's modification time, taken when it was opened
+     */
+    long long GetModificationTime() const;
+
+    /**
+     * @brief Writes a pack from loose files. Used by the offline cooker
+     *
+     * @param path Pack file path
+     * @param names Asset names, looked up by Find
+     * @param files Files holding each asset's bytes, in the order of names
+     *
+     * @returns false if a file can't be read, two names share a hash or the pack can't be written
+     */
+    static bool Write(const std::string& path, const std::vector<std::string>& names, const std::vector<std::string>& files);
+
+    /**
+     * @brief Returns the hash assets are looked up by
+     */
+    static unsigned long long HashName(const std::string& name);
+
+private:
+    struct Header {
+        unsigned Magic;
+        unsigned Version;
+        unsigned EntryCount;
+        unsigned Reserved;
+        unsigned long long TocOffset;
+    };
+
+    struct Entry {
+        unsigned long long NameHash;
+        unsigned long long Offset;
+        unsigned long long Size;
+    };
+
+    const unsigned char* mData;
+    size_t mSize;
+    const Entry* mEntries;
+    unsigned mEntryCount;
+    long long mModificationTime;
+    // Platform handles of the mapping
+    void* mFile;
+    void* mMapping;
+};
@@ -10,20 +10,39 @@ Camera::Camera() {
     mMoveSpeed = 18.0f;
     mLookSpeed = 64.0f;
     mPlayerHeight = 2.0f;
+    mPendingMove = glm::vec2(0.0f);
+    mPendingRotation = glm::vec2(0.0f);
+    mFieldOfView = 45.0f;
+    mAspectRatio = 1.0f;
+    mNearPlane = 0.1f;
+    mFarPlane = 100.0f;
+    mViewDirty = true;
+    mProjectionDirty = true;
+    mViewProjectionDirty = true;
+    mFrustumDirty = true;
     updateVectors();
 }
 
 void
 Camera::Move(float dx, float dy, float dt) {
-    mPosition += (dx * mRight + dy * mFront) * mMoveSpeed * dt;
-    updateVectors();
+    mPendingMove += glm::vec2(dx, dy) * mMoveSpeed * dt;
 }
 
 void 
 Camera::Rotate(float dx, float dy, float dt) {
-    float RotateVelocity = mLookSpeed * dt;
-    mYaw += dx * RotateVelocity;
-    mPitch += dy * RotateVelocity;
+    mPendingRotation += glm::vec2(dx, dy) * mLookSpeed * dt;
+}
+
+void
+Camera::Update() {
+    if (mPendingMove == glm::vec2(0.0f) && mPendingRotation == glm::vec2(0.0f)) {
+        return;
+    }
+
+    // Movement uses the orientation from before this frame's rotation
+    mPosition += mPendingMove.x * mRight + mPendingMove.y * mFront;
+    mYaw += mPendingRotation.x;
+    mPitch += mPendingRotation.y;
 
     if (mPitch > 89.0f) {
         mPitch = 89.0f;
@@ -32,25 +51,77 @@ Camera::Rotate(float dx, float dy, float dt) {
         mPitch = -89.0f;
     }
 
+    mPendingMove = glm::vec2(0.0f);
+    mPendingRotation = glm::vec2(0.0f);
     updateVectors();
+    mViewDirty = true;
+    mViewProjectionDirty = true;
+    mFrustumDirty = true;
+}
+
+void
+Camera::SetPerspective(float fieldOfView, float aspectRatio, float nearPlane, float farPlane) {
+    mFieldOfView = fieldOfView;
+    mAspectRatio = aspectRatio;
+    mNearPlane = nearPlane;
+    mFarPlane = farPlane;
+    mProjectionDirty = true;
+    mViewProjectionDirty = true;
+    mFrustumDirty = true;
 }
 
 
 glm::vec3 
-Camera::GetPosition() {
+Camera::GetPosition() const {
     return mPosition;
 }
 
 glm::vec3
-Camera::GetTarget() {
+Camera::GetTarget() const {
     return mPosition + mFront;
 }
 
 glm::vec3
-Camera::GetUp() {
+Camera::GetUp() const {
     return mUp;
 }
 
+const glm::mat4&
+Camera::GetView() const {
+    if (mViewDirty) {
+        mView = glm::lookAt(mPosition, mPosition + mFront, mUp);
+        mViewDirty = false;
+    }
+    return mView;
+}
+
+const glm::mat4&
+Camera::GetProjection() const {
+    if (mProjectionDirty) {
+        mProjection = glm::perspective(mFieldOfView, mAspectRatio, mNearPlane, mFarPlane);
+        mProjectionDirty = false;
+    }
+    return mProjection;
+}
+
+const glm::mat4&
+Camera::GetViewProjection() const {
+    if (mViewProjectionDirty) {
+        mViewProjection = GetProjection() * GetView();
+        mViewProjectionDirty = false;
+    }
+    return mViewProjection;
+}
+
+const Frustum&
+Camera::GetFrustum() const {
+    if (mFrustumDirty) {
+        mFrustum = Frustum::FromMatrix(GetViewProjection());
+        mFrustumDirty = false;
+    }
+    return mFrustum;
+}
+
 void 
 Camera::updateVectors() {
     mFront.x = cos(glm::radians(mYaw)) * cos(glm::radians(mPitch));
@@ -64,4 +135,4 @@ Camera::updateVectors() {
         : mPosition.y > mPlayerHeight
             ? mPlayerHeight
             : mPosition.y;
-}
\ No newline at end of file
+}
@@ -3,20 +3,22 @@
 #include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "frustum.hpp"
 
 class Camera {
 public:
     Camera();
 
     /**
-     * @brief Moves camera in specified direction
+     * @brief Queues movement in specified direction. Applied by the next Update call
      * 
      * @param dir Direction
      * @param dt Delta time
      */
     void Move(float dx, float dy, float dt);
     /**
-     * @brief Rotates camera depending on difference between previous and current cursor position
+     * @brief Queues rotation depending on difference between previous and current cursor position.
+     * Applied by the next Update call
      *
      * @param dx Delta x
      * @param dy Delta y
@@ -24,27 +26,62 @@ public:
      */
     void Rotate(float dx, float dy, float dt);
 
+    /**
+     * @brief Applies movement and rotation queued since the last call. Should be called once per frame,
+     * after input handling and before any of the matrices are read
+     */
+    void Update();
+
+    /**
+     * @brief Sets perspective projection parameters. Only needs calling when they change, e.g. on resize
+     *
+     * @param fieldOfView Vertical field of view passed to glm::perspective
+     * @param aspectRatio Viewport width / height
+     * @param nearPlane Near clip plane distance
+     * @param farPlane Far clip plane distance
+     */
+    void SetPerspective(float fieldOfView, float aspectRatio, float nearPlane, float farPlane);
+
     /**
      * @brief Returns position vector
      *
      * @returns Position vector
      */
-    glm::vec3 GetPosition();
+    glm::vec3 GetPosition() const;
 
     /**
      * @brief Returns target vector
      *
      * @returns Target vector
      */
-    glm::vec3 GetTarget();
+    glm::vec3 GetTarget() const;
 
     /**
      * @brief Returns up vector
      *
      * @returns Up vector
      */
-    glm::vec3 GetUp();
+    glm::vec3 GetUp() const;
+
+    /**
+     * @brief Returns view matrix, rebuilt only after the camera moved or rotated
+     */
+    const glm::mat4& GetView() const;
+
+    /**
+     * @brief Returns projection matrix, rebuilt only after SetPerspective
+     */
+    const glm::mat4& GetProjection() const;
 
+    /**
+     * @brief Returns projection * view matrix
+     */
+    const glm::mat4& GetViewProjection() const;
+
+    /**
+     * @brief Returns world space frustum extracted from the view projection matrix
+     */
+    const Frustum& GetFrustum() const;
 
 private:
     glm::vec3 mWorldUp;
@@ -60,5 +97,25 @@ private:
     float mPitch;
     float mYaw;
     float mPlayerHeight;
+
+    // Input queued by Move and Rotate, in units of speed * time
+    glm::vec2 mPendingMove;
+    glm::vec2 mPendingRotation;
+
+    float mFieldOfView;
+    float mAspectRatio;
+    float mNearPlane;
+    float mFarPlane;
+
+    // Derived values are rebuilt lazily, dirty flags are cleared by the getters
+    mutable glm::mat4 mView;
+    mutable glm::mat4 mProjection;
+    mutable glm::mat4 mViewProjection;
+    mutable Frustum mFrustum;
+    mutable bool mViewDirty;
+    mutable bool mProjectionDirty;
+    mutable bool mViewProjectionDirty;
+    mutable bool mFrustumDirty;
+
     void updateVectors();
-};
\ No newline at end of file
+};
@@ -0,0 +1,174 @@
+#include "cooked.hpp"
+#include <sys/types.h>
+#include <sys/stat.h>
+
+const AssetPack* CookedFile::mPack = 0;
+FileIO* CookedFile::mIO = 0;
+
+CookedReader::CookedReader() {
+    mData = 0;
+    mSize = 0;
+    mOffset = 0;
+}
+
+void
+CookedReader::Reset(const AssetSpan& span) {
+    mStorage.clear();
+    mData = span.Data;
+    mSize = span.Size;
+    mOffset = 0;
+}
+
+bool
+CookedReader::Load(const std::string& path) {
+    if (!CookedFile::ReadFile(path, mStorage)) {
+        return false;
+    }
+    mData = mStorage.data();
+    mSize = mStorage.size();
+    mOffset = 0;
+    return true;
+}
+
+bool
+CookedReader::IsMapped() const {
+    return mData && mStorage.empty();
+}
+
+const unsigned char*
+CookedReader::ReadSpan(size_t size) {
+    if (size > mSize - mOffset) {
+        return 0;
+    }
+
+    const unsigned char* Bytes = mData + mOffset;
+    mOffset += size;
+    return Bytes;
+}
+
+bool
+CookedReader::ReadString(std::string& value) {
+    unsigned Size = 0;
+    if (!Read(Size)) {
+        return false;
+    }
+    const unsigned char* Bytes = ReadSpan(Size);
+    if (!Bytes) {
+        return false;
+    }
+    value.assign((const char*)Bytes, Size);
+    return true;
+}
+
+std::string
+CookedFile::GetPath(const std::string& sourcePath, const std::string& extension) {
+    return COOKED_DIRECTORY + sourcePath + extension;
+}
+
+void
+CookedFile::SetPack(const AssetPack* pack) {
+    mPack = pack;
+}
+
+void
+CookedFile::SetIO(FileIO* io) {
+    mIO = io;
+}
+
+void
+CookedFile::Prefetch(const std::vector<std::string>& sourcePaths, const std::string& extension, EIOPriority priority) {
+    if (!mIO) {
+        return;
+    }
+
+    // Picks the same file OpenRead will, so the prefetch is what gets claimed
+    std::vector<std::string> Paths;
+    for (const std::string& SourcePath : sourcePaths) {
+        const std::string Path = GetPath(SourcePath, extension);
+        AssetSpan Span;
+        if (mPack && mPack->Find(Path, Span) && !(COOKED_PACK_CHECK_SOURCES && mPack->GetModificationTime() < getModificationTime(SourcePath))) {
+            continue;
+        }
+        Paths.push_back(isCurrent(Path, SourcePath) ? Path : SourcePath);
+    }
+    mIO->Prefetch(Paths, priority);
+}
+
+bool
+CookedFile::ReadFile(const std::string& path, std::vector<unsigned char>& data) {
+    if (mIO && mIO->Take(path, data)) {
+        return true;
+    }
+
+    std::ifstream In(path, std::ios::binary | std::ios::ate);
+    if (!In) {
+        return false;
+    }
+    data.resize((size_t)In.tellg());
+    In.seekg(0);
+    return data.empty() || (bool)In.read((char*)data.data(), data.size());
+}
+
+bool
+CookedFile::OpenRead(const std::string& sourcePath, const std::string& extension, unsigned magic, CookedReader& reader) {
+    const std::string Path = GetPath(sourcePath, extension);
+    AssetSpan Span;
+    if (mPack && mPack->Find(Path, Span)) {
+        // Sources edited after the pack was written win, the next build cooks them again
+        if (COOKED_PACK_CHECK_SOURCES && mPack->GetModificationTime() < getModificationTime(sourcePath)) {
+            return false;
+        }
+        reader.Reset(Span);
+        if (readHeader(reader, magic)) {
+            return true;
+        }
+    }
+
+    return isCurrent(Path, sourcePath) && reader.Load(Path) && readHeader(reader, magic);
+}
+
+bool
+CookedFile::OpenWrite(const std::string& sourcePath, const std::string& extension, unsigned magic, std::ofstream& out) {
+    const std::string Path = GetPath(sourcePath, extension);
+    out.open(Path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "[Err] Failed to create cooked file " << Path << std::endl;
+        return false;
+    }
+
+    Write(out, magic);
+    Write(out, (unsigned)COOKED_VERSION);
+    return true;
+}
+
+void
+CookedFile::WriteString(std::ostream& out, const std::string& value) {
+    Write(out, (unsigned)value.size());
+    out.write(value.data(), value.size());
+}
+
+bool
+CookedFile::readHeader(CookedReader& reader, unsigned magic) {
+    unsigned Magic = 0;
+    unsigned Version = 0;
+    if (!reader.Read(Magic) || !reader.Read(Version) || Magic != magic || Version != COOKED_VERSION) {
+        std::cerr << "[Err] Ignoring stale cooked file of a different format" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool
+CookedFile::isCurrent(const std::string& cookedPath, const std::string& sourcePath) {
+    long long CookedTime = getModificationTime(cookedPath);
+    return CookedTime && CookedTime >= getModificationTime(sourcePath);
+}
+
+long long
+CookedFile::getModificationTime(const std::string& path) {
+    struct stat Info;
+    if (stat(path.c_str(), &Info)) {
+        return 0;
+    }
+    return (long long)Info.st_mtime;
+}
@@ -0,0 +1,222 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <iostream>
+#include "asset_pack.hpp"
+#include "file_io.hpp"
+
+// Cooked assets mirror the source tree under this directory: res/sand.png -> cooked/res/sand.png.tex
+#define COOKED_DIRECTORY "cooked/"
+// Bumped whenever a cooked format changes, files of other versions are ignored and recooked
+#define COOKED_VERSION 2
+// Magic numbers of the cooked formats, "CTEX", "CMDL" and "CSHD" in the file
+#define COOKED_TEXTURE_MAGIC 0x58455443
+#define COOKED_MODEL_MAGIC 0x4C444D43
+#define COOKED_SHADER_MAGIC 0x44485343
+// Extensions appended to the source names
+#define COOKED_TEXTURE_EXTENSION ".tex"
+#define COOKED_MODEL_EXTENSION ".model"
+#define COOKED_SHADER_EXTENSION ".glsl"
+// All cooked files in one mapped archive, rewritten by the cooker whenever one of them changes
+#define COOKED_PACK_PATH COOKED_DIRECTORY "assets.pack"
+// Compares pack entries against their sources, so edited assets win before the next cook. Costs a stat per asset
+#ifdef _DEBUG
+#define COOKED_PACK_CHECK_SOURCES true
+#else
+#define COOKED_PACK_CHECK_SOURCES false
+#endif
+
+/**
+ * @brief Read cursor over one cooked file in memory. Pack entries are read in place from the
+ * mapping, loose cooked files are read whole into the reader first
+ */
+class CookedReader {
+public:
+    CookedReader();
+
+    /**
+     * @brief Points the reader at bytes it doesn't own, e.g. a pack entry
+     */
+    void Reset(const AssetSpan& span);
+
+    /**
+     * @brief Reads a whole file into the reader
+     *
+     * @returns false if the file can't be read
+     */
+    bool Load(const std::string& path);
+
+    /**
+     * @brief Returns true if the bytes live in a pack mapping and stay valid after the reader is gone
+     */
+    bool IsMapped() const;
+
+    /**
+     * @brief Returns the next bytes without copying them and moves past them
+     *
+     * @param size Number of bytes
+     *
+     * @returns Pointer into the cooked file, 0 if it is truncated
+     */
+    const unsigned char* ReadSpan(size_t size);
+
+    /**
+     * @brief Reads a trivially copyable value
+     *
+     * @returns false on a truncated file
+     */
+    template<typename T>
+    bool Read(T& value) {
+        const unsigned char* Bytes = ReadSpan(sizeof(T));
+        if (Bytes) {
+            std::memcpy(&value, Bytes, sizeof(T));
+        }
+        return Bytes != 0;
+    }
+
+    /**
+     * @brief Reads a vector written by CookedFile::WriteVector
+     *
+     * @returns false on a truncated file
+     */
+    template<typename T>
+    bool ReadVector(std::vector<T>& values) {
+        unsigned Count = 0;
+        if (!Read(Count) || Count > (mSize - mOffset) / sizeof(T)) {
+            return false;
+        }
+        const unsigned char* Bytes = ReadSpan(Count * sizeof(T));
+        values.resize(Count);
+        if (Count) {
+            std::memcpy(values.data(), Bytes, Count * sizeof(T));
+        }
+        return true;
+    }
+
+    bool ReadString(std::string& value);
+
+private:
+    const unsigned char* mData;
+    size_t mSize;
+    size_t mOffset;
+    // Contents of loose files, pack entries stay in the mapping
+    std::vector<unsigned char> mStorage;
+};
+
+/**
+ * @brief Binary files written by the offline cooker (Cooker project) and read at startup instead
+ * of parsing the source assets. Every file starts with a magic number and COOKED_VERSION. They are
+ * looked up in the asset pack first and as loose files next. A cooked file older than its source
+ * is ignored, so edited assets work before they are cooked again
+ */
+class CookedFile {
+public:
+    /**
+     * @brief Returns the cooked path of a source asset
+     *
+     * @param sourcePath Source path relative to the working directory
+     * @param extension Extension of the cooked format, appended to the source name
+     */
+    static std::string GetPath(const std::string& sourcePath, const std::string& extension);
+
+    /**
+     * @brief Sets the pack cooked files are looked up in. Has to stay open while assets load
+     *
+     * @param pack Opened pack, 0 reads loose cooked files only
+     */
+    static void SetPack(const AssetPack* pack);
+
+    /**
+     * @brief Sets the IO service prefetched files are claimed from. Has to outlive asset loading
+     *
+     * @param io IO service, 0 reads every file on the calling thread
+     */
+    static void SetIO(FileIO* io);
+
+    /**
+     * @brief Starts background reads of the files OpenRead and ReadFile will need for some assets,
+     * the current cooked file if there is one and the source otherwise. Pack entries need no reads.
+     * Does nothing without an IO service
+     *
+     * @param sourcePaths Source asset paths
+     * @param extension Extension of the assets' cooked format
+     * @param priority IO priority of the reads
+     */
+    static void Prefetch(const std::vector<std::string>& sourcePaths, const std::string& extension, EIOPriority priority = IO_PRIORITY_NORMAL);
+
+    /**
+     * @brief Reads a whole file, claiming it from the IO service if it was prefetched
+     *
+     * @param path File path
+     * @param data Output bytes
+     *
+     * @returns false if the file can't be read
+     */
+    static bool ReadFile(const std::string& path, std::vector<unsigned char>& data);
+
+    /**
+     * @brief Opens a cooked file for reading and checks its header
+     *
+     * @param sourcePath Source asset path
+     * @param extension Extension of the cooked format
+     * @param magic Expected magic number
+     * @param reader Reader positioned after the header on success
+     *
+     * @returns false if there is no current cooked file, the source should be loaded instead
+     */
+    static bool OpenRead(const std::string& sourcePath, const std::string& extension, unsigned magic, CookedReader& reader);
+
+    /**
+     * @brief Creates a cooked file and writes its header. The directory has to exist
+     *
+     * @param sourcePath Source asset path
+     * @param extension Extension of the cooked format
+     * @param magic Magic number of the format
+     * @param out Stream positioned after the header on success
+     *
+     * @returns true - Success, false - Failure
+     */
+    static bool OpenWrite(const std::string& sourcePath, const std::string& extension, unsigned magic, std::ofstream& out);
+
+    /**
+     * @brief Writes a trivially copyable value
+     */
+    template<typename T>
+    static void Write(std::ostream& out, const T& value) {
+        out.write((const char*)&value, sizeof(T));
+    }
+
+    /**
+     * @brief Writes element count and elements of a vector of trivially copyable values
+     */
+    template<typename T>
+    static void WriteVector(std::ostream& out, const std::vector<T>& values) {
+        Write(out, (unsigned)values.size());
+        if (!values.empty()) {
+            out.write((const char*)values.data(), values.size() * sizeof(T));
+        }
+    }
+
+    static void WriteString(std::ostream& out, const std::string& value);
+
+private:
+    static const AssetPack* mPack;
+    static FileIO* mIO;
+
+    /**
+     * @brief Checks the magic number and version at the start of a cooked file
+     */
+    static bool readHeader(CookedReader& reader, unsigned magic);
+
+    /**
+     * @brief Returns true if a loose cooked file exists and isn't older than its source
+     */
+    static bool isCurrent(const std::string& cookedPath, const std::string& sourcePath);
+
+    /**
+     * @brief Returns modification time of a file, 0 if it doesn't exist
+     */
+    static long long getModificationTime(const std::string& path);
+};
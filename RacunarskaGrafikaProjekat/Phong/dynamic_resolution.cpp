@@ -0,0 +1,145 @@
+#include "dynamic_resolution.hpp"
+#include <algorithm>
+#include <cmath>
+#include "memory_accounting.hpp"
+
+// Weight of the newest GPU time in the moving average
+static const float SMOOTHING = 0.2f;
+
+DynamicResolution::DynamicResolution(int width, int height)
+    : mShader("shaders/fullscreen.vert", "shaders/upscale.frag") {
+    mFramebuffer = GLFramebuffer::Create();
+    mColor = GLTexture::Create();
+    mDepthStencil = GLTexture::Create();
+    mVAO = GLVertexArray::Create();
+    mWidth = 0;
+    mHeight = 0;
+    mEnabled = true;
+    mScale = 1.0f;
+    mSmoothedMilliseconds = 0.0f;
+    mSettleFrames = 0;
+    Resize(width, height);
+
+    glUseProgram(mShader.GetId());
+    mShader.SetUniform1i("uScene", 0);
+    glUseProgram(0);
+}
+
+void
+DynamicResolution::Resize(int width, int height) {
+    if (width <= 0 || height <= 0 || (width == mWidth && height == mHeight)) {
+        return;
+    }
+
+    mWidth = width;
+    mHeight = height;
+    glBindTexture(GL_TEXTURE_2D, mColor.Get());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Overdraw view counts in the stencil, particles copy the depth
+    glBindTexture(GL_TEXTURE_2D, mDepthStencil.Get());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    MemoryAccounting::Track(MEMORY_TEXTURE, mColor.Get(), "Scene color target", MemoryAccounting::GetTextureSize(width, height, 1, 4, false));
+    MemoryAccounting::Track(MEMORY_TEXTURE, mDepthStencil.Get(), "Scene depth target", MemoryAccounting::GetTextureSize(width, height, 1, 4, false));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer.Get());
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mColor.Get(), 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, mDepthStencil.Get(), 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "[Err] Scene render target is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void
+DynamicResolution::SetEnabled(bool enabled) {
+    mEnabled = enabled;
+    mSettleFrames = 0;
+    if (!mEnabled) {
+        mScale = 1.0f;
+    }
+}
+
+bool
+DynamicResolution::IsEnabled() const {
+    return mEnabled;
+}
+
+void
+DynamicResolution::Update(float gpuMilliseconds, float budgetMilliseconds) {
+    if (!mEnabled || gpuMilliseconds <= 0.0f) {
+        return;
+    }
+
+    mSmoothedMilliseconds = mSmoothedMilliseconds > 0.0f ? mSmoothedMilliseconds + (gpuMilliseconds - mSmoothedMilliseconds) * SMOOTHING : gpuMilliseconds;
+    if (++mSettleFrames < DYNAMIC_RESOLUTION_SETTLE_FRAMES) {
+        return;
+    }
+
+    const float Target = budgetMilliseconds * DYNAMIC_RESOLUTION_HEADROOM;
+    if (mSmoothedMilliseconds <= Target && mSmoothedMilliseconds >= Target * DYNAMIC_RESOLUTION_RAISE_THRESHOLD) {
+        return;
+    }
+
+    // Most GPU time scales with the pixel count, which goes with the square of the scale
+    float Scale = mScale * std::sqrt(Target / mSmoothedMilliseconds);
+    Scale = std::round(Scale / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP;
+    Scale = std::min(std::max(Scale, DYNAMIC_RESOLUTION_MIN_SCALE), 1.0f);
+    if (Scale != mScale) {
+        mScale = Scale;
+        mSettleFrames = 0;
+        // Older results were measured at the previous scale
+        mSmoothedMilliseconds = 0.0f;
+    }
+}
+
+void
+DynamicResolution::BeginScene() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer.Get());
+    glViewport(0, 0, GetRenderWidth(), GetRenderHeight());
+}
+
+void
+DynamicResolution::Present() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, mWidth, mHeight);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(mShader.GetId());
+    const glm::vec2 TexelSize(1.0f / mWidth, 1.0f / mHeight);
+    const glm::vec2 Scale(GetRenderWidth() * TexelSize.x, GetRenderHeight() * TexelSize.y);
+    mShader.SetUniform2f("uScale", Scale);
+    mShader.SetUniform2f("uMaxUV", Scale - TexelSize * 0.5f);
+    mShader.SetUniform2f("uTexelSize", TexelSize);
+    // Native resolution isn't sharpened, lower scales lose more detail and get more of it
+    const float Sharpness = (1.0f - mScale) / (1.0f - DYNAMIC_RESOLUTION_MIN_SCALE) * DYNAMIC_RESOLUTION_SHARPNESS;
+    mShader.SetUniform1f("uSharpness", Sharpness);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, mColor.Get());
+    glBindVertexArray(mVAO.Get());
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+float
+DynamicResolution::GetScale() const {
+    return mScale;
+}
+
+int
+DynamicResolution::GetRenderWidth() const {
+    return std::max((int)(mWidth * mScale + 0.5f), 1);
+}
+
+int
+DynamicResolution::GetRenderHeight() const {
+    return std::max((int)(mHeight * mScale + 0.5f), 1);
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <GL/glew.h>
+#include "shader.hpp"
+#include "gl_handle.hpp"
+
+// Lowest render scale per axis, a quarter of the pixels
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+// Scale changes in steps of this size, so timer noise doesn't move it every frame
+#define DYNAMIC_RESOLUTION_STEP 0.05f
+// GPU time aimed for as part of the frame budget, the rest is headroom for spikes
+#define DYNAMIC_RESOLUTION_HEADROOM 0.9f
+// Scale only goes up once GPU time drops below this part of the aimed time, so it doesn't oscillate
+#define DYNAMIC_RESOLUTION_RAISE_THRESHOLD 0.8f
+// Frames to wait after a change. GpuTimer results lag GpuTimer::QUERY_COUNT frames behind
+#define DYNAMIC_RESOLUTION_SETTLE_FRAMES 8
+// Sharpening applied at the lowest scale, less of it closer to native resolution
+#define DYNAMIC_RESOLUTION_SHARPNESS 0.8f
+
+/**
+ * @brief Renders the scene into an offscreen color and depth-stencil target and scales it to the
+ * window. The target is allocated at window size and the scene only renders into its lower left
+ * part, so changing the scale never reallocates. A controller follows GPU frame time and lowers the
+ * scale when the frame doesn't fit the budget, raising it again once there is time to spare. The
+ * upscale pass samples bilinearly and sharpens with contrast adaptive sharpening
+ */
+class DynamicResolution {
+public:
+    /**
+     * @brief Ctor - loads the upscale shader and creates the target
+     *
+     * @param width Window framebuffer width
+     * @param height Window framebuffer height
+     */
+    DynamicResolution(int width, int height);
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    /**
+     * @brief Resizes the target to a new window size. Zero sizes of a minimized window are ignored
+     */
+    void Resize(int width, int height);
+
+    /**
+     * @brief Turns scaling on or off, off renders at native resolution
+     */
+    void SetEnabled(bool enabled);
+
+    bool IsEnabled() const;
+
+    /**
+     * @brief Adjusts the scale from the last GPU frame time. Called once per frame
+     *
+     * @param gpuMilliseconds Latest GPU frame time, 0 while no result is available
+     * @param budgetMilliseconds Frame budget
+     */
+    void Update(float gpuMilliseconds, float budgetMilliseconds);
+
+    /**
+     * @brief Binds the target and sets the viewport to the scaled size. Call before clearing
+     */
+    void BeginScene() const;
+
+    /**
+     * @brief Upscales the rendered part of the target to the window framebuffer
+     */
+    void Present() const;
+
+    float GetScale() const;
+    int GetRenderWidth() const;
+    int GetRenderHeight() const;
+
+private:
+    Shader mShader;
+    GLFramebuffer mFramebuffer;
+    GLTexture mColor;
+    GLTexture mDepthStencil;
+    // Fullscreen triangle has no vertex attributes, core profile still needs a VAO bound
+    GLVertexArray mVAO;
+    int mWidth;
+    int mHeight;
+    bool mEnabled;
+    float mScale;
+    // Exponential moving average of GPU time, single frames are too noisy to act on
+    float mSmoothedMilliseconds;
+    unsigned mSettleFrames;
+};
@@ -0,0 +1,256 @@
+#include "fft.hpp"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Radix-2 butterflies a + w * b, a - w * b over contiguous arrays, one twiddle per butterfly
+ *
+ * @param count Number of butterflies, multiple of SIMD_WIDTH
+ */
+static inline void
+butterflies(float* aReal, float* aImaginary, float* bReal, float* bImaginary, const float* wReal, const float* wImaginary, unsigned count) {
+#if SIMD_SSE
+    for (unsigned Idx = 0; Idx < count; Idx += SIMD_WIDTH) {
+        __m128 WRe = _mm_loadu_ps(wReal + Idx);
+        __m128 WIm = _mm_loadu_ps(wImaginary + Idx);
+        __m128 BRe = _mm_loadu_ps(bReal + Idx);
+        __m128 BIm = _mm_loadu_ps(bImaginary + Idx);
+        __m128 TRe = _mm_sub_ps(_mm_mul_ps(BRe, WRe), _mm_mul_ps(BIm, WIm));
+        __m128 TIm = _mm_add_ps(_mm_mul_ps(BRe, WIm), _mm_mul_ps(BIm, WRe));
+        __m128 ARe = _mm_loadu_ps(aReal + Idx);
+        __m128 AIm = _mm_loadu_ps(aImaginary + Idx);
+        _mm_storeu_ps(aReal + Idx, _mm_add_ps(ARe, TRe));
+        _mm_storeu_ps(aImaginary + Idx, _mm_add_ps(AIm, TIm));
+        _mm_storeu_ps(bReal + Idx, _mm_sub_ps(ARe, TRe));
+        _mm_storeu_ps(bImaginary + Idx, _mm_sub_ps(AIm, TIm));
+    }
+#else
+    for (unsigned Idx = 0; Idx < count; ++Idx) {
+        float TRe = bReal[Idx] * wReal[Idx] - bImaginary[Idx] * wImaginary[Idx];
+        float TIm = bReal[Idx] * wImaginary[Idx] + bImaginary[Idx] * wReal[Idx];
+        float ARe = aReal[Idx];
+        float AIm = aImaginary[Idx];
+        aReal[Idx] = ARe + TRe;
+        aImaginary[Idx] = AIm + TIm;
+        bReal[Idx] = ARe - TRe;
+        bImaginary[Idx] = AIm - TIm;
+    }
+#endif
+}
+
+/**
+ * @brief Radix-2 butterflies a + w * b, a - w * b over contiguous arrays sharing one twiddle
+ *
+ * @param count Number of butterflies, multiple of SIMD_WIDTH
+ */
+static inline void
+butterfliesShared(float* aReal, float* aImaginary, float* bReal, float* bImaginary, float wReal, float wImaginary, unsigned count) {
+#if SIMD_SSE
+    __m128 WRe = _mm_set1_ps(wReal);
+    __m128 WIm = _mm_set1_ps(wImaginary);
+    for (unsigned Idx = 0; Idx < count; Idx += SIMD_WIDTH) {
+        __m128 BRe = _mm_loadu_ps(bReal + Idx);
+        __m128 BIm = _mm_loadu_ps(bImaginary + Idx);
+        __m128 TRe = _mm_sub_ps(_mm_mul_ps(BRe, WRe), _mm_mul_ps(BIm, WIm));
+        __m128 TIm = _mm_add_ps(_mm_mul_ps(BRe, WIm), _mm_mul_ps(BIm, WRe));
+        __m128 ARe = _mm_loadu_ps(aReal + Idx);
+        __m128 AIm = _mm_loadu_ps(aImaginary + Idx);
+        _mm_storeu_ps(aReal + Idx, _mm_add_ps(ARe, TRe));
+        _mm_storeu_ps(aImaginary + Idx, _mm_add_ps(AIm, TIm));
+        _mm_storeu_ps(bReal + Idx, _mm_sub_ps(ARe, TRe));
+        _mm_storeu_ps(bImaginary + Idx, _mm_sub_ps(AIm, TIm));
+    }
+#else
+    for (unsigned Idx = 0; Idx < count; ++Idx) {
+        float TRe = bReal[Idx] * wReal - bImaginary[Idx] * wImaginary;
+        float TIm = bReal[Idx] * wImaginary + bImaginary[Idx] * wReal;
+        float ARe = aReal[Idx];
+        float AIm = aImaginary[Idx];
+        aReal[Idx] = ARe + TRe;
+        aImaginary[Idx] = AIm + TIm;
+        bReal[Idx] = ARe - TRe;
+        bImaginary[Idx] = AIm - TIm;
+    }
+#endif
+}
+
+FFT::FFT(unsigned size) {
+    mSize = size;
+    unsigned Bits = 0;
+    while ((1u << Bits) < mSize) {
+        ++Bits;
+    }
+
+    mBitReverse.resize(mSize);
+    for (unsigned Idx = 0; Idx < mSize; ++Idx) {
+        unsigned Reversed = 0;
+        for (unsigned Bit = 0; Bit < Bits; ++Bit) {
+            Reversed |= ((Idx >> Bit) & 1) << (Bits - 1 - Bit);
+        }
+        mBitReverse[Idx] = Reversed;
+    }
+
+    // Inverse transform twiddles e^(2 PI i j / 2H), computed in double so large sizes stay accurate
+    const double TwoPi = 6.283185307179586;
+    mTwiddleReal.resize(mSize);
+    mTwiddleImaginary.resize(mSize);
+    for (unsigned Half = 1; Half < mSize; Half <<= 1) {
+        for (unsigned J = 0; J < Half; ++J) {
+            double Angle = TwoPi * J / (2.0 * Half);
+            mTwiddleReal[Half + J] = (float)std::cos(Angle);
+            mTwiddleImaginary[Half + J] = (float)std::sin(Angle);
+        }
+    }
+}
+
+void
+FFT::Inverse2D(float* const* real, float* const* imaginary, unsigned fieldCount, JobSystem* jobs) const {
+    const unsigned RowCount = fieldCount * mSize;
+    const unsigned BlocksPerField = mSize / FFT_COLUMN_BLOCK;
+    const unsigned BlockCount = fieldCount * BlocksPerField;
+
+    auto TransformRows = [this, real, imaginary](unsigned begin, unsigned end) {
+        for (unsigned Row = begin; Row < end; ++Row) {
+            unsigned Field = Row / mSize;
+            unsigned Offset = (Row % mSize) * mSize;
+            inverseRow(real[Field] + Offset, imaginary[Field] + Offset);
+        }
+    };
+    auto TransformColumns = [this, real, imaginary, BlocksPerField](unsigned begin, unsigned end) {
+        for (unsigned Block = begin; Block < end; ++Block) {
+            unsigned Field = Block / BlocksPerField;
+            unsigned Offset = (Block % BlocksPerField) * FFT_COLUMN_BLOCK;
+            inverseColumns(real[Field] + Offset, imaginary[Field] + Offset);
+        }
+    };
+
+    // Column pass needs every row finished, ParallelFor waits between the two
+    if (jobs) {
+        jobs->ParallelFor(RowCount, FFT_JOB_ROWS, TransformRows);
+        jobs->ParallelFor(BlockCount, 1, TransformColumns);
+        return;
+    }
+
+    TransformRows(0, RowCount);
+    TransformColumns(0, BlockCount);
+}
+
+unsigned
+FFT::GetSize() const {
+    return mSize;
+}
+
+void
+FFT::inverseRow(float* real, float* imaginary) const {
+    for (unsigned Idx = 0; Idx < mSize; ++Idx) {
+        unsigned Reversed = mBitReverse[Idx];
+        if (Idx < Reversed) {
+            std::swap(real[Idx], real[Reversed]);
+            std::swap(imaginary[Idx], imaginary[Reversed]);
+        }
+    }
+
+    // Spans 1 and 2 as one radix-4 butterfly. Their twiddles are 1 and i, so no multiplies are needed
+#if SIMD_SSE
+    // Four groups at a time, transposed so every vector holds the same element of four groups
+    for (unsigned Idx = 0; Idx < mSize; Idx += 4 * SIMD_WIDTH) {
+        __m128 Re0 = _mm_loadu_ps(real + Idx), Re1 = _mm_loadu_ps(real + Idx + 4);
+        __m128 Re2 = _mm_loadu_ps(real + Idx + 8), Re3 = _mm_loadu_ps(real + Idx + 12);
+        __m128 Im0 = _mm_loadu_ps(imaginary + Idx), Im1 = _mm_loadu_ps(imaginary + Idx + 4);
+        __m128 Im2 = _mm_loadu_ps(imaginary + Idx + 8), Im3 = _mm_loadu_ps(imaginary + Idx + 12);
+        _MM_TRANSPOSE4_PS(Re0, Re1, Re2, Re3);
+        _MM_TRANSPOSE4_PS(Im0, Im1, Im2, Im3);
+        __m128 A0Re = _mm_add_ps(Re0, Re1), A0Im = _mm_add_ps(Im0, Im1);
+        __m128 A1Re = _mm_sub_ps(Re0, Re1), A1Im = _mm_sub_ps(Im0, Im1);
+        __m128 A2Re = _mm_add_ps(Re2, Re3), A2Im = _mm_add_ps(Im2, Im3);
+        __m128 A3Re = _mm_sub_ps(Re2, Re3), A3Im = _mm_sub_ps(Im2, Im3);
+        Re0 = _mm_add_ps(A0Re, A2Re);
+        Im0 = _mm_add_ps(A0Im, A2Im);
+        Re2 = _mm_sub_ps(A0Re, A2Re);
+        Im2 = _mm_sub_ps(A0Im, A2Im);
+        Re1 = _mm_sub_ps(A1Re, A3Im);
+        Im1 = _mm_add_ps(A1Im, A3Re);
+        Re3 = _mm_add_ps(A1Re, A3Im);
+        Im3 = _mm_sub_ps(A1Im, A3Re);
+        _MM_TRANSPOSE4_PS(Re0, Re1, Re2, Re3);
+        _MM_TRANSPOSE4_PS(Im0, Im1, Im2, Im3);
+        _mm_storeu_ps(real + Idx, Re0);
+        _mm_storeu_ps(real + Idx + 4, Re1);
+        _mm_storeu_ps(real + Idx + 8, Re2);
+        _mm_storeu_ps(real + Idx + 12, Re3);
+        _mm_storeu_ps(imaginary + Idx, Im0);
+        _mm_storeu_ps(imaginary + Idx + 4, Im1);
+        _mm_storeu_ps(imaginary + Idx + 8, Im2);
+        _mm_storeu_ps(imaginary + Idx + 12, Im3);
+    }
+#else
+    for (unsigned Idx = 0; Idx < mSize; Idx += 4) {
+        float* Re = real + Idx;
+        float* Im = imaginary + Idx;
+        float A0Re = Re[0] + Re[1], A0Im = Im[0] + Im[1];
+        float A1Re = Re[0] - Re[1], A1Im = Im[0] - Im[1];
+        float A2Re = Re[2] + Re[3], A2Im = Im[2] + Im[3];
+        float A3Re = Re[2] - Re[3], A3Im = Im[2] - Im[3];
+        Re[0] = A0Re + A2Re;
+        Im[0] = A0Im + A2Im;
+        Re[2] = A0Re - A2Re;
+        Im[2] = A0Im - A2Im;
+        // i * A3 = (-A3Im, A3Re)
+        Re[1] = A1Re - A3Im;
+        Im[1] = A1Im + A3Re;
+        Re[3] = A1Re + A3Im;
+        Im[3] = A1Im - A3Re;
+    }
+#endif
+
+    // From span 4 on every group of butterflies is a whole number of vectors
+    for (unsigned Half = 4; Half < mSize; Half <<= 1) {
+        const float* WRe = &mTwiddleReal[Half];
+        const float* WIm = &mTwiddleImaginary[Half];
+        for (unsigned Block = 0; Block < mSize; Block += 2 * Half) {
+            butterflies(real + Block, imaginary + Block, real + Block + Half, imaginary + Block + Half, WRe, WIm, Half);
+        }
+    }
+}
+
+void
+FFT::inverseColumns(float* real, float* imaginary) const {
+    for (unsigned Row = 0; Row < mSize; ++Row) {
+        unsigned Reversed = mBitReverse[Row];
+        if (Row < Reversed) {
+            std::swap_ranges(real + Row * mSize, real + Row * mSize + FFT_COLUMN_BLOCK, real + Reversed * mSize);
+            std::swap_ranges(imaginary + Row * mSize, imaginary + Row * mSize + FFT_COLUMN_BLOCK, imaginary + Reversed * mSize);
+        }
+    }
+
+    // Spans 1 and 2 as one radix-4 butterfly, same as in inverseRow
+    for (unsigned Row = 0; Row < mSize; Row += 4) {
+        float* Re = real + Row * mSize;
+        float* Im = imaginary + Row * mSize;
+        for (unsigned Column = 0; Column < FFT_COLUMN_BLOCK; ++Column) {
+            float A0Re = Re[Column] + Re[Column + mSize], A0Im = Im[Column] + Im[Column + mSize];
+            float A1Re = Re[Column] - Re[Column + mSize], A1Im = Im[Column] - Im[Column + mSize];
+            float A2Re = Re[Column + 2 * mSize] + Re[Column + 3 * mSize], A2Im = Im[Column + 2 * mSize] + Im[Column + 3 * mSize];
+            float A3Re = Re[Column + 2 * mSize] - Re[Column + 3 * mSize], A3Im = Im[Column + 2 * mSize] - Im[Column + 3 * mSize];
+            Re[Column] = A0Re + A2Re;
+            Im[Column] = A0Im + A2Im;
+            Re[Column + 2 * mSize] = A0Re - A2Re;
+            Im[Column + 2 * mSize] = A0Im - A2Im;
+            Re[Column + mSize] = A1Re - A3Im;
+            Im[Column + mSize] = A1Im + A3Re;
+            Re[Column + 3 * mSize] = A1Re + A3Im;
+            Im[Column + 3 * mSize] = A1Im - A3Re;
+        }
+    }
+
+    // Each butterfly of a column is the same butterfly for all columns of the block
+    for (unsigned Half = 4; Half < mSize; Half <<= 1) {
+        for (unsigned Block = 0; Block < mSize; Block += 2 * Half) {
+            for (unsigned J = 0; J < Half; ++J) {
+                unsigned A = (Block + J) * mSize;
+                unsigned B = A + Half * mSize;
+                butterfliesShared(real + A, imaginary + A, real + B, imaginary + B, mTwiddleReal[Half + J], mTwiddleImaginary[Half + J], FFT_COLUMN_BLOCK);
+            }
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include "simd.hpp"
+#include "job_system.hpp"
+
+// Columns transformed together by one column pass. 16 floats fill a 64 byte cache line
+#define FFT_COLUMN_BLOCK 16
+// Rows per job in the row pass
+#define FFT_JOB_ROWS 16
+
+/**
+ * @brief Radix-2 decimation in time FFT over square complex fields stored as separate real and
+ * imaginary arrays, row major. The first two stages of every row are fused into one radix-4
+ * butterfly, later stages run SIMD_WIDTH butterflies at a time. Columns are transformed
+ * FFT_COLUMN_BLOCK at a time, so every butterfly works on whole vectors of neighboring columns
+ */
+class FFT {
+public:
+    /**
+     * @brief Ctor - builds twiddle and bit reversal tables
+     *
+     * @param size Field side, power of two and at least FFT_COLUMN_BLOCK
+     */
+    explicit FFT(unsigned size);
+
+    /**
+     * @brief Unnormalized inverse 2D transform in place, out[x] = sum of in[k] * e^(2 PI i k x / size)
+     *
+     * @param real Real parts of each field
+     * @param imaginary Imaginary parts of each field
+     * @param fieldCount Number of fields transformed together
+     * @param jobs Optional job system, rows and column blocks of all fields are split between its threads
+     */
+    void Inverse2D(float* const* real, float* const* imaginary, unsigned fieldCount, JobSystem* jobs = 0) const;
+
+    /**
+     * @brief Returns field side
+     */
+    unsigned GetSize() const;
+
+private:
+    unsigned mSize;
+    std::vector<unsigned> mBitReverse;
+    // Twiddles of the stage with butterfly span H are at [H, 2H)
+    std::vector<float> mTwiddleReal;
+    std::vector<float> mTwiddleImaginary;
+
+    void inverseRow(float* real, float* imaginary) const;
+    void inverseColumns(float* real, float* imaginary) const;
+};
@@ -0,0 +1,598 @@
+#include "file_io.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+// Talks to the kernel through the raw syscalls, liburing isn't needed
+#define FILE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+#endif
+
+#ifdef FILE_IO_URING
+struct FileIO::Ring {
+    int Fd;
+    // Shared ring memory, mapped from the ring descriptor
+    void* SqMemory;
+    size_t SqMemorySize;
+    void* CqMemory;
+    size_t CqMemorySize;
+    io_uring_sqe* Sqes;
+    size_t SqesSize;
+    unsigned* SqHead;
+    unsigned* SqTail;
+    unsigned* SqMask;
+    unsigned* SqArray;
+    unsigned* CqHead;
+    unsigned* CqTail;
+    unsigned* CqMask;
+    io_uring_cqe* Cqes;
+    // Block of every submission, indexed by the submission's user data
+    Block Slots[FILE_IO_QUEUE_DEPTH];
+    std::vector<unsigned> FreeSlots;
+};
+#else
+struct FileIO::Ring {
+};
+#endif
+
+FileRequest::FileRequest(const std::string& path, EIOPriority priority) {
+    mPath = path;
+    mPriority = priority;
+    mState = PENDING;
+    mFile = -1;
+    mOpened = false;
+    mIssued = 0;
+    mInFlight = 0;
+}
+
+bool
+FileRequest::IsDone() const {
+    return mState.load() != PENDING;
+}
+
+bool
+FileRequest::Succeeded() const {
+    return mState.load() == SUCCEEDED;
+}
+
+const std::string&
+FileRequest::GetPath() const {
+    return mPath;
+}
+
+std::vector<unsigned char>&
+FileRequest::GetData() {
+    return mData;
+}
+
+FileIO::FileIO(unsigned threadCount) {
+    mRunning = true;
+    mInFlight = 0;
+    if (initRing()) {
+        mThreads.push_back(std::thread(&FileIO::ringLoop, this));
+        std::cout << "File IO started on io_uring, " << FILE_IO_QUEUE_DEPTH << " blocks in flight" << std::endl;
+        return;
+    }
+
+    threadCount = std::max(threadCount, 1u);
+    for (unsigned ThreadIdx = 0; ThreadIdx < threadCount; ++ThreadIdx) {
+        mThreads.push_back(std::thread(&FileIO::threadLoop, this));
+    }
+    std::cout << "File IO started with " << threadCount << " reader threads" << std::endl;
+}
+
+FileIO::~FileIO() {
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mRunning = false;
+        for (std::deque<std::shared_ptr<FileRequest>>& Queue : mQueues) {
+            for (std::shared_ptr<FileRequest>& Request : Queue) {
+                cancelRequest(*Request);
+            }
+            Queue.clear();
+        }
+        mPrefetched.clear();
+    }
+    mQueued.notify_all();
+    for (std::thread& Thread : mThreads) {
+        Thread.join();
+    }
+    destroyRing();
+}
+
+std::shared_ptr<FileRequest>
+FileIO::Read(const std::string& path, EIOPriority priority) {
+    std::shared_ptr<FileRequest> Request = std::make_shared<FileRequest>(path, priority);
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        push(Request);
+    }
+    mQueued.notify_all();
+    return Request;
+}
+
+std::vector<std::shared_ptr<FileRequest>>
+FileIO::ReadBatch(const std::vector<std::string>& paths, EIOPriority priority) {
+    std::vector<std::shared_ptr<FileRequest>> Requests;
+    Requests.reserve(paths.size());
+    for (const std::string& Path : paths) {
+        Requests.push_back(std::make_shared<FileRequest>(Path, priority));
+    }
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        for (std::shared_ptr<FileRequest>& Request : Requests) {
+            push(Request);
+        }
+    }
+    mQueued.notify_all();
+    return Requests;
+}
+
+void
+FileIO::Cancel(FileRequest& request) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    cancelRequest(request);
+}
+
+bool
+FileIO::Wait(FileRequest& request) {
+    std::unique_lock<std::mutex> Lock(mMutex);
+    if (!request.IsDone() && !request.mIssued && request.mPriority != IO_PRIORITY_HIGH) {
+        std::deque<std::shared_ptr<FileRequest>>& Queue = mQueues[request.mPriority];
+        std::deque<std::shared_ptr<FileRequest>>::iterator Found = std::find_if(Queue.begin(), Queue.end(), [&request](const std::shared_ptr<FileRequest>& queued) {
+            return queued.get() == &request;
+        });
+        if (Found != Queue.end()) {
+            mQueues[IO_PRIORITY_HIGH].push_front(*Found);
+            Queue.erase(Found);
+            request.mPriority = IO_PRIORITY_HIGH;
+        }
+    }
+    mCompleted.wait(Lock, [&request]() { return request.IsDone(); });
+    return request.Succeeded();
+}
+
+void
+FileIO::Prefetch(const std::vector<std::string>& paths, EIOPriority priority) {
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        for (const std::string& Path : paths) {
+            std::shared_ptr<FileRequest>& Request = mPrefetched[Path];
+            if (!Request) {
+                Request = std::make_shared<FileRequest>(Path, priority);
+                push(Request);
+            }
+        }
+    }
+    mQueued.notify_all();
+}
+
+bool
+FileIO::Take(const std::string& path, std::vector<unsigned char>& data) {
+    std::shared_ptr<FileRequest> Request;
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        std::map<std::string, std::shared_ptr<FileRequest>>::iterator Found = mPrefetched.find(path);
+        if (Found == mPrefetched.end()) {
+            return false;
+        }
+        Request = Found->second;
+        mPrefetched.erase(Found);
+    }
+
+    if (!Wait(*Request)) {
+        return false;
+    }
+    data.swap(Request->mData);
+    return true;
+}
+
+unsigned
+FileIO::CancelPrefetches() {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    unsigned Cancelled = 0;
+    for (std::pair<const std::string, std::shared_ptr<FileRequest>>& Prefetched : mPrefetched) {
+        Cancelled += !Prefetched.second->IsDone();
+        cancelRequest(*Prefetched.second);
+    }
+    mPrefetched.clear();
+    return Cancelled;
+}
+
+bool
+FileIO::IsAsync() const {
+    return mRing != nullptr;
+}
+
+bool
+FileIO::nextBlock(Block& block) {
+    for (std::deque<std::shared_ptr<FileRequest>>& Queue : mQueues) {
+        while (!Queue.empty()) {
+            FileRequest& Request = *Queue.front();
+            // Cancelled and failed requests are dropped here rather than searched for
+            if (Request.IsDone()) {
+                Queue.pop_front();
+                continue;
+            }
+
+            if (!Request.mOpened && !openFile(Request)) {
+                std::cerr << "[Err] Failed to open " << Request.mPath << std::endl;
+                Request.mState = FileRequest::FAILED;
+                mCompleted.notify_all();
+                Queue.pop_front();
+                continue;
+            }
+            if (Request.mData.empty()) {
+                closeFile(Request);
+                Request.mState = FileRequest::SUCCEEDED;
+                mCompleted.notify_all();
+                Queue.pop_front();
+                continue;
+            }
+
+            block.Request = Queue.front();
+            block.Offset = Request.mIssued;
+            block.Size = std::min((size_t)FILE_IO_BLOCK_SIZE, Request.mData.size() - Request.mIssued);
+            Request.mIssued += block.Size;
+            ++Request.mInFlight;
+            ++mInFlight;
+            // Stays at the front until every block is issued, so one file is read front to back
+            if (Request.mIssued == Request.mData.size()) {
+                Queue.pop_front();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+FileIO::completeBlock(Block& block, long long read) {
+    FileRequest& Request = *block.Request;
+    --Request.mInFlight;
+    --mInFlight;
+    if (read != (long long)block.Size && !Request.IsDone()) {
+        std::cerr << "[Err] Failed to read " << Request.mPath << std::endl;
+        Request.mState = FileRequest::FAILED;
+    }
+
+    if (Request.mInFlight) {
+        return;
+    }
+    if (Request.IsDone()) {
+        // Failed or cancelled, the bytes read so far are of no use
+        closeFile(Request);
+        std::vector<unsigned char>().swap(Request.mData);
+        mCompleted.notify_all();
+    } else if (Request.mIssued == Request.mData.size()) {
+        closeFile(Request);
+        Request.mState = FileRequest::SUCCEEDED;
+        mCompleted.notify_all();
+    }
+}
+
+void
+FileIO::cancelRequest(FileRequest& request) {
+    if (request.IsDone()) {
+        return;
+    }
+    request.mState = FileRequest::CANCELLED;
+    // Blocks in flight still write into the data, the last one to complete cleans up
+    if (!request.mInFlight) {
+        closeFile(request);
+        std::vector<unsigned char>().swap(request.mData);
+    }
+    mCompleted.notify_all();
+}
+
+void
+FileIO::push(const std::shared_ptr<FileRequest>& request) {
+    mQueues[request->mPriority].push_back(request);
+}
+
+void
+FileIO::threadLoop() {
+    std::unique_lock<std::mutex> Lock(mMutex);
+    while (true) {
+        Block Current;
+        if (nextBlock(Current)) {
+            Lock.unlock();
+            long long Read = readBlock(Current);
+            Lock.lock();
+            completeBlock(Current, Read);
+            continue;
+        }
+
+        if (!mRunning) {
+            return;
+        }
+        mQueued.wait(Lock);
+    }
+}
+
+#ifdef FILE_IO_URING
+bool
+FileIO::initRing() {
+    io_uring_params Params;
+    memset(&Params, 0, sizeof(Params));
+    int Fd = (int)syscall(__NR_io_uring_setup, FILE_IO_QUEUE_DEPTH, &Params);
+    if (Fd < 0) {
+        // Old kernels and sandboxes without io_uring
+        return false;
+    }
+    // IORING_OP_READ came in 5.6, fast poll in 5.7 is the closest feature bit to check for it
+    if (!(Params.features & IORING_FEAT_FAST_POLL)) {
+        close(Fd);
+        return false;
+    }
+
+    std::unique_ptr<Ring> NewRing(new Ring());
+    NewRing->Fd = Fd;
+    NewRing->SqMemorySize = Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+    NewRing->CqMemorySize = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+    bool SingleMapping = Params.features & IORING_FEAT_SINGLE_MMAP;
+    if (SingleMapping) {
+        NewRing->SqMemorySize = NewRing->CqMemorySize = std::max(NewRing->SqMemorySize, NewRing->CqMemorySize);
+    }
+    NewRing->SqesSize = Params.sq_entries * sizeof(io_uring_sqe);
+    NewRing->SqMemory = mmap(0, NewRing->SqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQ_RING);
+    NewRing->CqMemory = SingleMapping ? NewRing->SqMemory : mmap(0, NewRing->CqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_CQ_RING);
+    void* Sqes = mmap(0, NewRing->SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQES);
+    if (NewRing->SqMemory == MAP_FAILED || NewRing->CqMemory == MAP_FAILED || Sqes == MAP_FAILED) {
+        std::cerr << "[Err] Failed to map io_uring, falling back to reader threads" << std::endl;
+        if (NewRing->SqMemory != MAP_FAILED) {
+            munmap(NewRing->SqMemory, NewRing->SqMemorySize);
+        }
+        if (!SingleMapping && NewRing->CqMemory != MAP_FAILED) {
+            munmap(NewRing->CqMemory, NewRing->CqMemorySize);
+        }
+        if (Sqes != MAP_FAILED) {
+            munmap(Sqes, NewRing->SqesSize);
+        }
+        close(Fd);
+        return false;
+    }
+
+    unsigned char* Sq = (unsigned char*)NewRing->SqMemory;
+    unsigned char* Cq = (unsigned char*)NewRing->CqMemory;
+    NewRing->Sqes = (io_uring_sqe*)Sqes;
+    NewRing->SqHead = (unsigned*)(Sq + Params.sq_off.head);
+    NewRing->SqTail = (unsigned*)(Sq + Params.sq_off.tail);
+    NewRing->SqMask = (unsigned*)(Sq + Params.sq_off.ring_mask);
+    NewRing->SqArray = (unsigned*)(Sq + Params.sq_off.array);
+    NewRing->CqHead = (unsigned*)(Cq + Params.cq_off.head);
+    NewRing->CqTail = (unsigned*)(Cq + Params.cq_off.tail);
+    NewRing->CqMask = (unsigned*)(Cq + Params.cq_off.ring_mask);
+    NewRing->Cqes = (io_uring_cqe*)(Cq + Params.cq_off.cqes);
+    for (unsigned SlotIdx = 0; SlotIdx < FILE_IO_QUEUE_DEPTH; ++SlotIdx) {
+        NewRing->FreeSlots.push_back(SlotIdx);
+    }
+    mRing = std::move(NewRing);
+    return true;
+}
+
+void
+FileIO::destroyRing() {
+    if (!mRing) {
+        return;
+    }
+    munmap(mRing->Sqes, mRing->SqesSize);
+    if (mRing->CqMemory != mRing->SqMemory) {
+        munmap(mRing->CqMemory, mRing->CqMemorySize);
+    }
+    munmap(mRing->SqMemory, mRing->SqMemorySize);
+    close(mRing->Fd);
+    mRing.reset();
+}
+
+void
+FileIO::ringLoop() {
+    Ring& R = *mRing;
+    // Remainders of short reads, issued before new blocks
+    std::vector<Block> Retries;
+    // Set once io_uring_enter fails for good, blocks are then read on this thread
+    bool Broken = false;
+    std::unique_lock<std::mutex> Lock(mMutex);
+    while (true) {
+        unsigned SqTail = *R.SqTail;
+        Block Current;
+        if (Broken) {
+            // Blocks the kernel never consumed are taken back, the ones it did still complete
+            unsigned SqHead = __atomic_load_n(R.SqHead, __ATOMIC_ACQUIRE);
+            for (; SqHead != SqTail; ++SqHead) {
+                unsigned Slot = (unsigned)R.Sqes[R.SqArray[SqHead & *R.SqMask]].user_data;
+                Retries.push_back(std::move(R.Slots[Slot]));
+                R.FreeSlots.push_back(Slot);
+            }
+            __atomic_store_n(R.SqTail, SqTail = SqHead, __ATOMIC_RELEASE);
+            while (!Retries.empty()) {
+                Current = std::move(Retries.back());
+                Retries.pop_back();
+                Lock.unlock();
+                long long Read = readBlock(Current);
+                Lock.lock();
+                completeBlock(Current, Read);
+            }
+            if (R.FreeSlots.size() == FILE_IO_QUEUE_DEPTH) {
+                Lock.unlock();
+                threadLoop();
+                return;
+            }
+
+            // Completions still land in the ring without entering it
+            Lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            Lock.lock();
+        }
+
+        while (!Broken && !R.FreeSlots.empty()) {
+            if (!Retries.empty()) {
+                Current = std::move(Retries.back());
+                Retries.pop_back();
+            } else if (!nextBlock(Current)) {
+                break;
+            }
+
+            unsigned Slot = R.FreeSlots.back();
+            R.FreeSlots.pop_back();
+            unsigned SqIdx = SqTail & *R.SqMask;
+            io_uring_sqe& Sqe = R.Sqes[SqIdx];
+            memset(&Sqe, 0, sizeof(Sqe));
+            Sqe.opcode = IORING_OP_READ;
+            Sqe.fd = (int)Current.Request->mFile;
+            Sqe.off = Current.Offset;
+            Sqe.addr = (unsigned long long)(Current.Request->mData.data() + Current.Offset);
+            Sqe.len = (unsigned)Current.Size;
+            Sqe.user_data = Slot;
+            R.SqArray[SqIdx] = SqIdx;
+            R.Slots[Slot] = std::move(Current);
+            ++SqTail;
+        }
+        __atomic_store_n(R.SqTail, SqTail, __ATOMIC_RELEASE);
+
+        if (!Broken && R.FreeSlots.size() == FILE_IO_QUEUE_DEPTH) {
+            if (!mRunning) {
+                return;
+            }
+            mQueued.wait(Lock);
+            continue;
+        }
+
+        if (!Broken) {
+            // Entries a failed or partial enter left behind are submitted again with the new ones
+            unsigned ToSubmit = SqTail - __atomic_load_n(R.SqHead, __ATOMIC_ACQUIRE);
+            // Requests queued while waiting here are picked up after the next completion
+            Lock.unlock();
+            int Entered = (int)syscall(__NR_io_uring_enter, R.Fd, ToSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            int Error = errno;
+            Lock.lock();
+            if (Entered < 0 && Error != EINTR && Error != EBUSY && Error != EAGAIN) {
+                std::cerr << "[Err] io_uring_enter failed: " << strerror(Error) << ", reading on this thread from now on" << std::endl;
+                Broken = true;
+            }
+        }
+
+        unsigned CqHead = *R.CqHead;
+        unsigned CqTail = __atomic_load_n(R.CqTail, __ATOMIC_ACQUIRE);
+        for (; CqHead != CqTail; ++CqHead) {
+            const io_uring_cqe& Cqe = R.Cqes[CqHead & *R.CqMask];
+            unsigned Slot = (unsigned)Cqe.user_data;
+            Block& Done = R.Slots[Slot];
+            if (Cqe.res == -EAGAIN || Cqe.res == -EINTR) {
+                Retries.push_back(std::move(Done));
+            } else if (Cqe.res > 0 && (size_t)Cqe.res < Done.Size && !Done.Request->IsDone()) {
+                Block Rest = { Done.Request, Done.Offset + Cqe.res, Done.Size - Cqe.res };
+                Retries.push_back(std::move(Rest));
+                Done.Request.reset();
+            } else {
+                completeBlock(Done, Cqe.res);
+                Done.Request.reset();
+            }
+            R.FreeSlots.push_back(Slot);
+        }
+        __atomic_store_n(R.CqHead, CqHead, __ATOMIC_RELEASE);
+    }
+}
+#else
+bool
+FileIO::initRing() {
+    return false;
+}
+
+void
+FileIO::destroyRing() {
+}
+
+void
+FileIO::ringLoop() {
+}
+#endif
+
+bool
+FileIO::openFile(FileRequest& request) {
+#ifdef _WIN32
+    HANDLE File = CreateFileA(request.mPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER Size;
+    if (File == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    if (!GetFileSizeEx(File, &Size)) {
+        CloseHandle(File);
+        return false;
+    }
+    request.mFile = (long long)File;
+    request.mData.resize((size_t)Size.QuadPart);
+#else
+    int File = open(request.mPath.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat Info;
+    if (File < 0) {
+        return false;
+    }
+    if (fstat(File, &Info)) {
+        close(File);
+        return false;
+    }
+    request.mFile = File;
+    request.mData.resize(Info.st_size);
+#endif
+    request.mOpened = true;
+    return true;
+}
+
+void
+FileIO::closeFile(FileRequest& request) {
+    if (!request.mOpened) {
+        return;
+    }
+#ifdef _WIN32
+    CloseHandle((HANDLE)request.mFile);
+#else
+    close((int)request.mFile);
+#endif
+    request.mFile = -1;
+    request.mOpened = false;
+}
+
+long long
+FileIO::readBlock(const Block& block) {
+    unsigned char* Destination = block.Request->mData.data() + block.Offset;
+    size_t Read = 0;
+    while (Read < block.Size) {
+#ifdef _WIN32
+        // Positional read on a synchronous handle, threads don't share a file pointer
+        OVERLAPPED Position = {};
+        unsigned long long Offset = block.Offset + Read;
+        Position.Offset = (DWORD)Offset;
+        Position.OffsetHigh = (DWORD)(Offset >> 32);
+        DWORD Count = 0;
+        if (!ReadFile((HANDLE)block.Request->mFile, Destination + Read, (DWORD)(block.Size - Read), &Count, &Position) || !Count) {
+            return -1;
+        }
+#else
+        ssize_t Count = pread((int)block.Request->mFile, Destination + Read, block.Size - Read, block.Offset + Read);
+        if (Count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (Count <= 0) {
+            return -1;
+        }
+#endif
+        Read += Count;
+    }
+    return (long long)Read;
+}
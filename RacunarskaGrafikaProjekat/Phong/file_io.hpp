@@ -0,0 +1,209 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Blocks kept in flight at once. Deep enough to keep an NVMe drive busy
+#define FILE_IO_QUEUE_DEPTH 32
+// Files are read in blocks of this size, so one big file still fills the queue
+#define FILE_IO_BLOCK_SIZE (256 * 1024)
+// Reader threads of the fallback backend, each has one block in flight
+#define FILE_IO_THREAD_COUNT 4
+
+enum EIOPriority {
+    IO_PRIORITY_HIGH = 0,
+    IO_PRIORITY_NORMAL = 1,
+    IO_PRIORITY_LOW = 2,
+    IO_PRIORITY_COUNT = 3,
+};
+
+/**
+ * @brief Read of one whole file, shared between the caller and FileIO
+ */
+class FileRequest {
+public:
+    FileRequest(const std::string& path, EIOPriority priority);
+
+    FileRequest(const FileRequest&) = delete;
+    FileRequest& operator=(const FileRequest&) = delete;
+
+    /**
+     * @brief Returns true once the read finished, failed or was cancelled
+     */
+    bool IsDone() const;
+
+    /**
+     * @brief Returns true if the whole file was read
+     */
+    bool Succeeded() const;
+
+    const std::string& GetPath() const;
+
+    /**
+     * @brief Returns the file's bytes. Only valid once the request succeeded
+     */
+    std::vector<unsigned char>& GetData();
+
+private:
+    friend class FileIO;
+    enum EState {
+        PENDING = 0,
+        SUCCEEDED = 1,
+        FAILED = 2,
+        CANCELLED = 3,
+    };
+
+    std::string mPath;
+    EIOPriority mPriority;
+    std::vector<unsigned char> mData;
+    std::atomic<int> mState;
+    // Platform file handle, opened when the first block is issued
+    long long mFile;
+    bool mOpened;
+    // Bytes handed out as blocks so far, and blocks issued but not completed
+    size_t mIssued;
+    unsigned mInFlight;
+};
+
+/**
+ * @brief Reads files in the background. Requests are split into blocks and up to FILE_IO_QUEUE_DEPTH
+ * blocks are in flight at once, highest priority requests first. On Linux the blocks go through one
+ * io_uring, elsewhere or if the kernel refuses a ring through a pool of threads doing positional reads.
+ * Nothing here waits on the render thread, callers only block in Wait or Take
+ */
+class FileIO {
+public:
+    /**
+     * @brief Ctor - starts the backend
+     *
+     * @param threadCount Reader threads if the thread pool backend is used
+     */
+    explicit FileIO(unsigned threadCount = FILE_IO_THREAD_COUNT);
+
+    /**
+     * @brief Dtor - cancels queued requests, waits for blocks in flight and stops the backend
+     */
+    ~FileIO();
+
+    FileIO(const FileIO&) = delete;
+    FileIO& operator=(const FileIO&) = delete;
+
+    /**
+     * @brief Queues a read of a whole file
+     *
+     * @param path File path
+     * @param priority Queue the request goes to, higher priorities are issued first
+     *
+     * @returns Request, completes in the background
+     */
+    std::shared_ptr<FileRequest> Read(const std::string& path, EIOPriority priority = IO_PRIORITY_NORMAL);
+
+    /**
+     * @brief Queues reads of several files at once, the backend is woken up once for all of them
+     *
+     * @param paths File paths
+     * @param priority Queue the requests go to
+     *
+     * @returns Requests in the order of paths
+     */
+    std::vector<std::shared_ptr<FileRequest>> ReadBatch(const std::vector<std::string>& paths, EIOPriority priority = IO_PRIORITY_NORMAL);
+
+    /**
+     * @brief Cancels a request. Queued blocks are dropped, blocks in flight finish but their data is discarded
+     */
+    void Cancel(FileRequest& request);
+
+    /**
+     * @brief Blocks until a request is done. A request still waiting in the queues is moved to the
+     * front of the high priority queue, someone needs it now
+     *
+     * @returns true if the file was read
+     */
+    bool Wait(FileRequest& request);
+
+    /**
+     * @brief Queues reads whose results are later claimed by path with Take. Paths already prefetched are skipped
+     *
+     * @param paths File paths
+     * @param priority Queue the requests go to
+     */
+    void Prefetch(const std::vector<std::string>& paths, EIOPriority priority = IO_PRIORITY_NORMAL);
+
+    /**
+     * @brief Claims a prefetched file, waiting for its read if needed
+     *
+     * @param path File path given to Prefetch
+     * @param data Output bytes
+     *
+     * @returns false if the path wasn't prefetched or couldn't be read
+     */
+    bool Take(const std::string& path, std::vector<unsigned char>& data);
+
+    /**
+     * @brief Cancels prefetched files nobody claimed
+     *
+     * @returns Number of cancelled prefetches
+     */
+    unsigned CancelPrefetches();
+
+    /**
+     * @brief Returns true if blocks go through io_uring
+     */
+    bool IsAsync() const;
+
+private:
+    struct Block {
+        std::shared_ptr<FileRequest> Request;
+        size_t Offset;
+        size_t Size;
+    };
+
+    std::deque<std::shared_ptr<FileRequest>> mQueues[IO_PRIORITY_COUNT];
+    std::map<std::string, std::shared_ptr<FileRequest>> mPrefetched;
+    std::mutex mMutex;
+    // Signalled when requests are queued and when requests complete
+    std::condition_variable mQueued;
+    std::condition_variable mCompleted;
+    std::vector<std::thread> mThreads;
+    bool mRunning;
+    unsigned mInFlight;
+    // io_uring state, see file_io.cpp
+    struct Ring;
+    std::unique_ptr<Ring> mRing;
+
+    /**
+     * @brief Takes the next block off the highest priority queue. Called with mMutex held
+     *
+     * @returns false if there is nothing to issue
+     */
+    bool nextBlock(Block& block);
+
+    /**
+     * @brief Finishes a block, completing its request after the last one. Called with mMutex held
+     *
+     * @param block Completed block
+     * @param read Bytes read, negative on error
+     */
+    void completeBlock(Block& block, long long read);
+
+    /**
+     * @brief Marks a request cancelled and frees its data unless blocks are in flight. Called with mMutex held
+     */
+    void cancelRequest(FileRequest& request);
+
+    void push(const std::shared_ptr<FileRequest>& request);
+    void threadLoop();
+    void ringLoop();
+    bool initRing();
+    void destroyRing();
+
+    static bool openFile(FileRequest& request);
+    static void closeFile(FileRequest& request);
+    static long long readBlock(const Block& block);
+};
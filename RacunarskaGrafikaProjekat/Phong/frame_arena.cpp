@@ -0,0 +1,71 @@
+#include "frame_arena.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+FrameArena::FrameArena(size_t size) {
+    mSize = size;
+    mData = (unsigned char*)::operator new(size);
+    mOffset = 0;
+    mOverflowBytes = 0;
+    mPeak = 0;
+    // Fallback pointers are kept in memory reserved now, not in the frame that overflows
+    mOverflow.reserve(64);
+}
+
+FrameArena::~FrameArena() {
+    Reset();
+    ::operator delete(mData);
+}
+
+void*
+FrameArena::Allocate(size_t size, size_t alignment) {
+    // Aligns the address, not the offset, so alignments above the heap's hold too
+    size_t Address = (size_t)mData + mOffset;
+    size_t Aligned = ((Address + alignment - 1) & ~(alignment - 1)) - (size_t)mData;
+    if (Aligned + size <= mSize) {
+        mOffset = Aligned + size;
+        return mData + Aligned;
+    }
+
+    if (mOverflow.empty()) {
+        std::cerr << "[Err] Frame arena of " << mSize << " bytes overflowed, raise FRAME_ARENA_SIZE" << std::endl;
+    }
+    mOverflowBytes += size;
+    mOverflow.push_back(::operator new(size));
+    return mOverflow.back();
+}
+
+const char*
+FrameArena::CopyString(const char* str) {
+    size_t Length = strlen(str) + 1;
+    char* Copy = AllocateArray<char>(Length);
+    memcpy(Copy, str, Length);
+    return Copy;
+}
+
+void
+FrameArena::Reset() {
+    mPeak = std::max(mPeak, mOffset + mOverflowBytes);
+    for (void* Memory : mOverflow) {
+        ::operator delete(Memory);
+    }
+    mOverflow.clear();
+    mOverflowBytes = 0;
+    mOffset = 0;
+}
+
+size_t
+FrameArena::GetUsed() const {
+    return mOffset;
+}
+
+size_t
+FrameArena::GetPeak() const {
+    return std::max(mPeak, mOffset + mOverflowBytes);
+}
+
+unsigned
+FrameArena::GetOverflowCount() const {
+    return mOverflow.size();
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Bytes of transient data one frame can allocate before the arena falls back to the heap
+#define FRAME_ARENA_SIZE (1024 * 1024)
+
+/**
+ * @brief Linear allocator for data that lives until the end of the frame. Allocating bumps an
+ * offset, nothing is freed individually and Reset makes the whole arena available again.
+ * Single threaded, owned by the thread running the frame
+ */
+class FrameArena {
+public:
+    /**
+     * @brief Ctor - reserves the arena up front
+     *
+     * @param size Arena capacity in bytes
+     */
+    explicit FrameArena(size_t size = FRAME_ARENA_SIZE);
+
+    /**
+     * @brief Dtor - frees heap fallback allocations too
+     */
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /**
+     * @brief Allocates uninitialized memory valid until the next Reset. Requests that don't fit
+     * go to the heap, they are freed on Reset and reported as overflow
+     *
+     * @param size Number of bytes
+     * @param alignment Power of two alignment
+     *
+     * @returns Memory
+     */
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    /**
+     * @brief Allocates an uninitialized array
+     *
+     * @param count Number of elements
+     */
+    template<typename T>
+    T* AllocateArray(size_t count) {
+        return (T*)Allocate(count * sizeof(T), alignof(T));
+    }
+
+    /**
+     * @brief Copies a string into the arena
+     *
+     * @returns Null terminated copy
+     */
+    const char* CopyString(const char* str);
+
+    /**
+     * @brief Frees everything allocated since the last reset. Called at the start of every frame
+     */
+    void Reset();
+
+    /**
+     * @brief Returns bytes allocated in the arena since the last reset
+     */
+    size_t GetUsed() const;
+
+    /**
+     * @brief Returns the most bytes one frame needed, including overflow
+     */
+    size_t GetPeak() const;
+
+    /**
+     * @brief Returns the number of allocations that went to the heap since the last reset
+     */
+    unsigned GetOverflowCount() const;
+
+private:
+    unsigned char* mData;
+    size_t mSize;
+    size_t mOffset;
+    size_t mOverflowBytes;
+    size_t mPeak;
+    std::vector<void*> mOverflow;
+};
+
+/**
+ * @brief STL allocator placing containers in a frame arena. Deallocation does nothing, so a
+ * container should be sized once and dropped before the arena resets
+ */
+template<typename T>
+class FrameAllocator {
+public:
+    typedef T value_type;
+
+    explicit FrameAllocator(FrameArena& arena) : mArena(&arena) {
+    }
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : mArena(other.GetArena()) {
+    }
+
+    T* allocate(size_t count) {
+        return mArena->AllocateArray<T>(count);
+    }
+
+    void deallocate(T*, size_t) {
+    }
+
+    FrameArena* GetArena() const {
+        return mArena;
+    }
+
+    template<typename U>
+    bool operator==(const FrameAllocator<U>& other) const {
+        return mArena == other.GetArena();
+    }
+
+    template<typename U>
+    bool operator!=(const FrameAllocator<U>& other) const {
+        return mArena != other.GetArena();
+    }
+
+private:
+    FrameArena* mArena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
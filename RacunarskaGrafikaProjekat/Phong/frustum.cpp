@@ -0,0 +1,56 @@
+#include "frustum.hpp"
+
+Frustum::Frustum() {
+    for (unsigned PlaneIdx = 0; PlaneIdx < PLANE_COUNT; ++PlaneIdx) {
+        mPlanes[PlaneIdx] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+Frustum
+Frustum::FromMatrix(const glm::mat4& clip) {
+    // GLM is column major, clip[column][row]
+    glm::vec4 Rows[4];
+    for (unsigned Row = 0; Row < 4; ++Row) {
+        Rows[Row] = glm::vec4(clip[0][Row], clip[1][Row], clip[2][Row], clip[3][Row]);
+    }
+
+    Frustum Result;
+    Result.mPlanes[LEFT_PLANE] = Rows[3] + Rows[0];
+    Result.mPlanes[RIGHT_PLANE] = Rows[3] - Rows[0];
+    Result.mPlanes[BOTTOM_PLANE] = Rows[3] + Rows[1];
+    Result.mPlanes[TOP_PLANE] = Rows[3] - Rows[1];
+    Result.mPlanes[NEAR_PLANE] = Rows[3] + Rows[2];
+    Result.mPlanes[FAR_PLANE] = Rows[3] - Rows[2];
+
+    for (unsigned PlaneIdx = 0; PlaneIdx < PLANE_COUNT; ++PlaneIdx) {
+        float Length = glm::length(glm::vec3(Result.mPlanes[PlaneIdx]));
+        if (Length > 0.0f) {
+            Result.mPlanes[PlaneIdx] /= Length;
+        }
+    }
+    return Result;
+}
+
+bool
+Frustum::IsSphereVisible(const glm::vec3& center, float radius) const {
+    for (unsigned PlaneIdx = 0; PlaneIdx < PLANE_COUNT; ++PlaneIdx) {
+        const glm::vec4& Plane = mPlanes[PlaneIdx];
+        if (glm::dot(glm::vec3(Plane), center) + Plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+Frustum::IsBoxVisible(const glm::vec3& min, const glm::vec3& max) const {
+    for (unsigned PlaneIdx = 0; PlaneIdx < PLANE_COUNT; ++PlaneIdx) {
+        const glm::vec4& Plane = mPlanes[PlaneIdx];
+        // Corner furthest along the plane normal
+        glm::vec3 Positive(Plane.x >= 0.0f ? max.x : min.x, Plane.y >= 0.0f ? max.y : min.y, Plane.z >= 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(Plane), Positive) + Plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/glm.hpp>
+
+class Frustum {
+public:
+    enum EPlane {
+        LEFT_PLANE = 0,
+        RIGHT_PLANE = 1,
+        BOTTOM_PLANE = 2,
+        TOP_PLANE = 3,
+        NEAR_PLANE = 4,
+        FAR_PLANE = 5,
+        PLANE_COUNT = 6,
+    };
+
+    // Plane equations (normal xyz, distance w) with normals pointing inside and normalized
+    glm::vec4 mPlanes[PLANE_COUNT];
+
+    Frustum();
+
+    /**
+     * @brief Extracts frustum planes from a clip matrix (Gribb-Hartmann).
+     * Planes are in the space the matrix transforms from, so passing
+     * Projection * View * Model gives object space planes
+     *
+     * @param clip Clip matrix
+     *
+     * @returns Frustum
+     */
+    static Frustum FromMatrix(const glm::mat4& clip);
+
+    /**
+     * @brief Tests sphere against the frustum
+     *
+     * @param center Sphere center
+     * @param radius Sphere radius
+     *
+     * @returns true - Sphere is at least partially inside, false - Sphere is outside
+     */
+    bool IsSphereVisible(const glm::vec3& center, float radius) const;
+
+    /**
+     * @brief Tests axis aligned box against the frustum
+     *
+     * @param min Minimum corner
+     * @param max Maximum corner
+     *
+     * @returns true - Box is at least partially inside, false - Box is outside
+     */
+    bool IsBoxVisible(const glm::vec3& min, const glm::vec3& max) const;
+};
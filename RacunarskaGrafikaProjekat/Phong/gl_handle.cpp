@@ -0,0 +1,63 @@
+#include "gl_handle.hpp"
+#include "memory_accounting.hpp"
+
+unsigned
+GLBufferTraits::Create() {
+    unsigned Id = 0;
+    glGenBuffers(1, &Id);
+    return Id;
+}
+
+void
+GLBufferTraits::Delete(unsigned id) {
+    MemoryAccounting::Untrack(MEMORY_MESH, id);
+    MemoryAccounting::Untrack(MEMORY_STREAMING, id);
+    glDeleteBuffers(1, &id);
+}
+
+unsigned
+GLVertexArrayTraits::Create() {
+    unsigned Id = 0;
+    glGenVertexArrays(1, &Id);
+    return Id;
+}
+
+void
+GLVertexArrayTraits::Delete(unsigned id) {
+    glDeleteVertexArrays(1, &id);
+}
+
+unsigned
+GLTextureTraits::Create() {
+    unsigned Id = 0;
+    glGenTextures(1, &Id);
+    return Id;
+}
+
+void
+GLTextureTraits::Delete(unsigned id) {
+    MemoryAccounting::Untrack(MEMORY_TEXTURE, id);
+    glDeleteTextures(1, &id);
+}
+
+unsigned
+GLProgramTraits::Create() {
+    return glCreateProgram();
+}
+
+void
+GLProgramTraits::Delete(unsigned id) {
+    glDeleteProgram(id);
+}
+
+unsigned
+GLFramebufferTraits::Create() {
+    unsigned Id = 0;
+    glGenFramebuffers(1, &Id);
+    return Id;
+}
+
+void
+GLFramebufferTraits::Delete(unsigned id) {
+    glDeleteFramebuffers(1, &id);
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <GL/glew.h>
+
+/**
+ * @brief Owns one OpenGL object name and deletes it when destroyed or reset. Move-only, so every
+ * object has exactly one owner and copies of the owner can't delete it twice. Traits create and
+ * delete the object kind. The context has to be current whenever a non-empty handle goes away
+ */
+template<typename Traits>
+class GLHandle {
+public:
+    GLHandle() : mId(0) {}
+
+    /**
+     * @brief Ctor - takes ownership of an existing object
+     */
+    explicit GLHandle(unsigned id) : mId(id) {}
+
+    ~GLHandle() {
+        Reset();
+    }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle&& other) noexcept : mId(other.Release()) {}
+
+    GLHandle& operator=(GLHandle&& other) noexcept {
+        Reset(other.Release());
+        return *this;
+    }
+
+    /**
+     * @brief Creates a new object
+     */
+    static GLHandle Create() {
+        return GLHandle(Traits::Create());
+    }
+
+    /**
+     * @brief Returns the object name, 0 if the handle is empty
+     */
+    unsigned Get() const {
+        return mId;
+    }
+
+    /**
+     * @brief Gives up ownership without deleting the object
+     *
+     * @returns Object name
+     */
+    unsigned Release() {
+        unsigned Id = mId;
+        mId = 0;
+        return Id;
+    }
+
+    /**
+     * @brief Deletes the owned object and takes ownership of another one
+     *
+     * @param id Object name, 0 leaves the handle empty
+     */
+    void Reset(unsigned id = 0) {
+        if (mId && mId != id) {
+            Traits::Delete(mId);
+        }
+        mId = id;
+    }
+
+private:
+    unsigned mId;
+};
+
+// Deleting buffers and textures also drops their sizes from MemoryAccounting
+struct GLBufferTraits {
+    static unsigned Create();
+    static void Delete(unsigned id);
+};
+
+struct GLVertexArrayTraits {
+    static unsigned Create();
+    static void Delete(unsigned id);
+};
+
+struct GLTextureTraits {
+    static unsigned Create();
+    static void Delete(unsigned id);
+};
+
+struct GLProgramTraits {
+    static unsigned Create();
+    static void Delete(unsigned id);
+};
+
+struct GLFramebufferTraits {
+    static unsigned Create();
+    static void Delete(unsigned id);
+};
+
+typedef GLHandle<GLBufferTraits> GLBuffer;
+typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+typedef GLHandle<GLTextureTraits> GLTexture;
+typedef GLHandle<GLProgramTraits> GLProgram;
+typedef GLHandle<GLFramebufferTraits> GLFramebuffer;
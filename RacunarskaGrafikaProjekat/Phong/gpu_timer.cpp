@@ -0,0 +1,34 @@
+#include "gpu_timer.hpp"
+
+GpuTimer::GpuTimer() {
+    glGenQueries(QUERY_COUNT, mQueries);
+    mCount = 0;
+    mMilliseconds = 0.0f;
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(QUERY_COUNT, mQueries);
+}
+
+void
+GpuTimer::Begin() {
+    unsigned Query = mQueries[mCount % QUERY_COUNT];
+    // The query about to be reused was issued QUERY_COUNT sections ago, its result is almost always ready
+    if (mCount >= QUERY_COUNT) {
+        GLuint64 Nanoseconds = 0;
+        glGetQueryObjectui64v(Query, GL_QUERY_RESULT, &Nanoseconds);
+        mMilliseconds = Nanoseconds / 1000000.0f;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, Query);
+}
+
+void
+GpuTimer::End() {
+    glEndQuery(GL_TIME_ELAPSED);
+    ++mCount;
+}
+
+float
+GpuTimer::GetMilliseconds() const {
+    return mMilliseconds;
+}
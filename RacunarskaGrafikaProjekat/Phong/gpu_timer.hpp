@@ -0,0 +1,48 @@
+#pragma once
+#include <GL/glew.h>
+
+/**
+ * @brief Measures GPU time of a section of commands with GL_TIME_ELAPSED queries.
+ * Queries are rotated over QUERY_COUNT frames, so results are read a few frames late
+ * and reading them doesn't stall the pipeline
+ */
+class GpuTimer {
+public:
+    static const unsigned QUERY_COUNT = 4;
+
+    /**
+     * @brief Ctor - creates the queries
+     */
+    GpuTimer();
+
+    /**
+     * @brief Dtor - deletes the queries
+     */
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    /**
+     * @brief Starts timing. Sections can't be nested, only one GL_TIME_ELAPSED query may be active
+     */
+    void Begin();
+
+    /**
+     * @brief Stops timing the current section
+     */
+    void End();
+
+    /**
+     * @brief Returns the latest available result
+     *
+     * @returns GPU time in milliseconds, 0 until the first result is available
+     */
+    float GetMilliseconds() const;
+
+private:
+    unsigned mQueries[QUERY_COUNT];
+    // Number of started sections
+    unsigned mCount;
+    float mMilliseconds;
+};
@@ -0,0 +1,110 @@
+#include "index_buffer.hpp"
+
+IndexBuffer::IndexBuffer() {
+    mCount = 0;
+    mType = GL_UNSIGNED_INT;
+    mPrimitiveRestart = false;
+}
+
+void
+IndexBuffer::Upload(const std::vector<unsigned>& indices, unsigned vertexCount, bool primitiveRestart) {
+    mCount = indices.size();
+    mType = ChooseType(vertexCount, primitiveRestart);
+    mPrimitiveRestart = primitiveRestart;
+
+    if (!mBuffer.Get()) {
+        mBuffer = GLBuffer::Create();
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mBuffer.Get());
+
+    if (mType == GL_UNSIGNED_SHORT) {
+        std::vector<unsigned short> ShortIndices(mCount);
+        for (unsigned IndexIdx = 0; IndexIdx < mCount; ++IndexIdx) {
+            unsigned Index = indices[IndexIdx];
+            ShortIndices[IndexIdx] = Index == RESTART_INDEX ? (unsigned short)GetRestartIndex(mType) : (unsigned short)Index;
+        }
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GetSizeInBytes(), ShortIndices.data(), GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GetSizeInBytes(), indices.data(), GL_STATIC_DRAW);
+    }
+}
+
+void
+IndexBuffer::Bind() const {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mBuffer.Get());
+}
+
+void
+IndexBuffer::Draw(GLenum mode) const {
+    DrawRange(mode, 0, mCount);
+}
+
+void
+IndexBuffer::DrawRange(GLenum mode, unsigned first, unsigned count) const {
+    beginDraw();
+    glDrawElements(mode, count, mType, GetOffset(first));
+    endDraw();
+}
+
+void
+IndexBuffer::DrawInstanced(GLenum mode, unsigned instanceCount) const {
+    beginDraw();
+    glDrawElementsInstanced(mode, mCount, mType, (void*)0, instanceCount);
+    endDraw();
+}
+
+const void*
+IndexBuffer::GetOffset(unsigned index) const {
+    return (const void*)((size_t)index * GetIndexSize());
+}
+
+unsigned
+IndexBuffer::GetId() const {
+    return mBuffer.Get();
+}
+
+unsigned
+IndexBuffer::GetCount() const {
+    return mCount;
+}
+
+GLenum
+IndexBuffer::GetType() const {
+    return mType;
+}
+
+unsigned
+IndexBuffer::GetIndexSize() const {
+    return mType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned);
+}
+
+unsigned
+IndexBuffer::GetSizeInBytes() const {
+    return mCount * GetIndexSize();
+}
+
+GLenum
+IndexBuffer::ChooseType(unsigned vertexCount, bool primitiveRestart) {
+    unsigned MaxVertexCount = primitiveRestart ? 0xFFFF : 0x10000;
+    return vertexCount <= MaxVertexCount ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+unsigned
+IndexBuffer::GetRestartIndex(GLenum type) {
+    return type == GL_UNSIGNED_SHORT ? 0xFFFF : 0xFFFFFFFF;
+}
+
+void
+IndexBuffer::beginDraw() const {
+    if (mPrimitiveRestart) {
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(GetRestartIndex(mType));
+    }
+}
+
+void
+IndexBuffer::endDraw() const {
+    if (mPrimitiveRestart) {
+        glDisable(GL_PRIMITIVE_RESTART);
+    }
+}
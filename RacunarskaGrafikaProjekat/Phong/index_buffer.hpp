@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include "gl_handle.hpp"
+
+class IndexBuffer {
+public:
+    // Marks a strip restart in the index data passed to Upload, translated to the width specific value
+    static const unsigned RESTART_INDEX = 0xFFFFFFFF;
+
+    IndexBuffer();
+
+    /**
+     * @brief Creates the element buffer if needed and uploads indices using the
+     * narrowest index type that can address all vertices. The buffer is sized exactly to the index data.
+     * NOTE: Bind the target VAO before uploading, the element buffer binding is VAO state
+     *
+     * @param indices Index data. RESTART_INDEX entries restart strips if primitiveRestart is set
+     * @param vertexCount Number of vertices the indices address
+     * @param primitiveRestart Enables primitive restart while drawing this buffer
+     */
+    void Upload(const std::vector<unsigned>& indices, unsigned vertexCount, bool primitiveRestart = false);
+
+    /**
+     * @brief Binds the buffer as GL_ELEMENT_ARRAY_BUFFER
+     */
+    void Bind() const;
+
+    /**
+     * @brief Draws all indices with the bound VAO
+     *
+     * @param mode Primitive type, GL_TRIANGLES, GL_TRIANGLE_STRIP...
+     */
+    void Draw(GLenum mode) const;
+
+    /**
+     * @brief Draws part of the index buffer with the bound VAO
+     *
+     * @param mode Primitive type
+     * @param first First index
+     * @param count Number of indices
+     */
+    void DrawRange(GLenum mode, unsigned first, unsigned count) const;
+
+    /**
+     * @brief Draws the index buffer multiple times with the bound VAO
+     *
+     * @param mode Primitive type
+     * @param instanceCount Number of instances
+     */
+    void DrawInstanced(GLenum mode, unsigned instanceCount) const;
+
+    /**
+     * @brief Returns byte offset of an index, for use as glDrawElements* indices pointer
+     *
+     * @param index Index position in the buffer
+     *
+     * @returns Byte offset
+     */
+    const void* GetOffset(unsigned index) const;
+
+    unsigned GetId() const;
+    unsigned GetCount() const;
+    GLenum GetType() const;
+    unsigned GetIndexSize() const;
+    unsigned GetSizeInBytes() const;
+
+    /**
+     * @brief Picks the narrowest index type able to address vertexCount vertices.
+     * With primitive restart the largest value of the type is reserved
+     *
+     * @param vertexCount Number of vertices
+     * @param primitiveRestart Whether primitive restart is used
+     *
+     * @returns GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+     */
+    static GLenum ChooseType(unsigned vertexCount, bool primitiveRestart);
+
+    /**
+     * @brief Returns the primitive restart index for an index type
+     *
+     * @param type GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+     *
+     * @returns Largest value of the type
+     */
+    static unsigned GetRestartIndex(GLenum type);
+
+private:
+    GLBuffer mBuffer;
+    unsigned mCount;
+    GLenum mType;
+    bool mPrimitiveRestart;
+
+    void beginDraw() const;
+    void endDraw() const;
+};
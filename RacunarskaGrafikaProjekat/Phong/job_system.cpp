@@ -0,0 +1,246 @@
+#include "job_system.hpp"
+#include <algorithm>
+
+// Queue of the thread running the code, set for workers and the owning thread.
+// Threads outside the system use the owner's queue
+static thread_local const JobSystem* tOwner = 0;
+static thread_local unsigned tQueueIdx = 0;
+
+JobCounter::JobCounter() {
+    mCount = 0;
+}
+
+bool
+JobCounter::IsDone() const {
+    // Zero is published under the lock, so once this sees it no finish() still touches the counter
+    std::lock_guard<std::mutex> Lock(mMutex);
+    return mCount.load() == 0;
+}
+
+JobSystem::JobSystem(unsigned workerCount) {
+    if (!workerCount) {
+        unsigned HardwareThreads = std::thread::hardware_concurrency();
+        workerCount = HardwareThreads > 1 ? HardwareThreads - 1 : 1;
+    }
+
+    mRunning = true;
+    mQueuedJobs = 0;
+    for (unsigned QueueIdx = 0; QueueIdx <= workerCount; ++QueueIdx) {
+        WorkQueue* Queue = new WorkQueue();
+        Queue->Jobs.resize(JOB_QUEUE_CAPACITY);
+        Queue->Head = 0;
+        Queue->Count = 0;
+        mQueues.push_back(std::unique_ptr<WorkQueue>(Queue));
+    }
+
+    tOwner = this;
+    tQueueIdx = 0;
+    for (unsigned WorkerIdx = 1; WorkerIdx <= workerCount; ++WorkerIdx) {
+        mWorkers.push_back(std::thread(&JobSystem::workerLoop, this, WorkerIdx));
+    }
+    std::cout << "Job system started with " << workerCount << " workers" << std::endl;
+}
+
+JobSystem::~JobSystem() {
+    while (runOne(0)) {
+    }
+    {
+        std::lock_guard<std::mutex> Lock(mWakeMutex);
+        mRunning = false;
+    }
+    mWake.notify_all();
+    for (std::thread& Worker : mWorkers) {
+        Worker.join();
+    }
+}
+
+void
+JobSystem::Run(JobFunction job, JobCounter* counter) {
+    if (counter) {
+        ++counter->mCount;
+    }
+    Job NewJob = { std::move(job), counter };
+    push(std::move(NewJob));
+}
+
+void
+JobSystem::RunAfter(JobCounter& dependency, JobFunction job, JobCounter* counter) {
+    if (counter) {
+        ++counter->mCount;
+    }
+    {
+        // Checked under the lock, finish() drains continuations under the same lock after reaching zero
+        std::lock_guard<std::mutex> Lock(dependency.mMutex);
+        if (dependency.mCount.load() > 0) {
+            dependency.mContinuations.push_back(std::make_pair(std::move(job), counter));
+            return;
+        }
+    }
+    Job NewJob = { std::move(job), counter };
+    push(std::move(NewJob));
+}
+
+void
+JobSystem::Wait(JobCounter& counter) {
+    unsigned QueueIdx = currentQueue();
+    while (!counter.IsDone()) {
+        if (!runOne(QueueIdx)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void
+JobSystem::parallelFor(unsigned count, unsigned batchSize, RangeCallback callback, const void* context) {
+    if (!count) {
+        return;
+    }
+    batchSize = std::max(batchSize, 1u);
+    // Not worth a round trip through the queues
+    if (count <= batchSize) {
+        callback(context, 0, count);
+        return;
+    }
+
+    // Jobs capture one pointer and the range, small enough for std::function to store without allocating
+    struct Range {
+        RangeCallback Callback;
+        const void* Context;
+    };
+    const Range Batches = { callback, context };
+    JobCounter Counter;
+    for (unsigned Begin = batchSize; Begin < count; Begin += batchSize) {
+        unsigned End = std::min(Begin + batchSize, count);
+        Run([&Batches, Begin, End]() { Batches.Callback(Batches.Context, Begin, End); }, &Counter);
+    }
+    // First batch runs here instead of waiting idle
+    callback(context, 0, batchSize);
+    Wait(Counter);
+}
+
+unsigned
+JobSystem::GetThreadCount() const {
+    return mQueues.size();
+}
+
+void
+JobSystem::workerLoop(unsigned queueIdx) {
+    tOwner = this;
+    tQueueIdx = queueIdx;
+    while (true) {
+        if (runOne(queueIdx)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Lock(mWakeMutex);
+        mWake.wait(Lock, [this]() { return !mRunning || mQueuedJobs.load() > 0; });
+        if (!mRunning && mQueuedJobs.load() == 0) {
+            return;
+        }
+    }
+}
+
+void
+JobSystem::push(Job job) {
+    WorkQueue& Queue = *mQueues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> Lock(Queue.Mutex);
+        pushBack(Queue, std::move(job));
+    }
+    {
+        std::lock_guard<std::mutex> Lock(mWakeMutex);
+        ++mQueuedJobs;
+    }
+    mWake.notify_one();
+}
+
+bool
+JobSystem::runOne(unsigned queueIdx) {
+    Job Current;
+    bool Found = false;
+
+    // Newest own job first, it most likely works on data that is still in cache
+    {
+        WorkQueue& Own = *mQueues[queueIdx];
+        std::lock_guard<std::mutex> Lock(Own.Mutex);
+        Found = popBack(Own, Current);
+    }
+
+    // Steal the oldest job from the other queues, those tend to be the biggest chunks of work
+    for (unsigned Offset = 1; !Found && Offset < mQueues.size(); ++Offset) {
+        WorkQueue& Victim = *mQueues[(queueIdx + Offset) % mQueues.size()];
+        std::lock_guard<std::mutex> Lock(Victim.Mutex);
+        Found = popFront(Victim, Current);
+    }
+
+    if (!Found) {
+        return false;
+    }
+
+    --mQueuedJobs;
+    Current.Function();
+    finish(Current.Counter);
+    return true;
+}
+
+void
+JobSystem::finish(JobCounter* counter) {
+    if (!counter) {
+        return;
+    }
+
+    // The last decrement and the drain happen under the lock, waiters only see zero after the unlock
+    // and may destroy the counter right away, so nothing below touches it
+    std::vector<std::pair<JobFunction, JobCounter*>> Continuations;
+    {
+        std::lock_guard<std::mutex> Lock(counter->mMutex);
+        if (--counter->mCount > 0) {
+            return;
+        }
+        Continuations.swap(counter->mContinuations);
+    }
+    for (std::pair<JobFunction, JobCounter*>& Continuation : Continuations) {
+        Job NewJob = { std::move(Continuation.first), Continuation.second };
+        push(std::move(NewJob));
+    }
+}
+
+unsigned
+JobSystem::currentQueue() const {
+    return tOwner == this ? tQueueIdx : 0;
+}
+
+void
+JobSystem::pushBack(WorkQueue& queue, Job job) {
+    if (queue.Count == queue.Jobs.size()) {
+        std::vector<Job> Grown(std::max<size_t>(queue.Jobs.size() * 2, JOB_QUEUE_CAPACITY));
+        for (unsigned JobIdx = 0; JobIdx < queue.Count; ++JobIdx) {
+            Grown[JobIdx] = std::move(queue.Jobs[(queue.Head + JobIdx) % queue.Jobs.size()]);
+        }
+        queue.Jobs.swap(Grown);
+        queue.Head = 0;
+    }
+    queue.Jobs[(queue.Head + queue.Count) % queue.Jobs.size()] = std::move(job);
+    ++queue.Count;
+}
+
+bool
+JobSystem::popBack(WorkQueue& queue, Job& job) {
+    if (!queue.Count) {
+        return false;
+    }
+    --queue.Count;
+    job = std::move(queue.Jobs[(queue.Head + queue.Count) % queue.Jobs.size()]);
+    return true;
+}
+
+bool
+JobSystem::popFront(WorkQueue& queue, Job& job) {
+    if (!queue.Count) {
+        return false;
+    }
+    job = std::move(queue.Jobs[queue.Head]);
+    queue.Head = (queue.Head + 1) % queue.Jobs.size();
+    --queue.Count;
+    return true;
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Jobs each thread's queue holds before its ring has to grow
+#define JOB_QUEUE_CAPACITY 256
+
+class JobSystem;
+
+/**
+ * @brief Counts unfinished jobs. Jobs can wait on it or be scheduled to run once it reaches zero
+ */
+class JobCounter {
+public:
+    JobCounter();
+
+    /**
+     * @brief Returns true if all jobs tracked by the counter finished
+     */
+    bool IsDone() const;
+
+private:
+    friend class JobSystem;
+    std::atomic<int> mCount;
+    mutable std::mutex mMutex;
+    // Jobs waiting for the counter to reach zero
+    std::vector<std::pair<std::function<void()>, JobCounter*>> mContinuations;
+};
+
+/**
+ * @brief Thread pool with a job deque per worker. Workers pop their own newest jobs and steal
+ * the oldest jobs of other workers when idle. The thread that created the system has its own
+ * deque too, jobs submitted from outside the workers go there
+ */
+class JobSystem {
+public:
+    typedef std::function<void()> JobFunction;
+    typedef void (*RangeCallback)(const void* context, unsigned begin, unsigned end);
+
+    /**
+     * @brief Ctor - starts the workers
+     *
+     * @param workerCount Number of worker threads. 0 uses one less than the number of hardware threads
+     */
+    explicit JobSystem(unsigned workerCount = 0);
+
+    /**
+     * @brief Dtor - finishes queued jobs and joins the workers
+     */
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /**
+     * @brief Schedules a job
+     *
+     * @param job Job function
+     * @param counter Optional counter incremented now and decremented when the job finishes
+     */
+    void Run(JobFunction job, JobCounter* counter = 0);
+
+    /**
+     * @brief Schedules a job to run once all jobs tracked by dependency have finished
+     *
+     * @param dependency Counter to wait for
+     * @param job Job function
+     * @param counter Optional counter incremented now and decremented when the job finishes
+     */
+    void RunAfter(JobCounter& dependency, JobFunction job, JobCounter* counter = 0);
+
+    /**
+     * @brief Blocks until the counter reaches zero. The waiting thread runs queued jobs meanwhile
+     *
+     * @param counter Counter to wait for
+     */
+    void Wait(JobCounter& counter);
+
+    /**
+     * @brief Splits [0, count) into batches, runs them on all threads and waits for them
+     *
+     * @param count Number of elements
+     * @param batchSize Number of elements per job
+     * @param function Called with [begin, end) element range of each batch
+     */
+    template<typename Function>
+    void ParallelFor(unsigned count, unsigned batchSize, const Function& function) {
+        // Called through a function pointer, wrapping every caller's lambda in std::function could allocate
+        parallelFor(count, batchSize, [](const void* context, unsigned begin, unsigned end) {
+            (*(const Function*)context)(begin, end);
+        }, &function);
+    }
+
+    /**
+     * @brief Returns number of threads executing jobs, including the creating thread
+     */
+    unsigned GetThreadCount() const;
+
+private:
+    struct Job {
+        JobFunction Function;
+        JobCounter* Counter;
+    };
+
+    // Ring buffer of jobs. Unlike a deque it only allocates when it grows, not as jobs come and go
+    struct WorkQueue {
+        std::mutex Mutex;
+        std::vector<Job> Jobs;
+        unsigned Head;
+        unsigned Count;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> mQueues;
+    std::vector<std::thread> mWorkers;
+    std::atomic<bool> mRunning;
+    std::atomic<int> mQueuedJobs;
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+
+    void workerLoop(unsigned queueIdx);
+    void push(Job job);
+    bool runOne(unsigned queueIdx);
+    void finish(JobCounter* counter);
+    void parallelFor(unsigned count, unsigned batchSize, RangeCallback callback, const void* context);
+    unsigned currentQueue() const;
+
+    /**
+     * @brief Appends a job to a queue, doubling its ring when full. Called with the queue locked
+     */
+    static void pushBack(WorkQueue& queue, Job job);
+
+    /**
+     * @brief Takes the newest (back) or oldest (front) job of a queue. Called with the queue locked
+     *
+     * @returns false if the queue is empty
+     */
+    static bool popBack(WorkQueue& queue, Job& job);
+    static bool popFront(WorkQueue& queue, Job& job);
+};
@@ -11,6 +11,28 @@
 #include "camera.hpp"
 #include "model.hpp"
 #include "texture.hpp"
+#include "stream_buffer.hpp"
+#include "job_system.hpp"
+#include "transform.hpp"
+#include "gpu_timer.hpp"
+#include "overdraw_view.hpp"
+#include "sample_counter.hpp"
+#include "ocean.hpp"
+#include "ocean_spectrum.hpp"
+#include "terrain.hpp"
+#include "particles.hpp"
+#include "vegetation.hpp"
+#include "model_impostor.hpp"
+#include "skinning.hpp"
+#include "asset_pack.hpp"
+#include "cooked.hpp"
+#include "file_io.hpp"
+#include "frame_arena.hpp"
+#include "allocation_tracker.hpp"
+#include "memory_accounting.hpp"
+#include "dynamic_resolution.hpp"
+#include <cstring>
+#include <cstdlib>
 
  /**
   * @brief Returns x value inside range
@@ -30,6 +52,40 @@ int WindowWidth = 1200;
 int WindowHeight = 800;
 const float TargetFPS = 60.0f;
 const std::string WindowTitle = "Karibi";
+const float FieldOfView = 45.0f;
+const float NearPlane = 0.1f;
+const float FarPlane = 300.0f;
+
+// Layers of the texture array used by the islands and palms
+enum ETextureLayer {
+    SAND_LAYER = 0,
+    PALM_TREE_LAYER = 1,
+    PALM_LEAF_LAYER = 2,
+    TEXTURE_LAYER_COUNT = 3,
+};
+const int TextureArraySize = 1024;
+
+// Per draw values, matches the std140 PerDraw uniform block in basic.vert and color.vert
+struct DrawData {
+    glm::mat4 Model;
+    glm::vec4 Color;
+};
+const unsigned PerDrawBinding = 0;
+// Bytes of per draw data the stream buffer can hold each frame
+const unsigned DrawStreamFrameSize = 256 * 1024;
+// Object count used by --transform-benchmark when none is given
+const unsigned DefaultBenchmarkObjectCount = 100000;
+// FFT ocean grid side, also used by --ocean-benchmark when none is given
+const unsigned OceanSpectrumSize = 256;
+// Fire and smoke particles, also used by --particle-benchmark when no count is given
+const unsigned ParticleCount = 131072;
+// Animated instances of a rigged model, also used by --animation-benchmark when no count is given
+const unsigned AnimatedInstanceCount = 256;
+// Memory budgets per category, sized for the bundled scene with headroom. Lower them to fit smaller machines
+const size_t TextureMemoryBudget = 256 * 1024 * 1024;
+const size_t MeshMemoryBudget = 128 * 1024 * 1024;
+const size_t CpuGeometryMemoryBudget = 128 * 1024 * 1024;
+const size_t StreamingMemoryBudget = 8 * 1024 * 1024;
 
 
 struct Input {
@@ -46,10 +102,27 @@ struct Input {
 struct EngineState {
     Input* mInput;
     Camera* mCamera;
+    JobSystem* mJobs;
+    DynamicResolution* mResolution;
     bool mDrawDebugLines;
+    bool mDepthPrePass;
+    EOverdrawMode mOverdrawMode;
+    bool mCaptureSamples;
+    bool mOceanSpectrum;
+    bool mCpuParticles;
     float mDT;
 };
 bool pressed = true;
+/**
+ * @brief Terminates GLFW when main returns. Declared before any GL object, so models, shaders
+ * and buffers are destroyed while the context still exists
+ */
+struct GlfwSession {
+    ~GlfwSession() {
+        glfwTerminate();
+    }
+};
+
 /**
  * @brief Error callback function for GLFW. See GLFW docs for details
  *
@@ -93,6 +166,53 @@ KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mode) {
         }
     } break;
 
+    case GLFW_KEY_P: {
+        if (action == GLFW_PRESS) {
+            State->mDepthPrePass ^= true;
+            std::cout << "Depth pre-pass " << (State->mDepthPrePass ? "on" : "off") << std::endl;
+        }
+    } break;
+
+    case GLFW_KEY_O: {
+        if (action == GLFW_PRESS) {
+            State->mOverdrawMode = (EOverdrawMode)((State->mOverdrawMode + 1) % OVERDRAW_MODE_COUNT);
+            std::cout << "Overdraw view: " << OverdrawView::GetModeName(State->mOverdrawMode) << std::endl;
+        }
+    } break;
+
+    case GLFW_KEY_K: {
+        if (action == GLFW_PRESS) {
+            State->mCaptureSamples = true;
+        }
+    } break;
+
+    case GLFW_KEY_F: {
+        if (action == GLFW_PRESS) {
+            State->mOceanSpectrum ^= true;
+            std::cout << "Ocean waves: " << (State->mOceanSpectrum ? "FFT spectrum" : "Gerstner") << std::endl;
+        }
+    } break;
+
+    case GLFW_KEY_M: {
+        if (action == GLFW_PRESS) {
+            MemoryAccounting::PrintReport(std::cout);
+        }
+    } break;
+
+    case GLFW_KEY_R: {
+        if (action == GLFW_PRESS) {
+            State->mResolution->SetEnabled(!State->mResolution->IsEnabled());
+            std::cout << "Dynamic resolution " << (State->mResolution->IsEnabled() ? "on" : "off") << std::endl;
+        }
+    } break;
+
+    case GLFW_KEY_C: {
+        if (action == GLFW_PRESS) {
+            State->mCpuParticles ^= true;
+            std::cout << "Particle simulation: " << (State->mCpuParticles ? "CPU" : "GPU") << std::endl;
+        }
+    } break;
+
     case GLFW_KEY_ESCAPE: glfwSetWindowShouldClose(window, GLFW_TRUE); break;
 
     case GLFW_KEY_SPACE: if (IsDown) pressed = !pressed; break;
@@ -103,7 +223,29 @@ static void
 FramebufferSizeCallback(GLFWwindow* window, int width, int height) {
     WindowWidth = width;
     WindowHeight = height;
-    glViewport(0, 0, width, height);
+    // Minimized window reports zero size, keep the last projection and target
+    if (width > 0 && height > 0) {
+        EngineState* State = (EngineState*)glfwGetWindowUserPointer(window);
+        State->mCamera->SetPerspective(FieldOfView, width / (float)height, NearPlane, FarPlane);
+        State->mResolution->Resize(width, height);
+    }
+}
+
+/**
+ * @brief Writes per draw values into the stream buffer and binds them to the PerDraw uniform block
+ *
+ * @param stream Per frame stream buffer
+ * @param alignment Uniform buffer offset alignment
+ * @param model Model matrix
+ * @param color Color used by the color shader
+ */
+static void
+BindDrawData(StreamBuffer& stream, unsigned alignment, const glm::mat4& model, const glm::vec3& color = glm::vec3(1.0f)) {
+    DrawData Data = { model, glm::vec4(color, 1.0f) };
+    unsigned Offset = stream.Push(&Data, sizeof(DrawData), alignment);
+    if (Offset != StreamBuffer::INVALID_OFFSET) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, PerDrawBinding, stream.GetId(), Offset, sizeof(DrawData));
+    }
 }
 
 /**
@@ -127,21 +269,159 @@ HandleInput(EngineState* state) {
 }
 
 
-int main() {
+/**
+ * @brief Sets light and material uniforms that don't change between frames.
+ * The shader has to be bound
+ *
+ * @param shader Lit shader using phong_material_texture.frag
+ */
+static void
+SetLightUniforms(const Shader& shader) {
+    shader.SetUniform3f("uDirLight.Direction", glm::vec3(-8.0f, 10.0f, -3.0f));
+    //Yellow ambient and diffuse, white specular 
+    shader.SetUniform3f("uDirLight.Ka", glm::vec3(0.6f, 0.6f, 0.4f));
+    shader.SetUniform3f("uDirLight.Kd", glm::vec3(0.6f, 0.6f, 0.4f));
+    shader.SetUniform3f("uDirLight.Ks", glm::vec3(1.0f));
+
+    shader.SetUniform3f("uPointLight.Ka", glm::vec3(0.7f, 0.5f, 0.0f));
+    shader.SetUniform3f("uPointLight.Kd", glm::vec3(0.7f, 0.5f, 0.0f));
+    shader.SetUniform3f("uPointLight.Ks", glm::vec3(1.0f));
+    shader.SetUniform1f("uPointLight.Kc", 0.7f );
+    shader.SetUniform1f("uPointLight.Kl", 0.592f );
+    shader.SetUniform1f("uPointLight.Kq", 0.532f);
+
+    //Fire position
+    shader.SetUniform3f("uPointLightPosition1", glm::vec3(-1.7f, 0.21f, -2.0f));
+    shader.SetUniform3f("uPointLightPosition2", glm::vec3(-10.0f, -0.4f, 0.0f));
+    shader.SetUniform3f("uPointLightPosition3", glm::vec3(10.0f, -0.4f, -3.0f));
+
+    shader.SetUniform3f("uSpotLightPosition1", glm::vec3(-15.0f, 2.5f, -15.0f));
+    shader.SetUniform3f("uSpotLightPosition2", glm::vec3(-15.0f, 2.5f, -15.0f));
+    shader.SetUniform3f("uSpotLightDirection1", glm::vec3(2.0f, 0.0f, 10.0f));
+    shader.SetUniform3f("uSpotLightDirection2", glm::vec3(-2.0f, 0.0f, -10.0f));
+    shader.SetUniform3f("uSpotlight.Ka", glm::vec3(1.0f, 1.0f, 0.0f));
+    shader.SetUniform3f("uSpotlight.Kd", glm::vec3(1.0f, 1.0f, 0.0f));
+    shader.SetUniform3f("uSpotlight.Ks", glm::vec3(1.0f));
+    shader.SetUniform1f("uSpotlight.Kc", 0.5f);
+    shader.SetUniform1f("uSpotlight.Kl", 0.092f);
+    shader.SetUniform1f("uSpotlight.Kq", 0.032f);
+    shader.SetUniform1f("uSpotlight.InnerCutOff", glm::cos(glm::radians(50.0f)));
+    shader.SetUniform1f("uSpotlight.OuterCutOff", glm::cos(glm::radians(50.5f)));
+
+    shader.SetUniform1i("uMaterial.Kd", 0.9);
+    shader.SetUniform1i("uMaterial.Ks", 1);
+    shader.SetUniform1f("uMaterial.Shininess", 150.0f);
+    shader.SetUniform1i("uDiffuseArray", 2);
+}
+
+/**
+ * @brief Sets animated light uniforms and the camera position for the current frame.
+ * The shader has to be bound
+ *
+ * @param shader Lit shader using phong_material_texture.frag
+ * @param viewPosition World space camera position
+ */
+static void
+SetFrameLightUniforms(const Shader& shader, const glm::vec3& viewPosition) {
+    shader.SetUniform3f("uViewPos", viewPosition);
+
+    //Change intensity of fire
+    shader.SetUniform1f("uPointLight.Kc", 0.3 + abs(sin(glfwGetTime())));
+    shader.SetUniform1f("uPointLight.Kl", 0.2 + abs(sin(glfwGetTime())));
+    shader.SetUniform1f("uPointLight.Kq", 0.5 + abs(sin(glfwGetTime())));
+
+    if (pressed) {
+        shader.SetUniform3f("uSpotlight.Ka", glm::vec3(0.0f, 0.0f, 0.0f));
+        shader.SetUniform3f("uSpotlight.Kd", glm::vec3(0.0f, 0.0f, 0.0f));
+        shader.SetUniform3f("uSpotlight.Ks", glm::vec3(0.0f, 0.0f, 0.0f));
+    }
+    else {
+        shader.SetUniform3f("uSpotlight.Ka", glm::vec3(1.0f, 1.0f, 0.0f));
+        shader.SetUniform3f("uSpotlight.Kd", glm::vec3(1.0f, 1.0f, 0.0f));
+        shader.SetUniform3f("uSpotlight.Ks", glm::vec3(1.0f));
+        shader.SetUniform3f("uSpotLightDirection1", glm::vec3(sin(glfwGetTime()), 0.00, cos(glfwGetTime())));
+        shader.SetUniform3f("uSpotLightDirection2", glm::vec3(sin(glfwGetTime() + 3.14), 0.00, cos(glfwGetTime() + 3.14)));
+    }
+}
+
+int main(int argc, char** argv) {
+    //Asset decoding, culling and transform updates run on worker threads, GL calls stay on this one
+    JobSystem Jobs;
+
+    //Cooked assets are read straight out of the mapped pack, loose cooked files and sources are the fallback
+    AssetPack Pack;
+    if (Pack.Open(COOKED_PACK_PATH)) {
+        CookedFile::SetPack(&Pack);
+    }
+
+    //Compares SIMD transform kernels against the glm chain and exits, no window needed
+    if (argc > 1 && !strcmp(argv[1], "--transform-benchmark")) {
+        unsigned ObjectCount = argc > 2 ? (unsigned)atoi(argv[2]) : DefaultBenchmarkObjectCount;
+        TransformBatch::RunBenchmark(ObjectCount ? ObjectCount : DefaultBenchmarkObjectCount, Jobs);
+        return 0;
+    }
+
+    //Times the FFT ocean simulation and checks it against a direct sum, no window needed
+    if (argc > 1 && !strcmp(argv[1], "--ocean-benchmark")) {
+        unsigned Size = argc > 2 ? (unsigned)atoi(argv[2]) : OceanSpectrumSize;
+        OceanSpectrum::RunBenchmark(Size ? Size : OceanSpectrumSize, Jobs);
+        return 0;
+    }
+
+    //Times the CPU particle simulation and checks the SIMD path against the scalar one, no window needed
+    if (argc > 1 && !strcmp(argv[1], "--particle-benchmark")) {
+        unsigned Count = argc > 2 ? (unsigned)atoi(argv[2]) : ParticleCount;
+        ParticleSimulation::RunBenchmark(Count ? Count : ParticleCount, Jobs);
+        return 0;
+    }
+
+    //Times clip sampling, blending and skinning and checks the SIMD path against the scalar one, no window needed
+    if (argc > 1 && !strcmp(argv[1], "--animation-benchmark")) {
+        unsigned Count = argc > 2 ? (unsigned)atoi(argv[2]) : AnimatedInstanceCount;
+        AnimationClip::RunBenchmark(Count ? Count : AnimatedInstanceCount, Jobs);
+        return 0;
+    }
+
+    //Every texture and buffer is sized as it is created, M prints what is resident
+    MemoryAccounting::SetBudget(MEMORY_TEXTURE, TextureMemoryBudget);
+    MemoryAccounting::SetBudget(MEMORY_MESH, MeshMemoryBudget);
+    MemoryAccounting::SetBudget(MEMORY_CPU_GEOMETRY, CpuGeometryMemoryBudget);
+    MemoryAccounting::SetBudget(MEMORY_STREAMING, StreamingMemoryBudget);
+    bool MemoryReport = argc > 1 && !strcmp(argv[1], "--memory-report");
+
+    //Asset files are read in the background while the window and context are created
+    const std::vector<std::string> TexturePaths = {
+        "res/container_diffuse.png", "res/container_specular.png",
+        "res/floor_diffuse.jpg", "res/floor_specular.jpg",
+        "res/oceanDiffuse.png", "res/oceanSpec.png",
+    };
+    //Order has to match ETextureLayer
+    const std::vector<std::string> LayerPaths = { "res/sand.png", "res/palm_tree.png", "res/palm_leaf.png" };
+    const std::vector<std::string> ModelPaths = {
+        "res/alduin/alduin-dragon.obj", "res/low-poly-fox/low-poly-fox.obj", "res/monkey/12958_Spider_Monkey_v1_l2.obj",
+    };
+    FileIO IO;
+    CookedFile::SetIO(&IO);
+    CookedFile::Prefetch(TexturePaths, COOKED_TEXTURE_EXTENSION);
+    CookedFile::Prefetch(LayerPaths, COOKED_TEXTURE_EXTENSION);
+    CookedFile::Prefetch(ModelPaths, COOKED_MODEL_EXTENSION);
+
     GLFWwindow* Window = 0;
     if (!glfwInit()) {
         std::cerr << "Failed to init glfw" << std::endl;
         return -1;
     }
+    GlfwSession Session;
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    //Overdraw view counts fragments in the stencil buffer
+    glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
     Window = glfwCreateWindow(WindowWidth, WindowHeight, WindowTitle.c_str(), 0, 0);
     if (!Window) {
         std::cerr << "Failed to create window" << std::endl;
-        glfwTerminate();
         return -1;
     }
     glfwMakeContextCurrent(Window);
@@ -149,15 +429,19 @@ int main() {
     GLenum GlewError = glewInit();
     if (GlewError != GLEW_OK) {
         std::cerr << "Failed to init glew: " << glewGetErrorString(GlewError) << std::endl;
-        glfwTerminate();
         return -1;
     }
 
     EngineState State = { 0 };
     Camera FPSCamera;
+    FPSCamera.SetPerspective(FieldOfView, WindowWidth / (float)WindowHeight, NearPlane, FarPlane);
     Input UserInput = { 0 };
     State.mCamera = &FPSCamera;
     State.mInput = &UserInput;
+    State.mJobs = &Jobs;
+    State.mDepthPrePass = true;
+    State.mOverdrawMode = OVERDRAW_OFF;
+    State.mOceanSpectrum = true;
     glfwSetWindowUserPointer(Window, &State);
 
     glfwSetErrorCallback(ErrorCallback);
@@ -169,15 +453,25 @@ int main() {
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
-    unsigned CubeDiffuseTexture = Texture::LoadImageToTexture("res/container_diffuse.png");
-    unsigned CubeSpecularTexture = Texture::LoadImageToTexture("res/container_specular.png");
-    unsigned FloorDiffuseTexture = Texture::LoadImageToTexture("res/floor_diffuse.jpg");
-    unsigned FloorSpecularTexture = Texture::LoadImageToTexture("res/floor_specular.jpg");
-    unsigned SandDiffuseTexture = Texture::LoadImageToTexture("res/sand.png");
-    unsigned OceanDiffuseTexture = Texture::LoadImageToTexture("res/oceanDiffuse.png");
-    unsigned OceanSpecularTexture = Texture::LoadImageToTexture("res/oceanSpec.png");
-    unsigned PalmTreeDiffuseTexture = Texture::LoadImageToTexture("res/palm_tree.png");
-    unsigned PalmLeafDiffuseTexture = Texture::LoadImageToTexture("res/palm_leaf.png");
+    //Scene renders offscreen at a scale that keeps GPU time within the frame budget, R toggles it
+    int FramebufferWidth = 0;
+    int FramebufferHeight = 0;
+    glfwGetFramebufferSize(Window, &FramebufferWidth, &FramebufferHeight);
+    DynamicResolution Resolution(FramebufferWidth, FramebufferHeight);
+    State.mResolution = &Resolution;
+
+    //Decoded in parallel, uploaded in order
+    std::vector<GLTexture> Textures;
+    for (unsigned Id : Texture::LoadImagesToTextures(TexturePaths, &Jobs)) {
+        Textures.push_back(GLTexture(Id));
+    }
+    unsigned CubeDiffuseTexture = Textures[0].Get();
+    unsigned CubeSpecularTexture = Textures[1].Get();
+    unsigned FloorDiffuseTexture = Textures[2].Get();
+    unsigned FloorSpecularTexture = Textures[3].Get();
+    unsigned OceanDiffuseTexture = Textures[4].Get();
+    unsigned OceanSpecularTexture = Textures[5].Get();
+    GLTexture StaticDiffuseArray(Texture::LoadImagesToTextureArray(LayerPaths, TextureArraySize, TextureArraySize, &Jobs));
 
     std::vector<float> CubeVertices = {
         // X     Y     Z     NX    NY    NZ    U     V    
@@ -227,12 +521,10 @@ int main() {
 
 
 
-    unsigned CubeVAO;
-    glGenVertexArrays(1, &CubeVAO);
-    glBindVertexArray(CubeVAO);
-    unsigned CubeVBO;
-    glGenBuffers(1, &CubeVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, CubeVBO);
+    GLVertexArray CubeVAO = GLVertexArray::Create();
+    glBindVertexArray(CubeVAO.Get());
+    GLBuffer CubeVBO = GLBuffer::Create();
+    glBindBuffer(GL_ARRAY_BUFFER, CubeVBO.Get());
     glBufferData(GL_ARRAY_BUFFER, CubeVertices.size() * sizeof(float), CubeVertices.data(), GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -243,26 +535,32 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    Model Alduin("res/alduin/alduin-dragon.obj");
-    if (!Alduin.Load()) {
+    const glm::vec3 AxisX(1.0f, 0.0f, 0.0f);
+    const glm::vec3 AxisY(0.0f, 1.0f, 0.0f);
+
+    Model Alduin(ModelPaths[0]);
+    if (!Alduin.Load(&Jobs)) {
         std::cerr << "Failed to load alduin\n";
-        glfwTerminate();
         return -1;
     }
 
-    Model Fox("res/low-poly-fox/low-poly-fox.obj");
-    if (!Fox.Load()) {
+    Model Fox(ModelPaths[1]);
+    if (!Fox.Load(&Jobs)) {
         std::cerr << "Failed to load fox\n";
-        glfwTerminate();
         return -1;
     }
 
-    Model Monkey("res/monkey/12958_Spider_Monkey_v1_l2.obj");
-    if (!Monkey.Load()) {
+    Model Monkey(ModelPaths[2]);
+    if (!Monkey.Load(&Jobs)) {
         std::cerr << "Failed to load fox\n";
-        glfwTerminate();
         return -1;
     }
+    //Far away the monkey is a two triangle impostor baked from all around it
+    ModelImpostor MonkeyImpostor(Monkey);
+    Shader ModelImpostorShader("shaders/model_impostor.vert", "shaders/model_impostor.frag");
+    glUseProgram(ModelImpostorShader.GetId());
+    SetLightUniforms(ModelImpostorShader);
+    glUseProgram(0);
 
     //Used to only define color
     Shader ColorShader("shaders/color.vert", "shaders/color.frag");
@@ -278,48 +576,132 @@ int main() {
 
     //Phong shader with material and texture support
     Shader PhongShaderMaterialTexture("shaders/basic.vert", "shaders/phong_material_texture.frag");
-    glUseProgram(PhongShaderMaterialTexture.GetId());
-    PhongShaderMaterialTexture.SetUniform3f("uDirLight.Direction", glm::vec3(-8.0f, 10.0f, -3.0f));
-    //Yellow ambient and diffuse, white specular 
-    PhongShaderMaterialTexture.SetUniform3f("uDirLight.Ka", glm::vec3(0.6f, 0.6f, 0.4f));
-    PhongShaderMaterialTexture.SetUniform3f("uDirLight.Kd", glm::vec3(0.6f, 0.6f, 0.4f));
-    PhongShaderMaterialTexture.SetUniform3f("uDirLight.Ks", glm::vec3(1.0f));
 
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight.Ka", glm::vec3(0.7f, 0.5f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight.Kd", glm::vec3(0.7f, 0.5f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight.Ks", glm::vec3(1.0f));
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight.Kc", 0.7f );
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight.Kl", 0.592f );
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight.Kq", 0.532f);
+    //Depth only, for the pre-pass
+    Shader DepthShader("shaders/depth.vert", "shaders/depth.frag");
+    glUseProgram(PhongShaderMaterialTexture.GetId());
+    SetLightUniforms(PhongShaderMaterialTexture);
 
-    //Fire position
-    PhongShaderMaterialTexture.SetUniform3f("uPointLightPosition1", glm::vec3(-1.7f, 0.21f, -2.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLightPosition2", glm::vec3(-10.0f, -0.4f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLightPosition3", glm::vec3(10.0f, -0.4f, -3.0f));
-
-    PhongShaderMaterialTexture.SetUniform3f("uSpotLightPosition1", glm::vec3(-15.0f, 2.5f, -15.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotLightPosition2", glm::vec3(-15.0f, 2.5f, -15.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotLightDirection1", glm::vec3(2.0f, 0.0f, 10.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotLightDirection2", glm::vec3(-2.0f, 0.0f, -10.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight.Ka", glm::vec3(1.0f, 1.0f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight.Kd", glm::vec3(1.0f, 1.0f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight.Ks", glm::vec3(1.0f));
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.Kc", 0.5f);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.Kl", 0.092f);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.Kq", 0.032f);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.InnerCutOff", glm::cos(glm::radians(50.0f)));
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.OuterCutOff", glm::cos(glm::radians(50.5f)));
-
-    PhongShaderMaterialTexture.SetUniform1i("uMaterial.Kd", 0.9);
-    PhongShaderMaterialTexture.SetUniform1i("uMaterial.Ks", 1);
-    PhongShaderMaterialTexture.SetUniform1f("uMaterial.Shininess", 150.0f);
+    //Ocean - clipmap grid displaced in the vertex shader, lit the same way as the textured objects
+    Shader OceanShader("shaders/ocean.vert", "shaders/phong_material_texture.frag");
+    Shader OceanDepthShader("shaders/ocean.vert", "shaders/depth.frag");
+    glUseProgram(OceanShader.GetId());
+    SetLightUniforms(OceanShader);
     glUseProgram(0);
+    Ocean Sea(0.25f, -1.6f);
+    //FFT waves tile every 64 units, F switches back to the Gerstner waves
+    OceanSpectrum SeaSpectrum(OceanSpectrumSize, 64.0f, glm::vec2(10.0f, 4.0f), 0.25f, 1.0f);
+    std::cout << "Ocean: " << Sea.GetTriangleCount() << " triangles, extent " << Sea.GetExtent() << std::endl;
+
+    //Islands - heightmap chunks generated on the workers as they come into view. The fixed ones
+    //carry the fires, the palm tree and the lighthouse, procedural ones fill the rest of the sea
+    Shader TerrainShader("shaders/terrain.vert", "shaders/phong_material_texture.frag");
+    Shader TerrainDepthShader("shaders/terrain.vert", "shaders/depth.frag");
+    glUseProgram(TerrainShader.GetId());
+    SetLightUniforms(TerrainShader);
+    glUseProgram(0);
+    Terrain Islands(32.0f, -1.6f, 1234, Jobs);
+    Islands.AddIsland(glm::vec2(-10.0f, 0.0f), 3.0f, -0.5f);
+    Islands.AddIsland(glm::vec2(-0.3f, -2.0f), 5.5f, 0.1f);
+    Islands.AddIsland(glm::vec2(10.0f, -3.0f), 3.5f, -0.5f);
+    Islands.AddIsland(glm::vec2(-15.0f, -15.0f), 2.5f, -1.2f);
+
+    //Fires - particle emitters at the fire point lights, C switches between GPU and CPU simulation
+    std::vector<ParticleEmitter> FireEmitters;
+    const glm::vec3 FirePositions[] = { glm::vec3(-10.0f, -0.4f, 0.0f), glm::vec3(-1.7f, 0.2f, -2.0f), glm::vec3(10.0f, -0.4f, -3.0f) };
+    for (const glm::vec3& FirePosition : FirePositions) {
+        ParticleEmitter Emitter = { FirePosition, 0.15f };
+        FireEmitters.push_back(Emitter);
+    }
+    ParticleSystem Fires(ParticleCount, FireEmitters);
+
+    //Palms - scattered over the procedural islands, instanced up close and impostors further away.
+    //The fixed islands keep their layout, only the hand placed palm grows there
+    Shader VegetationShader("shaders/vegetation.vert", "shaders/phong_material_texture.frag");
+    Shader VegetationDepthShader("shaders/vegetation.vert", "shaders/depth.frag");
+    Shader ImpostorShader("shaders/impostor.vert", "shaders/impostor.frag");
+    const Shader* VegetationShaders[] = { &VegetationShader, &ImpostorShader };
+    for (const Shader* LitShader : VegetationShaders) {
+        glUseProgram(LitShader->GetId());
+        SetLightUniforms(*LitShader);
+    }
+    glUseProgram(0);
+    Vegetation Palms(Islands, Jobs, StaticDiffuseArray.Get(), PALM_TREE_LAYER, PALM_LEAF_LAYER);
+    const glm::vec3 FixedIslands[] = {
+        glm::vec3(-10.0f, 0.0f, 3.0f), glm::vec3(-0.3f, -2.0f, 5.5f), glm::vec3(10.0f, -3.0f, 3.5f), glm::vec3(-15.0f, -15.0f, 2.5f),
+    };
+    for (const glm::vec3& FixedIsland : FixedIslands) {
+        Palms.AddExclusion(glm::vec2(FixedIsland.x, FixedIsland.y), FixedIsland.z + 1.0f);
+    }
+    VegetationInstance HeroPalm = { glm::vec3(0.3f, -0.5f, -2.0f), 1.0f, 0.0f };
+    Palms.AddInstance(HeroPalm);
+
+    //Foxes - a pack on the big island, skinned on the GPU in one instanced draw. Only
+    //rigged models with clips get instances, the bundled OBJ has neither
+    Shader SkinnedShader("shaders/skinned.vert", "shaders/phong_material_texture.frag");
+    glUseProgram(SkinnedShader.GetId());
+    SetLightUniforms(SkinnedShader);
+    glUseProgram(0);
+    SkinnedCrowd Foxes(Fox, AnimatedInstanceCount);
+    if (Foxes.IsAnimated()) {
+        const unsigned FoxRows = 4;
+        float FoxX[FoxRows * FoxRows];
+        float FoxZ[FoxRows * FoxRows];
+        float FoxY[FoxRows * FoxRows];
+        for (unsigned FoxIdx = 0; FoxIdx < FoxRows * FoxRows; ++FoxIdx) {
+            FoxX[FoxIdx] = -1.8f + 0.8f * (FoxIdx % FoxRows);
+            FoxZ[FoxIdx] = -3.5f + 0.8f * (FoxIdx / FoxRows);
+        }
+        Islands.SampleHeights(FoxX, FoxZ, FoxY, FoxRows * FoxRows);
+        for (unsigned FoxIdx = 0; FoxIdx < FoxRows * FoxRows; ++FoxIdx) {
+            glm::mat4 FoxModel = glm::translate(glm::mat4(1.0f), glm::vec3(FoxX[FoxIdx], FoxY[FoxIdx], FoxZ[FoxIdx]));
+            FoxModel = glm::rotate(FoxModel, glm::radians(37.0f * FoxIdx), AxisY);
+            FoxModel = glm::scale(FoxModel, glm::vec3(0.01f));
+            unsigned Instance = Foxes.Add(FoxModel, FoxIdx, FoxIdx / (float)(FoxRows * FoxRows));
+            //Every other fox mixes in the next clip, a walk blended into a run stays in step
+            if (FoxIdx % 2) {
+                Foxes.SetBlend(Instance, FoxIdx + 1, 0.5f);
+            }
+        }
+    }
+
+    //Model matrices and colors are streamed per draw instead of set with glUniform calls
+    const Shader* DrawDataShaders[] = { &ColorShader, &PhongShader, &PhongShaderMaterial, &PhongShaderMaterialTexture, &DepthShader };
+    for (const Shader* DrawDataShader : DrawDataShaders) {
+        DrawDataShader->SetUniformBlockBinding("PerDraw", PerDrawBinding);
+    }
+    GLint DrawDataAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &DrawDataAlignment);
+    StreamBuffer DrawStream(GL_UNIFORM_BUFFER, DrawStreamFrameSize);
 
     
 
-    glm::mat4 Projection = glm::perspective(45.0f, WindowWidth / (float)WindowHeight, 0.1f, 100.0f);
-    glm::mat4 View = glm::lookAt(FPSCamera.GetPosition(), FPSCamera.GetTarget(), FPSCamera.GetUp());
-    glm::mat4 ModelMatrix(1.0f);
+    //Objects drawn one by one. Their transforms live in one batch that is composed once per frame
+    const glm::quat NoRotation(1.0f, 0.0f, 0.0f, 0.0f);
+    TransformBatch SceneTransforms;
+    //Monkey is scaled and rotated before it is moved, so its offset is scaled and rotated too
+    const glm::quat MonkeyRotation = glm::angleAxis(glm::radians(90.0f), -AxisX);
+    unsigned MonkeyTransform = SceneTransforms.Add(0.009f * (MonkeyRotation * glm::vec3(0.0f, 85.0f, 12.8f)), MonkeyRotation, glm::vec3(0.009f));
+    //Sun - one cube and three copies turned further around the same axis
+    const glm::vec3 SunAxis = glm::normalize(glm::vec3(2.0f, 1.0f, 1.0f));
+    const float SunAngles[] = { 0.0f, 30.0f, 90.0f, 185.0f };
+    unsigned SunTransforms = SceneTransforms.GetCount();
+    for (float SunAngle : SunAngles) {
+        SceneTransforms.Add(glm::vec3(-8.0f, 10.0f, -3.0f), glm::angleAxis(glm::radians(SunAngle), SunAxis), glm::vec3(0.5f));
+    }
+    //Clouds - 4
+    unsigned CloudTransforms = SceneTransforms.Add(glm::vec3(11.0f, 7.0f, -5.0f), glm::angleAxis(glm::radians(30.0f), glm::normalize(glm::vec3(2.0f, 1.0f, 1.0f))), glm::vec3(1.2f));
+    SceneTransforms.Add(glm::vec3(1.2f, 9.0f, -8.0f), glm::angleAxis(glm::radians(45.0f), glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f))), glm::vec3(0.9f));
+    SceneTransforms.Add(glm::vec3(-5.3f, 7.0f, -6.0f), glm::angleAxis(glm::radians(32.0f), glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f))), glm::vec3(1.5f));
+    SceneTransforms.Add(glm::vec3(-15.3f, 6.0f, -8.0f), glm::angleAxis(glm::radians(100.0f), glm::normalize(glm::vec3(1.0f, 2.0f, 0.0f))), glm::vec3(1.0f));
+    //Lighthouse - four stacked cubes, the top one spins
+    unsigned LighthouseTransforms = SceneTransforms.GetCount();
+    for (unsigned Level = 0; Level < 4; ++Level) {
+        SceneTransforms.Add(glm::vec3(-15.0f, -1.5f + Level, -15.0f));
+    }
+    unsigned LighthouseTopTransform = LighthouseTransforms + 3;
+    std::vector<glm::mat4> SceneModels(SceneTransforms.GetCount());
+
     
     //Current angle around Y axis, with regards to XZ plane at which the point light is situated at
     float Angle = 0.0f;
@@ -333,402 +715,311 @@ int main() {
 
     //Currently used shader
     Shader* CurrentShader = &PhongShaderMaterialTexture;
+
+    //Frame time statistics, printed once per second
+    GpuTimer FrameTimer;
+
+    //Debug views, O cycles the overdraw heatmap, K prints samples shaded per draw for one frame
+    OverdrawView Overdraw;
+    SampleCounter Samples;
+    float StatsTime = 0.0f;
+    float StatsCpuTime = 0.0f;
+    float StatsGpuTime = 0.0f;
+    float StatsSpectrumTime = 0.0f;
+    float StatsParticleTime = 0.0f;
+    unsigned StatsFrames = 0;
+    unsigned long long StatsAllocations = 0;
+
+    //Transient per-frame data goes here, the render loop itself shouldn't touch the heap once warmed up
+    FrameArena Frame;
+
+    //Prefetches nobody claimed, e.g. rigged models Assimp reads itself, only hold memory from here on
+    unsigned UnclaimedReads = IO.CancelPrefetches();
+    if (UnclaimedReads) {
+        std::cout << "Cancelled " << UnclaimedReads << " unclaimed asset reads" << std::endl;
+    }
+    if (MemoryReport) {
+        MemoryAccounting::PrintReport(std::cout);
+    }
     
     while (!glfwWindowShouldClose(Window)) {
         glfwPollEvents();
+        Frame.Reset();
+        unsigned long long FrameAllocations = AllocationTracker::GetCount();
+        //Nothing from the last frame is referenced anymore, so streamed buffers over budget can go
+        MemoryAccounting::EnforceBudgets();
         HandleInput(&State);
+        //Input from this frame is applied at once, matrices below are rebuilt only if the camera changed
+        FPSCamera.Update();
+        const glm::mat4& Projection = FPSCamera.GetProjection();
+        const glm::mat4& View = FPSCamera.GetView();
         CurrentShader = &PhongShaderMaterialTexture;
+        DrawStream.BeginFrame();
 
         
-        
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        // In case of window resize, update projection. Bit bad for performance to do it every iteration.
-        // If laggy, remove this line
-        Projection = glm::perspective(45.0f, WindowWidth / (float)WindowHeight, 0.1f, 100.0f);
-        View = glm::lookAt(FPSCamera.GetPosition(), FPSCamera.GetTarget(), FPSCamera.GetUp());
+        Resolution.BeginScene();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
         StartTime = glfwGetTime();
+        FrameTimer.Begin();
+        Overdraw.BeginFrame(State.mOverdrawMode);
+        if (State.mCaptureSamples) {
+            Samples.Capture();
+            State.mCaptureSamples = false;
+        }
+        Samples.BeginFrame(Frame);
         glUseProgram(CurrentShader->GetId());
         CurrentShader->SetProjection(Projection);
         CurrentShader->SetView(View);
-        CurrentShader->SetUniform3f("uViewPos", FPSCamera.GetPosition());
-
-        
-
-        //Change intensity of fire
-        CurrentShader->SetUniform1f("uPointLight.Kc", 0.3 + abs(sin(glfwGetTime())));
-        CurrentShader->SetUniform1f("uPointLight.Kl", 0.2 + abs(sin(glfwGetTime())));
-        CurrentShader->SetUniform1f("uPointLight.Kq", 0.5 + abs(sin(glfwGetTime())));
+        SetFrameLightUniforms(*CurrentShader, FPSCamera.GetPosition());
 
         if (angle > 360) {
             angle = 0;
         }
-        if (pressed) {
-            CurrentShader->SetUniform3f("uSpotlight.Ka", glm::vec3(0.0f, 0.0f, 0.0f));
-            CurrentShader->SetUniform3f("uSpotlight.Kd", glm::vec3(0.0f, 0.0f, 0.0f));
-            CurrentShader->SetUniform3f("uSpotlight.Ks", glm::vec3(0.0f, 0.0f, 0.0f));
-            
-        }
-        else {
-            CurrentShader->SetUniform3f("uSpotlight.Ka", glm::vec3(1.0f, 1.0f, 0.0f));
-            CurrentShader->SetUniform3f("uSpotlight.Kd", glm::vec3(1.0f, 1.0f, 0.0f));
-            CurrentShader->SetUniform3f("uSpotlight.Ks", glm::vec3(1.0f));
-            CurrentShader->SetUniform3f("uSpotLightDirection1", glm::vec3(sin(glfwGetTime()), 0.00, cos(glfwGetTime())));
-            CurrentShader->SetUniform3f("uSpotLightDirection2", glm::vec3(sin(glfwGetTime() + 3.14), 0.00, cos(glfwGetTime() + 3.14)));
-        }
         //CurrentShader->SetUniform1f("uPointLight.Kq", 0.5 + abs(sin(glfwGetTime())));
         Angle += State.mDT;
         angle += 1.3;
 
-        //Ocean - goes up and down, simulating the rising of the ocean
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0, 0.2 * sin(glfwGetTime()) - 6.6, -10.0));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(100.0f, 10.0f, 40.0));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        CurrentShader->SetModel(ModelMatrix);
+        Sea.Update(FPSCamera.GetPosition());
+        //Spectrum simulates on the workers while this thread composes and culls the scene
+        //Spectrum and both ocean passes use the frame start time, so the depth pre-pass matches the color pass
+        Sea.SetSpectrum(State.mOceanSpectrum ? &SeaSpectrum : 0);
+        Sea.BeginSpectrumUpdate(StartTime, Jobs);
+        SceneTransforms.SetRotation(LighthouseTopTransform, glm::angleAxis(glm::radians(angle), AxisY));
+        SceneTransforms.Compose(SceneModels.data(), &Jobs);
+        //Both passes draw the same visible meshlets, the impostor needs no culling
+        bool MonkeyFar = MonkeyImpostor.IsFar(SceneModels[MonkeyTransform], FPSCamera.GetPosition());
+        if (!MonkeyFar) {
+            Monkey.Cull(FPSCamera.GetViewProjection(), SceneModels[MonkeyTransform], FPSCamera.GetPosition(), &Jobs);
+        }
+        Islands.Update(FPSCamera.GetFrustum(), FPSCamera.GetPosition(), FarPlane);
+        Palms.Update(FPSCamera.GetFrustum(), FPSCamera.GetPosition());
+        Fires.SetCpuSimulation(State.mCpuParticles);
+        Fires.Update(State.mDT, Jobs);
+        Foxes.Update(State.mDT, Jobs);
+        Sea.EndSpectrumUpdate(Jobs);
+
+        //Depth pre-pass - lit geometry only writes depth first, so the lighting shader below
+        //runs once per visible pixel instead of once per rasterized fragment
+        if (State.mDepthPrePass) {
+            glUseProgram(DepthShader.GetId());
+            DepthShader.SetProjection(Projection);
+            DepthShader.SetView(View);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            Overdraw.PauseCounting();
+
+            glUseProgram(OceanDepthShader.GetId());
+            OceanDepthShader.SetProjection(Projection);
+            OceanDepthShader.SetView(View);
+            OceanDepthShader.SetUniform3f("uViewPos", FPSCamera.GetPosition());
+            Sea.Render(OceanDepthShader, StartTime);
+
+            glUseProgram(TerrainDepthShader.GetId());
+            TerrainDepthShader.SetProjection(Projection);
+            TerrainDepthShader.SetView(View);
+            Islands.Render(TerrainDepthShader);
+
+            glUseProgram(VegetationDepthShader.GetId());
+            VegetationDepthShader.SetProjection(Projection);
+            VegetationDepthShader.SetView(View);
+            Palms.Render();
+            glUseProgram(DepthShader.GetId());
+
+            if (!MonkeyFar) {
+                BindDrawData(DrawStream, DrawDataAlignment, SceneModels[MonkeyTransform]);
+                Monkey.RenderCulled(true);
+            }
+
+            //Depth is final, the color pass only shades fragments that match it
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthMask(GL_FALSE);
+            glDepthFunc(GL_LEQUAL);
+            Overdraw.ResumeCounting();
+            glUseProgram(CurrentShader->GetId());
+        }
+
+        glUseProgram(OceanShader.GetId());
+        OceanShader.SetProjection(Projection);
+        OceanShader.SetView(View);
+        SetFrameLightUniforms(OceanShader, FPSCamera.GetPosition());
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, OceanDiffuseTexture);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, OceanSpecularTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        Samples.Begin("Ocean");
+        Sea.Render(OceanShader, StartTime);
+        Samples.End();
         glBindTexture(GL_TEXTURE_2D, 0);
+        glUseProgram(CurrentShader->GetId());
 
-        //Islands - 3
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-10.0f, -1.5f, 0.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(3.0f, 2.0f, 2.0f));
-        ModelMatrix = glm::rotate(ModelMatrix, glm::radians(2.0f), glm::vec3(0.0, 1.0, 0.0));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, SandDiffuseTexture);
+        //Islands and palms - diffuse textures come from the texture array
         glActiveTexture(GL_TEXTURE1);
-        
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-0.3f, -1.4f, -2.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(6.0f, 3.0f, 5.0f));
-        ModelMatrix = glm::rotate(ModelMatrix, glm::radians(2.0f), glm::vec3(0.0, 1.0, 0.0));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, SandDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(10.0f, -1.5f, -3.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(4.0f, 2.0f, 2.0f));
-        ModelMatrix = glm::rotate(ModelMatrix, glm::radians(2.0f), glm::vec3(0.0, 1.0, 0.0));
-        CurrentShader->SetModel(ModelMatrix);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, StaticDiffuseArray.Get());
+        glUseProgram(TerrainShader.GetId());
+        TerrainShader.SetProjection(Projection);
+        TerrainShader.SetView(View);
+        SetFrameLightUniforms(TerrainShader, FPSCamera.GetPosition());
+        TerrainShader.SetUniform1f("uLayer", SAND_LAYER);
+        Samples.Begin("Islands");
+        Islands.Render(TerrainShader);
+        Samples.End();
+
+        glUseProgram(VegetationShader.GetId());
+        VegetationShader.SetProjection(Projection);
+        VegetationShader.SetView(View);
+        SetFrameLightUniforms(VegetationShader, FPSCamera.GetPosition());
+        Samples.Begin("Palms");
+        Palms.Render();
+        Samples.End();
+        glUseProgram(CurrentShader->GetId());
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, SandDiffuseTexture);
-        
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
 
+        //Monkey model
+        if (!MonkeyFar) {
+            BindDrawData(DrawStream, DrawDataAlignment, SceneModels[MonkeyTransform]);
+            Samples.Begin("Monkey");
+            Monkey.RenderCulled();
+            Samples.End();
+        }
 
-        //Palm tree - made of one tree trunk and treetop
-        //Trunk
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.3f, 1.0f, -2.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f, 3.0f, 0.4f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmTreeDiffuseTexture);
-        
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        //Treetop - made of four leafs
-        //Front leaf 
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.30f, 2.35f, -1.6f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.30f, 2.2f, -1.1f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.30f, 2.05f, -0.6f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        //Right leaf
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.80f, 2.35f, -2.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(1.3f, 2.2f, -2.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(1.8f, 2.05f, -2.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        //Left leaf
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-0.2f, 2.35f, -2.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-0.7f, 2.2f, -2.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-1.2, 2.05f, -2.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        //Back leaf
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.30f, 2.35f, -2.4f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.30f, 2.2f, -2.9f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.30f, 2.05f, -3.4f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-        CurrentShader->SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, PalmLeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        //Unlit objects below are cheap to shade and not part of the pre-pass
+        if (State.mDepthPrePass) {
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+        }
 
-        //Monkey model
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.009, 0.009, 0.009));
-        ModelMatrix = glm::rotate(ModelMatrix, glm::radians(90.0f), glm::vec3(-1.0, 0.0, 0.0));
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.0f, 85.0f, 12.8f));
-        CurrentShader->SetModel(ModelMatrix);
-        Monkey.Render();
+        //Monkey impostor - writes its baked depth, which the pre-pass can't
+        if (MonkeyFar) {
+            glUseProgram(ModelImpostorShader.GetId());
+            ModelImpostorShader.SetProjection(Projection);
+            ModelImpostorShader.SetView(View);
+            ModelImpostorShader.SetUniform3f("uViewPos", FPSCamera.GetPosition());
+            Samples.Begin("Monkey impostor");
+            MonkeyImpostor.Render(ModelImpostorShader, SceneModels[MonkeyTransform]);
+            Samples.End();
+        }
+
+        //Foxes - vertices move every frame, so they stay out of the pre-pass
+        if (Foxes.GetCount()) {
+            glUseProgram(SkinnedShader.GetId());
+            SkinnedShader.SetProjection(Projection);
+            SkinnedShader.SetView(View);
+            SetFrameLightUniforms(SkinnedShader, FPSCamera.GetPosition());
+            Samples.Begin("Foxes");
+            Foxes.Render(SkinnedShader);
+            Samples.End();
+        }
+
+        //Palm impostors - alpha tested, so they stay out of the pre-pass like the other unlit objects
+        glUseProgram(ImpostorShader.GetId());
+        ImpostorShader.SetProjection(Projection);
+        ImpostorShader.SetView(View);
+        ImpostorShader.SetUniform3f("uViewPos", FPSCamera.GetPosition());
+        Samples.Begin("Palm impostors");
+        Palms.RenderImpostors(ImpostorShader);
+        Samples.End();
 
         glUseProgram(ColorShader.GetId());
         ColorShader.SetProjection(Projection);
         ColorShader.SetView(View);
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.0f, 1.0f, -2.0f));
-        ColorShader.SetModel(ModelMatrix);
-
-        //Fires 
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-10.0f, -0.4f, 0.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.15f));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.7, 0.3, 0.0));
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-1.7f, 0.2f, -2.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.15f));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.7, 0.3, 0.0));
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(10.0f, -0.4f, -3.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.15f));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.7, 0.3, 0.0));
-        glDrawArrays(GL_TRIANGLES, 0, 36);
 
         //Sun
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-8.0f, 10.0f, -3.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.5f));
-
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.5f, 0.5f, 0.0f));
+        glBindVertexArray(CubeVAO.Get());
+        BindDrawData(DrawStream, DrawDataAlignment, SceneModels[SunTransforms], glm::vec3(0.5f, 0.5f, 0.0f));
+        Samples.Begin("Sun", 0);
         glDrawArrays(GL_TRIANGLES, 0, 36);
+        Samples.End();
 
-        ModelMatrix = glm::rotate(ModelMatrix, glm::radians(30.0f), glm::vec3(2.0, 1.0, 1.0));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.8, 0.4 + abs(sin(glfwGetTime())), 0.1));
+        BindDrawData(DrawStream, DrawDataAlignment, SceneModels[SunTransforms + 1], glm::vec3(0.8, 0.4 + abs(sin(glfwGetTime())), 0.1));
+        Samples.Begin("Sun", 1);
         glDrawArrays(GL_TRIANGLES, 0, 36);
+        Samples.End();
 
-       ModelMatrix = glm::rotate(ModelMatrix, glm::radians(60.0f), glm::vec3(2.0, 1.0, 1.0));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.5, 0.2 + abs(sin(glfwGetTime())), 0));
+        BindDrawData(DrawStream, DrawDataAlignment, SceneModels[SunTransforms + 2], glm::vec3(0.5, 0.2 + abs(sin(glfwGetTime())), 0));
+        Samples.Begin("Sun", 2);
         glDrawArrays(GL_TRIANGLES, 0, 36);
+        Samples.End();
 
-        ModelMatrix = glm::rotate(ModelMatrix, glm::radians(95.0f), glm::vec3(2.0, 1.0, 1.0));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.8, 0.6 + abs(sin(glfwGetTime())), 0));
+        BindDrawData(DrawStream, DrawDataAlignment, SceneModels[SunTransforms + 3], glm::vec3(0.8, 0.6 + abs(sin(glfwGetTime())), 0));
+        Samples.Begin("Sun", 3);
         glDrawArrays(GL_TRIANGLES, 0, 36);
+        Samples.End();
 
 
         //Clouds
         //Dessapear or appear on space click
         if (pressed) {
-            ModelMatrix = glm::mat4(1.0f);
-            ModelMatrix = glm::translate(ModelMatrix, glm::vec3(11.0f, 7.0f, -5.0f));
-            ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.2f));
-            ModelMatrix = glm::rotate(ModelMatrix, glm::radians(30.0f), glm::vec3(2.0, 1.0, 1.0));
-            ColorShader.SetModel(ModelMatrix);
-            glBindVertexArray(CubeVAO);
-            ColorShader.SetUniform3f("uColor", glm::vec3(1.0, 1.0, 1.0));
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-
-            ModelMatrix = glm::mat4(1.0f);
-            ModelMatrix = glm::translate(ModelMatrix, glm::vec3(1.2f, 9.0f, -8.0f));
-            ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.9f));
-            ModelMatrix = glm::rotate(ModelMatrix, glm::radians(45.0f), glm::vec3(1.0, 1.0, 0.0));
-            ColorShader.SetModel(ModelMatrix);
-            glBindVertexArray(CubeVAO);
-            ColorShader.SetUniform3f("uColor", glm::vec3(1.0, 1.0, 1.0));
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-
-            ModelMatrix = glm::mat4(1.0f);
-            ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-5.3f, 7.0f, -6.0f));
-            ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.5f));
-            ModelMatrix = glm::rotate(ModelMatrix, glm::radians(32.0f), glm::vec3(1.0, 1.0, 0.0));
-            ColorShader.SetModel(ModelMatrix);
-            glBindVertexArray(CubeVAO);
-            ColorShader.SetUniform3f("uColor", glm::vec3(1.0, 1.0, 1.0));
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-
-            ModelMatrix = glm::mat4(1.0f);
-            ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-15.3f, 6.0f, -8.0f));
-            ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0f));
-            ModelMatrix = glm::rotate(ModelMatrix, glm::radians(100.0f), glm::vec3(1.0, 2.0, 0.0));
-            ColorShader.SetModel(ModelMatrix);
-            glBindVertexArray(CubeVAO);
-            ColorShader.SetUniform3f("uColor", glm::vec3(1.0, 1.0, 1.0));
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            for (unsigned Cloud = 0; Cloud < 4; ++Cloud) {
+                BindDrawData(DrawStream, DrawDataAlignment, SceneModels[CloudTransforms + Cloud], glm::vec3(1.0, 1.0, 1.0));
+                Samples.Begin("Cloud", Cloud);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                Samples.End();
+            }
         }
         
         //Lighthouse - lights up when there are no clouds
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-15.0f, -1.5f, -15.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0f));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.3, 0.0, 0.0));
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-       
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-15.0f, -0.5f, -15.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0f));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.7, 0.7, 0.7));
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-15.0f, 0.5f, -15.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0f));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.3, 0.0, 0.0));
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        
-        ModelMatrix = glm::mat4(1.0f);
-        ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-15.0f, 1.5f, -15.0f));
-        ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0f));
-        ModelMatrix = glm::rotate(ModelMatrix, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-        ColorShader.SetModel(ModelMatrix);
-        glBindVertexArray(CubeVAO);
-        ColorShader.SetUniform3f("uColor", glm::vec3(0.7, 0.7, 0.7));
-        glRotatef(Angle, 0, 1, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        
-
+        const glm::vec3 LighthouseColors[] = {
+            glm::vec3(0.3, 0.0, 0.0), glm::vec3(0.7, 0.7, 0.7), glm::vec3(0.3, 0.0, 0.0), glm::vec3(0.7, 0.7, 0.7),
+        };
+        for (unsigned Level = 0; Level < 4; ++Level) {
+            BindDrawData(DrawStream, DrawDataAlignment, SceneModels[LighthouseTransforms + Level], LighthouseColors[Level]);
+            Samples.Begin("Lighthouse", Level);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            Samples.End();
+        }
 
+        //Fires and smoke - drawn last, they fade out against the depth of everything above
+        Fires.CaptureSceneDepth(Resolution.GetRenderWidth(), Resolution.GetRenderHeight());
+        Samples.Begin("Particles");
+        Fires.Render(Projection, View);
+        Samples.End();
 
         glBindVertexArray(0);
         glUseProgram(0);
+        Overdraw.Resolve();
+        Resolution.Present();
+        Samples.EndFrame();
+        FrameTimer.End();
+        DrawStream.EndFrame();
         glfwSwapBuffers(Window);
+        StatsAllocations += AllocationTracker::GetCount() - FrameAllocations;
 
         //Time management
         EndTime = glfwGetTime();
         float WorkTime = EndTime - StartTime;
+        StatsCpuTime += WorkTime * 1000.0f;
+        StatsGpuTime += FrameTimer.GetMilliseconds();
+        Resolution.Update(FrameTimer.GetMilliseconds(), TargetFrameTime * 1000.0f);
+        StatsSpectrumTime += State.mOceanSpectrum ? Sea.GetSpectrumMilliseconds() : 0.0f;
+        StatsParticleTime += Fires.GetUpdateMilliseconds();
+        ++StatsFrames;
         if (WorkTime < TargetFrameTime) {
             int DeltaMS = (int)((TargetFrameTime - WorkTime) * 1000.0f);
             std::this_thread::sleep_for(std::chrono::milliseconds(DeltaMS));
             EndTime = glfwGetTime();
         }
         State.mDT = EndTime - StartTime;
+
+        StatsTime += State.mDT;
+        if (StatsTime >= 1.0f) {
+            std::cout << "[Frame] Depth pre-pass " << (State.mDepthPrePass ? "on" : "off")
+                << ", CPU " << StatsCpuTime / StatsFrames << " ms, GPU " << StatsGpuTime / StatsFrames << " ms at " << (int)(Resolution.GetScale() * 100.0f + 0.5f) << "% scale, ocean spectrum " << StatsSpectrumTime / StatsFrames << " ms, terrain "
+                << Islands.GetTriangleCount() << " triangles in " << Islands.GetResidentChunkCount() << " resident chunks, palms "
+                << Palms.GetNearInstanceCount() << " instanced " << Palms.GetImpostorCount() << " impostors, "
+                << Fires.GetCount() << " particles " << StatsParticleTime / StatsFrames << " ms (" << (Fires.IsCpuSimulation() ? "CPU" : "GPU") << "), "
+                << StatsAllocations / (float)StatsFrames << " heap allocations per frame, frame arena peak " << Frame.GetPeak() / 1024 << " KB, tracked memory "
+                << (MemoryAccounting::GetUsage(MEMORY_TEXTURE) + MemoryAccounting::GetUsage(MEMORY_MESH) + MemoryAccounting::GetUsage(MEMORY_STREAMING)) / (1024 * 1024) << " MB GPU "
+                << MemoryAccounting::GetUsage(MEMORY_CPU_GEOMETRY) / (1024 * 1024) << " MB CPU" << std::endl;
+            StatsTime = 0.0f;
+            StatsCpuTime = 0.0f;
+            StatsGpuTime = 0.0f;
+            StatsSpectrumTime = 0.0f;
+            StatsParticleTime = 0.0f;
+            StatsAllocations = 0;
+            StatsFrames = 0;
+        }
     }
 
-    glfwTerminate();
     return 0;
 }
@@ -0,0 +1,182 @@
+#include "memory_accounting.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+std::mutex MemoryAccounting::mMutex;
+MemoryAccounting::ResourceMap MemoryAccounting::mResources[MEMORY_CATEGORY_COUNT];
+size_t MemoryAccounting::mUsage[MEMORY_CATEGORY_COUNT] = {};
+size_t MemoryAccounting::mPeak[MEMORY_CATEGORY_COUNT] = {};
+size_t MemoryAccounting::mBudgets[MEMORY_CATEGORY_COUNT] = {};
+bool MemoryAccounting::mOverBudget[MEMORY_CATEGORY_COUNT] = {};
+std::vector<MemoryAccounting::Callback> MemoryAccounting::mCallbacks;
+unsigned MemoryAccounting::mNextCallbackId = 1;
+
+void
+MemoryAccounting::Track(EMemoryCategory category, unsigned long long key, const std::string& name, size_t bytes) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    Resource& Tracked = mResources[category][key];
+    mUsage[category] += bytes - Tracked.Bytes;
+    mPeak[category] = std::max(mPeak[category], mUsage[category]);
+    Tracked.Name = name;
+    Tracked.Bytes = bytes;
+}
+
+void
+MemoryAccounting::Untrack(EMemoryCategory category, unsigned long long key) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    ResourceMap::iterator It = mResources[category].find(key);
+    if (It == mResources[category].end()) {
+        return;
+    }
+
+    mUsage[category] -= It->second.Bytes;
+    mResources[category].erase(It);
+}
+
+void
+MemoryAccounting::SetBudget(EMemoryCategory category, size_t bytes) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    mBudgets[category] = bytes;
+    mOverBudget[category] = false;
+}
+
+unsigned
+MemoryAccounting::AddEvictionCallback(EMemoryCategory category, const EvictionCallback& callback) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    Callback NewCallback = { mNextCallbackId++, category, callback };
+    mCallbacks.push_back(NewCallback);
+    return NewCallback.Id;
+}
+
+void
+MemoryAccounting::RemoveEvictionCallback(unsigned id) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    mCallbacks.erase(std::remove_if(mCallbacks.begin(), mCallbacks.end(), [id](const Callback& c) { return c.Id == id; }), mCallbacks.end());
+}
+
+void
+MemoryAccounting::EnforceBudgets() {
+    for (unsigned Category = 0; Category < MEMORY_CATEGORY_COUNT; ++Category) {
+        size_t Excess = 0;
+        std::vector<EvictionCallback> Evictions;
+        {
+            std::lock_guard<std::mutex> Lock(mMutex);
+            if (!mBudgets[Category] || mUsage[Category] <= mBudgets[Category]) {
+                mOverBudget[Category] = false;
+                continue;
+            }
+
+            Excess = mUsage[Category] - mBudgets[Category];
+            for (const Callback& Registered : mCallbacks) {
+                if (Registered.Category == Category) {
+                    Evictions.push_back(Registered.Evict);
+                }
+            }
+        }
+
+        // Callbacks untrack what they free, so they run without the lock
+        for (const EvictionCallback& Evict : Evictions) {
+            size_t Freed = Evict(Excess);
+            Excess = Freed < Excess ? Excess - Freed : 0;
+            if (!Excess) {
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> Lock(mMutex);
+        if (mUsage[Category] <= mBudgets[Category]) {
+            mOverBudget[Category] = false;
+        } else if (!mOverBudget[Category]) {
+            mOverBudget[Category] = true;
+            std::cerr << "[Err] " << GetCategoryName((EMemoryCategory)Category) << " memory " << formatBytes(mUsage[Category])
+                << " is over its budget of " << formatBytes(mBudgets[Category]) << std::endl;
+        }
+    }
+}
+
+size_t
+MemoryAccounting::GetUsage(EMemoryCategory category) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    return mUsage[category];
+}
+
+size_t
+MemoryAccounting::GetPeak(EMemoryCategory category) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    return mPeak[category];
+}
+
+void
+MemoryAccounting::PrintReport(std::ostream& out) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    struct Entry {
+        EMemoryCategory Category;
+        const Resource* Tracked;
+    };
+    std::vector<Entry> Entries;
+    size_t Total = 0;
+    out << "Memory report" << std::endl;
+    for (unsigned Category = 0; Category < MEMORY_CATEGORY_COUNT; ++Category) {
+        out << "  " << std::left << std::setw(14) << GetCategoryName((EMemoryCategory)Category) << std::right
+            << std::setw(10) << formatBytes(mUsage[Category]) << " in " << mResources[Category].size() << " resources, peak "
+            << formatBytes(mPeak[Category]) << ", budget " << (mBudgets[Category] ? formatBytes(mBudgets[Category]) : "none") << std::endl;
+        Total += mUsage[Category];
+        for (const std::pair<const unsigned long long, Resource>& Tracked : mResources[Category]) {
+            Entry NewEntry = { (EMemoryCategory)Category, &Tracked.second };
+            Entries.push_back(NewEntry);
+        }
+    }
+    out << "  Total " << formatBytes(Total) << std::endl;
+
+    std::sort(Entries.begin(), Entries.end(), [](const Entry& a, const Entry& b) {
+        return a.Tracked->Bytes > b.Tracked->Bytes;
+    });
+    const size_t Listed = std::min(Entries.size(), (size_t)MEMORY_REPORT_ENTRIES);
+    for (size_t EntryIdx = 0; EntryIdx < Listed; ++EntryIdx) {
+        const Entry& Listing = Entries[EntryIdx];
+        out << "  " << std::setw(10) << formatBytes(Listing.Tracked->Bytes) << "  " << std::left << std::setw(14)
+            << GetCategoryName(Listing.Category) << std::right << Listing.Tracked->Name << std::endl;
+    }
+    if (Entries.size() > Listed) {
+        out << "  ... and " << Entries.size() - Listed << " smaller resources" << std::endl;
+    }
+}
+
+size_t
+MemoryAccounting::GetTextureSize(int width, int height, int layers, int texelSize, bool mipmapped) {
+    size_t Size = 0;
+    while (true) {
+        Size += (size_t)width * height * layers * texelSize;
+        if (!mipmapped || (width == 1 && height == 1)) {
+            return Size;
+        }
+        // Array layers aren't mipped, only width and height halve
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+}
+
+const char*
+MemoryAccounting::GetCategoryName(EMemoryCategory category) {
+    switch (category) {
+    case MEMORY_TEXTURE: return "Textures";
+    case MEMORY_MESH: return "Mesh buffers";
+    case MEMORY_CPU_GEOMETRY: return "CPU geometry";
+    case MEMORY_STREAMING: return "Streaming";
+    default: return "Unknown";
+    }
+}
+
+std::string
+MemoryAccounting::formatBytes(size_t bytes) {
+    std::ostringstream Out;
+    Out << std::fixed << std::setprecision(1);
+    if (bytes >= 1024 * 1024) {
+        Out << bytes / (1024.0 * 1024.0) << " MB";
+    } else {
+        Out << bytes / 1024.0 << " KB";
+    }
+    return Out.str();
+}
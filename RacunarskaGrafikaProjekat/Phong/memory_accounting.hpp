@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "pool_allocator.hpp"
+
+// Largest resources listed by the report, the rest only count towards the totals
+#define MEMORY_REPORT_ENTRIES 32
+
+enum EMemoryCategory {
+    // Texture storage including mip chains
+    MEMORY_TEXTURE = 0,
+    // Vertex and index buffers of loaded meshes
+    MEMORY_MESH = 1,
+    // Geometry kept in RAM after upload
+    MEMORY_CPU_GEOMETRY = 2,
+    // Buffers of terrain chunks and vegetation cells, created and freed as the camera moves
+    MEMORY_STREAMING = 3,
+    MEMORY_CATEGORY_COUNT = 4,
+};
+
+/**
+ * @brief Records how much memory every texture, buffer and CPU side copy takes, sized when the
+ * resource is created. Each category can be given a budget; categories over it ask their eviction
+ * callbacks to free memory once per frame in EnforceBudgets, categories without callbacks only
+ * warn. Sizes are what the resources need, drivers may round them up or keep extra copies.
+ * Thread safe
+ */
+class MemoryAccounting {
+public:
+    /**
+     * @brief Called with the bytes a category is over budget
+     *
+     * @returns Bytes freed
+     */
+    typedef std::function<size_t(size_t)> EvictionCallback;
+
+    /**
+     * @brief Records a resource. Tracking the same key again replaces the old size
+     *
+     * @param category Category the resource counts towards
+     * @param key Identifies the resource within its category, usually its GL name
+     * @param name Shown in the report
+     * @param bytes Resource size
+     */
+    static void Track(EMemoryCategory category, unsigned long long key, const std::string& name, size_t bytes);
+
+    /**
+     * @brief Forgets a resource once it is freed. Unknown keys are ignored
+     */
+    static void Untrack(EMemoryCategory category, unsigned long long key);
+
+    /**
+     * @brief Sets the budget of a category
+     *
+     * @param bytes Budget, 0 for none
+     */
+    static void SetBudget(EMemoryCategory category, size_t bytes);
+
+    /**
+     * @brief Registers a callback freeing memory of a category that is over budget.
+     * Callbacks are called in the order they were added until the category fits
+     *
+     * @returns Callback id for RemoveEvictionCallback
+     */
+    static unsigned AddEvictionCallback(EMemoryCategory category, const EvictionCallback& callback);
+
+    static void RemoveEvictionCallback(unsigned id);
+
+    /**
+     * @brief Runs eviction callbacks of categories over budget and warns about those still over.
+     * Called once per frame on the thread owning the resources, at a point where nothing freed is in use
+     */
+    static void EnforceBudgets();
+
+    /**
+     * @brief Returns bytes currently tracked in a category
+     */
+    static size_t GetUsage(EMemoryCategory category);
+
+    /**
+     * @brief Returns the highest usage of a category since startup
+     */
+    static size_t GetPeak(EMemoryCategory category);
+
+    /**
+     * @brief Prints usage, peak and budget per category and the largest resources
+     */
+    static void PrintReport(std::ostream& out);
+
+    /**
+     * @brief Computes the size of a texture
+     *
+     * @param width Base level width
+     * @param height Base level height
+     * @param layers Array layers, 1 for plain 2D textures
+     * @param texelSize Bytes per texel
+     * @param mipmapped Counts the full mip chain down to 1x1
+     *
+     * @returns Texture size in bytes
+     */
+    static size_t GetTextureSize(int width, int height, int layers, int texelSize, bool mipmapped);
+
+    static const char* GetCategoryName(EMemoryCategory category);
+
+private:
+    struct Resource {
+        std::string Name;
+        size_t Bytes;
+    };
+
+    struct Callback {
+        unsigned Id;
+        EMemoryCategory Category;
+        EvictionCallback Evict;
+    };
+
+    // Nodes come from a pool, streamed resources come and go every few frames
+    typedef std::unordered_map<unsigned long long, Resource, std::hash<unsigned long long>, std::equal_to<unsigned long long>,
+        PoolAllocator<std::pair<const unsigned long long, Resource>>> ResourceMap;
+
+    static std::mutex mMutex;
+    static ResourceMap mResources[MEMORY_CATEGORY_COUNT];
+    static size_t mUsage[MEMORY_CATEGORY_COUNT];
+    static size_t mPeak[MEMORY_CATEGORY_COUNT];
+    static size_t mBudgets[MEMORY_CATEGORY_COUNT];
+    // Set while a category is over budget, so the warning is printed once per overrun
+    static bool mOverBudget[MEMORY_CATEGORY_COUNT];
+    static std::vector<Callback> mCallbacks;
+    static unsigned mNextCallbackId;
+
+    static std::string formatBytes(size_t bytes);
+};
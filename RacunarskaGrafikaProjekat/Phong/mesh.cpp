@@ -1,93 +1,342 @@
 #include "mesh.hpp"
+#include "cooked.hpp"
+#include "memory_accounting.hpp"
 
-Mesh::Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string &resPath) {
-    processMesh(mesh, material, resPath);
+Mesh::Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string &resPath, bool keepGeometry) {
+    processMesh(ProcessGeometry(mesh, material, resPath), resPath, keepGeometry);
+}
+
+Mesh::Mesh(MeshGeometry&& geometry, const std::string& resPath, bool keepGeometry) {
+    processMesh(std::move(geometry), resPath, keepGeometry);
+}
+
+Mesh::~Mesh() {
+    // Moved from meshes have no VAO and nothing tracked
+    if (mVAO.Get()) {
+        MemoryAccounting::Untrack(MEMORY_CPU_GEOMETRY, mVAO.Get());
+    }
 }
 
 void
 Mesh::Render() const {
-    glBindVertexArray(mVAO);
+    glBindVertexArray(mVAO.Get());
+    bindTextures();
+    draw();
+    glBindVertexArray(0);
+}
+
+void
+Mesh::Render(const Frustum& frustum, const glm::vec3& cameraPosition) const {
+    Cull(frustum, cameraPosition);
+    RenderCulled();
+}
 
-    if (mDiffuseTexture) {
+void
+Mesh::Cull(const Frustum& frustum, const glm::vec3& cameraPosition) const {
+    if (!mMeshlets.GetCount()) {
+        return;
+    }
+
+    mMeshlets.Cull(frustum, cameraPosition, mIndexBuffer.GetIndexSize(), mDrawCounts, mDrawOffsets);
+}
+
+void
+Mesh::RenderCulled(bool depthOnly) const {
+    if (mMeshlets.GetCount() && mDrawCounts.empty()) {
+        return;
+    }
+
+    glBindVertexArray(depthOnly ? mDepthVAO.Get() : mVAO.Get());
+    if (!depthOnly) {
+        bindTextures();
+    }
+
+    if (mMeshlets.GetCount()) {
+        glMultiDrawElements(GL_TRIANGLES, mDrawCounts.data(), mIndexBuffer.GetType(), mDrawOffsets.data(), mDrawCounts.size());
+    } else {
+        draw();
+    }
+    glBindVertexArray(0);
+}
+
+void
+Mesh::RenderInstanced(unsigned instanceCount) const {
+    glBindVertexArray(mVAO.Get());
+    bindTextures();
+    if (mIndexBuffer.GetCount()) {
+        mIndexBuffer.DrawInstanced(GL_TRIANGLES, instanceCount);
+    } else {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, mVertexCount, instanceCount);
+    }
+    glBindVertexArray(0);
+}
+
+unsigned
+Mesh::GetStride() const {
+    return mStride;
+}
+
+bool
+Mesh::IsSkinned() const {
+    return mStride == MESH_SKINNED_VERTEX_STRIDE;
+}
+
+bool
+Mesh::GetBounds(glm::vec3& min, glm::vec3& max) const {
+    min = mMin;
+    max = mMax;
+    return mVertexCount > 0;
+}
+
+const std::vector<float>&
+Mesh::GetVertices() const {
+    return mVertices;
+}
+
+const std::vector<unsigned>&
+Mesh::GetIndices() const {
+    return mIndices;
+}
+
+void
+Mesh::bindTextures() const {
+    if (mDiffuseTexture.Get()) {
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mDiffuseTexture);
+        glBindTexture(GL_TEXTURE_2D, mDiffuseTexture.Get());
     }
 
-    if (mSpecularTexture) {
+    if (mSpecularTexture.Get()) {
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, mSpecularTexture);
+        glBindTexture(GL_TEXTURE_2D, mSpecularTexture.Get());
     }
+}
 
-    if (mIndexCount) {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-        glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, (void*)0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void
+Mesh::draw() const {
+    if (mIndexBuffer.GetCount()) {
+        mIndexBuffer.Draw(GL_TRIANGLES);
         return;
     }
 
     glDrawArrays(GL_TRIANGLES, 0, mVertexCount);
-    glBindVertexArray(0);
 }
 
-unsigned
-Mesh::loadMeshTexture(const aiMaterial* material, const std::string& resPath, aiTextureType type) {
+std::string
+Mesh::getTexturePath(const aiMaterial* material, const std::string& resPath, aiTextureType type) {
     if (material && material->GetTextureCount(type) > 0) {
         aiString Path;
         if (material->GetTexture(type, 0, &Path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS) {
-            std::string FullPath = resPath + "/" + Path.data;
-            unsigned TextureID = Texture::LoadImageToTexture(FullPath);
-            return TextureID;
+            return resPath + "/" + Path.data;
         }
     }
 
-    return 0;
+    return std::string();
+}
+
+void
+Mesh::DecodeTextures(MeshGeometry& geometry) {
+    if (!geometry.DiffusePath.empty()) {
+        geometry.DiffuseImage = Texture::DecodeImage(geometry.DiffusePath);
+    }
+    if (!geometry.SpecularPath.empty()) {
+        geometry.SpecularImage = Texture::DecodeImage(geometry.SpecularPath);
+    }
 }
 
 void
-Mesh::processMesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath) {
+Mesh::WriteGeometry(std::ostream& out, const MeshGeometry& geometry) {
+    CookedFile::Write(out, geometry.Stride);
+    CookedFile::WriteVector(out, geometry.Vertices);
+    CookedFile::WriteVector(out, geometry.Indices);
+    CookedFile::WriteString(out, geometry.DiffusePath);
+    CookedFile::WriteString(out, geometry.SpecularPath);
+    geometry.Meshlets.Write(out);
+}
+
+bool
+Mesh::ReadGeometry(CookedReader& reader, MeshGeometry& geometry) {
+    if (!reader.Read(geometry.Stride) || !reader.ReadVector(geometry.Vertices) || !reader.ReadVector(geometry.Indices)) {
+        return false;
+    }
+    if (!reader.ReadString(geometry.DiffusePath) || !reader.ReadString(geometry.SpecularPath) || !geometry.Meshlets.Read(reader, geometry.Indices.size())) {
+        return false;
+    }
+    // Cooked by another build with a different vertex layout
+    if ((geometry.Stride != MESH_VERTEX_STRIDE && geometry.Stride != MESH_SKINNED_VERTEX_STRIDE) || geometry.Vertices.size() % geometry.Stride != 0) {
+        return false;
+    }
+    // A corrupt index would make the draw read past the vertex buffer
+    const size_t VertexCount = geometry.Vertices.size() / geometry.Stride;
+    if (geometry.Indices.size() % 3 != 0) {
+        return false;
+    }
+    for (unsigned Index : geometry.Indices) {
+        if (Index >= VertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+MeshGeometry
+Mesh::ProcessGeometry(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath, const Skeleton* skeleton, bool decodeTextures) {
     const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+    MeshGeometry Geometry;
+    const bool Skinned = skeleton && skeleton->GetCount() && mesh->HasBones();
+    Geometry.Stride = Skinned ? MESH_SKINNED_VERTEX_STRIDE : MESH_VERTEX_STRIDE;
+    Geometry.Vertices.reserve(mesh->mNumVertices * Geometry.Stride);
+    Geometry.Indices.reserve(mesh->mNumFaces * 3);
 
     for (unsigned VertexIndex = 0; VertexIndex < mesh->mNumVertices; ++VertexIndex) {
-        std::vector<float> Position = { mesh->mVertices[VertexIndex].x, mesh->mVertices[VertexIndex].y, mesh->mVertices[VertexIndex].z };
-        mVertices.insert(mVertices.end(), Position.begin(), Position.end());
-        std::vector<float> Normals = { mesh->mNormals[VertexIndex].x, mesh->mNormals[VertexIndex].y, mesh->mNormals[VertexIndex].z };
-        mVertices.insert(mVertices.end(), Normals.begin(), Normals.end());
+        const aiVector3D& Position = mesh->mVertices[VertexIndex];
+        const aiVector3D& Normal = mesh->mNormals ? mesh->mNormals[VertexIndex] : Zero3D;
         const aiVector3D* TexCoords = mesh->HasTextureCoords(0) ? &(mesh->mTextureCoords[0][VertexIndex]) : &Zero3D;
-        std::vector<float> UV = { TexCoords->x, TexCoords->y };
-        mVertices.insert(mVertices.end(), UV.begin(), UV.end());
+        // Unused bone slots point at bone 0 with zero weight
+        float Vertex[MESH_SKINNED_VERTEX_STRIDE] = { Position.x, Position.y, Position.z, Normal.x, Normal.y, Normal.z, TexCoords->x, TexCoords->y };
+        Geometry.Vertices.insert(Geometry.Vertices.end(), Vertex, Vertex + Geometry.Stride);
+    }
+    if (Skinned) {
+        addBoneWeights(mesh, *skeleton, Geometry.Vertices);
     }
 
     for (unsigned FaceIndex = 0; FaceIndex < mesh->mNumFaces; ++FaceIndex) {
         const aiFace& Face = mesh->mFaces[FaceIndex];
-        mIndices.push_back(Face.mIndices[0]);
-        mIndices.push_back(Face.mIndices[1]);
-        mIndices.push_back(Face.mIndices[2]);
+        // Lines and points survive triangulation, they aren't rendered
+        if (Face.mNumIndices != 3) {
+            continue;
+        }
+        Geometry.Indices.push_back(Face.mIndices[0]);
+        Geometry.Indices.push_back(Face.mIndices[1]);
+        Geometry.Indices.push_back(Face.mIndices[2]);
     }
 
-    mVertexCount = mVertices.size() / 6;
-    mIndexCount = mIndices.size();
+    // OBJ import gives every face corner its own vertex, merge the identical ones
+    MeshOptimizer::WeldVertices(Geometry.Vertices, Geometry.Indices, Geometry.Stride);
+    // Meshlet bounds are only valid for the bind pose
+    const bool BuildMeshlets = !Skinned && Geometry.Indices.size() / 3 >= MESHLET_MIN_MESH_TRIANGLES;
+    MeshOptimizer::Optimize(Geometry.Vertices, Geometry.Indices, Geometry.Stride, MESH_OPTIMIZE_OVERDRAW, mesh->mName.data, BuildMeshlets ? &Geometry.Meshlets : 0);
 
-    mDiffuseTexture = loadMeshTexture(material, resPath, aiTextureType_DIFFUSE);
-    mSpecularTexture = loadMeshTexture(material, resPath, aiTextureType_SPECULAR);
+    Geometry.DiffusePath = getTexturePath(material, resPath, aiTextureType_DIFFUSE);
+    Geometry.SpecularPath = getTexturePath(material, resPath, aiTextureType_SPECULAR);
+    if (decodeTextures) {
+        DecodeTextures(Geometry);
+    }
+    return Geometry;
+}
+
+void
+Mesh::processMesh(MeshGeometry&& geometry, const std::string& resPath, bool keepGeometry) {
+    // Freed when this returns unless the mesh keeps its geometry
+    std::vector<float> Vertices = std::move(geometry.Vertices);
+    std::vector<unsigned> Indices = std::move(geometry.Indices);
+    mMeshlets = std::move(geometry.Meshlets);
+    mStride = geometry.Stride;
+    mVertexCount = Vertices.size() / mStride;
 
-    glGenVertexArrays(1, &mVAO);
-    glBindVertexArray(mVAO);
-    glGenBuffers(1, &mVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(float), mVertices.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    mDiffuseTexture = GLTexture(Texture::UploadImage(geometry.DiffuseImage, geometry.DiffusePath));
+    mSpecularTexture = GLTexture(Texture::UploadImage(geometry.SpecularImage, geometry.SpecularPath));
+
+    mVAO = GLVertexArray::Create();
+    glBindVertexArray(mVAO.Get());
+    mVBO = GLBuffer::Create();
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO.Get());
+    glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(float), Vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, mStride * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, mStride * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, mStride * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
+    if (IsSkinned()) {
+        // Bone indices and weights, read by shaders/skinned.vert
+        glVertexAttribPointer(3, ANIMATION_BONES_PER_VERTEX, GL_FLOAT, GL_FALSE, mStride * sizeof(float), (void*)(MESH_VERTEX_STRIDE * sizeof(float)));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(4, ANIMATION_BONES_PER_VERTEX, GL_FLOAT, GL_FALSE, mStride * sizeof(float), (void*)((MESH_VERTEX_STRIDE + ANIMATION_BONES_PER_VERTEX) * sizeof(float)));
+        glEnableVertexAttribArray(4);
+    }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     
-    if (mIndexCount) {
-        glGenBuffers(1, &mEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndexCount * sizeof(float), mIndices.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    // Element buffer binding is stored in the VAO, so it stays bound until the VAO is unbound.
+    // Welded meshes mostly fit into 16 bit indices, which halves the index buffer
+    if (!Indices.empty()) {
+        mIndexBuffer.Upload(Indices, mVertexCount);
     }
     glBindVertexArray(0);
+
+    // Depth pre-pass only needs positions, a tightly packed copy fetches 12 instead of 32 bytes per vertex.
+    // Bounds come from the same pass, so they don't need the vertices later
+    std::vector<float> Positions;
+    Positions.reserve(mVertexCount * 3);
+    mMin = glm::vec3(0.0f);
+    mMax = glm::vec3(0.0f);
+    for (unsigned VertexIdx = 0; VertexIdx < mVertexCount; ++VertexIdx) {
+        const float* Position = &Vertices[VertexIdx * mStride];
+        Positions.insert(Positions.end(), Position, Position + 3);
+        glm::vec3 Point(Position[0], Position[1], Position[2]);
+        mMin = VertexIdx ? glm::min(mMin, Point) : Point;
+        mMax = VertexIdx ? glm::max(mMax, Point) : Point;
+    }
+    mDepthVAO = GLVertexArray::Create();
+    glBindVertexArray(mDepthVAO.Get());
+    mDepthVBO = GLBuffer::Create();
+    glBindBuffer(GL_ARRAY_BUFFER, mDepthVBO.Get());
+    glBufferData(GL_ARRAY_BUFFER, Positions.size() * sizeof(float), Positions.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (!Indices.empty()) {
+        mIndexBuffer.Bind();
+    }
+    glBindVertexArray(0);
+
+    MemoryAccounting::Track(MEMORY_MESH, mVBO.Get(), resPath + " vertices", Vertices.size() * sizeof(float));
+    MemoryAccounting::Track(MEMORY_MESH, mDepthVBO.Get(), resPath + " depth vertices", Positions.size() * sizeof(float));
+    if (!Indices.empty()) {
+        MemoryAccounting::Track(MEMORY_MESH, mIndexBuffer.GetId(), resPath + " indices", mIndexBuffer.GetSizeInBytes());
+    }
+    if (keepGeometry) {
+        mVertices = std::move(Vertices);
+        mIndices = std::move(Indices);
+        MemoryAccounting::Track(MEMORY_CPU_GEOMETRY, mVAO.Get(), resPath + " geometry", mVertices.capacity() * sizeof(float) + mIndices.capacity() * sizeof(unsigned));
+    }
+}
+
+void
+Mesh::addBoneWeights(const aiMesh* mesh, const Skeleton& skeleton, std::vector<float>& vertices) {
+    const unsigned BoneSlots = MESH_VERTEX_STRIDE;
+    const unsigned WeightSlots = MESH_VERTEX_STRIDE + ANIMATION_BONES_PER_VERTEX;
+    for (unsigned BoneIdx = 0; BoneIdx < mesh->mNumBones; ++BoneIdx) {
+        const aiBone* Bone = mesh->mBones[BoneIdx];
+        int SkeletonBone = skeleton.Find(Bone->mName.data);
+        if (SkeletonBone < 0) {
+            continue;
+        }
+
+        for (unsigned WeightIdx = 0; WeightIdx < Bone->mNumWeights; ++WeightIdx) {
+            const aiVertexWeight& Weight = Bone->mWeights[WeightIdx];
+            float* Vertex = &vertices[Weight.mVertexId * MESH_SKINNED_VERTEX_STRIDE];
+            // Keeps the strongest influences, replacing the weakest one kept so far
+            unsigned Weakest = 0;
+            for (unsigned Slot = 1; Slot < ANIMATION_BONES_PER_VERTEX; ++Slot) {
+                if (Vertex[WeightSlots + Slot] < Vertex[WeightSlots + Weakest]) {
+                    Weakest = Slot;
+                }
+            }
+            if (Weight.mWeight > Vertex[WeightSlots + Weakest]) {
+                Vertex[BoneSlots + Weakest] = (float)SkeletonBone;
+                Vertex[WeightSlots + Weakest] = Weight.mWeight;
+            }
+        }
+    }
+
+    for (unsigned Idx = 0; Idx < vertices.size(); Idx += MESH_SKINNED_VERTEX_STRIDE) {
+        float* Weights = &vertices[Idx + WeightSlots];
+        float Sum = 0.0f;
+        for (unsigned Slot = 0; Slot < ANIMATION_BONES_PER_VERTEX; ++Slot) {
+            Sum += Weights[Slot];
+        }
+        for (unsigned Slot = 0; Slot < ANIMATION_BONES_PER_VERTEX; ++Slot) {
+            Weights[Slot] = Sum > 0.0f ? Weights[Slot] / Sum : 0.0f;
+        }
+    }
 }
\ No newline at end of file
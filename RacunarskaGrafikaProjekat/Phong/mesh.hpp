@@ -5,21 +5,114 @@
 #include <GL/glew.h>
 #include <iostream>
 #include "texture.hpp"
+#include "meshopt.hpp"
+#include "index_buffer.hpp"
+#include "meshlet.hpp"
+#include "animation.hpp"
+#include "gl_handle.hpp"
 
+// Vertex layout: position (3), normal (3), UV (2)
+#define MESH_VERTEX_STRIDE 8
+// Skinned vertex layout: the regular one, then ANIMATION_BONES_PER_VERTEX bone indices and weights
+#define MESH_SKINNED_VERTEX_STRIDE (MESH_VERTEX_STRIDE + 2 * ANIMATION_BONES_PER_VERTEX)
+// Sort triangle clusters at import for lower overdraw. Costs a bit of vertex cache efficiency
+#define MESH_OPTIMIZE_OVERDRAW true
+
+// CPU side geometry of a mesh, ready for upload
+struct MeshGeometry {
+    std::vector<float> Vertices;
+    std::vector<unsigned> Indices;
+    // MESH_VERTEX_STRIDE, or MESH_SKINNED_VERTEX_STRIDE for meshes with bones
+    unsigned Stride = MESH_VERTEX_STRIDE;
+    // Only built for static meshes for meshes with at least MESHLET_MIN_MESH_TRIANGLES triangles
+    MeshletSet Meshlets;
+    // Material texture paths, empty if the material has none
+    std::string DiffusePath;
+    std::string SpecularPath;
+    // Decoded material textures, uploaded together with the geometry
+    TextureImage DiffuseImage;
+    TextureImage SpecularImage;
+};
+
+/**
+ * @brief Uploaded mesh. Owns its buffers, VAOs and textures, which are freed with it, so meshes
+ * can be moved but not copied. Geometry is dropped from RAM once it is on the GPU unless the
+ * mesh is created with keepGeometry
+ */
 class Mesh {
 public:
-    std::vector<unsigned> mIndices;
-    std::vector<float> mVertices;
-
     /**
      * @brief Ctor - buffers mesh data
      *
      * @param mesh - Assimp mesh
      * @param MeshMaterial - Assimp material
      * @param resPath - Resource relative path. For loading textures, etc...
+     * @param keepGeometry - Keeps vertices and indices in RAM after upload, e.g. for collision
      * 
      */
-    Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath);
+    Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath, bool keepGeometry = false);
+
+    /**
+     * @brief Ctor - buffers already processed mesh data
+     *
+     * @param geometry - Geometry produced by ProcessGeometry, moved into the mesh. Its textures are already decoded
+     * @param resPath - Resource relative path. For loading textures, etc...
+     * @param keepGeometry - Keeps vertices and indices in RAM after upload, e.g. for collision
+     *
+     */
+    Mesh(MeshGeometry&& geometry, const std::string& resPath, bool keepGeometry = false);
+
+    /**
+     * @brief Dtor - GL objects are freed by their handles, this only forgets the kept geometry
+     */
+    ~Mesh();
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&&) = default;
+    // Overwriting a mesh would drop its VAO without untracking the kept geometry, vectors only need the move ctor
+    Mesh& operator=(Mesh&&) = delete;
+
+    /**
+     * @brief Extracts, welds and optimizes Assimp mesh geometry and decodes its material textures.
+     * Doesn't touch OpenGL, so it can run on worker threads
+     *
+     * @param mesh - Assimp mesh
+     * @param material - Assimp material
+     * @param resPath - Resource relative path. For loading textures, etc...
+     * @param skeleton - Optional skeleton bones are matched to. Meshes with bones get the skinned vertex layout
+     * @param decodeTextures - Decodes the material textures, off when only the texture paths are needed
+     *
+     * @returns Processed geometry
+     */
+    static MeshGeometry ProcessGeometry(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath, const Skeleton* skeleton = 0, bool decodeTextures = true);
+
+    /**
+     * @brief Decodes the material textures named by the geometry's texture paths
+     *
+     * @param geometry - Geometry, images are written into it
+     *
+     */
+    static void DecodeTextures(MeshGeometry& geometry);
+
+    /**
+     * @brief Writes processed geometry into a cooked model. Texture paths are written instead of the images
+     *
+     * @param out - Cooked file stream
+     * @param geometry - Geometry produced by ProcessGeometry
+     *
+     */
+    static void WriteGeometry(std::ostream& out, const MeshGeometry& geometry);
+
+    /**
+     * @brief Reads geometry written by WriteGeometry, without decoding its textures
+     *
+     * @param reader - Cooked file reader
+     * @param geometry - Output geometry
+     *
+     * @returns false on a truncated or malformed file
+     */
+    static bool ReadGeometry(CookedReader& reader, MeshGeometry& geometry);
 
     /**
      * @brief Renders the current mesh
@@ -27,14 +120,95 @@ public:
      */
     void Render() const;
 
+    /**
+     * @brief Renders only the meshlets that pass frustum and normal cone culling.
+     * Meshes without meshlets are rendered whole
+     *
+     * @param frustum - Object space frustum
+     * @param cameraPosition - Object space camera position
+     *
+     */
+    void Render(const Frustum& frustum, const glm::vec3& cameraPosition) const;
+
+    /**
+     * @brief Culls meshlets against the frustum and normal cones and keeps the visible ranges
+     * for RenderCulled. Doesn't touch OpenGL, so meshes can be culled on worker threads
+     *
+     * @param frustum - Object space frustum
+     * @param cameraPosition - Object space camera position
+     *
+     */
+    void Cull(const Frustum& frustum, const glm::vec3& cameraPosition) const;
+
+    /**
+     * @brief Renders the meshlet ranges kept by the last Cull call.
+     * Meshes without meshlets are rendered whole
+     *
+     * @param depthOnly - Uses the position only vertex stream and skips textures, for the depth pre-pass
+     *
+     */
+    void RenderCulled(bool depthOnly = false) const;
+
+    /**
+     * @brief Renders several instances of the whole mesh, e.g. skinned ones reading their bones per instance
+     *
+     * @param instanceCount - Number of instances
+     *
+     */
+    void RenderInstanced(unsigned instanceCount) const;
+
+    /**
+     * @brief Returns vertex size in floats
+     */
+    unsigned GetStride() const;
+
+    /**
+     * @brief Returns true if vertices carry bone indices and weights
+     */
+    bool IsSkinned() const;
+
+    /**
+     * @brief Returns the object space bounding box, computed at upload
+     *
+     * @param min - Minimum corner
+     * @param max - Maximum corner
+     *
+     * @returns false if the mesh has no vertices
+     */
+    bool GetBounds(glm::vec3& min, glm::vec3& max) const;
+
+    /**
+     * @brief Returns vertices, empty unless the mesh was created with keepGeometry
+     */
+    const std::vector<float>& GetVertices() const;
+
+    /**
+     * @brief Returns indices, empty unless the mesh was created with keepGeometry
+     */
+    const std::vector<unsigned>& GetIndices() const;
+
 private:
-    unsigned mVAO;
-    unsigned mVBO;
-    unsigned mEBO;
+    std::vector<float> mVertices;
+    std::vector<unsigned> mIndices;
+    GLVertexArray mVAO;
+    GLBuffer mVBO;
+    // Position only copy of the vertices sharing the index buffer, read by the depth pre-pass
+    GLVertexArray mDepthVAO;
+    GLBuffer mDepthVBO;
+    IndexBuffer mIndexBuffer;
     unsigned mVertexCount;
-    unsigned mIndexCount;
-    unsigned mDiffuseTexture;
-    unsigned mSpecularTexture;
-    unsigned loadMeshTexture(const aiMaterial* material, const std::string& resPath, aiTextureType type);
-    void processMesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath);
+    unsigned mStride;
+    MeshletSet mMeshlets;
+    // Reused between frames to avoid allocating multi-draw arguments every frame
+    mutable std::vector<GLsizei> mDrawCounts;
+    mutable std::vector<const void*> mDrawOffsets;
+    glm::vec3 mMin;
+    glm::vec3 mMax;
+    GLTexture mDiffuseTexture;
+    GLTexture mSpecularTexture;
+    void bindTextures() const;
+    void draw() const;
+    static void addBoneWeights(const aiMesh* mesh, const Skeleton& skeleton, std::vector<float>& vertices);
+    static std::string getTexturePath(const aiMaterial* material, const std::string& resPath, aiTextureType type);
+    void processMesh(MeshGeometry&& geometry, const std::string& resPath, bool keepGeometry);
 };
@@ -0,0 +1,321 @@
+#include "meshlet.hpp"
+#include "simd.hpp"
+#include "cooked.hpp"
+#include <cmath>
+#include <algorithm>
+
+MeshletSet::MeshletSet() {
+    mCount = 0;
+}
+
+MeshletSet
+MeshletSet::Build(const std::vector<float>& vertices, std::vector<unsigned>& indices, unsigned stride) {
+    MeshletSet Result;
+    unsigned TriangleCount = indices.size() / 3;
+    unsigned VertexCount = vertices.size() / stride;
+
+    // Vertex -> triangle adjacency used to grow meshlets over connected triangles
+    std::vector<unsigned> AdjacencyOffsets(VertexCount + 1, 0);
+    for (unsigned Index : indices) {
+        ++AdjacencyOffsets[Index + 1];
+    }
+    for (unsigned VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx) {
+        AdjacencyOffsets[VertexIdx + 1] += AdjacencyOffsets[VertexIdx];
+    }
+    std::vector<unsigned> Adjacency(indices.size());
+    std::vector<unsigned> Fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+    std::vector<glm::vec3> Centroids(TriangleCount);
+    std::vector<glm::vec3> Normals(TriangleCount);
+    for (unsigned TriangleIdx = 0; TriangleIdx < TriangleCount; ++TriangleIdx) {
+        glm::vec3 Corners[3];
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned Index = indices[TriangleIdx * 3 + Corner];
+            Adjacency[Fill[Index]++] = TriangleIdx;
+            Corners[Corner] = glm::vec3(vertices[Index * stride], vertices[Index * stride + 1], vertices[Index * stride + 2]);
+        }
+        Centroids[TriangleIdx] = (Corners[0] + Corners[1] + Corners[2]) / 3.0f;
+        glm::vec3 Cross = glm::cross(Corners[1] - Corners[0], Corners[2] - Corners[0]);
+        float Length = glm::length(Cross);
+        Normals[TriangleIdx] = Length > 0.0f ? Cross / Length : glm::vec3(0.0f);
+    }
+
+    std::vector<bool> Assigned(TriangleCount, false);
+    // Vertex belongs to the current meshlet if it is marked with the current meshlet number
+    std::vector<unsigned> Marks(VertexCount, ~0u);
+    std::vector<unsigned> MeshletVertices;
+    std::vector<unsigned> Reordered;
+    Reordered.reserve(indices.size());
+    unsigned Cursor = 0;
+    unsigned MeshletTriangles = 0;
+    glm::vec3 CentroidSum(0.0f);
+    glm::vec3 NormalSum(0.0f);
+
+    for (unsigned Step = 0; Step < TriangleCount; ++Step) {
+        // Grow the current meshlet with the connected triangle that adds the fewest vertices,
+        // ties go to the one closest to the meshlet center with the most similar normal
+        int Best = -1;
+        unsigned BestNewVertices = 4;
+        float BestScore = 0.0f;
+        if (MeshletTriangles && MeshletTriangles < MESHLET_MAX_TRIANGLES) {
+            glm::vec3 Center = CentroidSum / (float)MeshletTriangles;
+            float NormalLength = glm::length(NormalSum);
+            glm::vec3 AverageNormal = NormalLength > 0.0f ? NormalSum / NormalLength : glm::vec3(0.0f);
+            for (unsigned Vertex : MeshletVertices) {
+                for (unsigned AdjacencyIdx = AdjacencyOffsets[Vertex]; AdjacencyIdx < AdjacencyOffsets[Vertex + 1]; ++AdjacencyIdx) {
+                    unsigned Candidate = Adjacency[AdjacencyIdx];
+                    if (Assigned[Candidate]) {
+                        continue;
+                    }
+                    const unsigned* Triangle = &indices[Candidate * 3];
+                    unsigned NewVertices = (Marks[Triangle[0]] != Step) + (Marks[Triangle[1]] != Step) + (Marks[Triangle[2]] != Step);
+                    if (MeshletVertices.size() + NewVertices > MESHLET_MAX_VERTICES || NewVertices > BestNewVertices) {
+                        continue;
+                    }
+                    float Score = glm::length(Centroids[Candidate] - Center) * (2.0f - glm::dot(Normals[Candidate], AverageNormal));
+                    if (NewVertices < BestNewVertices || Score < BestScore) {
+                        Best = Candidate;
+                        BestNewVertices = NewVertices;
+                        BestScore = Score;
+                    }
+                }
+            }
+        }
+
+        // Nothing connected fits, start a new meshlet from the next triangle in input order
+        if (Best < 0) {
+            if (MeshletTriangles) {
+                Result.addMeshlet(vertices, Reordered, stride, Reordered.size() - MeshletTriangles * 3, MeshletTriangles * 3);
+            }
+            while (Assigned[Cursor]) {
+                ++Cursor;
+            }
+            Best = Cursor;
+            MeshletVertices.clear();
+            MeshletTriangles = 0;
+            CentroidSum = glm::vec3(0.0f);
+            NormalSum = glm::vec3(0.0f);
+        }
+
+        // Marks are refreshed every step so a vertex is in the meshlet iff marked with the current step
+        for (unsigned Vertex : MeshletVertices) {
+            Marks[Vertex] = Step + 1;
+        }
+        const unsigned* Triangle = &indices[Best * 3];
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            if (Marks[Triangle[Corner]] != Step + 1) {
+                Marks[Triangle[Corner]] = Step + 1;
+                MeshletVertices.push_back(Triangle[Corner]);
+            }
+        }
+        Reordered.insert(Reordered.end(), Triangle, Triangle + 3);
+        Assigned[Best] = true;
+        ++MeshletTriangles;
+        CentroidSum += Centroids[Best];
+        NormalSum += Normals[Best];
+    }
+    if (MeshletTriangles) {
+        Result.addMeshlet(vertices, Reordered, stride, Reordered.size() - MeshletTriangles * 3, MeshletTriangles * 3);
+    }
+    indices.swap(Reordered);
+
+    // Padding lanes are never reported as visible, values only need to be valid floats
+    unsigned PaddedCount = SimdPadCount(Result.mCount);
+    std::vector<float>* Arrays[] = {
+        &Result.mCenterX, &Result.mCenterY, &Result.mCenterZ, &Result.mRadius,
+        &Result.mConeAxisX, &Result.mConeAxisY, &Result.mConeAxisZ, &Result.mConeCutoff,
+    };
+    for (std::vector<float>* Array : Arrays) {
+        Array->resize(PaddedCount, 0.0f);
+    }
+    return Result;
+}
+
+unsigned
+MeshletSet::GetCount() const {
+    return mCount;
+}
+
+unsigned
+MeshletSet::Cull(const Frustum& frustum, const glm::vec3& cameraPosition, unsigned indexSize, std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const {
+    counts.clear();
+    offsets.clear();
+    unsigned VisibleCount = 0;
+
+#if SIMD_SSE
+    __m128 PlaneX[Frustum::PLANE_COUNT], PlaneY[Frustum::PLANE_COUNT], PlaneZ[Frustum::PLANE_COUNT], PlaneW[Frustum::PLANE_COUNT];
+    for (unsigned PlaneIdx = 0; PlaneIdx < Frustum::PLANE_COUNT; ++PlaneIdx) {
+        PlaneX[PlaneIdx] = _mm_set1_ps(frustum.mPlanes[PlaneIdx].x);
+        PlaneY[PlaneIdx] = _mm_set1_ps(frustum.mPlanes[PlaneIdx].y);
+        PlaneZ[PlaneIdx] = _mm_set1_ps(frustum.mPlanes[PlaneIdx].z);
+        PlaneW[PlaneIdx] = _mm_set1_ps(frustum.mPlanes[PlaneIdx].w);
+    }
+    __m128 CameraX = _mm_set1_ps(cameraPosition.x);
+    __m128 CameraY = _mm_set1_ps(cameraPosition.y);
+    __m128 CameraZ = _mm_set1_ps(cameraPosition.z);
+
+    for (unsigned Base = 0; Base < mCount; Base += SIMD_WIDTH) {
+        __m128 CenterX = _mm_loadu_ps(&mCenterX[Base]);
+        __m128 CenterY = _mm_loadu_ps(&mCenterY[Base]);
+        __m128 CenterZ = _mm_loadu_ps(&mCenterZ[Base]);
+        __m128 Radius = _mm_loadu_ps(&mRadius[Base]);
+        __m128 NegativeRadius = _mm_sub_ps(_mm_setzero_ps(), Radius);
+
+        __m128 Visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (unsigned PlaneIdx = 0; PlaneIdx < Frustum::PLANE_COUNT; ++PlaneIdx) {
+            __m128 Distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(PlaneX[PlaneIdx], CenterX), _mm_mul_ps(PlaneY[PlaneIdx], CenterY)),
+                _mm_add_ps(_mm_mul_ps(PlaneZ[PlaneIdx], CenterZ), PlaneW[PlaneIdx]));
+            Visible = _mm_and_ps(Visible, _mm_cmpge_ps(Distance, NegativeRadius));
+        }
+
+        __m128 ToCenterX = _mm_sub_ps(CenterX, CameraX);
+        __m128 ToCenterY = _mm_sub_ps(CenterY, CameraY);
+        __m128 ToCenterZ = _mm_sub_ps(CenterZ, CameraZ);
+        __m128 Length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ToCenterX, ToCenterX), _mm_mul_ps(ToCenterY, ToCenterY)), _mm_mul_ps(ToCenterZ, ToCenterZ)));
+        __m128 ConeDot = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(ToCenterX, _mm_loadu_ps(&mConeAxisX[Base])),
+            _mm_mul_ps(ToCenterY, _mm_loadu_ps(&mConeAxisY[Base]))),
+            _mm_mul_ps(ToCenterZ, _mm_loadu_ps(&mConeAxisZ[Base])));
+        __m128 ConeLimit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&mConeCutoff[Base]), Length), Radius);
+        Visible = _mm_andnot_ps(_mm_cmpge_ps(ConeDot, ConeLimit), Visible);
+
+        int Mask = _mm_movemask_ps(Visible);
+        for (unsigned Lane = 0; Lane < SIMD_WIDTH && Base + Lane < mCount; ++Lane) {
+            if (Mask & (1 << Lane)) {
+                appendRange(Base + Lane, indexSize, counts, offsets);
+                ++VisibleCount;
+            }
+        }
+    }
+#else
+    for (unsigned MeshletIdx = 0; MeshletIdx < mCount; ++MeshletIdx) {
+        glm::vec3 Center(mCenterX[MeshletIdx], mCenterY[MeshletIdx], mCenterZ[MeshletIdx]);
+        if (!frustum.IsSphereVisible(Center, mRadius[MeshletIdx])) {
+            continue;
+        }
+        glm::vec3 ToCenter = Center - cameraPosition;
+        glm::vec3 Axis(mConeAxisX[MeshletIdx], mConeAxisY[MeshletIdx], mConeAxisZ[MeshletIdx]);
+        if (glm::dot(ToCenter, Axis) >= mConeCutoff[MeshletIdx] * glm::length(ToCenter) + mRadius[MeshletIdx]) {
+            continue;
+        }
+        appendRange(MeshletIdx, indexSize, counts, offsets);
+        ++VisibleCount;
+    }
+#endif
+
+    return VisibleCount;
+}
+
+void
+MeshletSet::addMeshlet(const std::vector<float>& vertices, const std::vector<unsigned>& indices, unsigned stride, unsigned indexOffset, unsigned indexCount) {
+    mIndexOffsets.push_back(indexOffset);
+    mIndexCounts.push_back(indexCount);
+    ++mCount;
+
+    glm::vec3 Min(INFINITY);
+    glm::vec3 Max(-INFINITY);
+    for (unsigned IndexIdx = indexOffset; IndexIdx < indexOffset + indexCount; ++IndexIdx) {
+        glm::vec3 Position(vertices[indices[IndexIdx] * stride], vertices[indices[IndexIdx] * stride + 1], vertices[indices[IndexIdx] * stride + 2]);
+        Min = glm::min(Min, Position);
+        Max = glm::max(Max, Position);
+    }
+    glm::vec3 Center = (Min + Max) * 0.5f;
+    float Radius = 0.0f;
+    for (unsigned IndexIdx = indexOffset; IndexIdx < indexOffset + indexCount; ++IndexIdx) {
+        glm::vec3 Position(vertices[indices[IndexIdx] * stride], vertices[indices[IndexIdx] * stride + 1], vertices[indices[IndexIdx] * stride + 2]);
+        Radius = std::max(Radius, glm::length(Position - Center));
+    }
+
+    // Cone axis is the average face normal, its spread is the largest angle to any face normal
+    std::vector<glm::vec3> FaceNormals;
+    FaceNormals.reserve(indexCount / 3);
+    glm::vec3 AxisSum(0.0f);
+    for (unsigned IndexIdx = indexOffset; IndexIdx < indexOffset + indexCount; IndexIdx += 3) {
+        const float* A = &vertices[indices[IndexIdx] * stride];
+        const float* B = &vertices[indices[IndexIdx + 1] * stride];
+        const float* C = &vertices[indices[IndexIdx + 2] * stride];
+        glm::vec3 Cross = glm::cross(glm::vec3(B[0] - A[0], B[1] - A[1], B[2] - A[2]), glm::vec3(C[0] - A[0], C[1] - A[1], C[2] - A[2]));
+        float Length = glm::length(Cross);
+        if (Length > 0.0f) {
+            FaceNormals.push_back(Cross / Length);
+            AxisSum += FaceNormals.back();
+        }
+    }
+
+    glm::vec3 Axis(0.0f);
+    // Cutoff of 1 can never pass the cone test, used for meshlets that can't be back-face culled
+    float Cutoff = 1.0f;
+    float AxisLength = glm::length(AxisSum);
+    if (AxisLength > 0.0f && !FaceNormals.empty()) {
+        Axis = AxisSum / AxisLength;
+        float MinDot = 1.0f;
+        for (const glm::vec3& Normal : FaceNormals) {
+            MinDot = std::min(MinDot, glm::dot(Axis, Normal));
+        }
+        // Normal cone half angle a has cos(a) = MinDot. Back-facing cone is widened by 90 degrees
+        // on both sides and inverted, giving the cutoff -cos(a + 90) = sin(a)
+        if (MinDot > 0.1f) {
+            Cutoff = sqrtf(1.0f - MinDot * MinDot);
+        }
+    }
+
+    mCenterX.push_back(Center.x);
+    mCenterY.push_back(Center.y);
+    mCenterZ.push_back(Center.z);
+    mRadius.push_back(Radius);
+    mConeAxisX.push_back(Axis.x);
+    mConeAxisY.push_back(Axis.y);
+    mConeAxisZ.push_back(Axis.z);
+    mConeCutoff.push_back(Cutoff);
+}
+
+void
+MeshletSet::Write(std::ostream& out) const {
+    CookedFile::Write(out, mCount);
+    const std::vector<unsigned>* const Ranges[] = { &mIndexOffsets, &mIndexCounts };
+    for (const std::vector<unsigned>* Range : Ranges) {
+        CookedFile::WriteVector(out, *Range);
+    }
+    const std::vector<float>* const Bounds[] = { &mCenterX, &mCenterY, &mCenterZ, &mRadius, &mConeAxisX, &mConeAxisY, &mConeAxisZ, &mConeCutoff };
+    for (const std::vector<float>* Bound : Bounds) {
+        CookedFile::WriteVector(out, *Bound);
+    }
+}
+
+bool
+MeshletSet::Read(CookedReader& reader, size_t indexCount) {
+    if (!reader.Read(mCount)) {
+        return false;
+    }
+    std::vector<unsigned>* const Ranges[] = { &mIndexOffsets, &mIndexCounts };
+    for (std::vector<unsigned>* Range : Ranges) {
+        if (!reader.ReadVector(*Range) || Range->size() != mCount) {
+            return false;
+        }
+    }
+    // Culling loads whole SIMD lanes, so the bounds must keep their padding
+    const unsigned PaddedCount = SimdPadCount(mCount);
+    std::vector<float>* const Bounds[] = { &mCenterX, &mCenterY, &mCenterZ, &mRadius, &mConeAxisX, &mConeAxisY, &mConeAxisZ, &mConeCutoff };
+    for (std::vector<float>* Bound : Bounds) {
+        if (!reader.ReadVector(*Bound) || Bound->size() != PaddedCount) {
+            return false;
+        }
+    }
+    for (unsigned MeshletIdx = 0; MeshletIdx < mCount; ++MeshletIdx) {
+        if ((size_t)mIndexOffsets[MeshletIdx] + mIndexCounts[MeshletIdx] > indexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+MeshletSet::appendRange(unsigned meshletIdx, unsigned indexSize, std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const {
+    size_t Offset = (size_t)mIndexOffsets[meshletIdx] * indexSize;
+    if (!counts.empty() && (size_t)offsets.back() + (size_t)counts.back() * indexSize == Offset) {
+        counts.back() += mIndexCounts[meshletIdx];
+        return;
+    }
+    counts.push_back(mIndexCounts[meshletIdx]);
+    offsets.push_back((const void*)Offset);
+}
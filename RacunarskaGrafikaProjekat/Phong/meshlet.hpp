@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include <iostream>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "frustum.hpp"
+
+class CookedReader;
+
+// Meshlet limits. Around 64 vertices and 124 triangles keeps clusters small enough to cull
+// finely while the per-meshlet normal cone stays narrow
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+// Smaller meshes are drawn whole, culling them per cluster costs more than it saves
+#define MESHLET_MIN_MESH_TRIANGLES 2048
+
+/**
+ * @brief Triangle clusters of one mesh. Each meshlet is a contiguous range of the mesh index buffer,
+ * its bounds are stored as structure of arrays (padded to SIMD_WIDTH) for batched culling
+ */
+class MeshletSet {
+public:
+    std::vector<unsigned> mIndexOffsets;
+    std::vector<unsigned> mIndexCounts;
+
+    // Bounding spheres
+    std::vector<float> mCenterX;
+    std::vector<float> mCenterY;
+    std::vector<float> mCenterZ;
+    std::vector<float> mRadius;
+
+    // Normal cones. Meshlet faces away from the camera if
+    // dot(center - camera, axis) >= cutoff * length(center - camera) + radius
+    std::vector<float> mConeAxisX;
+    std::vector<float> mConeAxisY;
+    std::vector<float> mConeAxisZ;
+    std::vector<float> mConeCutoff;
+
+    MeshletSet();
+
+    /**
+     * @brief Splits an indexed triangle list into meshlets by greedily growing each one over
+     * connected triangles. Triangles are reordered so every meshlet is a contiguous index range,
+     * within a meshlet the order stays vertex cache friendly since it references at most MESHLET_MAX_VERTICES vertices
+     *
+     * @param vertices Interleaved vertex data, position has to be the first 3 floats
+     * @param indices Triangle list indices, reordered in place
+     * @param stride Vertex size in floats
+     *
+     * @returns Meshlets
+     */
+    static MeshletSet Build(const std::vector<float>& vertices, std::vector<unsigned>& indices, unsigned stride);
+
+    /**
+     * @brief Returns number of meshlets
+     */
+    unsigned GetCount() const;
+
+    /**
+     * @brief Culls meshlets against the frustum and by normal cone and writes the visible
+     * index ranges as glMultiDrawElements arguments. Neighbouring visible meshlets are merged into one range.
+     * NOTE: Frustum and camera have to be in the mesh's object space and the model
+     * transform must not contain non-uniform scale for the cone test to hold
+     *
+     * @param frustum Object space frustum
+     * @param cameraPosition Object space camera position
+     * @param indexSize Size of one index in bytes
+     * @param counts Output index counts, cleared first
+     * @param offsets Output byte offsets into the index buffer, cleared first
+     *
+     * @returns Number of visible meshlets
+     */
+    unsigned Cull(const Frustum& frustum, const glm::vec3& cameraPosition, unsigned indexSize, std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const;
+
+    /**
+     * @brief Writes the meshlets into a cooked model, padding included
+     *
+     * @param out Cooked file stream
+     */
+    void Write(std::ostream& out) const;
+
+    /**
+     * @brief Reads meshlets written by Write
+     *
+     * @param reader Cooked file reader
+     * @param indexCount Size of the index buffer the ranges point into
+     *
+     * @returns false on a truncated file or ranges that don't fit the index buffer
+     */
+    bool Read(CookedReader& reader, size_t indexCount);
+
+private:
+    unsigned mCount;
+
+    void addMeshlet(const std::vector<float>& vertices, const std::vector<unsigned>& indices, unsigned stride, unsigned indexOffset, unsigned indexCount);
+    void appendRange(unsigned meshletIdx, unsigned indexSize, std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const;
+};
@@ -0,0 +1,430 @@
+#include "meshopt.hpp"
+#include "meshlet.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+// Size of the LRU cache modeled by the Forsyth scoring function
+static const unsigned FORSYTH_CACHE_SIZE = 32;
+// Valences above this value are scored with the same (lowest) valence bonus
+static const unsigned FORSYTH_MAX_VALENCE = 32;
+
+/**
+ * @brief Scores a vertex by its position in the modeled LRU cache and remaining triangle count.
+ * Higher score means the vertex should be used sooner
+ *
+ * @param cachePosition Position in the cache or -1 if vertex isn't cached
+ * @param liveTriangles Number of not yet emitted triangles using the vertex
+ *
+ * @returns Vertex score
+ */
+static float
+forsythVertexScore(int cachePosition, unsigned liveTriangles) {
+    static float CacheScores[FORSYTH_CACHE_SIZE];
+    static float ValenceScores[FORSYTH_MAX_VALENCE + 1];
+    static bool Initialized = false;
+    if (!Initialized) {
+        for (unsigned Position = 0; Position < FORSYTH_CACHE_SIZE; ++Position) {
+            // Last triangle's vertices get a fixed score so the same triangle isn't favored twice
+            CacheScores[Position] = Position < 3
+                ? 0.75f
+                : powf(1.0f - (Position - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+        ValenceScores[0] = 0.0f;
+        for (unsigned Valence = 1; Valence <= FORSYTH_MAX_VALENCE; ++Valence) {
+            ValenceScores[Valence] = 2.0f / sqrtf((float)Valence);
+        }
+        Initialized = true;
+    }
+
+    if (!liveTriangles) {
+        return -1.0f;
+    }
+
+    float Score = cachePosition >= 0 ? CacheScores[cachePosition] : 0.0f;
+    return Score + ValenceScores[std::min(liveTriangles, FORSYTH_MAX_VALENCE)];
+}
+
+void
+MeshOptimizer::Optimize(std::vector<float>& vertices, std::vector<unsigned>& indices, unsigned stride, bool optimizeOverdraw, const std::string& name, MeshletSet* meshlets) {
+    if (indices.empty() || vertices.empty()) {
+        return;
+    }
+
+    unsigned VertexCount = vertices.size() / stride;
+    VertexCacheStats Before = AnalyzeVertexCache(indices, VertexCount);
+
+    OptimizeVertexCache(indices, VertexCount);
+    if (optimizeOverdraw) {
+        OptimizeOverdraw(indices, vertices, stride);
+    }
+    // Meshlets start from the next unassigned triangle in this order, so they come out in overdraw order.
+    // Growing them scatters the triangles, each meshlet gets its own cache order back
+    if (meshlets) {
+        *meshlets = MeshletSet::Build(vertices, indices, stride);
+        OptimizeVertexCacheRanges(indices, VertexCount, meshlets->mIndexOffsets, meshlets->mIndexCounts);
+    }
+    // Only vertices move from here on, meshlet ranges and bounds stay valid
+    VertexCount = OptimizeVertexFetch(vertices, indices, stride);
+
+    VertexCacheStats After = AnalyzeVertexCache(indices, VertexCount);
+    // Meshes can be optimized on worker threads, so the report is written in one go
+    std::ostringstream Report;
+    Report << "Optimized mesh " << name << " (" << indices.size() / 3 << " triangles";
+    if (meshlets) {
+        Report << ", " << meshlets->GetCount() << " meshlets";
+    }
+    Report << "): ACMR " << Before.ACMR << " -> " << After.ACMR << ", ATVR " << Before.ATVR << " -> " << After.ATVR << std::endl;
+    std::cout << Report.str();
+}
+
+unsigned
+MeshOptimizer::WeldVertices(std::vector<float>& vertices, std::vector<unsigned>& indices, unsigned stride, float step) {
+    unsigned VertexCount = vertices.size() / stride;
+    if (!VertexCount) {
+        return 0;
+    }
+
+    std::vector<long long> Quantized(vertices.size());
+    for (unsigned ValueIdx = 0; ValueIdx < vertices.size(); ++ValueIdx) {
+        Quantized[ValueIdx] = llroundf(vertices[ValueIdx] / step);
+    }
+
+    // Open addressing hash table of unique vertex indices, kept at most half full
+    unsigned TableSize = 1;
+    while (TableSize < VertexCount * 2) {
+        TableSize <<= 1;
+    }
+    const unsigned Empty = ~0u;
+    std::vector<unsigned> Table(TableSize, Empty);
+    std::vector<unsigned> Remap(VertexCount);
+    std::vector<float> Result;
+    Result.reserve(vertices.size());
+    unsigned UniqueCount = 0;
+
+    for (unsigned VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx) {
+        const long long* Key = &Quantized[VertexIdx * stride];
+        // FNV-1a over the quantized tuple
+        unsigned long long Hash = 14695981039346656037ull;
+        for (unsigned Component = 0; Component < stride; ++Component) {
+            Hash = (Hash ^ (unsigned long long)Key[Component]) * 1099511628211ull;
+        }
+
+        unsigned Slot = (unsigned)(Hash ^ (Hash >> 32)) & (TableSize - 1);
+        while (Table[Slot] != Empty) {
+            const long long* Other = &Quantized[Table[Slot] * stride];
+            if (std::equal(Key, Key + stride, Other)) {
+                break;
+            }
+            Slot = (Slot + 1) & (TableSize - 1);
+        }
+
+        if (Table[Slot] == Empty) {
+            Table[Slot] = VertexIdx;
+            Remap[VertexIdx] = UniqueCount++;
+            Result.insert(Result.end(), vertices.begin() + VertexIdx * stride, vertices.begin() + (VertexIdx + 1) * stride);
+        } else {
+            Remap[VertexIdx] = Remap[Table[Slot]];
+        }
+    }
+
+    for (unsigned& Index : indices) {
+        Index = Remap[Index];
+    }
+    vertices.swap(Result);
+    return UniqueCount;
+}
+
+VertexCacheStats
+MeshOptimizer::AnalyzeVertexCache(const std::vector<unsigned>& indices, unsigned vertexCount, unsigned cacheSize) {
+    VertexCacheStats Stats = { 0, 0.0f, 0.0f };
+    if (indices.empty() || !vertexCount) {
+        return Stats;
+    }
+
+    // Vertex is in the FIFO cache if fewer than cacheSize vertices were pushed since it was
+    std::vector<unsigned> CacheTimestamps(vertexCount, 0);
+    std::vector<bool> Referenced(vertexCount, false);
+    unsigned Timestamp = cacheSize + 1;
+    unsigned UniqueVertices = 0;
+
+    for (unsigned Index : indices) {
+        if (Timestamp - CacheTimestamps[Index] > cacheSize) {
+            CacheTimestamps[Index] = Timestamp++;
+            ++Stats.VerticesTransformed;
+        }
+        if (!Referenced[Index]) {
+            Referenced[Index] = true;
+            ++UniqueVertices;
+        }
+    }
+
+    Stats.ACMR = Stats.VerticesTransformed / (float)(indices.size() / 3);
+    Stats.ATVR = Stats.VerticesTransformed / (float)UniqueVertices;
+    return Stats;
+}
+
+void
+MeshOptimizer::OptimizeVertexCache(std::vector<unsigned>& indices, unsigned vertexCount) {
+    unsigned TriangleCount = indices.size() / 3;
+    if (!TriangleCount) {
+        return;
+    }
+
+    // Vertex -> triangle adjacency. First LiveTriangles[v] entries of each range are not yet emitted
+    std::vector<unsigned> LiveTriangles(vertexCount, 0);
+    for (unsigned Index : indices) {
+        ++LiveTriangles[Index];
+    }
+    std::vector<unsigned> AdjacencyOffsets(vertexCount + 1, 0);
+    for (unsigned VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        AdjacencyOffsets[VertexIdx + 1] = AdjacencyOffsets[VertexIdx] + LiveTriangles[VertexIdx];
+    }
+    std::vector<unsigned> Adjacency(indices.size());
+    std::vector<unsigned> Fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+    for (unsigned TriangleIdx = 0; TriangleIdx < TriangleCount; ++TriangleIdx) {
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            Adjacency[Fill[indices[TriangleIdx * 3 + Corner]]++] = TriangleIdx;
+        }
+    }
+
+    std::vector<int> CachePositions(vertexCount, -1);
+    std::vector<float> VertexScores(vertexCount);
+    for (unsigned VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        VertexScores[VertexIdx] = forsythVertexScore(-1, LiveTriangles[VertexIdx]);
+    }
+
+    std::vector<bool> Emitted(TriangleCount, false);
+    std::vector<unsigned> Result;
+    Result.reserve(indices.size());
+
+    unsigned Cache[FORSYTH_CACHE_SIZE + 3];
+    unsigned CacheCount = 0;
+    unsigned NewCache[FORSYTH_CACHE_SIZE + 3];
+    unsigned Cursor = 0;
+    int BestTriangle = -1;
+
+    for (unsigned Step = 0; Step < TriangleCount; ++Step) {
+        // Nothing useful in cache, continue with the next triangle in input order
+        if (BestTriangle < 0) {
+            while (Emitted[Cursor]) {
+                ++Cursor;
+            }
+            BestTriangle = Cursor;
+        }
+
+        const unsigned* Triangle = &indices[BestTriangle * 3];
+        Result.insert(Result.end(), Triangle, Triangle + 3);
+        Emitted[BestTriangle] = true;
+
+        // Remove emitted triangle from its vertices' live lists
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned Vertex = Triangle[Corner];
+            unsigned* Live = &Adjacency[AdjacencyOffsets[Vertex]];
+            unsigned LiveCount = LiveTriangles[Vertex];
+            for (unsigned LiveIdx = 0; LiveIdx < LiveCount; ++LiveIdx) {
+                if (Live[LiveIdx] == (unsigned)BestTriangle) {
+                    std::swap(Live[LiveIdx], Live[LiveCount - 1]);
+                    --LiveTriangles[Vertex];
+                    break;
+                }
+            }
+        }
+
+        // Emitted vertices move to the front of the LRU cache
+        unsigned NewCacheCount = 0;
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            NewCache[NewCacheCount++] = Triangle[Corner];
+        }
+        for (unsigned CacheIdx = 0; CacheIdx < CacheCount; ++CacheIdx) {
+            unsigned Vertex = Cache[CacheIdx];
+            if (Vertex != Triangle[0] && Vertex != Triangle[1] && Vertex != Triangle[2]) {
+                NewCache[NewCacheCount++] = Vertex;
+            }
+        }
+
+        // Rescore vertices, including the ones that just fell out of the cache
+        for (unsigned CacheIdx = 0; CacheIdx < NewCacheCount; ++CacheIdx) {
+            unsigned Vertex = NewCache[CacheIdx];
+            CachePositions[Vertex] = CacheIdx < FORSYTH_CACHE_SIZE ? (int)CacheIdx : -1;
+            VertexScores[Vertex] = forsythVertexScore(CachePositions[Vertex], LiveTriangles[Vertex]);
+        }
+
+        // Only triangles touching cached vertices are candidates for the next pick
+        BestTriangle = -1;
+        float BestScore = 0.0f;
+        CacheCount = std::min(NewCacheCount, FORSYTH_CACHE_SIZE);
+        for (unsigned CacheIdx = 0; CacheIdx < CacheCount; ++CacheIdx) {
+            unsigned Vertex = NewCache[CacheIdx];
+            Cache[CacheIdx] = Vertex;
+            const unsigned* Live = &Adjacency[AdjacencyOffsets[Vertex]];
+            for (unsigned LiveIdx = 0; LiveIdx < LiveTriangles[Vertex]; ++LiveIdx) {
+                const unsigned* Candidate = &indices[Live[LiveIdx] * 3];
+                float Score = VertexScores[Candidate[0]] + VertexScores[Candidate[1]] + VertexScores[Candidate[2]];
+                if (Score > BestScore) {
+                    BestScore = Score;
+                    BestTriangle = Live[LiveIdx];
+                }
+            }
+        }
+    }
+
+    indices.swap(Result);
+}
+
+void
+MeshOptimizer::OptimizeVertexCacheRanges(std::vector<unsigned>& indices, unsigned vertexCount, const std::vector<unsigned>& offsets, const std::vector<unsigned>& counts) {
+    // Ranges reference few vertices, so each one is optimized on local vertex numbers
+    std::vector<unsigned> LocalIds(vertexCount, ~0u);
+    std::vector<unsigned> GlobalIds;
+    std::vector<unsigned> Range;
+    for (unsigned RangeIdx = 0; RangeIdx < offsets.size(); ++RangeIdx) {
+        Range.clear();
+        GlobalIds.clear();
+        for (unsigned IndexIdx = offsets[RangeIdx]; IndexIdx < offsets[RangeIdx] + counts[RangeIdx]; ++IndexIdx) {
+            unsigned& Local = LocalIds[indices[IndexIdx]];
+            if (Local == ~0u) {
+                Local = GlobalIds.size();
+                GlobalIds.push_back(indices[IndexIdx]);
+            }
+            Range.push_back(Local);
+        }
+
+        OptimizeVertexCache(Range, GlobalIds.size());
+        for (unsigned IndexIdx = 0; IndexIdx < Range.size(); ++IndexIdx) {
+            indices[offsets[RangeIdx] + IndexIdx] = GlobalIds[Range[IndexIdx]];
+        }
+        for (unsigned Global : GlobalIds) {
+            LocalIds[Global] = ~0u;
+        }
+    }
+}
+
+void
+MeshOptimizer::OptimizeOverdraw(std::vector<unsigned>& indices, const std::vector<float>& vertices, unsigned stride) {
+    unsigned TriangleCount = indices.size() / 3;
+    unsigned VertexCount = vertices.size() / stride;
+    if (TriangleCount < 2) {
+        return;
+    }
+
+    // Cluster boundaries are triangles where the simulated cache is completely cold,
+    // so reordering whole clusters costs (almost) no extra vertex transforms
+    std::vector<unsigned> ClusterStarts;
+    std::vector<unsigned> CacheTimestamps(VertexCount, 0);
+    unsigned Timestamp = FIFO_CACHE_SIZE + 1;
+    for (unsigned TriangleIdx = 0; TriangleIdx < TriangleCount; ++TriangleIdx) {
+        unsigned Misses = 0;
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned Index = indices[TriangleIdx * 3 + Corner];
+            if (Timestamp - CacheTimestamps[Index] > FIFO_CACHE_SIZE) {
+                CacheTimestamps[Index] = Timestamp++;
+                ++Misses;
+            }
+        }
+        if (TriangleIdx == 0 || Misses == 3) {
+            ClusterStarts.push_back(TriangleIdx);
+        }
+    }
+    ClusterStarts.push_back(TriangleCount);
+    unsigned ClusterCount = ClusterStarts.size() - 1;
+    if (ClusterCount < 2) {
+        return;
+    }
+
+    struct Cluster {
+        unsigned FirstTriangle;
+        unsigned TriangleCount;
+        float SortKey;
+    };
+    std::vector<Cluster> Clusters(ClusterCount);
+    std::vector<float> Centroids(ClusterCount * 3, 0.0f);
+    std::vector<float> Normals(ClusterCount * 3, 0.0f);
+    float MeshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float MeshArea = 0.0f;
+
+    for (unsigned ClusterIdx = 0; ClusterIdx < ClusterCount; ++ClusterIdx) {
+        Cluster& Current = Clusters[ClusterIdx];
+        Current.FirstTriangle = ClusterStarts[ClusterIdx];
+        Current.TriangleCount = ClusterStarts[ClusterIdx + 1] - Current.FirstTriangle;
+
+        float* Centroid = &Centroids[ClusterIdx * 3];
+        float* Normal = &Normals[ClusterIdx * 3];
+        float ClusterArea = 0.0f;
+        for (unsigned TriangleIdx = Current.FirstTriangle; TriangleIdx < Current.FirstTriangle + Current.TriangleCount; ++TriangleIdx) {
+            const float* A = &vertices[indices[TriangleIdx * 3 + 0] * stride];
+            const float* B = &vertices[indices[TriangleIdx * 3 + 1] * stride];
+            const float* C = &vertices[indices[TriangleIdx * 3 + 2] * stride];
+            float AB[3] = { B[0] - A[0], B[1] - A[1], B[2] - A[2] };
+            float AC[3] = { C[0] - A[0], C[1] - A[1], C[2] - A[2] };
+            // Cross product length is twice the triangle area, so the sum is an area weighted normal
+            float Cross[3] = {
+                AB[1] * AC[2] - AB[2] * AC[1],
+                AB[2] * AC[0] - AB[0] * AC[2],
+                AB[0] * AC[1] - AB[1] * AC[0],
+            };
+            float Area = sqrtf(Cross[0] * Cross[0] + Cross[1] * Cross[1] + Cross[2] * Cross[2]);
+            for (unsigned Axis = 0; Axis < 3; ++Axis) {
+                Normal[Axis] += Cross[Axis];
+                Centroid[Axis] += (A[Axis] + B[Axis] + C[Axis]) / 3.0f * Area;
+            }
+            ClusterArea += Area;
+        }
+
+        for (unsigned Axis = 0; Axis < 3; ++Axis) {
+            MeshCentroid[Axis] += Centroid[Axis];
+            Centroid[Axis] = ClusterArea > 0.0f ? Centroid[Axis] / ClusterArea : vertices[indices[Current.FirstTriangle * 3] * stride + Axis];
+        }
+        MeshArea += ClusterArea;
+    }
+
+    for (unsigned Axis = 0; Axis < 3; ++Axis) {
+        MeshCentroid[Axis] = MeshArea > 0.0f ? MeshCentroid[Axis] / MeshArea : 0.0f;
+    }
+
+    // Clusters that face away from the mesh center are most likely to occlude the rest
+    for (unsigned ClusterIdx = 0; ClusterIdx < ClusterCount; ++ClusterIdx) {
+        const float* Centroid = &Centroids[ClusterIdx * 3];
+        const float* Normal = &Normals[ClusterIdx * 3];
+        float NormalLength = sqrtf(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+        float Key = 0.0f;
+        if (NormalLength > 0.0f) {
+            for (unsigned Axis = 0; Axis < 3; ++Axis) {
+                Key += (Centroid[Axis] - MeshCentroid[Axis]) * Normal[Axis] / NormalLength;
+            }
+        }
+        Clusters[ClusterIdx].SortKey = Key;
+    }
+
+    std::stable_sort(Clusters.begin(), Clusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.SortKey > b.SortKey;
+    });
+
+    std::vector<unsigned> Result;
+    Result.reserve(indices.size());
+    for (const Cluster& Current : Clusters) {
+        Result.insert(Result.end(), indices.begin() + Current.FirstTriangle * 3, indices.begin() + (Current.FirstTriangle + Current.TriangleCount) * 3);
+    }
+    indices.swap(Result);
+}
+
+unsigned
+MeshOptimizer::OptimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned>& indices, unsigned stride) {
+    const unsigned Unmapped = ~0u;
+    unsigned VertexCount = vertices.size() / stride;
+    std::vector<unsigned> Remap(VertexCount, Unmapped);
+    std::vector<float> Result;
+    Result.reserve(vertices.size());
+
+    unsigned NextVertex = 0;
+    for (unsigned& Index : indices) {
+        if (Remap[Index] == Unmapped) {
+            Remap[Index] = NextVertex++;
+            Result.insert(Result.end(), vertices.begin() + Index * stride, vertices.begin() + (Index + 1) * stride);
+        }
+        Index = Remap[Index];
+    }
+
+    vertices.swap(Result);
+    return NextVertex;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <iostream>
+#include <string>
+
+class MeshletSet;
+
+struct VertexCacheStats {
+    // Number of vertex shader invocations needed for the whole index buffer
+    unsigned VerticesTransformed;
+    // Average cache miss ratio - transformed vertices per triangle. 0.5 is ideal, 3.0 is worst
+    float ACMR;
+    // Average transform to vertex ratio - transformed vertices per unique vertex. 1.0 is ideal
+    float ATVR;
+};
+
+class MeshOptimizer {
+public:
+    // Size of the simulated post-transform FIFO cache used for reporting
+    static const unsigned FIFO_CACHE_SIZE = 16;
+    // Attribute values closer than this are considered equal when welding
+    static constexpr float WELD_QUANTIZATION_STEP = 1e-5f;
+
+    /**
+     * @brief Merges vertices whose quantized attribute tuples are equal and rebuilds the index buffer.
+     * Only touches the passed buffers, so it is safe to run for different meshes in parallel
+     *
+     * @param vertices Interleaved vertex data, compacted in place
+     * @param indices Triangle list indices, remapped in place
+     * @param stride Vertex size in floats
+     * @param step Quantization step for all attributes
+     *
+     * @returns New vertex count
+     */
+    static unsigned WeldVertices(std::vector<float>& vertices, std::vector<unsigned>& indices, unsigned stride, float step = WELD_QUANTIZATION_STEP);
+
+    /**
+     * @brief Runs the whole import-time optimization stage on an indexed triangle list:
+     * vertex cache reordering, optional overdraw clustering, optional meshlet building and vertex
+     * fetch reordering. Meshlet grouping reorders triangles, so the cache order is rebuilt inside
+     * every meshlet afterwards. Prints ACMR/ATVR of the input and of the final buffer
+     *
+     * @param vertices Interleaved vertex data, position has to be the first 3 floats
+     * @param indices Triangle list indices
+     * @param stride Vertex size in floats
+     * @param optimizeOverdraw Whether to sort triangle clusters for lower overdraw
+     * @param name Name used in the report
+     * @param meshlets Receives the meshlets of the final buffer, null to skip building them
+     */
+    static void Optimize(std::vector<float>& vertices, std::vector<unsigned>& indices, unsigned stride, bool optimizeOverdraw, const std::string& name, MeshletSet* meshlets = 0);
+
+    /**
+     * @brief Simulates a FIFO post-transform cache over the index buffer
+     *
+     * @param indices Triangle list indices
+     * @param vertexCount Number of vertices referenced by the indices
+     * @param cacheSize Simulated cache size
+     *
+     * @returns Cache statistics
+     */
+    static VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned>& indices, unsigned vertexCount, unsigned cacheSize = FIFO_CACHE_SIZE);
+
+    /**
+     * @brief Reorders triangles for post-transform vertex cache locality (Forsyth's linear-speed algorithm)
+     *
+     * @param indices Triangle list indices, reordered in place
+     * @param vertexCount Number of vertices referenced by the indices
+     */
+    static void OptimizeVertexCache(std::vector<unsigned>& indices, unsigned vertexCount);
+
+    /**
+     * @brief Runs OptimizeVertexCache inside each index range separately, triangles never leave their range
+     *
+     * @param indices Triangle list indices, reordered in place
+     * @param vertexCount Number of vertices referenced by the indices
+     * @param offsets First index of every range
+     * @param counts Index count of every range, a multiple of 3
+     */
+    static void OptimizeVertexCacheRanges(std::vector<unsigned>& indices, unsigned vertexCount, const std::vector<unsigned>& offsets, const std::vector<unsigned>& counts);
+
+    /**
+     * @brief Splits cache optimized triangles into clusters and sorts them so outward facing
+     * clusters are drawn first, which lowers overdraw while keeping most of the cache locality
+     *
+     * @param indices Cache optimized triangle list indices, reordered in place
+     * @param vertices Interleaved vertex data, position has to be the first 3 floats
+     * @param stride Vertex size in floats
+     */
+    static void OptimizeOverdraw(std::vector<unsigned>& indices, const std::vector<float>& vertices, unsigned stride);
+
+    /**
+     * @brief Reorders vertices in order of first use in the index buffer and remaps the indices.
+     * Unreferenced vertices are dropped
+     *
+     * @param vertices Interleaved vertex data, reordered in place
+     * @param indices Triangle list indices, remapped in place
+     * @param stride Vertex size in floats
+     *
+     * @returns New vertex count
+     */
+    static unsigned OptimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned>& indices, unsigned stride);
+};
@@ -1,4 +1,5 @@
 #include "model.hpp"
+#include "cooked.hpp"
 
 Model::Model(std::string filename) {
     mFilename = filename;
@@ -6,7 +7,13 @@ Model::Model(std::string filename) {
 }
 
 bool
-Model::Load() {
+Model::Load(JobSystem* jobs, bool keepGeometry) {
+    mMeshes.clear();
+    mClips.clear();
+    if (loadCooked(jobs, keepGeometry)) {
+        return true;
+    }
+
     Assimp::Importer Importer;
     const aiScene *Scene = Importer.ReadFile(mFilename, POSTPROCESS_FLAGS);
 
@@ -14,14 +21,115 @@ Model::Load() {
         std::cerr << "[Err] Failed to load model:" << std::endl << Importer.GetErrorString() << std::endl;
         return false;
     }
+    // Bone weights are stored as skeleton indices, so the skeleton comes before the meshes
+    mSkeleton = Skeleton::FromScene(Scene);
+    for(unsigned AnimationIdx = 0; mSkeleton.GetCount() && AnimationIdx < Scene->mNumAnimations; ++AnimationIdx) {
+        mClips.push_back(AnimationClip::FromAssimp(Scene->mAnimations[AnimationIdx], mSkeleton));
+    }
+
+    // Welding, optimization and texture decoding are CPU only and independent per mesh, run them in parallel.
+    // Buffers and textures are created on this thread since it owns the GL context
+    std::vector<MeshGeometry> Geometries(Scene->mNumMeshes);
+    auto ProcessMeshes = [this, Scene, &Geometries](unsigned begin, unsigned end) {
+        for(unsigned MeshIdx = begin; MeshIdx < end; ++MeshIdx) {
+            aiMesh* CurrAIMesh = Scene->mMeshes[MeshIdx];
+            Geometries[MeshIdx] = Mesh::ProcessGeometry(CurrAIMesh, Scene->mMaterials[CurrAIMesh->mMaterialIndex], mDirectory, &mSkeleton);
+        }
+    };
+    if (jobs) {
+        jobs->ParallelFor(Scene->mNumMeshes, 1, ProcessMeshes);
+    } else {
+        ProcessMeshes(0, Scene->mNumMeshes);
+    }
+
     mMeshes.reserve(Scene->mNumMeshes);
+    for(unsigned MeshIdx = 0; MeshIdx < Scene->mNumMeshes; ++MeshIdx) {
+        mMeshes.emplace_back(std::move(Geometries[MeshIdx]), mDirectory, keepGeometry);
+    }
+    std::cout << mFilename << " Loaded " << mMeshes.size() << " meshes";
+    if (mSkeleton.GetCount()) {
+        std::cout << ", " << mSkeleton.GetCount() << " bones, " << mClips.size() << " animations";
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+bool
+Model::Cook(const std::string& filename) {
+    Assimp::Importer Importer;
+    const aiScene *Scene = Importer.ReadFile(filename, POSTPROCESS_FLAGS);
+    if (!Scene || Scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !Scene->mRootNode) {
+        std::cerr << "[Err] Failed to cook model " << filename << ":" << std::endl << Importer.GetErrorString() << std::endl;
+        return false;
+    }
+    if (Scene->mNumAnimations || Skeleton::FromScene(Scene).GetCount()) {
+        std::cout << filename << " is rigged, left to the importer" << std::endl;
+        return true;
+    }
+
+    // Mesh count, then every mesh as written by Mesh::WriteGeometry. Textures are cooked
+    // on their own, the model only keeps their paths
+    const std::string Directory = filename.substr(0, filename.find_last_of('/'));
+    std::ofstream Out;
+    if (!CookedFile::OpenWrite(filename, COOKED_MODEL_EXTENSION, COOKED_MODEL_MAGIC, Out)) {
+        return false;
+    }
+    CookedFile::Write(Out, Scene->mNumMeshes);
     for(unsigned MeshIdx = 0; MeshIdx < Scene->mNumMeshes; ++MeshIdx) {
         aiMesh* CurrAIMesh = Scene->mMeshes[MeshIdx];
-        Mesh CurrMesh(CurrAIMesh, Scene->mMaterials[CurrAIMesh->mMaterialIndex], mDirectory);
-        mMeshes.push_back(CurrMesh);
+        MeshGeometry Geometry = Mesh::ProcessGeometry(CurrAIMesh, Scene->mMaterials[CurrAIMesh->mMaterialIndex], Directory, 0, false);
+        Mesh::WriteGeometry(Out, Geometry);
+    }
+    return (bool)Out;
+}
 
+bool
+Model::loadCooked(JobSystem* jobs, bool keepGeometry) {
+    CookedReader Reader;
+    if (!CookedFile::OpenRead(mFilename, COOKED_MODEL_EXTENSION, COOKED_MODEL_MAGIC, Reader)) {
+        return false;
     }
-    std::cout << mFilename << " Loaded " << mMeshes.size() << " meshes" << std::endl;
+
+    unsigned MeshCount = 0;
+    if (!Reader.Read(MeshCount)) {
+        return false;
+    }
+    std::vector<MeshGeometry> Geometries(MeshCount);
+    for(MeshGeometry& Geometry : Geometries) {
+        if (!Mesh::ReadGeometry(Reader, Geometry)) {
+            std::cerr << "[Err] Malformed cooked model of " << mFilename << ", importing the source" << std::endl;
+            return false;
+        }
+    }
+
+    // Geometry is ready as read, only the textures still need decoding. Their reads are queued
+    // together, so the decode jobs mostly find their files already in memory
+    std::vector<std::string> TexturePaths;
+    for(const MeshGeometry& Geometry : Geometries) {
+        if (!Geometry.DiffusePath.empty()) {
+            TexturePaths.push_back(Geometry.DiffusePath);
+        }
+        if (!Geometry.SpecularPath.empty()) {
+            TexturePaths.push_back(Geometry.SpecularPath);
+        }
+    }
+    CookedFile::Prefetch(TexturePaths, COOKED_TEXTURE_EXTENSION);
+    auto DecodeMeshTextures = [&Geometries](unsigned begin, unsigned end) {
+        for(unsigned MeshIdx = begin; MeshIdx < end; ++MeshIdx) {
+            Mesh::DecodeTextures(Geometries[MeshIdx]);
+        }
+    };
+    if (jobs) {
+        jobs->ParallelFor(MeshCount, 1, DecodeMeshTextures);
+    } else {
+        DecodeMeshTextures(0, MeshCount);
+    }
+
+    mMeshes.reserve(MeshCount);
+    for(unsigned MeshIdx = 0; MeshIdx < MeshCount; ++MeshIdx) {
+        mMeshes.emplace_back(std::move(Geometries[MeshIdx]), mDirectory, keepGeometry);
+    }
+    std::cout << mFilename << " Loaded " << mMeshes.size() << " cooked meshes" << std::endl;
     return true;
 }
 
@@ -32,3 +140,67 @@ Model::Render() {
         mMeshes[MeshIdx].Render();
     }
 }
+
+void
+Model::Render(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& cameraPosition, JobSystem* jobs) {
+    Cull(viewProjection, model, cameraPosition, jobs);
+    RenderCulled();
+}
+
+void
+Model::Cull(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& cameraPosition, JobSystem* jobs) {
+    // Culling happens in object space so meshlet bounds never need transforming
+    Frustum ObjectFrustum = Frustum::FromMatrix(viewProjection * model);
+    glm::vec3 ObjectCameraPosition = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+    auto CullMeshes = [this, &ObjectFrustum, &ObjectCameraPosition](unsigned begin, unsigned end) {
+        for(unsigned MeshIdx = begin; MeshIdx < end; ++MeshIdx) {
+            mMeshes[MeshIdx].Cull(ObjectFrustum, ObjectCameraPosition);
+        }
+    };
+    if (jobs) {
+        jobs->ParallelFor(mMeshes.size(), 1, CullMeshes);
+    } else {
+        CullMeshes(0, mMeshes.size());
+    }
+}
+
+void
+Model::RenderCulled(bool depthOnly) {
+    // Draw calls stay on this thread, it owns the GL context
+    for(unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        mMeshes[MeshIdx].RenderCulled(depthOnly);
+    }
+}
+
+bool
+Model::GetBounds(glm::vec3& min, glm::vec3& max) const {
+    bool Found = false;
+    for(const Mesh& CurrMesh : mMeshes) {
+        glm::vec3 MeshMin;
+        glm::vec3 MeshMax;
+        if (!CurrMesh.GetBounds(MeshMin, MeshMax)) {
+            continue;
+        }
+        min = Found ? glm::min(min, MeshMin) : MeshMin;
+        max = Found ? glm::max(max, MeshMax) : MeshMax;
+        Found = true;
+    }
+    return Found;
+}
+
+void
+Model::RenderInstanced(unsigned instanceCount) {
+    for(unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        mMeshes[MeshIdx].RenderInstanced(instanceCount);
+    }
+}
+
+const Skeleton&
+Model::GetSkeleton() const {
+    return mSkeleton;
+}
+
+const std::vector<AnimationClip>&
+Model::GetClips() const {
+    return mClips;
+}
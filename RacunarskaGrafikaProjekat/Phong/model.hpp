@@ -10,6 +10,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "shader.hpp"
 #include "mesh.hpp"
+#include "job_system.hpp"
+#include "animation.hpp"
 
 #define POSITION_LOCATION 0
 #define NORMAL_LOCATION 1
@@ -30,6 +32,19 @@ enum EBufferType {
 class Model {
 private:
     std::vector<Mesh> mMeshes;
+    // Empty for models without bones
+    Skeleton mSkeleton;
+    std::vector<AnimationClip> mClips;
+
+    /**
+     * @brief Loads meshes from the cooked model if there is a current one
+     *
+     * @param jobs - Optional job system textures are decoded on
+     * @param keepGeometry - Meshes keep their vertices and indices in RAM
+     *
+     * @returns false if the source has to be imported
+     */
+    bool loadCooked(JobSystem* jobs, bool keepGeometry);
 
 public:
     std::string mFilename;
@@ -43,12 +58,32 @@ public:
      */
     Model(std::string filename);
 
+    // Meshes own GL objects, a model can be moved but not copied
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    Model(Model&&) = default;
+    Model& operator=(Model&&) = default;
+
     /**
-     * @brief Loads all the meshes and model data
+     * @brief Loads all the meshes and model data. A current cooked model skips the import and geometry processing.
+     * Loading again replaces the meshes and frees their GL objects
+     *
+     * @param jobs - Optional job system. Geometry processing and texture decoding run on it, one job per mesh
+     * @param keepGeometry - Meshes keep their vertices and indices in RAM after upload, e.g. for collision
      *
      * @returns true - Success, false - Failure
      */
-    bool Load();
+    bool Load(JobSystem* jobs = 0, bool keepGeometry = false);
+
+    /**
+     * @brief Imports a model and writes its processed meshes as a cooked model Load reads instead.
+     * Rigged models are left to the importer, their skeleton and clips aren't cooked. Doesn't touch OpenGL
+     *
+     * @param filename - Model path
+     *
+     * @returns true - Success, false - Failure
+     */
+    static bool Cook(const std::string& filename);
 
     /**
      * @brief Renderable Render implementation
@@ -56,6 +91,65 @@ public:
      */
     void Render();
 
+    /**
+     * @brief Renders the model with per-meshlet frustum and back-face cone culling
+     *
+     * @param viewProjection - Projection * View matrix
+     * @param model - Model matrix. Should only contain translation, rotation and uniform scale
+     * @param cameraPosition - World space camera position
+     * @param jobs - Optional job system meshes are culled on
+     *
+     */
+    void Render(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& cameraPosition, JobSystem* jobs = 0);
+
+    /**
+     * @brief Culls meshlets of all meshes and keeps the result for RenderCulled, so several passes
+     * can draw the same visible set
+     *
+     * @param viewProjection - Projection * View matrix
+     * @param model - Model matrix. Should only contain translation, rotation and uniform scale
+     * @param cameraPosition - World space camera position
+     * @param jobs - Optional job system meshes are culled on
+     *
+     */
+    void Cull(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& cameraPosition, JobSystem* jobs = 0);
+
+    /**
+     * @brief Renders meshlets kept by the last Cull call
+     *
+     * @param depthOnly - Position only vertex streams without textures, for the depth pre-pass
+     *
+     */
+    void RenderCulled(bool depthOnly = false);
+
+    /**
+     * @brief Computes the object space bounding box of all meshes
+     *
+     * @param min - Minimum corner
+     * @param max - Maximum corner
+     *
+     * @returns false if the model has no vertices
+     */
+    bool GetBounds(glm::vec3& min, glm::vec3& max) const;
+
+    /**
+     * @brief Renders several instances of all meshes. Skinned meshes read the bones of each instance
+     *
+     * @param instanceCount - Number of instances
+     *
+     */
+    void RenderInstanced(unsigned instanceCount);
+
+    /**
+     * @brief Returns the skeleton, empty if the model has no bones
+     */
+    const Skeleton& GetSkeleton() const;
+
+    /**
+     * @brief Returns animation clips imported with the model
+     */
+    const std::vector<AnimationClip>& GetClips() const;
+
 };
 
 #define MESH_HP
@@ -0,0 +1,149 @@
+#include "model_impostor.hpp"
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include "model.hpp"
+#include "memory_accounting.hpp"
+
+// Frames are sampled with mipmaps down to 8x8 texels, smaller levels would bleed between frames
+static const int MAX_MIP_LEVEL = 4;
+
+/**
+ * @brief Direction of an octahedral map point, same as octahedronDirection in model_impostor.vert
+ *
+ * @param uv Point on the map in [-1, 1]. Upper hemisphere in the inner diamond, lower one folded into the corners
+ *
+ * @returns Normalized direction
+ */
+static glm::vec3
+octahedronDirection(const glm::vec2& uv) {
+    glm::vec3 Direction(uv.x, 1.0f - std::fabs(uv.x) - std::fabs(uv.y), uv.y);
+    if (Direction.y < 0.0f) {
+        float X = (1.0f - std::fabs(Direction.z)) * (Direction.x >= 0.0f ? 1.0f : -1.0f);
+        float Z = (1.0f - std::fabs(Direction.x)) * (Direction.z >= 0.0f ? 1.0f : -1.0f);
+        Direction.x = X;
+        Direction.z = Z;
+    }
+    return glm::normalize(Direction);
+}
+
+/**
+ * @brief Up vector of the frame seen from a direction, same as frameUp in model_impostor.vert
+ */
+static glm::vec3
+frameUp(const glm::vec3& direction) {
+    return std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+ModelImpostor::ModelImpostor(Model& model) {
+    mCenter = glm::vec3(0.0f);
+    mRadius = 1.0f;
+    glm::vec3 Min;
+    glm::vec3 Max;
+    if (model.GetBounds(Min, Max)) {
+        mCenter = (Min + Max) * 0.5f;
+        mRadius = glm::length(Max - Min) * 0.5f;
+    } else {
+        std::cerr << "[Err] Impostor of " << model.mFilename << " baked from an empty model" << std::endl;
+    }
+
+    mVAO = GLVertexArray::Create();
+    bake(model);
+}
+
+bool
+ModelImpostor::IsFar(const glm::mat4& model, const glm::vec3& cameraPosition) const {
+    glm::vec3 WorldCenter = glm::vec3(model * glm::vec4(mCenter, 1.0f));
+    float WorldRadius = mRadius * glm::length(glm::vec3(model[0]));
+    return glm::length(cameraPosition - WorldCenter) > WorldRadius * MODEL_IMPOSTOR_DISTANCE_RADII;
+}
+
+void
+ModelImpostor::Render(const Shader& shader, const glm::mat4& model) const {
+    shader.SetModel(model);
+    shader.SetUniform3f("uImpostorCenter", mCenter);
+    shader.SetUniform1f("uImpostorRadius", mRadius);
+    shader.SetUniform1i("uAlbedoAtlas", 3);
+    shader.SetUniform1i("uNormalDepthAtlas", 4);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, mAlbedoAtlas.Get());
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, mNormalDepthAtlas.Get());
+
+    glBindVertexArray(mVAO.Get());
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void
+ModelImpostor::bake(Model& model) {
+    const unsigned AtlasSize = MODEL_IMPOSTOR_FRAMES * MODEL_IMPOSTOR_FRAME_SIZE;
+    GLTexture* const Atlases[] = { &mAlbedoAtlas, &mNormalDepthAtlas };
+    for (GLTexture* Atlas : Atlases) {
+        *Atlas = GLTexture::Create();
+        glBindTexture(GL_TEXTURE_2D, Atlas->Get());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, AtlasSize, AtlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        // Only levels up to MAX_MIP_LEVEL are generated, the full chain is close enough
+        MemoryAccounting::Track(MEMORY_TEXTURE, Atlas->Get(), "Impostor atlas of " + model.mFilename, MemoryAccounting::GetTextureSize(AtlasSize, AtlasSize, 1, 4, true));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MAX_MIP_LEVEL);
+    }
+
+    GLFramebuffer Framebuffer = GLFramebuffer::Create();
+    unsigned DepthBuffer;
+    glGenRenderbuffers(1, &DepthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, DepthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, AtlasSize, AtlasSize);
+    glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer.Get());
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, DepthBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mAlbedoAtlas.Get(), 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, mNormalDepthAtlas.Get(), 0);
+    const GLenum DrawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, DrawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "[Err] Impostor framebuffer of " << model.mFilename << " is incomplete" << std::endl;
+    }
+
+    GLint Viewport[4];
+    glGetIntegerv(GL_VIEWPORT, Viewport);
+    const float Clear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glViewport(0, 0, AtlasSize, AtlasSize);
+    glClearBufferfv(GL_COLOR, 0, Clear);
+    glClearBufferfv(GL_COLOR, 1, Clear);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // Bakes in object space. Meshes bind their own diffuse texture to unit 0
+    Shader BakeShader("shaders/model_impostor_bake.vert", "shaders/model_impostor_bake.frag");
+    glUseProgram(BakeShader.GetId());
+    BakeShader.SetUniform1i("uDiffuse", 0);
+    // Depth 0 is one radius in front of the center and 1 one radius behind, see model_impostor.frag
+    BakeShader.SetProjection(glm::ortho(-mRadius, mRadius, -mRadius, mRadius, 0.0f, 2.0f * mRadius));
+    for (unsigned FrameY = 0; FrameY < MODEL_IMPOSTOR_FRAMES; ++FrameY) {
+        for (unsigned FrameX = 0; FrameX < MODEL_IMPOSTOR_FRAMES; ++FrameX) {
+            // Frame centers sit on the grid points, so the outer frames see straight down the seams of the map
+            glm::vec2 MapPoint = glm::vec2(FrameX, FrameY) / (float)(MODEL_IMPOSTOR_FRAMES - 1) * 2.0f - 1.0f;
+            glm::vec3 Direction = octahedronDirection(MapPoint);
+            BakeShader.SetView(glm::lookAt(mCenter + Direction * mRadius, mCenter, frameUp(Direction)));
+            glViewport(FrameX * MODEL_IMPOSTOR_FRAME_SIZE, FrameY * MODEL_IMPOSTOR_FRAME_SIZE, MODEL_IMPOSTOR_FRAME_SIZE, MODEL_IMPOSTOR_FRAME_SIZE);
+            model.Render();
+        }
+    }
+
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &DepthBuffer);
+    glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+
+    for (GLTexture* Atlas : Atlases) {
+        glBindTexture(GL_TEXTURE_2D, Atlas->Get());
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "gl_handle.hpp"
+
+class Model;
+
+// Frames per atlas side. Frame directions cover the whole sphere through an octahedral map
+#define MODEL_IMPOSTOR_FRAMES 12
+// Texels per frame side
+#define MODEL_IMPOSTOR_FRAME_SIZE 128
+// Models further away than this many bounding radii are drawn as impostors
+#define MODEL_IMPOSTOR_DISTANCE_RADII 40.0f
+
+/**
+ * @brief Two triangle stand-in for a model far away. At construction the model is rendered
+ * from MODEL_IMPOSTOR_FRAMES^2 directions spread over an octahedron into one atlas of color and
+ * one of object space normal and depth. At runtime a camera facing quad blends the four frames
+ * closest to the view direction, is lit from the baked normals and writes the baked depth, so it
+ * intersects the scene like the model would
+ */
+class ModelImpostor {
+public:
+    /**
+     * @brief Ctor - bakes the atlases. The model has to be loaded
+     *
+     * @param model Model to bake, only read during construction
+     */
+    ModelImpostor(Model& model);
+
+    ModelImpostor(const ModelImpostor&) = delete;
+    ModelImpostor& operator=(const ModelImpostor&) = delete;
+
+    /**
+     * @brief Returns true if the model is far enough from the camera to be drawn by Render
+     *
+     * @param model Model matrix. Should only contain translation, rotation and uniform scale
+     * @param cameraPosition World space camera position
+     */
+    bool IsFar(const glm::mat4& model, const glm::vec3& cameraPosition) const;
+
+    /**
+     * @brief Draws the impostor. The shader has to be bound and use model_impostor.vert and model_impostor.frag
+     *
+     * @param shader Impostor shader
+     * @param model Model matrix. Should only contain translation, rotation and uniform scale
+     */
+    void Render(const Shader& shader, const glm::mat4& model) const;
+
+private:
+    // Object space bounding sphere the frames are fitted to
+    glm::vec3 mCenter;
+    float mRadius;
+    GLTexture mAlbedoAtlas;
+    GLTexture mNormalDepthAtlas;
+    // Quad corners come from gl_VertexID, core profile still needs a VAO bound
+    GLVertexArray mVAO;
+
+    void bake(Model& model);
+};
@@ -0,0 +1,132 @@
+#include "noise.hpp"
+#include <cmath>
+
+// Lattice values keep 24 bits of the hash, the float mantissa holds them exactly
+static const float HASH_TO_UNIT = 1.0f / 16777216.0f;
+
+#if SIMD_SSE
+/**
+ * @brief 32 bit multiply keeping the low halves, SSE2 only has the 64 bit one
+ */
+static inline __m128i
+mulLo32(__m128i a, __m128i b) {
+    __m128i Even = _mm_mul_epu32(a, b);
+    __m128i Odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(Even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(Odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/**
+ * @brief Same as Noise::Hash for four lattice points, returns the lattice values in [0, 1)
+ */
+static inline __m128
+hashToUnit(__m128i x, __m128i z, __m128i seed) {
+    __m128i Hash = _mm_xor_si128(_mm_xor_si128(mulLo32(x, _mm_set1_epi32(0x27d4eb2d)), mulLo32(z, _mm_set1_epi32(0x165667b1))), seed);
+    Hash = _mm_xor_si128(Hash, _mm_srli_epi32(Hash, 15));
+    Hash = mulLo32(Hash, _mm_set1_epi32(0x2c1b3c6d));
+    Hash = _mm_xor_si128(Hash, _mm_srli_epi32(Hash, 12));
+    Hash = mulLo32(Hash, _mm_set1_epi32(0x297a2d39));
+    Hash = _mm_xor_si128(Hash, _mm_srli_epi32(Hash, 15));
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(Hash, 8)), _mm_set1_ps(HASH_TO_UNIT));
+}
+
+/**
+ * @brief Noise::Value for four points
+ */
+static inline __m128
+valueNoise4(__m128 x, __m128 z, __m128i seed) {
+    // Truncation rounds negative coordinates up, step those back down to get floor
+    __m128i X0 = _mm_cvttps_epi32(x);
+    __m128i Z0 = _mm_cvttps_epi32(z);
+    X0 = _mm_add_epi32(X0, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(X0))));
+    Z0 = _mm_add_epi32(Z0, _mm_castps_si128(_mm_cmplt_ps(z, _mm_cvtepi32_ps(Z0))));
+    __m128 FX = _mm_sub_ps(x, _mm_cvtepi32_ps(X0));
+    __m128 FZ = _mm_sub_ps(z, _mm_cvtepi32_ps(Z0));
+    __m128 Three = _mm_set1_ps(3.0f);
+    __m128 Two = _mm_set1_ps(2.0f);
+    __m128 U = _mm_mul_ps(_mm_mul_ps(FX, FX), _mm_sub_ps(Three, _mm_mul_ps(Two, FX)));
+    __m128 W = _mm_mul_ps(_mm_mul_ps(FZ, FZ), _mm_sub_ps(Three, _mm_mul_ps(Two, FZ)));
+
+    __m128i One = _mm_set1_epi32(1);
+    __m128i X1 = _mm_add_epi32(X0, One);
+    __m128i Z1 = _mm_add_epi32(Z0, One);
+    __m128 H00 = hashToUnit(X0, Z0, seed);
+    __m128 H10 = hashToUnit(X1, Z0, seed);
+    __m128 H01 = hashToUnit(X0, Z1, seed);
+    __m128 H11 = hashToUnit(X1, Z1, seed);
+    __m128 Near = _mm_add_ps(H00, _mm_mul_ps(_mm_sub_ps(H10, H00), U));
+    __m128 Far = _mm_add_ps(H01, _mm_mul_ps(_mm_sub_ps(H11, H01), U));
+    return _mm_add_ps(Near, _mm_mul_ps(_mm_sub_ps(Far, Near), W));
+}
+#endif
+
+unsigned
+Noise::Hash(int x, int z, unsigned seed) {
+    unsigned Hash = ((unsigned)x * 0x27d4eb2du) ^ ((unsigned)z * 0x165667b1u) ^ seed;
+    Hash ^= Hash >> 15;
+    Hash *= 0x2c1b3c6du;
+    Hash ^= Hash >> 12;
+    Hash *= 0x297a2d39u;
+    Hash ^= Hash >> 15;
+    return Hash;
+}
+
+float
+Noise::Value(float x, float z, unsigned seed) {
+    float FloorX = std::floor(x);
+    float FloorZ = std::floor(z);
+    int X0 = (int)FloorX;
+    int Z0 = (int)FloorZ;
+    float FX = x - FloorX;
+    float FZ = z - FloorZ;
+    float U = FX * FX * (3.0f - 2.0f * FX);
+    float W = FZ * FZ * (3.0f - 2.0f * FZ);
+
+    float H00 = (Hash(X0, Z0, seed) >> 8) * HASH_TO_UNIT;
+    float H10 = (Hash(X0 + 1, Z0, seed) >> 8) * HASH_TO_UNIT;
+    float H01 = (Hash(X0, Z0 + 1, seed) >> 8) * HASH_TO_UNIT;
+    float H11 = (Hash(X0 + 1, Z0 + 1, seed) >> 8) * HASH_TO_UNIT;
+    float Near = H00 + (H10 - H00) * U;
+    float Far = H01 + (H11 - H01) * U;
+    return Near + (Far - Near) * W;
+}
+
+void
+Noise::Fractal(const float* x, const float* z, float* out, unsigned count, float frequency, unsigned octaves, unsigned seed) {
+    float AmplitudeSum = 0.0f;
+    float Amplitude = 1.0f;
+    for (unsigned Octave = 0; Octave < octaves; ++Octave) {
+        AmplitudeSum += Amplitude;
+        Amplitude *= 0.5f;
+    }
+    const float Normalize = 1.0f / AmplitudeSum;
+
+#if SIMD_SSE
+    for (unsigned Idx = 0; Idx < count; Idx += SIMD_WIDTH) {
+        __m128 X = _mm_loadu_ps(x + Idx);
+        __m128 Z = _mm_loadu_ps(z + Idx);
+        __m128 Sum = _mm_setzero_ps();
+        float OctaveFrequency = frequency;
+        float OctaveAmplitude = Normalize;
+        for (unsigned Octave = 0; Octave < octaves; ++Octave) {
+            __m128 Frequency = _mm_set1_ps(OctaveFrequency);
+            __m128 Value = valueNoise4(_mm_mul_ps(X, Frequency), _mm_mul_ps(Z, Frequency), _mm_set1_epi32(seed + Octave));
+            Sum = _mm_add_ps(Sum, _mm_mul_ps(Value, _mm_set1_ps(OctaveAmplitude)));
+            OctaveFrequency *= 2.0f;
+            OctaveAmplitude *= 0.5f;
+        }
+        _mm_storeu_ps(out + Idx, Sum);
+    }
+#else
+    for (unsigned Idx = 0; Idx < count; ++Idx) {
+        float Sum = 0.0f;
+        float OctaveFrequency = frequency;
+        float OctaveAmplitude = Normalize;
+        for (unsigned Octave = 0; Octave < octaves; ++Octave) {
+            Sum += Value(x[Idx] * OctaveFrequency, z[Idx] * OctaveFrequency, seed + Octave) * OctaveAmplitude;
+            OctaveFrequency *= 2.0f;
+            OctaveAmplitude *= 0.5f;
+        }
+        out[Idx] = Sum;
+    }
+#endif
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "simd.hpp"
+
+/**
+ * @brief Hash based 2D value noise. Lattice values come from an integer hash instead of a
+ * permutation table, so SIMD_WIDTH samples are evaluated together without gathers and the
+ * same coordinates give the same value on any thread
+ */
+class Noise {
+public:
+    /**
+     * @brief Hashes lattice coordinates
+     *
+     * @param x Lattice X
+     * @param z Lattice Z
+     * @param seed Noise seed
+     *
+     * @returns 32 bit hash
+     */
+    static unsigned Hash(int x, int z, unsigned seed);
+
+    /**
+     * @brief Samples value noise, smoothly interpolated between lattice points
+     *
+     * @param x Sample X, lattice spacing is 1
+     * @param z Sample Z
+     * @param seed Noise seed
+     *
+     * @returns Value in [0, 1)
+     */
+    static float Value(float x, float z, unsigned seed);
+
+    /**
+     * @brief Samples fractal (fBm) value noise for many points. Each octave doubles the frequency
+     * and halves the amplitude
+     *
+     * @param x Sample X coordinates
+     * @param z Sample Z coordinates
+     * @param out Output values in [0, 1)
+     * @param count Number of samples, multiple of SIMD_WIDTH
+     * @param frequency Lattice points per unit of the first octave
+     * @param octaves Number of octaves
+     * @param seed Noise seed, each octave uses the next one
+     */
+    static void Fractal(const float* x, const float* z, float* out, unsigned count, float frequency, unsigned octaves, unsigned seed);
+};
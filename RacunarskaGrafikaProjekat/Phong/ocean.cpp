@@ -0,0 +1,242 @@
+#include "ocean.hpp"
+#include <chrono>
+#include <cmath>
+#include "memory_accounting.hpp"
+
+// World units per repeat of the ocean textures
+static const float OCEAN_TEXTURE_SCALE = 10.0f;
+
+Ocean::Ocean(float cellSize, float height) {
+    mCellSize = cellSize;
+    mHeight = height;
+    mCenter = glm::vec2(0.0f);
+    mSpectrum = 0;
+    mSpectrumBufferIdx = 0;
+    mSpectrumUpdating = false;
+    mSpectrumMilliseconds = 0.0f;
+
+    // Direction, steepness and wavelength. Steepness values have to sum below 1, otherwise crests loop over.
+    // Amplitude is steepness * wavelength / 2PI, about 0.45 for all waves together
+    mWaves[0] = glm::vec4(glm::normalize(glm::vec2(1.0f, 0.6f)), 0.05f, 24.0f);
+    mWaves[1] = glm::vec4(glm::normalize(glm::vec2(0.7f, 1.0f)), 0.08f, 11.0f);
+    mWaves[2] = glm::vec4(glm::normalize(glm::vec2(-0.4f, 1.0f)), 0.1f, 5.0f);
+    mWaves[3] = glm::vec4(glm::normalize(glm::vec2(1.0f, -0.3f)), 0.12f, 2.3f);
+
+    // Vertices are integer grid coordinates centered on the origin, two shorts each
+    const int HalfSize = OCEAN_GRID_SIZE / 2;
+    std::vector<short> Grid;
+    Grid.reserve((OCEAN_GRID_SIZE + 1) * (OCEAN_GRID_SIZE + 1) * 2);
+    for (int Z = -HalfSize; Z <= HalfSize; ++Z) {
+        for (int X = -HalfSize; X <= HalfSize; ++X) {
+            Grid.push_back((short)X);
+            Grid.push_back((short)Z);
+        }
+    }
+
+    std::vector<unsigned> Indices;
+    for (unsigned Z = 0; Z < OCEAN_GRID_SIZE; ++Z) {
+        for (unsigned X = 0; X < OCEAN_GRID_SIZE; ++X) {
+            appendQuad(Indices, X, Z);
+        }
+    }
+    mFullIndexCount = Indices.size();
+
+    // Ring skips the middle half, which the previous level covers with cells half the size
+    const unsigned HoleBegin = OCEAN_GRID_SIZE / 4;
+    const unsigned HoleEnd = OCEAN_GRID_SIZE - OCEAN_GRID_SIZE / 4;
+    for (unsigned Z = 0; Z < OCEAN_GRID_SIZE; ++Z) {
+        for (unsigned X = 0; X < OCEAN_GRID_SIZE; ++X) {
+            if (X >= HoleBegin && X < HoleEnd && Z >= HoleBegin && Z < HoleEnd) {
+                continue;
+            }
+            appendQuad(Indices, X, Z);
+        }
+    }
+    mRingIndexCount = Indices.size() - mFullIndexCount;
+
+    mVAO = GLVertexArray::Create();
+    glBindVertexArray(mVAO.Get());
+    mVBO = GLBuffer::Create();
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO.Get());
+    glBufferData(GL_ARRAY_BUFFER, Grid.size() * sizeof(short), Grid.data(), GL_STATIC_DRAW);
+    MemoryAccounting::Track(MEMORY_MESH, mVBO.Get(), "Ocean grid", Grid.size() * sizeof(short));
+    glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, 2 * sizeof(short), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    mIndexBuffer.Upload(Indices, Grid.size() / 2);
+    glBindVertexArray(0);
+}
+
+void
+Ocean::Update(const glm::vec3& cameraPosition) {
+    // Snapping to the coarsest cell keeps every level on its own lattice, so vertices
+    // don't swim when the camera moves. Costs up to half a coarse cell of centering
+    float SnapSize = mCellSize * (1 << (OCEAN_LEVEL_COUNT - 1));
+    mCenter = glm::vec2(std::floor(cameraPosition.x / SnapSize + 0.5f), std::floor(cameraPosition.z / SnapSize + 0.5f)) * SnapSize;
+}
+
+void
+Ocean::SetSpectrum(OceanSpectrum* spectrum) {
+    if (mSpectrumUpdating) {
+        std::cerr << "[Err] Ocean spectrum can't change during an update" << std::endl;
+        return;
+    }
+    if (spectrum == mSpectrum) {
+        return;
+    }
+
+    mSpectrum = spectrum;
+    if (!mSpectrum) {
+        return;
+    }
+
+    // Float maps are filterable in GL 3.3, so the vertex shader can read them with mipmaps
+    unsigned Size = mSpectrum->GetSize();
+    allocateSpectrumMap(mDisplacementMap, Size, GL_RGB32F, GL_RGB, 3 * sizeof(float), "Ocean displacement");
+    allocateSpectrumMap(mSlopeMap, Size, GL_RG32F, GL_RG, 2 * sizeof(float), "Ocean slopes");
+
+    for (unsigned BufferIdx = 0; BufferIdx < 2; ++BufferIdx) {
+        if (!mSpectrumBuffers[BufferIdx].Get()) {
+            mSpectrumBuffers[BufferIdx] = GLBuffer::Create();
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mSpectrumBuffers[BufferIdx].Get());
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, Size * Size * 5 * sizeof(float), 0, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void
+Ocean::BeginSpectrumUpdate(float time, JobSystem& jobs) {
+    if (!mSpectrum || mSpectrumUpdating) {
+        return;
+    }
+
+    // Invalidating gives back fresh memory instead of waiting for the copy still reading the old contents
+    unsigned Size = mSpectrum->GetSize();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mSpectrumBuffers[mSpectrumBufferIdx].Get());
+    float* Displacement = (float*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, Size * Size * 5 * sizeof(float), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!Displacement) {
+        std::cerr << "[Err] Failed to map ocean spectrum buffer" << std::endl;
+        return;
+    }
+
+    // Workers write straight into the mapped buffer, so there is no extra copy before the upload
+    mSpectrumUpdating = true;
+    OceanSpectrum* Spectrum = mSpectrum;
+    float* Slopes = Displacement + Size * Size * 3;
+    JobSystem* Jobs = &jobs;
+    jobs.Run([this, Spectrum, time, Displacement, Slopes, Jobs]() {
+        std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+        Spectrum->Simulate(time, Displacement, Slopes, Jobs);
+        mSpectrumMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+    }, &mSpectrumCounter);
+}
+
+void
+Ocean::EndSpectrumUpdate(JobSystem& jobs) {
+    if (!mSpectrumUpdating) {
+        return;
+    }
+
+    jobs.Wait(mSpectrumCounter);
+    mSpectrumUpdating = false;
+    unsigned Size = mSpectrum->GetSize();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mSpectrumBuffers[mSpectrumBufferIdx].Get());
+    mSpectrumBufferIdx ^= 1;
+    // Contents can be lost on mode switches, the maps keep the previous tick then
+    if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+        std::cerr << "[Err] Ocean spectrum buffer was lost, skipping upload" << std::endl;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    // Offsets into the bound pixel buffer instead of client pointers, the copy doesn't block this thread
+    glActiveTexture(GL_TEXTURE0 + OCEAN_DISPLACEMENT_UNIT);
+    glBindTexture(GL_TEXTURE_2D, mDisplacementMap.Get());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Size, Size, GL_RGB, GL_FLOAT, (void*)0);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glActiveTexture(GL_TEXTURE0 + OCEAN_SLOPE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, mSlopeMap.Get());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Size, Size, GL_RG, GL_FLOAT, (void*)(Size * Size * 3 * sizeof(float)));
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glActiveTexture(GL_TEXTURE0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+float
+Ocean::GetSpectrumMilliseconds() const {
+    return mSpectrumMilliseconds;
+}
+
+void
+Ocean::Render(const Shader& shader, float time) const {
+    shader.SetUniform2f("uOceanCenter", mCenter);
+    shader.SetUniform1f("uOceanHeight", mHeight);
+    shader.SetUniform1f("uTime", time);
+    shader.SetUniform1f("uTextureScale", OCEAN_TEXTURE_SCALE);
+    shader.SetUniform4fv("uWaves", mWaves, OCEAN_WAVE_COUNT);
+    shader.SetUniform1i("uUseSpectrum", mSpectrum != 0);
+    if (mSpectrum) {
+        glActiveTexture(GL_TEXTURE0 + OCEAN_DISPLACEMENT_UNIT);
+        glBindTexture(GL_TEXTURE_2D, mDisplacementMap.Get());
+        glActiveTexture(GL_TEXTURE0 + OCEAN_SLOPE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, mSlopeMap.Get());
+        glActiveTexture(GL_TEXTURE0);
+        shader.SetUniform1i("uDisplacementMap", OCEAN_DISPLACEMENT_UNIT);
+        shader.SetUniform1i("uSlopeMap", OCEAN_SLOPE_UNIT);
+        shader.SetUniform1f("uSpectrumPatchSize", mSpectrum->GetPatchSize());
+        shader.SetUniform1f("uSpectrumTexelSize", mSpectrum->GetPatchSize() / mSpectrum->GetSize());
+    }
+
+    glBindVertexArray(mVAO.Get());
+    for (unsigned Level = 0; Level < OCEAN_LEVEL_COUNT; ++Level) {
+        float CellSize = mCellSize * (1 << Level);
+        shader.SetUniform1f("uCellSize", CellSize);
+        shader.SetUniform1f("uLevelExtent", CellSize * OCEAN_GRID_SIZE / 2);
+        if (Level == 0) {
+            mIndexBuffer.DrawRange(GL_TRIANGLES, 0, mFullIndexCount);
+        } else {
+            mIndexBuffer.DrawRange(GL_TRIANGLES, mFullIndexCount, mRingIndexCount);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+unsigned
+Ocean::GetTriangleCount() const {
+    return (mFullIndexCount + mRingIndexCount * (OCEAN_LEVEL_COUNT - 1)) / 3;
+}
+
+float
+Ocean::GetExtent() const {
+    return mCellSize * (1 << (OCEAN_LEVEL_COUNT - 1)) * OCEAN_GRID_SIZE / 2;
+}
+
+void
+Ocean::appendQuad(std::vector<unsigned>& indices, unsigned x, unsigned z) {
+    const unsigned RowSize = OCEAN_GRID_SIZE + 1;
+    unsigned V00 = z * RowSize + x;
+    unsigned V10 = V00 + 1;
+    unsigned V01 = V00 + RowSize;
+    unsigned V11 = V01 + 1;
+    // Counter clockwise seen from above
+    unsigned Quad[6] = { V00, V01, V10, V10, V01, V11 };
+    indices.insert(indices.end(), Quad, Quad + 6);
+}
+
+void
+Ocean::allocateSpectrumMap(GLTexture& texture, unsigned size, GLenum internalFormat, GLenum format, unsigned texelSize, const char* name) {
+    if (!texture.Get()) {
+        texture = GLTexture::Create();
+    }
+    glBindTexture(GL_TEXTURE_2D, texture.Get());
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0, format, GL_FLOAT, NULL);
+    MemoryAccounting::Track(MEMORY_TEXTURE, texture.Get(), name, MemoryAccounting::GetTextureSize(size, size, 1, texelSize, true));
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "index_buffer.hpp"
+#include "gl_handle.hpp"
+#include "ocean_spectrum.hpp"
+#include "job_system.hpp"
+
+// Grid cells per level side, has to be a multiple of 4 so the ring hole is whole cells
+#define OCEAN_GRID_SIZE 128
+// Level 0 is a full grid, each next level is a ring around it with twice the cell size
+#define OCEAN_LEVEL_COUNT 5
+#define OCEAN_WAVE_COUNT 4
+// Texture units of the spectrum maps, after the material textures and the diffuse array
+#define OCEAN_DISPLACEMENT_UNIT 3
+#define OCEAN_SLOPE_UNIT 4
+
+/**
+ * @brief Ocean surface as a geometry clipmap: nested square grids centered on the camera,
+ * each level doubling the cell size of the previous. Vertex density falls off with distance
+ * so the triangle count doesn't depend on how far the ocean reaches.
+ * All levels share one vertex buffer of integer grid coordinates, the vertex shader
+ * (ocean.vert) scales them per level and displaces them with a sum of Gerstner waves,
+ * or with displacement and slope maps from an OceanSpectrum when one is set
+ */
+class Ocean {
+public:
+    /**
+     * @brief Ctor - builds the level grids
+     *
+     * @param cellSize Cell size of the finest level
+     * @param height Rest height of the water surface
+     */
+    Ocean(float cellSize, float height);
+
+    /**
+     * @brief Moves the clipmap under the camera
+     *
+     * @param cameraPosition World space camera position
+     */
+    void Update(const glm::vec3& cameraPosition);
+
+    /**
+     * @brief Switches between the FFT spectrum and the Gerstner waves. Spectrum maps are created
+     * the first time a spectrum is set
+     *
+     * @param spectrum Spectrum to simulate, has to outlive the ocean. 0 goes back to Gerstner waves.
+     * Can't be called between BeginSpectrumUpdate and EndSpectrumUpdate
+     */
+    void SetSpectrum(OceanSpectrum* spectrum);
+
+    /**
+     * @brief Maps the next pixel buffer and starts simulating the spectrum into it on the job system.
+     * Does nothing without a spectrum. Other work can run until EndSpectrumUpdate
+     *
+     * @param time Wave animation time in seconds
+     * @param jobs Job system running the simulation
+     */
+    void BeginSpectrumUpdate(float time, JobSystem& jobs);
+
+    /**
+     * @brief Waits for the simulation started by BeginSpectrumUpdate and copies the pixel buffer
+     * into the spectrum maps. The copy runs on the GPU, this call doesn't wait for it
+     *
+     * @param jobs Job system running the simulation, this thread helps it while waiting
+     */
+    void EndSpectrumUpdate(JobSystem& jobs);
+
+    /**
+     * @brief Returns how long the last spectrum simulation took on the job system
+     */
+    float GetSpectrumMilliseconds() const;
+
+    /**
+     * @brief Sets ocean uniforms and draws all levels, finest first. The shader has to be bound
+     * and use ocean.vert
+     *
+     * @param shader Ocean shader, lit or depth only
+     * @param time Wave animation time in seconds
+     */
+    void Render(const Shader& shader, float time) const;
+
+    /**
+     * @brief Returns number of triangles drawn by Render
+     */
+    unsigned GetTriangleCount() const;
+
+    /**
+     * @brief Returns half the side of the area covered by the ocean
+     */
+    float GetExtent() const;
+
+private:
+    GLVertexArray mVAO;
+    GLBuffer mVBO;
+    // Full level 0 grid followed by the ring used by all other levels
+    IndexBuffer mIndexBuffer;
+    unsigned mFullIndexCount;
+    unsigned mRingIndexCount;
+    float mCellSize;
+    float mHeight;
+    glm::vec2 mCenter;
+    glm::vec4 mWaves[OCEAN_WAVE_COUNT];
+
+    OceanSpectrum* mSpectrum;
+    GLTexture mDisplacementMap;
+    GLTexture mSlopeMap;
+    // Simulation writes into one pixel buffer while the GPU may still be reading the other
+    GLBuffer mSpectrumBuffers[2];
+    unsigned mSpectrumBufferIdx;
+    bool mSpectrumUpdating;
+    JobCounter mSpectrumCounter;
+    float mSpectrumMilliseconds;
+
+    static void appendQuad(std::vector<unsigned>& indices, unsigned x, unsigned z);
+    static void allocateSpectrumMap(GLTexture& texture, unsigned size, GLenum internalFormat, GLenum format, unsigned texelSize, const char* name);
+};
@@ -0,0 +1,263 @@
+#include "ocean_spectrum.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+static const float GRAVITY = 9.81f;
+static const double TWO_PI = 6.283185307179586;
+// Waves travelling against the wind keep this much of their energy
+static const float OPPOSING_WAVE_FACTOR = 0.07f;
+// Waves shorter than this fraction of the largest wind wave are damped out
+static const float SMALL_WAVE_FRACTION = 0.001f;
+
+/**
+ * @brief Checks the spectrum grid size and replaces an unsupported one with the nearest supported power of two
+ *
+ * @param size Requested grid side
+ *
+ * @returns Usable grid side
+ */
+static unsigned
+spectrumSize(unsigned size) {
+    unsigned Valid = FFT_COLUMN_BLOCK;
+    while (Valid < size && Valid < 1024) {
+        Valid <<= 1;
+    }
+    if (Valid != size) {
+        std::cerr << "[Err] Ocean spectrum size " << size << " isn't a power of two between " << FFT_COLUMN_BLOCK << " and 1024, using " << Valid << std::endl;
+    }
+    return Valid;
+}
+
+OceanSpectrum::OceanSpectrum(unsigned size, float patchSize, const glm::vec2& wind, float rmsHeight, float choppiness)
+    : mSize(spectrumSize(size)), mFFT(mSize) {
+    mPatchSize = patchSize;
+    mChoppiness = choppiness;
+    const unsigned Count = mSize * mSize;
+    mH0Real.resize(Count);
+    mH0Imaginary.resize(Count);
+    mH0ConjugateReal.resize(Count);
+    mH0ConjugateImaginary.resize(Count);
+    mFrequency.resize(Count);
+    for (unsigned Field = 0; Field < OCEAN_SPECTRUM_FIELD_COUNT; ++Field) {
+        mFieldReal[Field].resize(Count);
+        mFieldImaginary[Field].resize(Count);
+    }
+
+    // Phillips spectrum, amplitude is normalized below so only its shape matters here
+    float WindSpeed = glm::length(wind);
+    glm::vec2 WindDirection = WindSpeed > 0.0f ? wind / WindSpeed : glm::vec2(1.0f, 0.0f);
+    float LargestWave = std::max(WindSpeed * WindSpeed / GRAVITY, 1e-3f);
+    float SmallestWave = LargestWave * SMALL_WAVE_FRACTION;
+    std::mt19937 Random(1234);
+    std::normal_distribution<float> Gaussian(0.0f, 1.0f);
+    double Energy = 0.0;
+    for (unsigned Row = 0; Row < mSize; ++Row) {
+        for (unsigned Column = 0; Column < mSize; ++Column) {
+            unsigned Idx = Row * mSize + Column;
+            float RandomReal = Gaussian(Random);
+            float RandomImaginary = Gaussian(Random);
+            glm::vec2 K(getWaveNumber(Column), getWaveNumber(Row));
+            float KLength = glm::length(K);
+            mFrequency[Idx] = (unsigned short)(std::sqrt(GRAVITY * KLength) * OCEAN_SPECTRUM_REPEAT_TIME / TWO_PI + 0.5);
+            // Nyquist row and column have no mirrored wave, they would leak into the imaginary parts
+            if (KLength == 0.0f || !Row || !Column) {
+                mH0Real[Idx] = 0.0f;
+                mH0Imaginary[Idx] = 0.0f;
+                continue;
+            }
+
+            float KWind = glm::dot(K / KLength, WindDirection);
+            float Phillips = std::exp(-1.0f / (KLength * LargestWave * KLength * LargestWave)) / (KLength * KLength * KLength * KLength) * KWind * KWind;
+            Phillips *= std::exp(-KLength * KLength * SmallestWave * SmallestWave);
+            if (KWind < 0.0f) {
+                Phillips *= OPPOSING_WAVE_FACTOR;
+            }
+            float Amplitude = std::sqrt(Phillips * 0.5f);
+            mH0Real[Idx] = RandomReal * Amplitude;
+            mH0Imaginary[Idx] = RandomImaginary * Amplitude;
+            Energy += mH0Real[Idx] * mH0Real[Idx] + mH0Imaginary[Idx] * mH0Imaginary[Idx];
+        }
+    }
+
+    // Mean square height over time is the sum of |h0(k)|^2 + |h0(-k)|^2, twice the energy
+    float Scale = Energy > 0.0 ? (float)(rmsHeight / std::sqrt(2.0 * Energy)) : 0.0f;
+    for (unsigned Idx = 0; Idx < Count; ++Idx) {
+        mH0Real[Idx] *= Scale;
+        mH0Imaginary[Idx] *= Scale;
+    }
+    for (unsigned Row = 0; Row < mSize; ++Row) {
+        for (unsigned Column = 0; Column < mSize; ++Column) {
+            unsigned Idx = Row * mSize + Column;
+            unsigned Mirrored = ((mSize - Row) % mSize) * mSize + (mSize - Column) % mSize;
+            mH0ConjugateReal[Idx] = mH0Real[Mirrored];
+            mH0ConjugateImaginary[Idx] = -mH0Imaginary[Mirrored];
+        }
+    }
+    for (unsigned Idx = 0; Idx < Count; ++Idx) {
+        if (mFrequency[Idx] >= mPhaseReal.size()) {
+            mPhaseReal.resize(mFrequency[Idx] + 1);
+        }
+    }
+    mPhaseImaginary.resize(mPhaseReal.size());
+}
+
+void
+OceanSpectrum::Simulate(float time, float* displacement, float* slopes, JobSystem* jobs) {
+    // Frequencies are whole multiples of the base frequency, so a few hundred sin/cos pairs
+    // cover every wave and the motion loops seamlessly after OCEAN_SPECTRUM_REPEAT_TIME
+    double Time = std::fmod((double)time, (double)OCEAN_SPECTRUM_REPEAT_TIME);
+    double BaseFrequency = TWO_PI / OCEAN_SPECTRUM_REPEAT_TIME;
+    for (unsigned Multiple = 0; Multiple < mPhaseReal.size(); ++Multiple) {
+        double Phase = BaseFrequency * Multiple * Time;
+        mPhaseReal[Multiple] = (float)std::cos(Phase);
+        mPhaseImaginary[Multiple] = (float)std::sin(Phase);
+    }
+
+    float* Real[OCEAN_SPECTRUM_FIELD_COUNT];
+    float* Imaginary[OCEAN_SPECTRUM_FIELD_COUNT];
+    for (unsigned Field = 0; Field < OCEAN_SPECTRUM_FIELD_COUNT; ++Field) {
+        Real[Field] = mFieldReal[Field].data();
+        Imaginary[Field] = mFieldImaginary[Field].data();
+    }
+
+    if (jobs) {
+        jobs->ParallelFor(mSize, OCEAN_SPECTRUM_JOB_ROWS, [this](unsigned begin, unsigned end) {
+            evolveRows(begin, end);
+        });
+        mFFT.Inverse2D(Real, Imaginary, OCEAN_SPECTRUM_FIELD_COUNT, jobs);
+        jobs->ParallelFor(mSize, OCEAN_SPECTRUM_JOB_ROWS, [this, displacement, slopes](unsigned begin, unsigned end) {
+            packRows(begin, end, displacement, slopes);
+        });
+        return;
+    }
+
+    evolveRows(0, mSize);
+    mFFT.Inverse2D(Real, Imaginary, OCEAN_SPECTRUM_FIELD_COUNT);
+    packRows(0, mSize, displacement, slopes);
+}
+
+unsigned
+OceanSpectrum::GetSize() const {
+    return mSize;
+}
+
+float
+OceanSpectrum::GetPatchSize() const {
+    return mPatchSize;
+}
+
+float
+OceanSpectrum::getWaveNumber(unsigned idx) const {
+    return (float)(TWO_PI * ((int)idx - (int)mSize / 2) / mPatchSize);
+}
+
+void
+OceanSpectrum::evolveRows(unsigned begin, unsigned end) {
+    for (unsigned Row = begin; Row < end; ++Row) {
+        float KZ = getWaveNumber(Row);
+        for (unsigned Column = 0; Column < mSize; ++Column) {
+            unsigned Idx = Row * mSize + Column;
+            float KX = getWaveNumber(Column);
+            float KLength = std::sqrt(KX * KX + KZ * KZ);
+            float InverseK = KLength > 0.0f ? 1.0f / KLength : 0.0f;
+
+            // h(k, t) = h0(k) * e^(iwt) + conj(h0(-k)) * e^(-iwt)
+            float ERe = mPhaseReal[mFrequency[Idx]];
+            float EIm = mPhaseImaginary[mFrequency[Idx]];
+            float HRe = (mH0Real[Idx] + mH0ConjugateReal[Idx]) * ERe + (mH0ConjugateImaginary[Idx] - mH0Imaginary[Idx]) * EIm;
+            float HIm = (mH0Imaginary[Idx] + mH0ConjugateImaginary[Idx]) * ERe + (mH0Real[Idx] - mH0ConjugateReal[Idx]) * EIm;
+
+            // Displacement D = -i * k / |k| * h, slope S = i * k * h. Two real results share one
+            // transform as A + iB, since both spectra are hermitian their transforms come out real
+            float DXRe = KX * InverseK * HIm, DXIm = -KX * InverseK * HRe;
+            float DZRe = KZ * InverseK * HIm, DZIm = -KZ * InverseK * HRe;
+            mFieldReal[0][Idx] = DXRe - HIm;
+            mFieldImaginary[0][Idx] = DXIm + HRe;
+            mFieldReal[1][Idx] = DZRe - KX * HRe;
+            mFieldImaginary[1][Idx] = DZIm - KX * HIm;
+            mFieldReal[2][Idx] = -KZ * HIm;
+            mFieldImaginary[2][Idx] = KZ * HRe;
+        }
+    }
+}
+
+void
+OceanSpectrum::packRows(unsigned begin, unsigned end, float* displacement, float* slopes) const {
+    for (unsigned Row = begin; Row < end; ++Row) {
+        for (unsigned Column = 0; Column < mSize; ++Column) {
+            unsigned Idx = Row * mSize + Column;
+            // Wave numbers start at -size / 2 instead of 0, which flips the sign of every other sample
+            float Sign = (Row + Column) & 1 ? -1.0f : 1.0f;
+            displacement[Idx * 3 + 0] = Sign * mChoppiness * mFieldReal[0][Idx];
+            displacement[Idx * 3 + 1] = Sign * mFieldImaginary[0][Idx];
+            displacement[Idx * 3 + 2] = Sign * mChoppiness * mFieldReal[1][Idx];
+            slopes[Idx * 2 + 0] = Sign * mFieldImaginary[1][Idx];
+            slopes[Idx * 2 + 1] = Sign * mFieldReal[2][Idx];
+        }
+    }
+}
+
+void
+OceanSpectrum::RunBenchmark(unsigned size, JobSystem& jobs) {
+    const unsigned Iterations = 50;
+    const float Time = 12.5f;
+    OceanSpectrum Spectrum(size, 64.0f, glm::vec2(10.0f, 4.0f), 0.25f, 1.0f);
+    size = Spectrum.GetSize();
+    std::vector<float> Displacement(size * size * 3);
+    std::vector<float> Slopes(size * size * 2);
+    typedef std::chrono::high_resolution_clock Clock;
+
+    std::cout << "Ocean spectrum benchmark: " << size << "x" << size << ", " << Iterations << " iterations" << std::endl;
+    for (unsigned Run = 0; Run < 2; ++Run) {
+        bool Threaded = Run == 1;
+        Spectrum.Simulate(Time, Displacement.data(), Slopes.data(), Threaded ? &jobs : 0);
+        Clock::time_point Start = Clock::now();
+        for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration) {
+            Spectrum.Simulate(Time + Iteration * 0.016f, Displacement.data(), Slopes.data(), Threaded ? &jobs : 0);
+        }
+        double SimulateTime = std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / Iterations;
+        std::cout << "  " << (Threaded ? "job system" : "single thread");
+        if (Threaded) {
+            std::cout << " x" << jobs.GetThreadCount() << " threads";
+        }
+        std::cout << ": " << SimulateTime << " ms" << std::endl;
+    }
+
+    // Direct sum of the evolved spectrum at a few grid points, O(size^2) each
+    Spectrum.Simulate(Time, Displacement.data(), Slopes.data(), &jobs);
+    double MeanSquare = 0.0;
+    for (unsigned Idx = 0; Idx < size * size; ++Idx) {
+        MeanSquare += Displacement[Idx * 3 + 1] * Displacement[Idx * 3 + 1];
+    }
+    float MaxHeightError = 0.0f;
+    float MaxSlopeError = 0.0f;
+    const unsigned SampleCount = 8;
+    for (unsigned Sample = 0; Sample < SampleCount; ++Sample) {
+        unsigned X = (Sample * 37 + 5) % size;
+        unsigned Z = (Sample * 101 + 11) % size;
+        double Height = 0.0;
+        double SlopeX = 0.0;
+        for (unsigned Row = 0; Row < size; ++Row) {
+            for (unsigned Column = 0; Column < size; ++Column) {
+                unsigned Idx = Row * size + Column;
+                float ERe = Spectrum.mPhaseReal[Spectrum.mFrequency[Idx]];
+                float EIm = Spectrum.mPhaseImaginary[Spectrum.mFrequency[Idx]];
+                double HRe = (Spectrum.mH0Real[Idx] + Spectrum.mH0ConjugateReal[Idx]) * ERe + (Spectrum.mH0ConjugateImaginary[Idx] - Spectrum.mH0Imaginary[Idx]) * EIm;
+                double HIm = (Spectrum.mH0Imaginary[Idx] + Spectrum.mH0ConjugateImaginary[Idx]) * ERe + (Spectrum.mH0Real[Idx] - Spectrum.mH0ConjugateReal[Idx]) * EIm;
+                double Phase = TWO_PI * (((int)Column - (int)size / 2) * (double)X + ((int)Row - (int)size / 2) * (double)Z) / size;
+                double Cos = std::cos(Phase);
+                double Sin = std::sin(Phase);
+                Height += HRe * Cos - HIm * Sin;
+                // Real part of i * kx * h * e^(i phase)
+                SlopeX -= Spectrum.getWaveNumber(Column) * (HRe * Sin + HIm * Cos);
+            }
+        }
+        unsigned Idx = Z * size + X;
+        MaxHeightError = std::max(MaxHeightError, (float)std::abs(Height - Displacement[Idx * 3 + 1]));
+        MaxSlopeError = std::max(MaxSlopeError, (float)std::abs(SlopeX - Slopes[Idx * 2]));
+    }
+    std::cout << "  RMS height " << std::sqrt(MeanSquare / (size * size)) << " m, max error against direct sum: height "
+        << MaxHeightError << " m, slope " << MaxSlopeError << std::endl;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <iostream>
+#include <glm/glm.hpp>
+#include "fft.hpp"
+#include "job_system.hpp"
+
+// Complex fields transformed per tick: Dx + i * height, Dz + i * slope x, slope z
+#define OCEAN_SPECTRUM_FIELD_COUNT 3
+// Wave motion repeats after this many seconds, which lets phases come from a small table
+#define OCEAN_SPECTRUM_REPEAT_TIME 200.0f
+// Rows per job when evolving and packing the spectrum
+#define OCEAN_SPECTRUM_JOB_ROWS 16
+
+/**
+ * @brief Tessendorf FFT ocean. A Phillips spectrum is generated once, every tick it is
+ * evolved in time and transformed into a tileable patch of height, horizontal (choppy)
+ * displacement and slopes. Doesn't touch OpenGL, Ocean uploads the output. Stays on the CPU
+ * because GL 3.3 has no compute shaders: a GPU transform would be a ping-pong fragment FFT, 2 * log2(size)
+ * full screen passes into float targets per pair of fields (16 at the default 256), and those passes
+ * land on the GPU time DynamicResolution budgets, so they would be paid in render scale. Here the
+ * transform runs on the workers while the main thread composes and culls, writing straight into the
+ * mapped upload buffer, and the frame only pays the join and a 1.25 MB upload. RunBenchmark and the
+ * "ocean spectrum" stat show the CPU cost, should it ever outgrow that overlap
+ */
+class OceanSpectrum {
+public:
+    /**
+     * @brief Ctor - generates the initial spectrum
+     *
+     * @param size Grid side, power of two between FFT_COLUMN_BLOCK and 1024
+     * @param patchSize World units covered by one tile of the patch
+     * @param wind Wind velocity in m/s, waves travel along it
+     * @param rmsHeight Root mean square wave height the spectrum is scaled to
+     * @param choppiness Horizontal displacement scale, sharpens crests. 0 gives plain sine-like swell
+     */
+    OceanSpectrum(unsigned size, float patchSize, const glm::vec2& wind, float rmsHeight, float choppiness);
+
+    /**
+     * @brief Computes the patch at the given time
+     *
+     * @param time Time in seconds
+     * @param displacement Output, size * size RGB floats: displacement x, height, displacement z
+     * @param slopes Output, size * size RG floats: height derivatives along x and z
+     * @param jobs Optional job system the work is split over
+     */
+    void Simulate(float time, float* displacement, float* slopes, JobSystem* jobs = 0);
+
+    /**
+     * @brief Returns grid side
+     */
+    unsigned GetSize() const;
+
+    /**
+     * @brief Returns world units covered by one tile of the patch
+     */
+    float GetPatchSize() const;
+
+    /**
+     * @brief Times Simulate single threaded and on the job system and checks the FFT
+     * against a direct sum of the spectrum at a few points. Prints the results
+     *
+     * @param size Grid side
+     * @param jobs Job system used for the threaded run
+     */
+    static void RunBenchmark(unsigned size, JobSystem& jobs);
+
+private:
+    unsigned mSize;
+    float mPatchSize;
+    float mChoppiness;
+    FFT mFFT;
+    // h0(k) and conj(h0(-k)), so evolving a wave doesn't need its mirrored index
+    std::vector<float> mH0Real;
+    std::vector<float> mH0Imaginary;
+    std::vector<float> mH0ConjugateReal;
+    std::vector<float> mH0ConjugateImaginary;
+    // Angular frequency of each wave as a multiple of 2 PI / OCEAN_SPECTRUM_REPEAT_TIME
+    std::vector<unsigned short> mFrequency;
+    // e^(i * frequency * t) per frequency multiple, rebuilt each tick
+    std::vector<float> mPhaseReal;
+    std::vector<float> mPhaseImaginary;
+    std::vector<float> mFieldReal[OCEAN_SPECTRUM_FIELD_COUNT];
+    std::vector<float> mFieldImaginary[OCEAN_SPECTRUM_FIELD_COUNT];
+
+    float getWaveNumber(unsigned idx) const;
+    void evolveRows(unsigned begin, unsigned end);
+    void packRows(unsigned begin, unsigned end, float* displacement, float* slopes) const;
+};
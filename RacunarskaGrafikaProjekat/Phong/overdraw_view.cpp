@@ -0,0 +1,84 @@
+#include "overdraw_view.hpp"
+
+// Black for untouched pixels, then blue over green and yellow to red and white
+static const glm::vec3 LevelColors[OverdrawView::LEVEL_COUNT] = {
+    glm::vec3(0.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 0.5f),
+    glm::vec3(0.0f, 0.4f, 1.0f),
+    glm::vec3(0.0f, 0.8f, 0.8f),
+    glm::vec3(0.0f, 0.8f, 0.0f),
+    glm::vec3(1.0f, 1.0f, 0.0f),
+    glm::vec3(1.0f, 0.5f, 0.0f),
+    glm::vec3(1.0f, 0.0f, 0.0f),
+    glm::vec3(1.0f, 1.0f, 1.0f),
+};
+
+OverdrawView::OverdrawView()
+    : mShader("shaders/fullscreen.vert", "shaders/heatmap.frag") {
+    mMode = OVERDRAW_OFF;
+    mVAO = GLVertexArray::Create();
+}
+
+void
+OverdrawView::BeginFrame(EOverdrawMode mode) {
+    mMode = mode;
+    if (mMode == OVERDRAW_OFF) {
+        return;
+    }
+
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, 0, 0xFF);
+    glStencilMask(0xFF);
+    // Increment saturates at 255, so counts never wrap back to 0
+    GLenum DepthFailOp = mMode == OVERDRAW_RASTERIZED ? GL_INCR : GL_KEEP;
+    glStencilOp(GL_KEEP, DepthFailOp, GL_INCR);
+}
+
+void
+OverdrawView::PauseCounting() const {
+    if (mMode != OVERDRAW_OFF) {
+        glStencilMask(0x00);
+    }
+}
+
+void
+OverdrawView::ResumeCounting() const {
+    if (mMode != OVERDRAW_OFF) {
+        glStencilMask(0xFF);
+    }
+}
+
+void
+OverdrawView::Resolve() const {
+    if (mMode == OVERDRAW_OFF) {
+        return;
+    }
+
+    glStencilMask(0x00);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(mShader.GetId());
+    glBindVertexArray(mVAO.Get());
+    // Every level overwrites pixels with at least that many fragments, the last matching level stays
+    for (unsigned Level = 0; Level < LEVEL_COUNT; ++Level) {
+        glStencilFunc(GL_LEQUAL, Level, 0xFF);
+        mShader.SetUniform3f("uColor", LevelColors[Level]);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    glEnable(GL_DEPTH_TEST);
+    glStencilMask(0xFF);
+    glDisable(GL_STENCIL_TEST);
+}
+
+const char*
+OverdrawView::GetModeName(EOverdrawMode mode) {
+    switch (mode) {
+    case OVERDRAW_OFF: return "off";
+    case OVERDRAW_RASTERIZED: return "rasterized fragments";
+    case OVERDRAW_SHADED: return "shaded fragments";
+    default: return "unknown";
+    }
+}
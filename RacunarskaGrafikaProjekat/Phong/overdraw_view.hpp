@@ -0,0 +1,60 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "gl_handle.hpp"
+
+enum EOverdrawMode {
+    // Regular rendering
+    OVERDRAW_OFF = 0,
+    // Counts every rasterized fragment, including ones failing the depth test
+    OVERDRAW_RASTERIZED = 1,
+    // Counts fragments passing the depth test, the ones that actually ran the shading
+    OVERDRAW_SHADED = 2,
+    OVERDRAW_MODE_COUNT = 3,
+};
+
+/**
+ * @brief Debug view that counts fragments per pixel in the stencil buffer while the scene renders
+ * and then replaces the image with a heatmap of the counts. Needs a stencil buffer in the default framebuffer
+ */
+class OverdrawView {
+public:
+    // Number of heatmap colors, counts above the last one share its color
+    static const unsigned LEVEL_COUNT = 9;
+
+    /**
+     * @brief Ctor - loads the heatmap shader
+     */
+    OverdrawView();
+
+    /**
+     * @brief Enables stencil counting for the frame. Call after clearing the stencil buffer
+     *
+     * @param mode Counting mode. OVERDRAW_OFF leaves the state untouched
+     */
+    void BeginFrame(EOverdrawMode mode);
+
+    /**
+     * @brief Stops counting, e.g. during a depth pre-pass whose fragments aren't shaded
+     */
+    void PauseCounting() const;
+
+    /**
+     * @brief Continues counting after PauseCounting
+     */
+    void ResumeCounting() const;
+
+    /**
+     * @brief Draws the heatmap over the frame and restores depth and stencil state
+     */
+    void Resolve() const;
+
+    static const char* GetModeName(EOverdrawMode mode);
+
+private:
+    EOverdrawMode mMode;
+    Shader mShader;
+    // Fullscreen triangle has no vertex attributes, core profile still needs a VAO bound
+    GLVertexArray mVAO;
+};
@@ -0,0 +1,260 @@
+#include "particle_simulation.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Keeps the age fraction of waiting particles, whose lifetime is 0, finite
+static const float MIN_LIFETIME = 1e-3f;
+static const float TWO_PI = 6.28318531f;
+
+ParticleSimulation::ParticleSimulation(unsigned count, const std::vector<ParticleEmitter>& emitters) {
+    mCount = SimdPadCount(count);
+    mEmitters = emitters;
+    if (mEmitters.size() > PARTICLE_MAX_EMITTERS) {
+        std::cerr << "[Err] Too many particle emitters, using the first " << PARTICLE_MAX_EMITTERS << std::endl;
+        mEmitters.resize(PARTICLE_MAX_EMITTERS);
+    }
+    mPositionX.resize(mCount);
+    mPositionY.resize(mCount);
+    mPositionZ.resize(mCount);
+    mVelocityX.resize(mCount, 0.0f);
+    mVelocityY.resize(mCount, 0.0f);
+    mVelocityZ.resize(mCount, 0.0f);
+    mAge.resize(mCount);
+    mLifetime.resize(mCount, 0.0f);
+
+    for (unsigned Idx = 0; Idx < mCount; ++Idx) {
+        glm::vec3 Position = mEmitters.empty() ? glm::vec3(0.0f) : mEmitters[Idx % mEmitters.size()].Position;
+        mPositionX[Idx] = Position.x;
+        mPositionY[Idx] = Position.y;
+        mPositionZ[Idx] = Position.z;
+        // Negative age counts down to the first spawn, so the emitters start evenly instead of in one burst
+        mAge[Idx] = -((Noise::Hash(Idx, 0, PARTICLE_SEED + 2) >> 8) / 16777216.0f) * PARTICLE_LIFETIME;
+    }
+}
+
+void
+ParticleSimulation::Step(float dt, unsigned frame, float* out, JobSystem* jobs) {
+    if (mEmitters.empty()) {
+        return;
+    }
+
+    if (jobs) {
+        jobs->ParallelFor(mCount, PARTICLE_JOB_SIZE, [this, dt, frame, out](unsigned begin, unsigned end) {
+            stepRange(begin, end, dt, frame, out);
+        });
+        return;
+    }
+
+    stepRange(0, mCount, dt, frame, out);
+}
+
+void
+ParticleSimulation::Store(float* out) const {
+    for (unsigned Idx = 0; Idx < mCount; ++Idx) {
+        float* Particle = out + Idx * PARTICLE_FLOATS;
+        Particle[0] = mPositionX[Idx];
+        Particle[1] = mPositionY[Idx];
+        Particle[2] = mPositionZ[Idx];
+        Particle[3] = mAge[Idx];
+        Particle[4] = mVelocityX[Idx];
+        Particle[5] = mVelocityY[Idx];
+        Particle[6] = mVelocityZ[Idx];
+        Particle[7] = mLifetime[Idx];
+    }
+}
+
+void
+ParticleSimulation::Load(const float* particles) {
+    for (unsigned Idx = 0; Idx < mCount; ++Idx) {
+        const float* Particle = particles + Idx * PARTICLE_FLOATS;
+        mPositionX[Idx] = Particle[0];
+        mPositionY[Idx] = Particle[1];
+        mPositionZ[Idx] = Particle[2];
+        mAge[Idx] = Particle[3];
+        mVelocityX[Idx] = Particle[4];
+        mVelocityY[Idx] = Particle[5];
+        mVelocityZ[Idx] = Particle[6];
+        mLifetime[Idx] = Particle[7];
+    }
+}
+
+unsigned
+ParticleSimulation::GetCount() const {
+    return mCount;
+}
+
+const std::vector<ParticleEmitter>&
+ParticleSimulation::GetEmitters() const {
+    return mEmitters;
+}
+
+void
+ParticleSimulation::RunBenchmark(unsigned count, JobSystem& jobs) {
+    const unsigned Iterations = 200;
+    const float DT = 1.0f / 60.0f;
+    std::vector<ParticleEmitter> Emitters;
+    for (unsigned EmitterIdx = 0; EmitterIdx < 3; ++EmitterIdx) {
+        ParticleEmitter Emitter = { glm::vec3(EmitterIdx * 10.0f, 0.0f, 0.0f), 0.15f };
+        Emitters.push_back(Emitter);
+    }
+
+    ParticleSimulation Reference(count, Emitters);
+    ParticleSimulation Simulation(count, Emitters);
+    std::vector<float> ReferenceOut(Reference.GetCount() * PARTICLE_FLOATS);
+    std::vector<float> Out(Simulation.GetCount() * PARTICLE_FLOATS);
+    typedef std::chrono::high_resolution_clock Clock;
+    std::cout << "Particle benchmark: " << Simulation.GetCount() << " particles, " << Iterations << " steps" << std::endl;
+
+    Clock::time_point Start = Clock::now();
+    for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration) {
+        Reference.stepRangeScalar(0, Reference.GetCount(), DT, Iteration + 1, ReferenceOut.data());
+    }
+    double ScalarTime = std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / Iterations;
+    std::cout << "  scalar: " << ScalarTime << " ms" << std::endl;
+
+    Start = Clock::now();
+    for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration) {
+        Simulation.Step(DT, Iteration + 1, Out.data());
+    }
+    double SimdTime = std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / Iterations;
+
+    float MaxError = 0.0f;
+    for (unsigned Idx = 0; Idx < Out.size(); ++Idx) {
+        MaxError = std::max(MaxError, std::abs(Out[Idx] - ReferenceOut[Idx]));
+    }
+    std::cout << "  " << (SIMD_SSE ? "SSE" : "scalar") << ": " << SimdTime << " ms, " << ScalarTime / SimdTime << "x, max error " << MaxError << std::endl;
+
+    Start = Clock::now();
+    for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration) {
+        Simulation.Step(DT, Iterations + Iteration + 1, Out.data(), &jobs);
+    }
+    double ThreadedTime = std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / Iterations;
+    std::cout << "  " << (SIMD_SSE ? "SSE" : "scalar") << " x" << jobs.GetThreadCount() << " threads: " << ThreadedTime << " ms, " << ScalarTime / ThreadedTime << "x" << std::endl;
+}
+
+void
+ParticleSimulation::stepRange(unsigned begin, unsigned end, float dt, unsigned frame, float* out) {
+#if SIMD_SSE
+    const __m128 DT = _mm_set1_ps(dt);
+    const __m128 MinLifetime = _mm_set1_ps(MIN_LIFETIME);
+    const __m128 Zero = _mm_setzero_ps();
+    const __m128 One = _mm_set1_ps(1.0f);
+    const __m128 Buoyancy = _mm_set1_ps(PARTICLE_BUOYANCY);
+    const __m128 Drag = _mm_set1_ps(PARTICLE_DRAG);
+    const glm::vec3 Wind = PARTICLE_WIND;
+    const __m128 WindX = _mm_set1_ps(Wind.x);
+    const __m128 WindY = _mm_set1_ps(Wind.y);
+    const __m128 WindZ = _mm_set1_ps(Wind.z);
+    for (unsigned Idx = begin; Idx < end; Idx += SIMD_WIDTH) {
+        __m128 Age = _mm_add_ps(_mm_loadu_ps(&mAge[Idx]), DT);
+        _mm_storeu_ps(&mAge[Idx], Age);
+        // Spawning needs hashes and emitter lookups, but only a few particles per frame do it
+        int Expired = _mm_movemask_ps(_mm_cmpge_ps(Age, _mm_loadu_ps(&mLifetime[Idx])));
+        if (Expired) {
+            for (unsigned Lane = 0; Lane < SIMD_WIDTH; ++Lane) {
+                if (Expired & (1 << Lane)) {
+                    respawn(Idx + Lane, frame);
+                }
+            }
+            Age = _mm_loadu_ps(&mAge[Idx]);
+        }
+
+        __m128 Lifetime = _mm_loadu_ps(&mLifetime[Idx]);
+        __m128 T = _mm_min_ps(_mm_max_ps(_mm_div_ps(Age, _mm_max_ps(Lifetime, MinLifetime)), Zero), One);
+        __m128 VX = _mm_loadu_ps(&mVelocityX[Idx]);
+        __m128 VY = _mm_loadu_ps(&mVelocityY[Idx]);
+        __m128 VZ = _mm_loadu_ps(&mVelocityZ[Idx]);
+        __m128 AX = _mm_mul_ps(_mm_sub_ps(WindX, VX), Drag);
+        __m128 AY = _mm_add_ps(_mm_mul_ps(Buoyancy, _mm_sub_ps(One, T)), _mm_mul_ps(_mm_sub_ps(WindY, VY), Drag));
+        __m128 AZ = _mm_mul_ps(_mm_sub_ps(WindZ, VZ), Drag);
+        VX = _mm_add_ps(VX, _mm_mul_ps(AX, DT));
+        VY = _mm_add_ps(VY, _mm_mul_ps(AY, DT));
+        VZ = _mm_add_ps(VZ, _mm_mul_ps(AZ, DT));
+        __m128 PX = _mm_add_ps(_mm_loadu_ps(&mPositionX[Idx]), _mm_mul_ps(VX, DT));
+        __m128 PY = _mm_add_ps(_mm_loadu_ps(&mPositionY[Idx]), _mm_mul_ps(VY, DT));
+        __m128 PZ = _mm_add_ps(_mm_loadu_ps(&mPositionZ[Idx]), _mm_mul_ps(VZ, DT));
+        _mm_storeu_ps(&mVelocityX[Idx], VX);
+        _mm_storeu_ps(&mVelocityY[Idx], VY);
+        _mm_storeu_ps(&mVelocityZ[Idx], VZ);
+        _mm_storeu_ps(&mPositionX[Idx], PX);
+        _mm_storeu_ps(&mPositionY[Idx], PY);
+        _mm_storeu_ps(&mPositionZ[Idx], PZ);
+
+        if (out) {
+            // Two 4x4 transposes turn the SoA registers into the interleaved particles
+            _MM_TRANSPOSE4_PS(PX, PY, PZ, Age);
+            _MM_TRANSPOSE4_PS(VX, VY, VZ, Lifetime);
+            float* Particle = out + Idx * PARTICLE_FLOATS;
+            _mm_storeu_ps(Particle + 0 * PARTICLE_FLOATS, PX);
+            _mm_storeu_ps(Particle + 0 * PARTICLE_FLOATS + 4, VX);
+            _mm_storeu_ps(Particle + 1 * PARTICLE_FLOATS, PY);
+            _mm_storeu_ps(Particle + 1 * PARTICLE_FLOATS + 4, VY);
+            _mm_storeu_ps(Particle + 2 * PARTICLE_FLOATS, PZ);
+            _mm_storeu_ps(Particle + 2 * PARTICLE_FLOATS + 4, VZ);
+            _mm_storeu_ps(Particle + 3 * PARTICLE_FLOATS, Age);
+            _mm_storeu_ps(Particle + 3 * PARTICLE_FLOATS + 4, Lifetime);
+        }
+    }
+#else
+    stepRangeScalar(begin, end, dt, frame, out);
+#endif
+}
+
+void
+ParticleSimulation::stepRangeScalar(unsigned begin, unsigned end, float dt, unsigned frame, float* out) {
+    const glm::vec3 Wind = PARTICLE_WIND;
+    for (unsigned Idx = begin; Idx < end; ++Idx) {
+        mAge[Idx] += dt;
+        if (mAge[Idx] >= mLifetime[Idx]) {
+            respawn(Idx, frame);
+        }
+
+        float T = std::min(std::max(mAge[Idx] / std::max(mLifetime[Idx], MIN_LIFETIME), 0.0f), 1.0f);
+        float AX = (Wind.x - mVelocityX[Idx]) * PARTICLE_DRAG;
+        float AY = PARTICLE_BUOYANCY * (1.0f - T) + (Wind.y - mVelocityY[Idx]) * PARTICLE_DRAG;
+        float AZ = (Wind.z - mVelocityZ[Idx]) * PARTICLE_DRAG;
+        mVelocityX[Idx] += AX * dt;
+        mVelocityY[Idx] += AY * dt;
+        mVelocityZ[Idx] += AZ * dt;
+        mPositionX[Idx] += mVelocityX[Idx] * dt;
+        mPositionY[Idx] += mVelocityY[Idx] * dt;
+        mPositionZ[Idx] += mVelocityZ[Idx] * dt;
+
+        if (out) {
+            float* Particle = out + Idx * PARTICLE_FLOATS;
+            Particle[0] = mPositionX[Idx];
+            Particle[1] = mPositionY[Idx];
+            Particle[2] = mPositionZ[Idx];
+            Particle[3] = mAge[Idx];
+            Particle[4] = mVelocityX[Idx];
+            Particle[5] = mVelocityY[Idx];
+            Particle[6] = mVelocityZ[Idx];
+            Particle[7] = mLifetime[Idx];
+        }
+    }
+}
+
+void
+ParticleSimulation::respawn(unsigned idx, unsigned frame) {
+    const ParticleEmitter& Emitter = mEmitters[idx % mEmitters.size()];
+    unsigned Hash0 = Noise::Hash(idx, frame, PARTICLE_SEED);
+    unsigned Hash1 = Noise::Hash(idx, frame, PARTICLE_SEED + 1);
+    float Angle = (Hash0 & 0xffff) / 65536.0f * TWO_PI;
+    // Square root spreads spawns evenly over the disk instead of bunching them at the center
+    float Radius = std::sqrt((Hash0 >> 16) / 65536.0f) * Emitter.Radius;
+    float Speed = 0.75f + 0.5f * ((Hash1 & 0xffff) / 65536.0f);
+    float Life = 0.75f + 0.5f * ((Hash1 >> 16) / 65536.0f);
+    float OffsetX = std::cos(Angle) * Radius;
+    float OffsetZ = std::sin(Angle) * Radius;
+
+    // Time past the end of the old life is spent in the new one, so spawns don't bunch up on frame boundaries
+    mAge[idx] -= mLifetime[idx];
+    mLifetime[idx] = PARTICLE_LIFETIME * Life;
+    mPositionX[idx] = Emitter.Position.x + OffsetX;
+    mPositionY[idx] = Emitter.Position.y;
+    mPositionZ[idx] = Emitter.Position.z + OffsetZ;
+    mVelocityX[idx] = OffsetX * PARTICLE_SPREAD;
+    mVelocityY[idx] = PARTICLE_RISE_SPEED * Speed;
+    mVelocityZ[idx] = OffsetZ * PARTICLE_SPREAD;
+}
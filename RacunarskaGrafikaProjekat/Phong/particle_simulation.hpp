@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <iostream>
+#include <glm/glm.hpp>
+#include "simd.hpp"
+#include "noise.hpp"
+#include "job_system.hpp"
+
+// Floats per particle in the interleaved layout shared with the GPU buffers:
+// position, age, velocity, lifetime
+#define PARTICLE_FLOATS 8
+// Emitters are passed to the simulation shader as a uniform array of this size
+#define PARTICLE_MAX_EMITTERS 8
+// Particles per job of the CPU simulation
+#define PARTICLE_JOB_SIZE 4096
+// Mean lifetime in seconds, each particle gets 75% to 125% of it
+#define PARTICLE_LIFETIME 2.5f
+// Upward speed at spawn
+#define PARTICLE_RISE_SPEED 0.6f
+// Outward speed per unit of distance from the emitter center at spawn
+#define PARTICLE_SPREAD 1.5f
+// Upward acceleration of hot fire, falls to zero as the particle turns to smoke
+#define PARTICLE_BUOYANCY 0.8f
+// Rate at which velocity approaches the wind
+#define PARTICLE_DRAG 0.5f
+#define PARTICLE_WIND glm::vec3(0.3f, 0.0f, 0.1f)
+// Seeds spawn randomness, shaders/particles_simulate.vert hashes the same way
+#define PARTICLE_SEED 0x5eed
+
+/**
+ * @brief Point that spawns particles on a horizontal disk
+ */
+struct ParticleEmitter {
+    glm::vec3 Position;
+    float Radius;
+};
+
+/**
+ * @brief CPU version of the fire and smoke simulation in shaders/particles_simulate.vert.
+ * Particles are stored SoA and stepped SIMD_WIDTH at a time, the result is written in the
+ * interleaved layout of the GPU buffers. Every particle is always either alive or waiting
+ * for its first spawn (negative age), dead ones respawn at the emitter they belong to, so
+ * the population is constant and no free lists are needed. Doesn't touch OpenGL
+ */
+class ParticleSimulation {
+public:
+    /**
+     * @brief Ctor - puts all particles in the waiting state, spawns are spread over one lifetime
+     *
+     * @param count Number of particles, rounded up to a multiple of SIMD_WIDTH
+     * @param emitters Emitters, at most PARTICLE_MAX_EMITTERS. Particle i belongs to the emitter at index i modulo the emitter count
+     */
+    ParticleSimulation(unsigned count, const std::vector<ParticleEmitter>& emitters);
+
+    /**
+     * @brief Advances particles, respawning the ones that outlived their lifetime
+     *
+     * @param dt Time step in seconds
+     * @param frame Frame number, seeds the spawn randomness
+     * @param out Optional output, GetCount() * PARTICLE_FLOATS floats
+     * @param jobs Optional job system the work is split over
+     */
+    void Step(float dt, unsigned frame, float* out, JobSystem* jobs = 0);
+
+    /**
+     * @brief Writes the particles in the interleaved layout
+     *
+     * @param out GetCount() * PARTICLE_FLOATS floats
+     */
+    void Store(float* out) const;
+
+    /**
+     * @brief Replaces the particles, e.g. with the state read back from the GPU
+     *
+     * @param particles GetCount() * PARTICLE_FLOATS floats
+     */
+    void Load(const float* particles);
+
+    /**
+     * @brief Returns number of particles
+     */
+    unsigned GetCount() const;
+
+    /**
+     * @brief Returns emitters
+     */
+    const std::vector<ParticleEmitter>& GetEmitters() const;
+
+    /**
+     * @brief Times Step single threaded and on the job system and compares the SIMD
+     * path against the scalar one. Prints the results
+     *
+     * @param count Number of particles
+     * @param jobs Job system used for the threaded run
+     */
+    static void RunBenchmark(unsigned count, JobSystem& jobs);
+
+private:
+    unsigned mCount;
+    std::vector<ParticleEmitter> mEmitters;
+    std::vector<float> mPositionX;
+    std::vector<float> mPositionY;
+    std::vector<float> mPositionZ;
+    std::vector<float> mVelocityX;
+    std::vector<float> mVelocityY;
+    std::vector<float> mVelocityZ;
+    std::vector<float> mAge;
+    std::vector<float> mLifetime;
+
+    void stepRange(unsigned begin, unsigned end, float dt, unsigned frame, float* out);
+    void stepRangeScalar(unsigned begin, unsigned end, float dt, unsigned frame, float* out);
+    void respawn(unsigned idx, unsigned frame);
+};
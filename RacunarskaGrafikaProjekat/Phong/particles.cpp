@@ -0,0 +1,205 @@
+#include "particles.hpp"
+#include <chrono>
+#include "memory_accounting.hpp"
+
+/**
+ * @brief Returns outputs of shaders/particles_simulate.vert in the order of the PARTICLE_FLOATS layout
+ */
+static std::vector<std::string>
+feedbackVaryings() {
+    std::vector<std::string> Varyings;
+    Varyings.push_back("vPositionAge");
+    Varyings.push_back("vVelocityLifetime");
+    return Varyings;
+}
+
+ParticleSystem::ParticleSystem(unsigned count, const std::vector<ParticleEmitter>& emitters)
+    : mSimulation(count, emitters),
+      mSimulateShader("shaders/particles_simulate.vert", feedbackVaryings()),
+      mRenderShader("shaders/particles.vert", "shaders/particles.frag") {
+    // A failed transform feedback program leaves the CPU simulation as the only option
+    mCpuSimulation = mSimulateShader.GetId() == 0;
+    mFrame = 0;
+    mCurrent = 0;
+    mDepthWidth = 0;
+    mDepthHeight = 0;
+    mUpdateMilliseconds = 0.0f;
+
+    std::vector<float> Particles(mSimulation.GetCount() * PARTICLE_FLOATS);
+    mSimulation.Store(Particles.data());
+    for (unsigned BufferIdx = 0; BufferIdx < 2; ++BufferIdx) {
+        mBuffers[BufferIdx] = GLBuffer::Create();
+        mSimulateVAOs[BufferIdx] = GLVertexArray::Create();
+        mRenderVAOs[BufferIdx] = GLVertexArray::Create();
+        glBindBuffer(GL_ARRAY_BUFFER, mBuffers[BufferIdx].Get());
+        glBufferData(GL_ARRAY_BUFFER, Particles.size() * sizeof(float), Particles.data(), GL_DYNAMIC_COPY);
+        MemoryAccounting::Track(MEMORY_MESH, mBuffers[BufferIdx].Get(), "Particles", Particles.size() * sizeof(float));
+        setupVAOs(BufferIdx);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (mSimulateShader.GetId()) {
+        const std::vector<ParticleEmitter>& Emitters = mSimulation.GetEmitters();
+        std::vector<glm::vec4> EmitterUniforms;
+        for (const ParticleEmitter& Emitter : Emitters) {
+            EmitterUniforms.push_back(glm::vec4(Emitter.Position, Emitter.Radius));
+        }
+        glUseProgram(mSimulateShader.GetId());
+        if (!EmitterUniforms.empty()) {
+            mSimulateShader.SetUniform4fv("uEmitters", EmitterUniforms.data(), EmitterUniforms.size());
+        }
+        mSimulateShader.SetUniform1i("uEmitterCount", Emitters.size());
+        mSimulateShader.SetUniform1f("uLifetime", PARTICLE_LIFETIME);
+        mSimulateShader.SetUniform1f("uRiseSpeed", PARTICLE_RISE_SPEED);
+        mSimulateShader.SetUniform1f("uSpread", PARTICLE_SPREAD);
+        mSimulateShader.SetUniform1f("uBuoyancy", PARTICLE_BUOYANCY);
+        mSimulateShader.SetUniform1f("uDrag", PARTICLE_DRAG);
+        mSimulateShader.SetUniform3f("uWind", PARTICLE_WIND);
+        mSimulateShader.SetUniform1i("uSeed", PARTICLE_SEED);
+    }
+    glUseProgram(mRenderShader.GetId());
+    mRenderShader.SetUniform1i("uSceneDepth", 0);
+    glUseProgram(0);
+}
+
+void
+ParticleSystem::SetCpuSimulation(bool cpu) {
+    if (cpu == mCpuSimulation || (!cpu && !mSimulateShader.GetId())) {
+        return;
+    }
+
+    mCpuSimulation = cpu;
+    if (mCpuSimulation) {
+        // The GPU was the last to write the particles, the CPU continues from there
+        std::vector<float> Particles(mSimulation.GetCount() * PARTICLE_FLOATS);
+        glBindBuffer(GL_ARRAY_BUFFER, mBuffers[mCurrent].Get());
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, Particles.size() * sizeof(float), Particles.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mSimulation.Load(Particles.data());
+    }
+}
+
+bool
+ParticleSystem::IsCpuSimulation() const {
+    return mCpuSimulation;
+}
+
+void
+ParticleSystem::Update(float dt, JobSystem& jobs) {
+    typedef std::chrono::high_resolution_clock Clock;
+    Clock::time_point Start = Clock::now();
+    ++mFrame;
+
+    if (mCpuSimulation) {
+        // Written straight into the buffer that gets drawn, invalidating it avoids waiting on last frame's draw
+        glBindBuffer(GL_ARRAY_BUFFER, mBuffers[mCurrent].Get());
+        float* Particles = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, mSimulation.GetCount() * PARTICLE_FLOATS * sizeof(float), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!Particles) {
+            std::cerr << "[Err] Failed to map particle buffer" << std::endl;
+        }
+        mSimulation.Step(dt, mFrame, Particles, &jobs);
+        if (Particles) {
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    } else {
+        unsigned Next = 1 - mCurrent;
+        glUseProgram(mSimulateShader.GetId());
+        mSimulateShader.SetUniform1f("uDT", dt);
+        mSimulateShader.SetUniform1i("uFrame", mFrame);
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(mSimulateVAOs[mCurrent].Get());
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, mBuffers[Next].Get());
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, mSimulation.GetCount());
+        glEndTransformFeedback();
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindVertexArray(0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        glUseProgram(0);
+        mCurrent = Next;
+    }
+
+    mUpdateMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - Start).count();
+}
+
+void
+ParticleSystem::CaptureSceneDepth(int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    if (!mDepthTexture.Get()) {
+        mDepthTexture = GLTexture::Create();
+    }
+    glBindTexture(GL_TEXTURE_2D, mDepthTexture.Get());
+    if (width != mDepthWidth || height != mDepthHeight) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        MemoryAccounting::Track(MEMORY_TEXTURE, mDepthTexture.Get(), "Particle depth copy", MemoryAccounting::GetTextureSize(width, height, 1, 4, false));
+        mDepthWidth = width;
+        mDepthHeight = height;
+    }
+    // Particles don't write depth, so the copy stays valid while they are drawn against the real depth buffer
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void
+ParticleSystem::Render(const glm::mat4& projection, const glm::mat4& view) const {
+    if (!mDepthTexture.Get()) {
+        return;
+    }
+
+    glUseProgram(mRenderShader.GetId());
+    mRenderShader.SetProjection(projection);
+    mRenderShader.SetView(view);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, mDepthTexture.Get());
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+
+    glBindVertexArray(mRenderVAOs[mCurrent].Get());
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, mSimulation.GetCount());
+    glBindVertexArray(0);
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+float
+ParticleSystem::GetUpdateMilliseconds() const {
+    return mUpdateMilliseconds;
+}
+
+unsigned
+ParticleSystem::GetCount() const {
+    return mSimulation.GetCount();
+}
+
+void
+ParticleSystem::setupVAOs(unsigned buffer) {
+    const unsigned Stride = PARTICLE_FLOATS * sizeof(float);
+    // Simulation reads every particle as one vertex
+    glBindVertexArray(mSimulateVAOs[buffer].Get());
+    glBindBuffer(GL_ARRAY_BUFFER, mBuffers[buffer].Get());
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Stride, (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    // Drawing reads one particle per instance, quad corners come from gl_VertexID
+    glBindVertexArray(mRenderVAOs[buffer].Get());
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, Stride, (void*)(7 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glBindVertexArray(0);
+}
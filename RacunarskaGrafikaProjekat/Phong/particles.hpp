@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "gl_handle.hpp"
+#include "job_system.hpp"
+#include "particle_simulation.hpp"
+
+/**
+ * @brief Fire and smoke particles. Simulated on the GPU with transform feedback between two
+ * buffers, or by ParticleSimulation on the CPU when transform feedback isn't available or
+ * is switched off. Drawn as instanced camera facing quads with premultiplied alpha: young
+ * particles add light like fire, old ones cover like smoke, so the draw order doesn't matter.
+ * Quads fade out where they get close to the scene depth instead of cutting into geometry
+ */
+class ParticleSystem {
+public:
+    /**
+     * @brief Ctor - loads the shaders and creates both particle buffers
+     *
+     * @param count Number of particles, rounded up to a multiple of SIMD_WIDTH
+     * @param emitters Emitters, at most PARTICLE_MAX_EMITTERS
+     */
+    ParticleSystem(unsigned count, const std::vector<ParticleEmitter>& emitters);
+
+    ParticleSystem(const ParticleSystem&) = delete;
+    ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+    /**
+     * @brief Chooses where particles are simulated. Switching to the CPU reads the particles
+     * back from the GPU once. Ignored if the transform feedback shader failed to load
+     *
+     * @param cpu true for the CPU simulation
+     */
+    void SetCpuSimulation(bool cpu);
+
+    /**
+     * @brief Returns true if particles are simulated on the CPU
+     */
+    bool IsCpuSimulation() const;
+
+    /**
+     * @brief Advances the particles
+     *
+     * @param dt Time step in seconds
+     * @param jobs Job system the CPU simulation is split over
+     */
+    void Update(float dt, JobSystem& jobs);
+
+    /**
+     * @brief Copies the depth buffer of the default framebuffer for the soft depth fade.
+     * Call after the opaque geometry is drawn
+     *
+     * @param width Framebuffer width
+     * @param height Framebuffer height
+     */
+    void CaptureSceneDepth(int width, int height);
+
+    /**
+     * @brief Draws the particles. Binds its own shader and restores blending and depth writes
+     *
+     * @param projection Projection matrix
+     * @param view View matrix
+     */
+    void Render(const glm::mat4& projection, const glm::mat4& view) const;
+
+    /**
+     * @brief Returns CPU time of the last Update in milliseconds
+     */
+    float GetUpdateMilliseconds() const;
+
+    /**
+     * @brief Returns number of particles
+     */
+    unsigned GetCount() const;
+
+private:
+    ParticleSimulation mSimulation;
+    Shader mSimulateShader;
+    Shader mRenderShader;
+    bool mCpuSimulation;
+    unsigned mFrame;
+    // Particle buffers, the simulation reads mCurrent and writes the other one
+    GLBuffer mBuffers[2];
+    GLVertexArray mSimulateVAOs[2];
+    GLVertexArray mRenderVAOs[2];
+    unsigned mCurrent;
+    GLTexture mDepthTexture;
+    int mDepthWidth;
+    int mDepthHeight;
+    float mUpdateMilliseconds;
+
+    void setupVAOs(unsigned buffer);
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Slots allocated at once when a pool runs out
+#define POOL_BLOCK_SLOTS 256
+
+/**
+ * @brief Free list of equally sized slots, one shared instance per slot size and alignment.
+ * Slots come from blocks that are only returned at exit, so freeing and allocating again
+ * never touches the heap. Thread safe
+ */
+template<size_t Size, size_t Alignment>
+class FixedPool {
+public:
+    static FixedPool& Instance() {
+        static FixedPool Pool;
+        return Pool;
+    }
+
+    FixedPool(const FixedPool&) = delete;
+    FixedPool& operator=(const FixedPool&) = delete;
+
+    void* Allocate() {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        if (!mFree) {
+            grow();
+        }
+        Slot* Taken = mFree;
+        mFree = Taken->Next;
+        return Taken;
+    }
+
+    void Free(void* memory) {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        Slot* Freed = (Slot*)memory;
+        Freed->Next = mFree;
+        mFree = Freed;
+    }
+
+private:
+    // Free slots hold the link to the next free slot
+    union Slot {
+        Slot* Next;
+        alignas(Alignment) unsigned char Storage[Size];
+    };
+
+    std::mutex mMutex;
+    Slot* mFree;
+    std::vector<Slot*> mBlocks;
+
+    FixedPool() {
+        mFree = 0;
+    }
+
+    ~FixedPool() {
+        for (Slot* Block : mBlocks) {
+            delete[] Block;
+        }
+    }
+
+    void grow() {
+        Slot* Block = new Slot[POOL_BLOCK_SLOTS];
+        mBlocks.push_back(Block);
+        for (unsigned SlotIdx = 0; SlotIdx < POOL_BLOCK_SLOTS; ++SlotIdx) {
+            Block[SlotIdx].Next = mFree;
+            mFree = &Block[SlotIdx];
+        }
+    }
+};
+
+/**
+ * @brief STL allocator taking single elements from a FixedPool, e.g. the nodes of node based
+ * containers holding scene objects. Arrays, such as hash map buckets, still go to the heap
+ */
+template<typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+
+    PoolAllocator() {
+    }
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>&) {
+    }
+
+    T* allocate(size_t count) {
+        if (count == 1) {
+            return (T*)FixedPool<sizeof(T), alignof(T)>::Instance().Allocate();
+        }
+        return (T*)::operator new(count * sizeof(T));
+    }
+
+    void deallocate(T* memory, size_t count) {
+        if (count == 1) {
+            FixedPool<sizeof(T), alignof(T)>::Instance().Free(memory);
+        } else {
+            ::operator delete(memory);
+        }
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U>&) const {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U>&) const {
+        return false;
+    }
+};
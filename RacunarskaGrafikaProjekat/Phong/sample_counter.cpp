@@ -0,0 +1,92 @@
+#include "sample_counter.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <utility>
+
+SampleCounter::SampleCounter() {
+    mRequested = false;
+    mCapturing = false;
+    mArena = 0;
+}
+
+SampleCounter::~SampleCounter() {
+    if (!mQueries.empty()) {
+        glDeleteQueries(mQueries.size(), mQueries.data());
+    }
+}
+
+void
+SampleCounter::Capture() {
+    mRequested = true;
+}
+
+void
+SampleCounter::BeginFrame(FrameArena& arena) {
+    mArena = &arena;
+    mCapturing = mRequested;
+    mRequested = false;
+    mNames.clear();
+}
+
+void
+SampleCounter::Begin(const char* name, int index) {
+    if (!mCapturing) {
+        return;
+    }
+
+    if (mNames.size() == mQueries.size()) {
+        unsigned Query;
+        glGenQueries(1, &Query);
+        mQueries.push_back(Query);
+    }
+    glBeginQuery(GL_SAMPLES_PASSED, mQueries[mNames.size()]);
+    if (index < 0) {
+        mNames.push_back(mArena->CopyString(name));
+    } else {
+        // Room for the name, a space and any int
+        size_t Size = strlen(name) + 13;
+        char* Indexed = mArena->AllocateArray<char>(Size);
+        snprintf(Indexed, Size, "%s %d", name, index);
+        mNames.push_back(Indexed);
+    }
+}
+
+void
+SampleCounter::End() {
+    if (mCapturing) {
+        glEndQuery(GL_SAMPLES_PASSED);
+    }
+}
+
+void
+SampleCounter::EndFrame() {
+    if (!mCapturing) {
+        return;
+    }
+    mCapturing = false;
+
+    // Blocks until the GPU finished the frame, fine for a one-shot debug report
+    FrameVector<std::pair<GLuint, const char*>> Results((FrameAllocator<std::pair<GLuint, const char*>>(*mArena)));
+    Results.reserve(mNames.size());
+    GLuint Total = 0;
+    for (unsigned DrawIdx = 0; DrawIdx < mNames.size(); ++DrawIdx) {
+        GLuint Samples = 0;
+        glGetQueryObjectuiv(mQueries[DrawIdx], GL_QUERY_RESULT, &Samples);
+        Results.push_back(std::make_pair(Samples, mNames[DrawIdx]));
+        Total += Samples;
+    }
+    std::sort(Results.begin(), Results.end(), [](const std::pair<GLuint, const char*>& a, const std::pair<GLuint, const char*>& b) {
+        return a.first > b.first;
+    });
+
+    std::streamsize Precision = std::cout.precision();
+    std::cout << "[Samples] " << Results.size() << " draws, " << Total << " samples shaded" << std::endl;
+    for (const std::pair<GLuint, const char*>& Result : Results) {
+        float Share = Total ? 100.0f * Result.first / Total : 0.0f;
+        std::cout << "  " << std::setw(10) << Result.first << std::setw(8) << std::fixed << std::setprecision(1) << Share << "%  " << Result.second << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout.precision(Precision);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <GL/glew.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "frame_arena.hpp"
+
+/**
+ * @brief Counts samples written by individual draws with GL_SAMPLES_PASSED occlusion queries.
+ * Capturing is one-shot: Capture arms it, the next frame's draws are measured and
+ * EndFrame prints the counts. Begin and End cost nothing while not capturing
+ */
+class SampleCounter {
+public:
+    SampleCounter();
+
+    /**
+     * @brief Dtor - deletes the queries
+     */
+    ~SampleCounter();
+
+    SampleCounter(const SampleCounter&) = delete;
+    SampleCounter& operator=(const SampleCounter&) = delete;
+
+    /**
+     * @brief Measures the draws of the next frame
+     */
+    void Capture();
+
+    /**
+     * @brief Starts capturing if it was requested
+     *
+     * @param arena Arena of the frame, draw names and the report are kept there
+     */
+    void BeginFrame(FrameArena& arena);
+
+    /**
+     * @brief Starts counting samples of a draw. Draws can't be nested
+     *
+     * @param name Name shown in the report
+     * @param index Appended to the name when not negative, for repeated objects
+     */
+    void Begin(const char* name, int index = -1);
+
+    /**
+     * @brief Stops counting samples of the current draw
+     */
+    void End();
+
+    /**
+     * @brief Waits for the results of the captured frame and prints them, largest first
+     */
+    void EndFrame();
+
+private:
+    bool mRequested;
+    bool mCapturing;
+    // Queries are kept between captures, only grown when a frame has more draws
+    std::vector<unsigned> mQueries;
+    // Names live in the frame arena, the vector keeps its capacity between captures
+    std::vector<const char*> mNames;
+    FrameArena* mArena;
+};
@@ -1,34 +1,116 @@
 #include "shader.hpp"
+#include "cooked.hpp"
+
+/**
+ * @brief Removes comments, indentation and trailing whitespace from GLSL source. Line breaks
+ * are kept, so compiler errors still point at the lines of the source file
+ *
+ * @param source GLSL source
+ *
+ * @returns Stripped source
+ */
+static std::string
+stripShaderSource(const std::string& source) {
+    std::string Result;
+    Result.reserve(source.size());
+    bool LineStart = true;
+    for (size_t Idx = 0; Idx < source.size(); ++Idx) {
+        char Current = source[Idx];
+        char Next = Idx + 1 < source.size() ? source[Idx + 1] : 0;
+        if (Current == '/' && Next == '/') {
+            while (Idx + 1 < source.size() && source[Idx + 1] != '\n') {
+                ++Idx;
+            }
+            continue;
+        }
+        if (Current == '/' && Next == '*') {
+            // Block comments separate tokens, their line breaks are kept
+            Idx += 2;
+            while (Idx + 1 < source.size() && !(source[Idx] == '*' && source[Idx + 1] == '/')) {
+                if (source[Idx] == '\n') {
+                    Result += '\n';
+                }
+                ++Idx;
+            }
+            ++Idx;
+            Result += ' ';
+            continue;
+        }
+        if (Current == '\n' || Current == '\r') {
+            while (!Result.empty() && (Result.back() == ' ' || Result.back() == '\t')) {
+                Result.pop_back();
+            }
+            if (Current == '\n') {
+                Result += '\n';
+            }
+            LineStart = true;
+            continue;
+        }
+        if (LineStart && (Current == ' ' || Current == '\t')) {
+            continue;
+        }
+        LineStart = false;
+        Result += Current;
+    }
+    return Result;
+}
 
 Shader::Shader(const std::string& vShaderPath, const std::string& fShaderPath) {
+    // Both stages are read at once, the render thread waits on them right away
+    CookedFile::Prefetch({ vShaderPath, fShaderPath }, COOKED_SHADER_EXTENSION, IO_PRIORITY_HIGH);
     unsigned vs = loadAndCompileShader(vShaderPath, GL_VERTEX_SHADER);
     unsigned fs = loadAndCompileShader(fShaderPath, GL_FRAGMENT_SHADER);
-    mId = createBasicProgram(vs, fs);
+    mProgram = GLProgram(createBasicProgram(vs, fs));
+    mUniforms.resize(SHADER_UNIFORM_CACHE_SIZE);
+}
+
+Shader::Shader(const std::string& vShaderPath, const std::vector<std::string>& feedbackVaryings) {
+    unsigned vs = loadAndCompileShader(vShaderPath, GL_VERTEX_SHADER);
+    mProgram = GLProgram(createFeedbackProgram(vs, feedbackVaryings));
+    mUniforms.resize(SHADER_UNIFORM_CACHE_SIZE);
 }
 
 unsigned
 Shader::GetId() const {
-    return mId;
+    return mProgram.Get();
+}
+
+void
+Shader::SetUniform1i(const char* uniform, int v) const {
+    glUniform1i(getUniformLocation(uniform), v);
+}
+
+void
+Shader::SetUniform1f(const char* uniform, float v) const {
+    glUniform1f(getUniformLocation(uniform), v);
 }
 
 void
-Shader::SetUniform1i(const std::string& uniform, int v) const {
-    glUniform1i(glGetUniformLocation(mId, uniform.c_str()), v);
+Shader::SetUniform3f(const char* uniform, const glm::vec3& v) const {
+    glUniform3f(getUniformLocation(uniform), v.x, v.y, v.z);
 }
 
 void
-Shader::SetUniform1f(const std::string& uniform, float v) const {
-    glUniform1f(glGetUniformLocation(mId, uniform.c_str()), v);
+Shader::SetUniform2f(const char* uniform, const glm::vec2& v) const {
+    glUniform2f(getUniformLocation(uniform), v.x, v.y);
 }
 
 void
-Shader::SetUniform3f(const std::string& uniform, const glm::vec3& v) const {
-    glUniform3f(glGetUniformLocation(mId, uniform.c_str()), v.x, v.y, v.z);
+Shader::SetUniform4fv(const char* uniform, const glm::vec4* v, unsigned count) const {
+    glUniform4fv(getUniformLocation(uniform), count, &v[0][0]);
 }
 
 void
-Shader::SetUniform4m(const std::string& uniform, const glm::mat4& m) const {
-    glUniformMatrix4fv(glGetUniformLocation(mId, uniform.c_str()), 1, GL_FALSE, &m[0][0]);
+Shader::SetUniform4m(const char* uniform, const glm::mat4& m) const {
+    glUniformMatrix4fv(getUniformLocation(uniform), 1, GL_FALSE, &m[0][0]);
+}
+
+void
+Shader::SetUniformBlockBinding(const std::string& block, unsigned binding) const {
+    unsigned BlockIndex = glGetUniformBlockIndex(mProgram.Get(), block.c_str());
+    if (BlockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(mProgram.Get(), BlockIndex, binding);
+    }
 }
 
 void
@@ -45,21 +127,42 @@ void Shader::SetProjection(const glm::mat4& m) const {
     SetUniform4m("uProjection", m);
 }
 
+int
+Shader::getUniformLocation(const char* name) const {
+    unsigned long long Hash = 14695981039346656037ull;
+    for (const char* Char = name; *Char; ++Char) {
+        Hash ^= (unsigned char)*Char;
+        Hash *= 1099511628211ull;
+    }
+
+    for (unsigned Probe = 0; Probe < mUniforms.size(); ++Probe) {
+        UniformSlot& Slot = mUniforms[(Hash + Probe) & (mUniforms.size() - 1)];
+        if (Slot.Name.empty()) {
+            Slot.Hash = Hash;
+            Slot.Name = name;
+            Slot.Location = glGetUniformLocation(mProgram.Get(), name);
+            return Slot.Location;
+        }
+        if (Slot.Hash == Hash && Slot.Name == name) {
+            return Slot.Location;
+        }
+    }
+    return glGetUniformLocation(mProgram.Get(), name);
+}
+
 unsigned
 Shader::loadAndCompileShader(std::string filename, GLuint shaderType) {
     unsigned ShaderID = 0;
-    std::ifstream In(filename);
     std::string Str;
-
-    In.seekg(0, std::ios::end);
-    Str.reserve(In.tellg());
-    In.seekg(0, std::ios::beg);
-
-    Str.assign((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+    CookedReader Cooked;
+    if (!CookedFile::OpenRead(filename, COOKED_SHADER_EXTENSION, COOKED_SHADER_MAGIC, Cooked) || !Cooked.ReadString(Str)) {
+        Str = readSource(filename);
+    }
     const char* CharContent = Str.c_str();
+    const GLint Length = (GLint)Str.size();
 
     ShaderID = glCreateShader(shaderType);
-    glShaderSource(ShaderID, 1, &CharContent, NULL);
+    glShaderSource(ShaderID, 1, &CharContent, &Length);
     glCompileShader(ShaderID);
 
     int Success;
@@ -77,27 +180,77 @@ Shader::loadAndCompileShader(std::string filename, GLuint shaderType) {
     return ShaderID;
 }
 
+bool
+Shader::Cook(const std::string& filename) {
+    std::ifstream In(filename);
+    if (!In) {
+        std::cerr << "[Err] Failed to open shader " << filename << std::endl;
+        return false;
+    }
+    In.close();
+
+    std::ofstream Out;
+    if (!CookedFile::OpenWrite(filename, COOKED_SHADER_EXTENSION, COOKED_SHADER_MAGIC, Out)) {
+        return false;
+    }
+    CookedFile::WriteString(Out, stripShaderSource(readSource(filename)));
+    return (bool)Out;
+}
+
+std::string
+Shader::readSource(const std::string& filename) {
+    std::vector<unsigned char> Bytes;
+    CookedFile::ReadFile(filename, Bytes);
+    return std::string(Bytes.begin(), Bytes.end());
+}
+
 unsigned
 Shader::createBasicProgram(unsigned vShader, unsigned fShader) {
-    unsigned ProgramID = 0;
-    ProgramID = glCreateProgram();
-    glAttachShader(ProgramID, vShader);
-    glAttachShader(ProgramID, fShader);
-    glLinkProgram(ProgramID);
+    // Deleted again if linking fails
+    GLProgram Program = GLProgram::Create();
+    glAttachShader(Program.Get(), vShader);
+    glAttachShader(Program.Get(), fShader);
+    glLinkProgram(Program.Get());
 
     int Success;
     char InfoLog[512];
-    glGetProgramiv(ProgramID, GL_LINK_STATUS, &Success);
+    glGetProgramiv(Program.Get(), GL_LINK_STATUS, &Success);
     if (!Success) {
-        glGetProgramInfoLog(ProgramID, 512, NULL, InfoLog);
+        glGetProgramInfoLog(Program.Get(), 512, NULL, InfoLog);
         std::cerr << "[Err] Failed to link shader program:" << std::endl << InfoLog << std::endl;
         return 0;
     }
 
-    glDetachShader(ProgramID, vShader);
-    glDetachShader(ProgramID, fShader);
+    glDetachShader(Program.Get(), vShader);
+    glDetachShader(Program.Get(), fShader);
     glDeleteShader(vShader);
     glDeleteShader(fShader);
 
-    return ProgramID;
-}
\ No newline at end of file
+    return Program.Release();
+}
+unsigned
+Shader::createFeedbackProgram(unsigned vShader, const std::vector<std::string>& feedbackVaryings) {
+    GLProgram Program = GLProgram::Create();
+    glAttachShader(Program.Get(), vShader);
+    // Varyings have to be known before linking
+    std::vector<const char*> Varyings;
+    for (const std::string& Varying : feedbackVaryings) {
+        Varyings.push_back(Varying.c_str());
+    }
+    glTransformFeedbackVaryings(Program.Get(), Varyings.size(), Varyings.data(), GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(Program.Get());
+
+    int Success;
+    char InfoLog[512];
+    glGetProgramiv(Program.Get(), GL_LINK_STATUS, &Success);
+    if (!Success) {
+        glGetProgramInfoLog(Program.Get(), 512, NULL, InfoLog);
+        std::cerr << "[Err] Failed to link transform feedback program:" << std::endl << InfoLog << std::endl;
+        return 0;
+    }
+
+    glDetachShader(Program.Get(), vShader);
+    glDeleteShader(vShader);
+
+    return Program.Release();
+}
@@ -4,14 +4,25 @@
 #include <fstream>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include "gl_handle.hpp"
+
+// Uniform locations remembered per program, a power of two. Names past it are looked up every time
+#define SHADER_UNIFORM_CACHE_SIZE 64
 
 class Shader {
 public:
     static const unsigned POSITION_LOCATION = 0;
     static const unsigned COLOR_LOCATION = 1;
-    unsigned mId;
 
     Shader(const std::string& vShaderPath, const std::string& fShaderPath);
+
+    /**
+     * @brief Ctor - vertex only program whose outputs are captured with transform feedback
+     *
+     * @param vShaderPath Vertex shader path
+     * @param feedbackVaryings Captured outputs, interleaved into one buffer in this order
+     */
+    Shader(const std::string& vShaderPath, const std::vector<std::string>& feedbackVaryings);
     unsigned GetId() const;
 
     /**
@@ -20,7 +31,7 @@ public:
      * @param uniform Name of uniform
      * @param v Value
      */
-    void SetUniform1i(const std::string& uniform, int v) const;
+    void SetUniform1i(const char* uniform, int v) const;
 
     /**
      * @brief Sets float uniform value
@@ -28,7 +39,7 @@ public:
      * @param uniform Name of uniform
      * @param v Value
      */
-    void SetUniform1f(const std::string& uniform, float v) const;
+    void SetUniform1f(const char* uniform, float v) const;
 
     /**
     * @brief Sets float uniform value
@@ -36,7 +47,24 @@ public:
     * @param uniform Name of uniform
     * @param v Value
     */
-    void SetUniform3f(const std::string& uniform, const glm::vec3& v) const;
+    void SetUniform3f(const char* uniform, const glm::vec3& v) const;
+
+    /**
+     * @brief Sets vec2 uniform value
+     *
+     * @param uniform Name of uniform
+     * @param v Value
+     */
+    void SetUniform2f(const char* uniform, const glm::vec2& v) const;
+
+    /**
+     * @brief Sets vec4 array uniform values
+     *
+     * @param uniform Name of uniform array
+     * @param v Values
+     * @param count Number of array elements
+     */
+    void SetUniform4fv(const char* uniform, const glm::vec4* v, unsigned count) const;
 
     /**
      * @brief Sets 4x4 matrix uniform value
@@ -44,7 +72,16 @@ public:
      * @param uniform Name of uniform
      * @param m GLM matrix
      */
-    void SetUniform4m(const std::string& uniform, const glm::mat4& m) const;
+    void SetUniform4m(const char* uniform, const glm::mat4& m) const;
+
+    /**
+     * @brief Assigns a uniform block to a uniform buffer binding point.
+     * Does nothing if the program has no such block
+     *
+     * @param block Name of the uniform block
+     * @param binding Binding point index
+     */
+    void SetUniformBlockBinding(const std::string& block, unsigned binding) const;
 
     /**
      * @brief Sets the Model matrix
@@ -66,8 +103,27 @@ public:
      * @param m Projection matrix
      */
     void SetProjection(const glm::mat4& m) const;
+
+    /**
+     * @brief Writes a cooked copy of a shader with comments and indentation stripped,
+     * which the constructors load instead. Used by the offline cooker, doesn't touch OpenGL
+     *
+     * @param filename Shader path
+     *
+     * @returns true - Success, false - Failure
+     */
+    static bool Cook(const std::string& filename);
 private:
 
+    /**
+     * @brief Reads a whole shader source file
+     *
+     * @param filename File path to be loaded
+     *
+     * @returns Source, empty if the file can't be read
+     */
+    static std::string readSource(const std::string& filename);
+
     /**
      * @brief Loads shader from file and returns the compiled shader's ID
      *
@@ -86,4 +142,32 @@ private:
      * @returns Shader program ID
      */
     unsigned createBasicProgram(unsigned vShader, unsigned fShader);
+
+    /**
+     * @brief Creates a vertex only transform feedback program and returns the ID
+     *
+     * @param vShader Compiled vertex shader
+     * @param feedbackVaryings Captured outputs, interleaved
+     *
+     * @returns Shader program ID, 0 if linking failed
+     */
+    unsigned createFeedbackProgram(unsigned vShader, const std::vector<std::string>& feedbackVaryings);
+
+    /**
+     * @brief Returns the location of a uniform, asking GL only the first time a name is used
+     *
+     * @param name Name of uniform
+     *
+     * @returns Location, -1 if the program has no such uniform
+     */
+    int getUniformLocation(const char* name) const;
+
+    // Open addressing table keyed by the name's hash. Names are copied once, on their first lookup
+    struct UniformSlot {
+        unsigned long long Hash;
+        std::string Name;
+        int Location;
+    };
+    mutable std::vector<UniformSlot> mUniforms;
+    GLProgram mProgram;
 };
\ No newline at end of file
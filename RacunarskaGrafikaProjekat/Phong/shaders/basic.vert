@@ -6,16 +6,25 @@ layout (location = 2) in vec2 aUV;
 
 uniform mat4 uProjection;
 uniform mat4 uView;
-uniform mat4 uModel;
+// Per draw data written to the stream buffer, see DrawData in main.cpp
+layout (std140) uniform PerDraw {
+	mat4 uModel;
+	vec4 uColor;
+};
 
 out vec2 UV;
 out vec3 vWorldSpaceFragment;
 out vec3 vWorldSpaceNormal;
+// Always negative, the 2D diffuse texture is used
+flat out float vLayer;
+// Depth pre-pass computes the same position in depth.vert
+invariant gl_Position;
 
 void main() {
 	vWorldSpaceFragment = vec3(uModel * vec4(aPos, 1.0f));
 	vWorldSpaceNormal = normalize(mat3(transpose(inverse(uModel))) * aNormal);
+	vLayer = -1.0f;
 
 	UV = aUV;
-	gl_Position = uProjection * uView * uModel * vec4(aPos, 1.0f);
-}
\ No newline at end of file
+	gl_Position = uProjection * uView * vec4(vWorldSpaceFragment, 1.0f);
+}
@@ -1,8 +1,13 @@
 #version 330 core
 
-uniform vec3 uColor;
+// Per draw data written to the stream buffer, see DrawData in main.cpp
+layout (std140) uniform PerDraw {
+	mat4 uModel;
+	vec4 uColor;
+};
+
 out vec4 FragColor;
 
 void main() {
-	FragColor = vec4(uColor, 1.0f);
+	FragColor = vec4(uColor.rgb, 1.0f);
 }
\ No newline at end of file
@@ -4,7 +4,11 @@ layout (location = 0) in vec3 aPos;
 
 uniform mat4 uProjection;
 uniform mat4 uView;
-uniform mat4 uModel;
+// Per draw data written to the stream buffer, see DrawData in main.cpp
+layout (std140) uniform PerDraw {
+	mat4 uModel;
+	vec4 uColor;
+};
 
 void main() {
 	gl_Position = uProjection * uView * uModel * vec4(aPos, 1.0f);
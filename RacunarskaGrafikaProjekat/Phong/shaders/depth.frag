@@ -0,0 +1,5 @@
+#version 330 core
+
+// Depth only, color writes are masked during the pre-pass
+void main() {
+}
@@ -0,0 +1,20 @@
+#version 330 core
+
+// Depth pre-pass, reads only the position stream
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+// Per draw data written to the stream buffer, see DrawData in main.cpp
+layout (std140) uniform PerDraw {
+	mat4 uModel;
+	vec4 uColor;
+};
+
+// Has to match basic.vert bit for bit, otherwise the GL_LEQUAL color pass drops fragments
+invariant gl_Position;
+
+void main() {
+	vec3 WorldSpacePosition = vec3(uModel * vec4(aPos, 1.0f));
+	gl_Position = uProjection * uView * vec4(WorldSpacePosition, 1.0f);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+
+// Fullscreen triangle generated from the vertex index, draw 3 vertices with an empty VAO
+out vec2 UV;
+
+void main() {
+	vec2 Corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	UV = Corner;
+	gl_Position = vec4(Corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}
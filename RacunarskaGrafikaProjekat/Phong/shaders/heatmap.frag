@@ -0,0 +1,10 @@
+#version 330 core
+
+// Color of the overdraw level being drawn, the stencil test picks the pixels
+uniform vec3 uColor;
+
+out vec4 FragColor;
+
+void main() {
+	FragColor = vec4(uColor, 1.0f);
+}
@@ -0,0 +1,39 @@
+#version 330 core
+
+struct DirectionalLight {
+	vec3 Position;
+	vec3 Direction;
+	vec3 Ka;
+	vec3 Kd;
+	vec3 Ks;
+	float InnerCutOff;
+	float OuterCutOff;
+	float Kc;
+	float Kl;
+	float Kq;
+};
+
+uniform DirectionalLight uDirLight;
+uniform sampler2DArray uImpostorAlbedo;
+uniform sampler2DArray uImpostorNormal;
+
+in vec3 vUV;
+flat in float vYaw;
+
+out vec4 FragColor;
+
+void main() {
+	vec4 Albedo = texture(uImpostorAlbedo, vUV);
+	if (Albedo.a < 0.5f) {
+		discard;
+	}
+
+	// Baked normals are in palm space
+	vec3 BakedNormal = texture(uImpostorNormal, vUV).rgb * 2.0f - 1.0f;
+	float C = cos(vYaw);
+	float S = sin(vYaw);
+	vec3 Normal = normalize(mat3(C, 0.0f, -S, 0.0f, 1.0f, 0.0f, S, 0.0f, C) * BakedNormal);
+	// Far away only the sun is noticeable
+	float Diffuse = max(dot(Normal, normalize(-uDirLight.Direction)), 0.0f);
+	FragColor = vec4((uDirLight.Ka + uDirLight.Kd * Diffuse) * Albedo.rgb, 1.0f);
+}
@@ -0,0 +1,41 @@
+#version 330 core
+
+// Per instance: trunk base and scale, then yaw in radians. Quad corners come from gl_VertexID
+layout (location = 0) in vec4 aPositionScale;
+layout (location = 1) in float aYaw;
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+uniform vec3 uViewPos;
+
+// Palm bounds the impostors were baked with, see Vegetation::bakeImpostors
+uniform float uImpostorRadius;
+uniform float uImpostorBottom;
+uniform float uImpostorTop;
+
+out vec3 vUV;
+flat out float vYaw;
+
+const float PI = 3.14159265f;
+// Same as VEGETATION_IMPOSTOR_VIEWS
+const float VIEWS = 8.0f;
+
+void main() {
+	vec2 Corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	vec3 Base = aPositionScale.xyz;
+	float Scale = aPositionScale.w;
+
+	// Turns around Y only, so trunks stay upright when looked at from above
+	vec2 ToCamera = uViewPos.xz - Base.xz;
+	vec2 Eye = length(ToCamera) > 1e-4f ? normalize(ToCamera) : vec2(0.0f, 1.0f);
+	vec3 Right = vec3(Eye.y, 0.0f, -Eye.x);
+	// View baked closest to the camera direction in palm space
+	float Slice = mod(round((atan(Eye.x, Eye.y) - aYaw) / (2.0f * PI / VIEWS)), VIEWS);
+
+	vec3 Position = Base
+		+ Right * mix(-uImpostorRadius, uImpostorRadius, Corner.x) * Scale
+		+ vec3(0.0f, mix(uImpostorBottom, uImpostorTop, Corner.y) * Scale, 0.0f);
+	vUV = vec3(Corner, Slice);
+	vYaw = aYaw;
+	gl_Position = uProjection * uView * vec4(Position, 1.0f);
+}
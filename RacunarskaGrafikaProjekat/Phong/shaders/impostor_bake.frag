@@ -0,0 +1,18 @@
+#version 330 core
+
+uniform sampler2DArray uDiffuseArray;
+
+in vec2 UV;
+in vec3 vWorldSpaceFragment;
+in vec3 vWorldSpaceNormal;
+flat in float vLayer;
+
+// Impostor texture arrays, alpha marks covered texels
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 Normal;
+
+void main() {
+	Albedo = vec4(texture(uDiffuseArray, vec3(UV, vLayer)).rgb, 1.0f);
+	// Palm space normal, the impostor shader turns it by the instance yaw
+	Normal = vec4(normalize(vWorldSpaceNormal) * 0.5f + 0.5f, 1.0f);
+}
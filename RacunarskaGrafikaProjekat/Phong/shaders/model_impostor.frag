@@ -0,0 +1,63 @@
+#version 330 core
+
+struct DirectionalLight {
+	vec3 Position;
+	vec3 Direction;
+	vec3 Ka;
+	vec3 Kd;
+	vec3 Ks;
+	float InnerCutOff;
+	float OuterCutOff;
+	float Kc;
+	float Kl;
+	float Kq;
+};
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+uniform mat4 uModel;
+uniform DirectionalLight uDirLight;
+uniform float uImpostorRadius;
+uniform sampler2D uAlbedoAtlas;
+uniform sampler2D uNormalDepthAtlas;
+
+in vec2 vCorner;
+in vec3 vObjectSpacePosition;
+flat in vec3 vObjectSpaceDirection;
+flat in vec4 vFrames01;
+flat in vec4 vFrames23;
+flat in vec4 vFrameWeights;
+
+out vec4 FragColor;
+
+// Same as MODEL_IMPOSTOR_FRAMES
+const float FRAMES = 12.0f;
+
+void main() {
+	vec2 FrameUV = vCorner / FRAMES;
+	vec2 Origins[4] = vec2[4](vFrames01.xy, vFrames01.zw, vFrames23.xy, vFrames23.zw);
+	vec4 Albedo = vec4(0.0f);
+	vec4 NormalDepth = vec4(0.0f);
+	for (int Frame = 0; Frame < 4; ++Frame) {
+		// Weighted by coverage too, so empty texels of one frame don't darken the others
+		vec4 FrameAlbedo = texture(uAlbedoAtlas, Origins[Frame] + FrameUV);
+		float Weight = vFrameWeights[Frame] * FrameAlbedo.a;
+		Albedo += vec4(FrameAlbedo.rgb * Weight, Weight);
+		NormalDepth += texture(uNormalDepthAtlas, Origins[Frame] + FrameUV) * Weight;
+	}
+	if (Albedo.a < 0.5f) {
+		discard;
+	}
+	Albedo.rgb /= Albedo.a;
+	NormalDepth /= Albedo.a;
+
+	// Baked depth moves the fragment off the quad to where the model surface was
+	vec3 ObjectSpacePosition = vObjectSpacePosition - vObjectSpaceDirection * (NormalDepth.a * 2.0f - 1.0f) * uImpostorRadius;
+	vec4 ClipPosition = uProjection * uView * uModel * vec4(ObjectSpacePosition, 1.0f);
+	gl_FragDepth = ClipPosition.z / ClipPosition.w * 0.5f + 0.5f;
+
+	// Far away only the sun is noticeable
+	vec3 Normal = normalize(mat3(uModel) * (NormalDepth.rgb * 2.0f - 1.0f));
+	float Diffuse = max(dot(Normal, normalize(-uDirLight.Direction)), 0.0f);
+	FragColor = vec4((uDirLight.Ka + uDirLight.Kd * Diffuse) * Albedo.rgb, 1.0f);
+}
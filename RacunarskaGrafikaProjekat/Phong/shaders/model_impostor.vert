@@ -0,0 +1,61 @@
+#version 330 core
+
+// No vertex attributes, quad corners come from gl_VertexID
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+uniform mat4 uModel;
+uniform vec3 uViewPos;
+
+// Object space bounding sphere the frames were baked with, see ModelImpostor
+uniform vec3 uImpostorCenter;
+uniform float uImpostorRadius;
+
+// Quad corner in [0, 1], the same in every frame
+out vec2 vCorner;
+out vec3 vObjectSpacePosition;
+flat out vec3 vObjectSpaceDirection;
+// Atlas origins of the four frames around the view direction and their weights
+flat out vec4 vFrames01;
+flat out vec4 vFrames23;
+flat out vec4 vFrameWeights;
+
+// Same as MODEL_IMPOSTOR_FRAMES
+const float FRAMES = 12.0f;
+
+vec2 octahedronPoint(vec3 direction) {
+	direction /= abs(direction.x) + abs(direction.y) + abs(direction.z);
+	vec2 Point = direction.xz;
+	if (direction.y < 0.0f) {
+		Point = (1.0f - abs(direction.zx)) * vec2(direction.x >= 0.0f ? 1.0f : -1.0f, direction.z >= 0.0f ? 1.0f : -1.0f);
+	}
+	return Point;
+}
+
+vec3 frameUp(vec3 direction) {
+	return abs(direction.y) > 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+}
+
+void main() {
+	vec2 Corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	// Uniform scale, so the transposed rotation takes world directions to object space
+	mat3 Rotation = mat3(uModel);
+	vec3 WorldCenter = vec3(uModel * vec4(uImpostorCenter, 1.0f));
+	vec3 Direction = normalize(transpose(Rotation) * (uViewPos - WorldCenter));
+
+	// Grid of frames over the map, blended bilinearly between the four around the direction
+	vec2 Grid = (octahedronPoint(Direction) * 0.5f + 0.5f) * (FRAMES - 1.0f);
+	vec2 Base = min(floor(Grid), vec2(FRAMES - 2.0f));
+	vec2 Blend = Grid - Base;
+	vFrames01 = vec4(Base, Base + vec2(1.0f, 0.0f)) / FRAMES;
+	vFrames23 = vec4(Base + vec2(0.0f, 1.0f), Base + vec2(1.0f)) / FRAMES;
+	vFrameWeights = vec4((1.0f - Blend.x) * (1.0f - Blend.y), Blend.x * (1.0f - Blend.y), (1.0f - Blend.x) * Blend.y, Blend.x * Blend.y);
+
+	// Oriented like the frame baked from exactly this direction
+	vec3 Right = normalize(cross(-Direction, frameUp(Direction)));
+	vec3 Up = cross(Right, -Direction);
+	vCorner = Corner;
+	vObjectSpacePosition = uImpostorCenter + (Right * (Corner.x * 2.0f - 1.0f) + Up * (Corner.y * 2.0f - 1.0f)) * uImpostorRadius;
+	vObjectSpaceDirection = Direction;
+	gl_Position = uProjection * uView * uModel * vec4(vObjectSpacePosition, 1.0f);
+}
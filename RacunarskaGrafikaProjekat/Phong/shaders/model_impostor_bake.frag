@@ -0,0 +1,16 @@
+#version 330 core
+
+uniform sampler2D uDiffuse;
+
+in vec2 UV;
+in vec3 vObjectSpaceNormal;
+
+// Impostor atlases, alpha marks covered texels
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalDepth;
+
+void main() {
+	Albedo = vec4(texture(uDiffuse, UV).rgb, 1.0f);
+	// Orthographic depth is linear from one radius in front of the center to one radius behind
+	NormalDepth = vec4(normalize(vObjectSpaceNormal) * 0.5f + 0.5f, gl_FragCoord.z);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Mesh vertex layout, see MESH_VERTEX_STRIDE
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aUV;
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+
+out vec2 UV;
+out vec3 vObjectSpaceNormal;
+
+void main() {
+	UV = aUV;
+	vObjectSpaceNormal = aNormal;
+	gl_Position = uProjection * uView * vec4(aPos, 1.0f);
+}
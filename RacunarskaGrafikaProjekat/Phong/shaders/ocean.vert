@@ -0,0 +1,91 @@
+#version 330 core
+
+// Integer grid coordinates of the clipmap level, see Ocean in ocean.hpp
+layout (location = 0) in vec2 aGrid;
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+uniform vec3 uViewPos;
+
+// World XZ of the clipmap center, shared by all levels so their edges line up
+uniform vec2 uOceanCenter;
+uniform float uOceanHeight;
+// Cell size and half extent of the current level
+uniform float uCellSize;
+uniform float uLevelExtent;
+uniform float uTime;
+// World units covered by one repeat of the ocean textures
+uniform float uTextureScale;
+
+// Gerstner waves: XY direction (normalized), Z steepness, W wavelength
+const int WAVE_COUNT = 4;
+uniform vec4 uWaves[WAVE_COUNT];
+
+// FFT spectrum maps, see OceanSpectrum. Displacement is XYZ, slopes are height derivatives along X and Z
+uniform bool uUseSpectrum;
+uniform sampler2D uDisplacementMap;
+uniform sampler2D uSlopeMap;
+uniform float uSpectrumPatchSize;
+uniform float uSpectrumTexelSize;
+
+out vec2 UV;
+out vec3 vWorldSpaceFragment;
+out vec3 vWorldSpaceNormal;
+flat out float vLayer;
+// Depth pre-pass runs this shader too
+invariant gl_Position;
+
+const float GRAVITY = 9.81f;
+const float PI = 3.14159265f;
+// Waves fade out between these multiples of their wavelength from the camera, before the grid gets too coarse for them
+const float WAVE_FADE_START = 20.0f;
+const float WAVE_FADE_END = 40.0f;
+
+void main() {
+	// Near the outer edge odd vertices slide onto their even neighbors, so the edge matches
+	// the next coarser level exactly and no cracks open between levels
+	vec2 LevelPosition = aGrid * uCellSize;
+	float EdgeDistance = max(abs(LevelPosition.x), abs(LevelPosition.y)) / uLevelExtent;
+	float Morph = clamp((EdgeDistance - 0.75f) / 0.2f, 0.0f, 1.0f);
+	vec2 Grid = aGrid - mod(aGrid, 2.0f) * Morph;
+	vec2 WorldXZ = uOceanCenter + Grid * uCellSize;
+
+	vec3 Position = vec3(WorldXZ.x, uOceanHeight, WorldXZ.y);
+	vec3 Normal;
+	if (uUseSpectrum) {
+		// Mip level matches the cell size, so coarse levels read waves averaged down to what they can show.
+		// It morphs along with the grid, so edge vertices read the same level as the next coarser ring
+		vec2 SpectrumUV = WorldXZ / uSpectrumPatchSize;
+		float Lod = max(log2(uCellSize / uSpectrumTexelSize) + Morph, 0.0f);
+		Position += textureLod(uDisplacementMap, SpectrumUV, Lod).xyz;
+		vec2 Slope = textureLod(uSlopeMap, SpectrumUV, Lod).xy;
+		Normal = normalize(vec3(-Slope.x, 1.0f, -Slope.y));
+	} else {
+		float CameraDistance = length(WorldXZ - uViewPos.xz);
+		vec3 Tangent = vec3(1.0f, 0.0f, 0.0f);
+		vec3 Binormal = vec3(0.0f, 0.0f, 1.0f);
+		for (int WaveIdx = 0; WaveIdx < WAVE_COUNT; ++WaveIdx) {
+			vec2 Direction = uWaves[WaveIdx].xy;
+			float Wavelength = uWaves[WaveIdx].w;
+			float Fade = 1.0f - smoothstep(Wavelength * WAVE_FADE_START, Wavelength * WAVE_FADE_END, CameraDistance);
+			float Steepness = uWaves[WaveIdx].z * Fade;
+			float K = 2.0f * PI / Wavelength;
+			float Speed = sqrt(GRAVITY / K);
+			float Phase = K * (dot(Direction, WorldXZ) - Speed * uTime);
+			float Amplitude = Steepness / K;
+			float Sin = sin(Phase);
+			float Cos = cos(Phase);
+
+			Position += vec3(Direction.x * Amplitude * Cos, Amplitude * Sin, Direction.y * Amplitude * Cos);
+			Tangent += vec3(-Direction.x * Direction.x * Steepness * Sin, Direction.x * Steepness * Cos, -Direction.x * Direction.y * Steepness * Sin);
+			Binormal += vec3(-Direction.x * Direction.y * Steepness * Sin, Direction.y * Steepness * Cos, -Direction.y * Direction.y * Steepness * Sin);
+		}
+		Normal = normalize(cross(Binormal, Tangent));
+	}
+
+	vWorldSpaceFragment = Position;
+	vWorldSpaceNormal = Normal;
+	vLayer = -1.0f;
+	UV = WorldXZ / uTextureScale;
+	gl_Position = uProjection * uView * vec4(vWorldSpaceFragment, 1.0f);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+
+in vec2 vCorner;
+in vec4 vColor;
+in float vViewDepth;
+
+uniform mat4 uProjection;
+// Copy of the scene depth buffer, see ParticleSystem::CaptureSceneDepth
+uniform sampler2D uSceneDepth;
+
+out vec4 FragColor;
+
+// View space distance over which particles fade out in front of geometry
+const float SOFT_DISTANCE = 0.3f;
+
+void main() {
+	float Falloff = max(1.0f - dot(vCorner, vCorner), 0.0f);
+	// Window depth back to view space distance, inverse of the projection's Z row
+	float SceneDepth = texelFetch(uSceneDepth, ivec2(gl_FragCoord.xy), 0).r * 2.0f - 1.0f;
+	float SceneViewDepth = uProjection[3][2] / (SceneDepth + uProjection[2][2]);
+	float Soft = clamp((SceneViewDepth - vViewDepth) / SOFT_DISTANCE, 0.0f, 1.0f);
+	FragColor = vColor * (Falloff * Soft);
+}
@@ -0,0 +1,47 @@
+#version 330 core
+
+// One particle per instance, see ParticleSystem in particles.hpp
+layout (location = 0) in vec4 aPositionAge;
+layout (location = 1) in float aLifetime;
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+
+// Quad corner in [-1, 1]
+out vec2 vCorner;
+// Premultiplied color
+out vec4 vColor;
+out float vViewDepth;
+
+// Part of the life spent as fire, the rest is smoke
+const float FIRE_END = 0.35f;
+const float FIRE_SIZE = 0.04f;
+const float SMOKE_SIZE = 0.15f;
+// Thousands of particles overlap in each fire, so each one only adds a little
+const float FIRE_INTENSITY = 0.03f;
+const vec3 SMOKE_COLOR = vec3(0.35f);
+const float SMOKE_OPACITY = 0.04f;
+
+void main() {
+	// Triangle strip corners from the vertex index, the quad needs no vertex buffer
+	vec2 Corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0f - 1.0f;
+	float Age = aPositionAge.w;
+	float T = clamp(Age / max(aLifetime, 1e-3f), 0.0f, 1.0f);
+
+	float Fire = 1.0f - smoothstep(FIRE_END - 0.1f, FIRE_END + 0.05f, T);
+	float Smoke = smoothstep(FIRE_END - 0.1f, FIRE_END + 0.1f, T) * (1.0f - smoothstep(0.6f, 1.0f, T)) * SMOKE_OPACITY;
+	vec3 FireColor = mix(vec3(1.0f, 0.85f, 0.4f), vec3(1.0f, 0.25f, 0.05f), clamp(T / FIRE_END, 0.0f, 1.0f)) * FIRE_INTENSITY;
+	// Fire only adds light, its alpha stays 0 so it doesn't darken what is behind it
+	vColor = vec4(FireColor * Fire + SMOKE_COLOR * Smoke, Smoke);
+	vCorner = Corner;
+
+	// Corners are offset in view space, so quads always face the camera
+	vec4 ViewPosition = uView * vec4(aPositionAge.xyz, 1.0f);
+	ViewPosition.xy += Corner * mix(FIRE_SIZE, SMOKE_SIZE, T);
+	vViewDepth = -ViewPosition.z;
+	gl_Position = uProjection * ViewPosition;
+	// Particles waiting for their first spawn are moved outside the clip volume
+	if (Age < 0.0f) {
+		gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+	}
+}
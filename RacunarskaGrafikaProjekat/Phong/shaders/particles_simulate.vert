@@ -0,0 +1,71 @@
+#version 330 core
+
+// One particle per vertex, see PARTICLE_FLOATS in particle_simulation.hpp. ParticleSimulation
+// runs the same simulation on the CPU, changes here have to be made there too
+layout (location = 0) in vec4 aPositionAge;
+layout (location = 1) in vec4 aVelocityLifetime;
+
+uniform float uDT;
+uniform int uFrame;
+// Emitters: XYZ position, W spawn disk radius
+const int MAX_EMITTERS = 8;
+uniform vec4 uEmitters[MAX_EMITTERS];
+uniform int uEmitterCount;
+uniform float uLifetime;
+uniform float uRiseSpeed;
+uniform float uSpread;
+uniform float uBuoyancy;
+uniform float uDrag;
+uniform vec3 uWind;
+uniform int uSeed;
+
+// Captured with transform feedback into the other particle buffer
+out vec4 vPositionAge;
+out vec4 vVelocityLifetime;
+
+const float TWO_PI = 6.28318531f;
+// Particles waiting for their first spawn have a lifetime of 0
+const float MIN_LIFETIME = 1e-3f;
+
+// Same as Noise::Hash
+uint hash(uint x, uint z, uint seed) {
+	uint Hash = (x * 0x27d4eb2du) ^ (z * 0x165667b1u) ^ seed;
+	Hash ^= Hash >> 15;
+	Hash *= 0x2c1b3c6du;
+	Hash ^= Hash >> 12;
+	Hash *= 0x297a2d39u;
+	Hash ^= Hash >> 15;
+	return Hash;
+}
+
+void main() {
+	vec3 Position = aPositionAge.xyz;
+	float Age = aPositionAge.w + uDT;
+	vec3 Velocity = aVelocityLifetime.xyz;
+	float Lifetime = aVelocityLifetime.w;
+
+	if (Age >= Lifetime) {
+		vec4 Emitter = uEmitters[gl_VertexID % uEmitterCount];
+		uint Hash0 = hash(uint(gl_VertexID), uint(uFrame), uint(uSeed));
+		uint Hash1 = hash(uint(gl_VertexID), uint(uFrame), uint(uSeed) + 1u);
+		float Angle = float(Hash0 & 0xffffu) / 65536.0f * TWO_PI;
+		float Radius = sqrt(float(Hash0 >> 16) / 65536.0f) * Emitter.w;
+		float Speed = 0.75f + 0.5f * (float(Hash1 & 0xffffu) / 65536.0f);
+		float Life = 0.75f + 0.5f * (float(Hash1 >> 16) / 65536.0f);
+		vec2 Offset = vec2(cos(Angle), sin(Angle)) * Radius;
+
+		Age -= Lifetime;
+		Lifetime = uLifetime * Life;
+		Position = Emitter.xyz + vec3(Offset.x, 0.0f, Offset.y);
+		Velocity = vec3(Offset.x * uSpread, uRiseSpeed * Speed, Offset.y * uSpread);
+	}
+
+	// Hot young particles rise, then drift with the wind as smoke
+	float T = clamp(Age / max(Lifetime, MIN_LIFETIME), 0.0f, 1.0f);
+	vec3 Acceleration = vec3(0.0f, uBuoyancy * (1.0f - T), 0.0f) + (uWind - Velocity) * uDrag;
+	Velocity += Acceleration * uDT;
+	Position += Velocity * uDT;
+
+	vPositionAge = vec4(Position, Age);
+	vVelocityLifetime = vec4(Velocity, Lifetime);
+}
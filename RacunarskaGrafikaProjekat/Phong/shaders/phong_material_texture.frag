@@ -46,13 +46,20 @@ uniform vec3 uSpotLightPosition2;
 uniform vec3 uSpotLightDirection1;
 uniform vec3 uSpotLightDirection2;
 
+// Diffuse textures of batched surfaces, layer is selected per instance
+uniform sampler2DArray uDiffuseArray;
+
 in vec2 UV;
 in vec3 vWorldSpaceFragment;
 in vec3 vWorldSpaceNormal;
+flat in float vLayer;
 
 out vec4 FragColor;
 
 void main() {
+	vec3 DiffuseTexel = vLayer >= 0.0f ? vec3(texture(uDiffuseArray, vec3(UV, vLayer))) : vec3(texture(uMaterial.Kd, UV));
+	vec3 SpecularTexel = vec3(texture(uMaterial.Ks, UV));
+
 	vec3 ViewDirection = normalize(uViewPos - vWorldSpaceFragment);
 	//Directional light
 	vec3 DirLightVector = normalize(-uDirLight.Direction);
@@ -61,9 +68,9 @@ void main() {
 	// 32 is the specular shininess factor. Hardcoded for now
 	float DirSpecular = pow(max(dot(ViewDirection, DirReflectDirection), 0.0f), uMaterial.Shininess);
 
-	vec3 DirAmbientColor = uDirLight.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 DirDiffuseColor = uDirLight.Kd * DirDiffuse * vec3(texture(uMaterial.Kd, UV));
-	vec3 DirSpecularColor = uDirLight.Ks * DirSpecular * vec3(texture(uMaterial.Ks, UV));
+	vec3 DirAmbientColor = uDirLight.Ka * DiffuseTexel;
+	vec3 DirDiffuseColor = uDirLight.Kd * DirDiffuse * DiffuseTexel;
+	vec3 DirSpecularColor = uDirLight.Ks * DirSpecular * SpecularTexel;
 	vec3 DirColor = DirAmbientColor + DirDiffuseColor + DirSpecularColor;
 
 	// Point light1 - srednja vatra
@@ -72,9 +79,9 @@ void main() {
 	vec3 PtReflectDirection = reflect(-PtLightVector, vWorldSpaceNormal);
 	float PtSpecular = pow(max(dot(ViewDirection, PtReflectDirection), 0.0f), uMaterial.Shininess);
 
-	vec3 PtAmbientColor = uPointLight.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtDiffuseColor = PtDiffuse * uPointLight.Kd * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtSpecularColor = PtSpecular * uPointLight.Ks * vec3(texture(uMaterial.Ks, UV));
+	vec3 PtAmbientColor = uPointLight.Ka * DiffuseTexel;
+	vec3 PtDiffuseColor = PtDiffuse * uPointLight.Kd * DiffuseTexel;
+	vec3 PtSpecularColor = PtSpecular * uPointLight.Ks * SpecularTexel;
 
 	float PtLightDistance = length(uPointLightPosition1 - vWorldSpaceFragment);
 	float PtAttenuation = 1.0f / (uPointLight.Kc + uPointLight.Kl * PtLightDistance + uPointLight.Kq * (PtLightDistance * PtLightDistance));
@@ -87,9 +94,9 @@ void main() {
 	PtReflectDirection = reflect(-PtLightVector, vWorldSpaceNormal);
 	PtSpecular = pow(max(dot(ViewDirection, PtReflectDirection), 0.0f), uMaterial.Shininess);
 
-	PtAmbientColor = uPointLight.Ka * vec3(texture(uMaterial.Kd, UV));
-	PtDiffuseColor = PtDiffuse * uPointLight.Kd * vec3(texture(uMaterial.Kd, UV));
-	PtSpecularColor = PtSpecular * uPointLight.Ks * vec3(texture(uMaterial.Ks, UV));
+	PtAmbientColor = uPointLight.Ka * DiffuseTexel;
+	PtDiffuseColor = PtDiffuse * uPointLight.Kd * DiffuseTexel;
+	PtSpecularColor = PtSpecular * uPointLight.Ks * SpecularTexel;
 
 	PtLightDistance = length(uPointLightPosition2 - vWorldSpaceFragment);
 	PtAttenuation = 1.0f / (uPointLight.Kc + uPointLight.Kl * PtLightDistance + uPointLight.Kq * (PtLightDistance * PtLightDistance));
@@ -101,9 +108,9 @@ void main() {
 	PtReflectDirection = reflect(-PtLightVector, vWorldSpaceNormal);
 	PtSpecular = pow(max(dot(ViewDirection, PtReflectDirection), 0.0f), uMaterial.Shininess);
 
-	PtAmbientColor = uPointLight.Ka * vec3(texture(uMaterial.Kd, UV));
-	PtDiffuseColor = PtDiffuse * uPointLight.Kd * vec3(texture(uMaterial.Kd, UV));
-	PtSpecularColor = PtSpecular * uPointLight.Ks * vec3(texture(uMaterial.Ks, UV));
+	PtAmbientColor = uPointLight.Ka * DiffuseTexel;
+	PtDiffuseColor = PtDiffuse * uPointLight.Kd * DiffuseTexel;
+	PtSpecularColor = PtSpecular * uPointLight.Ks * SpecularTexel;
 
 	PtLightDistance = length(uPointLightPosition3 - vWorldSpaceFragment);
 	PtAttenuation = 1.0f / (uPointLight.Kc + uPointLight.Kl * PtLightDistance + uPointLight.Kq * (PtLightDistance * PtLightDistance));
@@ -117,9 +124,9 @@ void main() {
 	vec3 SpotReflectDirection = reflect(-SpotlightVector, vWorldSpaceNormal);
 	float SpotSpecular = pow(max(dot(ViewDirection, SpotReflectDirection), 0.0f), uMaterial.Shininess);
 
-	vec3 SpotAmbientColor = uSpotlight.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 SpotDiffuseColor = SpotDiffuse * uSpotlight.Kd * vec3(texture(uMaterial.Kd, UV));
-	vec3 SpotSpecularColor = SpotSpecular * uSpotlight.Ks * vec3(texture(uMaterial.Ks, UV));
+	vec3 SpotAmbientColor = uSpotlight.Ka * DiffuseTexel;
+	vec3 SpotDiffuseColor = SpotDiffuse * uSpotlight.Kd * DiffuseTexel;
+	vec3 SpotSpecularColor = SpotSpecular * uSpotlight.Ks * SpecularTexel;
 
 	float SpotlightDistance = length(uSpotLightPosition1 - vWorldSpaceFragment);
 	float SpotAttenuation = 1.0f / (uSpotlight.Kc + uSpotlight.Kl * SpotlightDistance + uSpotlight.Kq * (SpotlightDistance * SpotlightDistance));
@@ -137,9 +144,9 @@ void main() {
 	SpotReflectDirection = reflect(-SpotlightVector, vWorldSpaceNormal);
 	SpotSpecular = pow(max(dot(ViewDirection, SpotReflectDirection), 0.0f), uMaterial.Shininess);
 
-	SpotAmbientColor = uSpotlight.Ka * vec3(texture(uMaterial.Kd, UV));
-	SpotDiffuseColor = SpotDiffuse * uSpotlight.Kd * vec3(texture(uMaterial.Kd, UV));
-	SpotSpecularColor = SpotSpecular * uSpotlight.Ks * vec3(texture(uMaterial.Ks, UV));
+	SpotAmbientColor = uSpotlight.Ka * DiffuseTexel;
+	SpotDiffuseColor = SpotDiffuse * uSpotlight.Kd * DiffuseTexel;
+	SpotSpecularColor = SpotSpecular * uSpotlight.Ks * SpecularTexel;
 
 	SpotlightDistance = length(uSpotLightPosition2 - vWorldSpaceFragment);
 	SpotAttenuation = 1.0f / (uSpotlight.Kc + uSpotlight.Kl * SpotlightDistance + uSpotlight.Kq * (SpotlightDistance * SpotlightDistance));
@@ -0,0 +1,39 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aUV;
+// Bone indices stored as floats, see ProcessGeometry in mesh.cpp
+layout (location = 3) in vec4 aBoneIndices;
+layout (location = 4) in vec4 aBoneWeights;
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+// Three RGBA32F texels per bone holding the top rows of its skinning matrix, model matrix included.
+// Instances follow each other, see SkinnedCrowd::Update
+uniform samplerBuffer uBones;
+uniform int uBoneCount;
+
+out vec2 UV;
+out vec3 vWorldSpaceFragment;
+out vec3 vWorldSpaceNormal;
+flat out float vLayer;
+
+mat4 boneMatrix(int bone) {
+	int Base = (gl_InstanceID * uBoneCount + bone) * 3;
+	return transpose(mat4(texelFetch(uBones, Base), texelFetch(uBones, Base + 1), texelFetch(uBones, Base + 2), vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+void main() {
+	mat4 Skin = boneMatrix(int(aBoneIndices.x)) * aBoneWeights.x
+		+ boneMatrix(int(aBoneIndices.y)) * aBoneWeights.y
+		+ boneMatrix(int(aBoneIndices.z)) * aBoneWeights.z
+		+ boneMatrix(int(aBoneIndices.w)) * aBoneWeights.w;
+	vWorldSpaceFragment = vec3(Skin * vec4(aPos, 1.0f));
+	// Bones and instances only rotate and scale uniformly, so the skinning matrix transforms normals as is
+	vWorldSpaceNormal = normalize(mat3(Skin) * aNormal);
+	vLayer = -1.0f;
+
+	UV = aUV;
+	gl_Position = uProjection * uView * vec4(vWorldSpaceFragment, 1.0f);
+}
@@ -0,0 +1,35 @@
+#version 330 core
+
+// Cell coordinates in the chunk, Z is 1 on skirt vertices. Shared by all chunks, see Terrain in terrain.hpp
+layout (location = 0) in vec3 aGrid;
+layout (location = 1) in float aHeight;
+layout (location = 2) in vec3 aNormal;
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+
+// World position of the chunk corner
+uniform vec3 uChunkOrigin;
+uniform float uCellSize;
+uniform float uSkirtDepth;
+// World units covered by one repeat of the sand texture
+uniform float uTextureScale;
+// Diffuse texture array layer
+uniform float uLayer;
+
+out vec2 UV;
+out vec3 vWorldSpaceFragment;
+out vec3 vWorldSpaceNormal;
+flat out float vLayer;
+// Depth pre-pass runs this shader too
+invariant gl_Position;
+
+void main() {
+	// Skirts hang straight down from the border, covering cracks to coarser neighbors
+	vec3 Position = uChunkOrigin + vec3(aGrid.x * uCellSize, aHeight - aGrid.z * uSkirtDepth, aGrid.y * uCellSize);
+	vWorldSpaceFragment = Position;
+	vWorldSpaceNormal = normalize(aNormal);
+	vLayer = uLayer;
+	UV = Position.xz / uTextureScale;
+	gl_Position = uProjection * uView * vec4(Position, 1.0f);
+}
@@ -0,0 +1,32 @@
+#version 330 core
+
+// Scene target, only the part given by uScale is rendered
+uniform sampler2D uScene;
+// Rendered part of the target in UV
+uniform vec2 uScale;
+// All taps stay below this UV, past it are stale pixels of larger frames
+uniform vec2 uMaxUV;
+uniform vec2 uTexelSize;
+// 0 keeps the bilinear upscale, 1 sharpens the most
+uniform float uSharpness;
+
+in vec2 UV;
+out vec4 FragColor;
+
+void main() {
+	vec2 Center = min(UV * uScale, uMaxUV);
+	vec3 C = texture(uScene, Center).rgb;
+	vec3 N = texture(uScene, min(Center + vec2(0.0f, uTexelSize.y), uMaxUV)).rgb;
+	vec3 S = texture(uScene, max(Center - vec2(0.0f, uTexelSize.y), vec2(0.0f))).rgb;
+	vec3 E = texture(uScene, min(Center + vec2(uTexelSize.x, 0.0f), uMaxUV)).rgb;
+	vec3 W = texture(uScene, max(Center - vec2(uTexelSize.x, 0.0f), vec2(0.0f))).rgb;
+
+	// Contrast adaptive sharpening: the cross is subtracted less where the neighborhood
+	// already spans a wide range, so edges don't ring and flat areas don't get noisy
+	vec3 MinRGB = min(C, min(min(N, S), min(E, W)));
+	vec3 MaxRGB = max(C, max(max(N, S), max(E, W)));
+	vec3 Amount = sqrt(clamp(min(MinRGB, 1.0f - MaxRGB) / max(MaxRGB, vec3(1e-4f)), 0.0f, 1.0f));
+	vec3 Weight = -Amount * mix(0.0f, 0.2f, uSharpness);
+	vec3 Sharpened = (C + (N + S + E + W) * Weight) / (1.0f + 4.0f * Weight);
+	FragColor = vec4(clamp(Sharpened, 0.0f, 1.0f), 1.0f);
+}
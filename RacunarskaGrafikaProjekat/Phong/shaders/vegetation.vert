@@ -0,0 +1,32 @@
+#version 330 core
+
+// Palm mesh, see Vegetation::buildMesh
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aUV;
+layout (location = 3) in float aLayer;
+// Per instance: trunk base and scale, then yaw in radians
+layout (location = 4) in vec4 aPositionScale;
+layout (location = 5) in float aYaw;
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+
+out vec2 UV;
+out vec3 vWorldSpaceFragment;
+out vec3 vWorldSpaceNormal;
+flat out float vLayer;
+// Depth pre-pass runs this shader too
+invariant gl_Position;
+
+void main() {
+	float C = cos(aYaw);
+	float S = sin(aYaw);
+	mat3 Rotation = mat3(C, 0.0f, -S, 0.0f, 1.0f, 0.0f, S, 0.0f, C);
+	vec3 Position = aPositionScale.xyz + Rotation * aPos * aPositionScale.w;
+	vWorldSpaceFragment = Position;
+	vWorldSpaceNormal = Rotation * aNormal;
+	vLayer = aLayer;
+	UV = aUV;
+	gl_Position = uProjection * uView * vec4(Position, 1.0f);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// SSE2 is part of x64 and enabled by default on x86 MSVC builds. Other targets use the scalar paths
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define SIMD_SSE 0
+#endif
+
+// AVX isn't guaranteed on x64, so AVX code paths are compiled separately and only called after
+// SimdHasAvx. MSVC emits AVX intrinsics without /arch:AVX, GCC and Clang need the target attribute
+#if SIMD_SSE
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_TARGET_AVX
+#else
+#include <cpuid.h>
+#define SIMD_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+// Number of floats processed together by SSE code paths. SoA arrays are padded to a multiple of it
+#define SIMD_WIDTH 4
+// Number of floats processed together by AVX code paths
+#define SIMD_AVX_WIDTH 8
+
+/**
+ * @brief Rounds count up to a multiple of SIMD_WIDTH
+ *
+ * @param count Element count
+ *
+ * @returns Padded element count
+ */
+inline unsigned
+SimdPadCount(unsigned count) {
+    return (count + SIMD_WIDTH - 1) & ~(SIMD_WIDTH - 1);
+}
+
+/**
+ * @brief Checks whether the CPU supports AVX and the OS saves the YMM registers
+ *
+ * @returns true if AVX code paths can be used
+ */
+inline bool
+SimdHasAvx() {
+#if SIMD_SSE
+    unsigned Ecx = 0;
+#if defined(_MSC_VER)
+    int Registers[4];
+    __cpuid(Registers, 1);
+    Ecx = Registers[2];
+#else
+    unsigned Eax, Ebx, Edx;
+    if (!__get_cpuid(1, &Eax, &Ebx, &Ecx, &Edx)) {
+        return false;
+    }
+#endif
+    // Bit 27 - OSXSAVE, bit 28 - AVX
+    if ((Ecx & (3u << 27)) != (3u << 27)) {
+        return false;
+    }
+
+    // XCR0 bits 1 and 2 - XMM and YMM state saved on context switches
+#if defined(_MSC_VER)
+    unsigned long long Xcr0 = _xgetbv(0);
+#else
+    unsigned Low, High;
+    __asm__ volatile("xgetbv" : "=a"(Low), "=d"(High) : "c"(0));
+    unsigned long long Xcr0 = ((unsigned long long)High << 32) | Low;
+#endif
+    return (Xcr0 & 6) == 6;
+#else
+    return false;
+#endif
+}
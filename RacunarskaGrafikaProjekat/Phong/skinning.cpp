@@ -0,0 +1,133 @@
+#include "skinning.hpp"
+#include <chrono>
+#include "model.hpp"
+#include "memory_accounting.hpp"
+
+SkinnedCrowd::SkinnedCrowd(Model& model, unsigned capacity) : mModel(model) {
+    mCapacity = IsAnimated() ? capacity : 0;
+    mUpdateMilliseconds = 0.0f;
+    if (!mCapacity) {
+        std::cout << mModel.mFilename << " has no animations, crowd stays empty" << std::endl;
+        return;
+    }
+
+    const unsigned BoneCount = mModel.GetSkeleton().GetCount();
+    mInstances.reserve(mCapacity);
+    const size_t Size = mCapacity * BoneCount * ANIMATION_MATRIX_FLOATS * sizeof(float);
+    mBuffer = GLBuffer::Create();
+    glBindBuffer(GL_TEXTURE_BUFFER, mBuffer.Get());
+    glBufferData(GL_TEXTURE_BUFFER, Size, 0, GL_STREAM_DRAW);
+    mTexture = GLTexture::Create();
+    glBindTexture(GL_TEXTURE_BUFFER, mTexture.Get());
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mBuffer.Get());
+    MemoryAccounting::Track(MEMORY_TEXTURE, mTexture.Get(), mModel.mFilename + " skinning matrices", Size);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+bool
+SkinnedCrowd::IsAnimated() const {
+    return mModel.GetSkeleton().GetCount() && !mModel.GetClips().empty();
+}
+
+unsigned
+SkinnedCrowd::Add(const glm::mat4& transform, unsigned clip, float phase) {
+    if (mInstances.size() >= mCapacity) {
+        return mCapacity;
+    }
+
+    const unsigned BoneCount = mModel.GetSkeleton().GetCount();
+    const unsigned ClipCount = mModel.GetClips().size();
+    Instance NewInstance = { transform, clip % ClipCount, clip % ClipCount, 0.0f, phase };
+    mInstances.push_back(NewInstance);
+    mPoses.push_back(AnimationPose(BoneCount));
+    mBlendPoses.push_back(AnimationPose(BoneCount));
+    return mInstances.size() - 1;
+}
+
+void
+SkinnedCrowd::SetTransform(unsigned idx, const glm::mat4& transform) {
+    mInstances[idx].Transform = transform;
+}
+
+void
+SkinnedCrowd::SetBlend(unsigned idx, unsigned clip, float weight) {
+    mInstances[idx].BlendClip = clip % mModel.GetClips().size();
+    mInstances[idx].BlendWeight = weight;
+}
+
+void
+SkinnedCrowd::Update(float dt, JobSystem& jobs) {
+    if (mInstances.empty()) {
+        return;
+    }
+
+    typedef std::chrono::high_resolution_clock Clock;
+    Clock::time_point Start = Clock::now();
+    const std::vector<AnimationClip>& Clips = mModel.GetClips();
+    for (Instance& CurrInstance : mInstances) {
+        // Blended clips share the phase, the cycle length blends with them
+        float Duration = Clips[CurrInstance.Clip].GetDuration() * (1.0f - CurrInstance.BlendWeight)
+            + Clips[CurrInstance.BlendClip].GetDuration() * CurrInstance.BlendWeight;
+        CurrInstance.Phase += dt / Duration;
+        CurrInstance.Phase -= (float)(int)CurrInstance.Phase;
+    }
+
+    // Written straight into the buffer that gets drawn, invalidating it avoids waiting on last frame's draw
+    glBindBuffer(GL_TEXTURE_BUFFER, mBuffer.Get());
+    const unsigned Size = mInstances.size() * mModel.GetSkeleton().GetCount() * ANIMATION_MATRIX_FLOATS * sizeof(float);
+    float* Skinning = (float*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, Size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (Skinning) {
+        jobs.ParallelFor(mInstances.size(), ANIMATION_JOB_SIZE, [this, Skinning](unsigned begin, unsigned end) {
+            animate(begin, end, Skinning);
+        });
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+    } else {
+        std::cerr << "[Err] Failed to map skinning buffer" << std::endl;
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    mUpdateMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - Start).count();
+}
+
+void
+SkinnedCrowd::Render(const Shader& shader) const {
+    if (mInstances.empty()) {
+        return;
+    }
+
+    shader.SetUniform1i("uBones", 5);
+    shader.SetUniform1i("uBoneCount", mModel.GetSkeleton().GetCount());
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_BUFFER, mTexture.Get());
+    mModel.RenderInstanced(mInstances.size());
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+unsigned
+SkinnedCrowd::GetCount() const {
+    return mInstances.size();
+}
+
+float
+SkinnedCrowd::GetUpdateMilliseconds() const {
+    return mUpdateMilliseconds;
+}
+
+void
+SkinnedCrowd::animate(unsigned begin, unsigned end, float* out) {
+    const Skeleton& Bones = mModel.GetSkeleton();
+    const std::vector<AnimationClip>& Clips = mModel.GetClips();
+    for (unsigned InstanceIdx = begin; InstanceIdx < end; ++InstanceIdx) {
+        const Instance& CurrInstance = mInstances[InstanceIdx];
+        const AnimationClip& Clip = Clips[CurrInstance.Clip];
+        Clip.Sample(CurrInstance.Phase * Clip.GetDuration(), mPoses[InstanceIdx]);
+        if (CurrInstance.BlendWeight > 0.0f) {
+            const AnimationClip& BlendClip = Clips[CurrInstance.BlendClip];
+            BlendClip.Sample(CurrInstance.Phase * BlendClip.GetDuration(), mBlendPoses[InstanceIdx]);
+            AnimationPose::Blend(mPoses[InstanceIdx], mBlendPoses[InstanceIdx], CurrInstance.BlendWeight, mPoses[InstanceIdx]);
+        }
+        mPoses[InstanceIdx].ComputeSkinning(Bones, CurrInstance.Transform, out + InstanceIdx * Bones.GetCount() * ANIMATION_MATRIX_FLOATS);
+    }
+}
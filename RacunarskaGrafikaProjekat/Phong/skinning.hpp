@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "gl_handle.hpp"
+#include "job_system.hpp"
+#include "animation.hpp"
+
+class Model;
+
+/**
+ * @brief Many animated instances of one rigged model. Every Update samples and blends the clips
+ * of all instances on the job system and writes their skinning matrices straight into a texture
+ * buffer, which shaders/skinned.vert reads by gl_InstanceID, so the whole crowd is one instanced
+ * draw per mesh. Blended clips are kept in step by a shared normalized phase, so feet of a walk
+ * and a run land together. Does nothing for models without a skeleton or clips
+ */
+class SkinnedCrowd {
+public:
+    /**
+     * @brief Ctor - allocates the skinning buffer
+     *
+     * @param model Loaded model, drawn by Render
+     * @param capacity Maximum number of instances
+     */
+    SkinnedCrowd(Model& model, unsigned capacity);
+
+    SkinnedCrowd(const SkinnedCrowd&) = delete;
+    SkinnedCrowd& operator=(const SkinnedCrowd&) = delete;
+
+    /**
+     * @brief Returns true if the model has a skeleton and at least one clip
+     */
+    bool IsAnimated() const;
+
+    /**
+     * @brief Adds an instance playing one clip
+     *
+     * @param transform Model matrix
+     * @param clip Clip index of the model
+     * @param phase Starting point in the clip, 0 to 1
+     *
+     * @returns Instance index, capacity if the crowd is full
+     */
+    unsigned Add(const glm::mat4& transform, unsigned clip, float phase);
+
+    void SetTransform(unsigned idx, const glm::mat4& transform);
+
+    /**
+     * @brief Blends a second clip over the first one
+     *
+     * @param idx Instance index
+     * @param clip Clip index of the model
+     * @param weight Weight of the second clip, 0 plays only the first one
+     */
+    void SetBlend(unsigned idx, unsigned clip, float weight);
+
+    /**
+     * @brief Advances all instances and uploads their skinning matrices
+     *
+     * @param dt Time step in seconds
+     * @param jobs Job system instances are split over
+     */
+    void Update(float dt, JobSystem& jobs);
+
+    /**
+     * @brief Draws all instances. The shader has to be bound and use skinned.vert
+     *
+     * @param shader Skinned shader
+     */
+    void Render(const Shader& shader) const;
+
+    unsigned GetCount() const;
+
+    /**
+     * @brief Returns CPU time of the last Update in milliseconds
+     */
+    float GetUpdateMilliseconds() const;
+
+private:
+    struct Instance {
+        glm::mat4 Transform;
+        unsigned Clip;
+        unsigned BlendClip;
+        float BlendWeight;
+        float Phase;
+    };
+
+    Model& mModel;
+    unsigned mCapacity;
+    std::vector<Instance> mInstances;
+    // Per instance scratch poses, so jobs never share one
+    std::vector<AnimationPose> mPoses;
+    std::vector<AnimationPose> mBlendPoses;
+    GLBuffer mBuffer;
+    // Buffer texture over mBuffer, tracked with the buffer's size
+    GLTexture mTexture;
+    float mUpdateMilliseconds;
+
+    void animate(unsigned begin, unsigned end, float* out);
+};
@@ -0,0 +1,100 @@
+#include "stream_buffer.hpp"
+#include <cstring>
+
+StreamBuffer::StreamBuffer(GLenum target, unsigned frameSize) {
+    mTarget = target;
+    mFrameSize = frameSize;
+    mFrameIndex = FRAME_COUNT - 1;
+    mHead = 0;
+    mMapped = 0;
+    for (unsigned FrameIdx = 0; FrameIdx < FRAME_COUNT; ++FrameIdx) {
+        mFences[FrameIdx] = 0;
+    }
+
+    mId = GLBuffer::Create();
+    glBindBuffer(mTarget, mId.Get());
+    mPersistent = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+    if (mPersistent) {
+        // Coherent mapping makes CPU writes visible to the GPU without explicit flushes
+        GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(mTarget, mFrameSize * FRAME_COUNT, NULL, Flags);
+        mMapped = (unsigned char*)glMapBufferRange(mTarget, 0, mFrameSize * FRAME_COUNT, Flags);
+        if (!mMapped) {
+            std::cerr << "[Err] Failed to persistently map stream buffer" << std::endl;
+        }
+    } else {
+        glBufferData(mTarget, mFrameSize * FRAME_COUNT, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(mTarget, 0);
+    std::cout << "Stream buffer: " << FRAME_COUNT << " x " << mFrameSize << " bytes, "
+        << (mPersistent ? "persistent mapping" : "unsynchronized mapping") << std::endl;
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (unsigned FrameIdx = 0; FrameIdx < FRAME_COUNT; ++FrameIdx) {
+        if (mFences[FrameIdx]) {
+            glDeleteSync(mFences[FrameIdx]);
+        }
+    }
+}
+
+void
+StreamBuffer::BeginFrame() {
+    mFrameIndex = (mFrameIndex + 1) % FRAME_COUNT;
+    mHead = 0;
+
+    // Only blocks when the CPU gets FRAME_COUNT frames ahead of the GPU
+    GLsync& Fence = mFences[mFrameIndex];
+    if (Fence) {
+        GLenum Result = glClientWaitSync(Fence, 0, 0);
+        while (Result == GL_TIMEOUT_EXPIRED) {
+            Result = glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(Fence);
+        Fence = 0;
+    }
+}
+
+unsigned
+StreamBuffer::Push(const void* data, unsigned size, unsigned alignment) {
+    unsigned Start = (mHead + alignment - 1) & ~(alignment - 1);
+    if (Start + size > mFrameSize) {
+        std::cerr << "[Err] Stream buffer frame region is full" << std::endl;
+        return INVALID_OFFSET;
+    }
+    mHead = Start + size;
+    unsigned Offset = mFrameIndex * mFrameSize + Start;
+
+    if (mPersistent) {
+        if (!mMapped) {
+            return INVALID_OFFSET;
+        }
+        memcpy(mMapped + Offset, data, size);
+        return Offset;
+    }
+
+    // Fence already guarantees the GPU is done with this region, so the driver doesn't have to synchronize
+    glBindBuffer(mTarget, mId.Get());
+    void* Destination = glMapBufferRange(mTarget, Offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (Destination) {
+        memcpy(Destination, data, size);
+        glUnmapBuffer(mTarget);
+    }
+    glBindBuffer(mTarget, 0);
+    return Destination ? Offset : INVALID_OFFSET;
+}
+
+void
+StreamBuffer::EndFrame() {
+    mFences[mFrameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+unsigned
+StreamBuffer::GetId() const {
+    return mId.Get();
+}
+
+bool
+StreamBuffer::IsPersistent() const {
+    return mPersistent;
+}
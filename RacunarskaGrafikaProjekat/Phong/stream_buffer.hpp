@@ -0,0 +1,69 @@
+#pragma once
+#include <GL/glew.h>
+#include <iostream>
+#include "gl_handle.hpp"
+
+/**
+ * @brief Ring buffer for data written by the CPU every frame, split into FRAME_COUNT regions.
+ * The CPU writes into one region while the GPU may still read the previous ones, a fence per
+ * region makes sure a region is only reused once the GPU is done with it.
+ * Uses a persistently mapped buffer (ARB_buffer_storage) when available, otherwise maps each
+ * written range with GL_MAP_UNSYNCHRONIZED_BIT, since a buffer can't be used for drawing while it is mapped
+ */
+class StreamBuffer {
+public:
+    static const unsigned FRAME_COUNT = 3;
+
+    /**
+     * @brief Ctor - creates the buffer
+     *
+     * @param target Buffer target the data is bound to, e.g. GL_UNIFORM_BUFFER
+     * @param frameSize Number of bytes available per frame
+     */
+    StreamBuffer(GLenum target, unsigned frameSize);
+
+    /**
+     * @brief Dtor - deletes the fences, the buffer handle deletes the buffer
+     */
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    /**
+     * @brief Waits until the GPU stopped reading the next region and makes it writable
+     */
+    void BeginFrame();
+
+    /**
+     * @brief Copies data into the current region
+     *
+     * @param data Data
+     * @param size Number of bytes
+     * @param alignment Required offset alignment, has to be a power of two
+     *
+     * @returns Byte offset of the data from the start of the buffer, INVALID_OFFSET if the region is full
+     */
+    unsigned Push(const void* data, unsigned size, unsigned alignment);
+
+    /**
+     * @brief Fences the current region. Call after the last draw using it
+     */
+    void EndFrame();
+
+    unsigned GetId() const;
+    bool IsPersistent() const;
+
+    static const unsigned INVALID_OFFSET = 0xFFFFFFFF;
+
+private:
+    GLBuffer mId;
+    GLenum mTarget;
+    unsigned mFrameSize;
+    unsigned mFrameIndex;
+    unsigned mHead;
+    bool mPersistent;
+    // Whole buffer, only when persistently mapped
+    unsigned char* mMapped;
+    GLsync mFences[FRAME_COUNT];
+};
@@ -0,0 +1,552 @@
+#include "terrain.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "memory_accounting.hpp"
+
+static const unsigned GRID_SIDE = TERRAIN_CHUNK_CELLS + 1;
+static const unsigned GRID_VERTEX_COUNT = GRID_SIDE * GRID_SIDE;
+// Skirt vertices follow the grid, one copy of every border vertex per edge
+static const unsigned SKIRT_VERTEX_COUNT = 4 * GRID_SIDE;
+
+// Procedural islands, at most one per cell of this size
+static const float ISLAND_SPACING = 48.0f;
+static const float ISLAND_PROBABILITY = 0.55f;
+static const float ISLAND_MIN_RADIUS = 8.0f;
+static const float ISLAND_MAX_RADIUS = 20.0f;
+// Plateau height above the sea
+static const float ISLAND_MIN_HEIGHT = 0.5f;
+static const float ISLAND_MAX_HEIGHT = 4.5f;
+// Part of the radius that is flat plateau
+static const float PLATEAU_FRACTION = 0.5f;
+// Coastline warp scales distances by [WARP_MIN, WARP_MIN + WARP_RANGE), so islands reach up to radius / WARP_MIN
+static const float WARP_MIN = 0.75f;
+static const float WARP_RANGE = 0.5f;
+static const float WARP_FREQUENCY = 1.0f / 16.0f;
+// Rocky detail on the slopes, none on the plateau and the sea floor
+static const float DETAIL_AMPLITUDE = 1.5f;
+static const float DETAIL_FREQUENCY = 1.0f / 4.0f;
+static const float SEA_FLOOR_DEPTH = 3.0f;
+// Chunks whose land stays this far under the sea are hidden by the water, even in wave troughs
+static const float EMPTY_DEPTH = 1.0f;
+static const float SKIRT_DEPTH = 2.0f;
+static const float TEXTURE_SCALE = 4.0f;
+
+/**
+ * @brief Returns grid index of a border vertex
+ *
+ * @param edge 0 - Z = 0, 1 - Z = max, 2 - X = 0, 3 - X = max
+ * @param t Position along the edge
+ */
+static unsigned
+edgeVertex(unsigned edge, unsigned t) {
+    switch (edge) {
+    case 0: return t;
+    case 1: return TERRAIN_CHUNK_CELLS * GRID_SIDE + t;
+    case 2: return t * GRID_SIDE;
+    default: return t * GRID_SIDE + TERRAIN_CHUNK_CELLS;
+    }
+}
+
+Terrain::Terrain(float chunkSize, float seaLevel, unsigned seed, JobSystem& jobs) : mJobs(jobs) {
+    mChunkSize = chunkSize;
+    mCellSize = chunkSize / TERRAIN_CHUNK_CELLS;
+    mSeaLevel = seaLevel;
+    mSeaFloor = seaLevel - SEA_FLOOR_DEPTH;
+    mMaxHeight = seaLevel + ISLAND_MAX_HEIGHT + DETAIL_AMPLITUDE;
+    // Each LOD doubles the distance it is used up to
+    mLodDistance = chunkSize * 1.5f;
+    mSeed = seed;
+    mFrame = 0;
+    mResidentCount = 0;
+    mPendingCount = 0;
+    mTriangleCount = 0;
+
+    // Cell coordinates and a skirt flag, chunks only add their heights and normals
+    std::vector<float> Grid;
+    Grid.reserve((GRID_VERTEX_COUNT + SKIRT_VERTEX_COUNT) * 3);
+    for (unsigned Z = 0; Z < GRID_SIDE; ++Z) {
+        for (unsigned X = 0; X < GRID_SIDE; ++X) {
+            float Vertex[3] = { (float)X, (float)Z, 0.0f };
+            Grid.insert(Grid.end(), Vertex, Vertex + 3);
+        }
+    }
+    for (unsigned Edge = 0; Edge < 4; ++Edge) {
+        for (unsigned T = 0; T < GRID_SIDE; ++T) {
+            unsigned GridIdx = edgeVertex(Edge, T);
+            float Vertex[3] = { (float)(GridIdx % GRID_SIDE), (float)(GridIdx / GRID_SIDE), 1.0f };
+            Grid.insert(Grid.end(), Vertex, Vertex + 3);
+        }
+    }
+    mGridVBO = GLBuffer::Create();
+    glBindBuffer(GL_ARRAY_BUFFER, mGridVBO.Get());
+    glBufferData(GL_ARRAY_BUFFER, Grid.size() * sizeof(float), Grid.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    MemoryAccounting::Track(MEMORY_MESH, mGridVBO.Get(), "Terrain grid", Grid.size() * sizeof(float));
+
+    std::vector<unsigned> Indices;
+    for (unsigned Lod = 0; Lod < TERRAIN_LOD_COUNT; ++Lod) {
+        const unsigned Step = 1 << Lod;
+        mLodFirst[Lod] = Indices.size();
+        for (unsigned Z = 0; Z < TERRAIN_CHUNK_CELLS; Z += Step) {
+            for (unsigned X = 0; X < TERRAIN_CHUNK_CELLS; X += Step) {
+                unsigned V00 = Z * GRID_SIDE + X;
+                unsigned V10 = V00 + Step;
+                unsigned V01 = V00 + Step * GRID_SIDE;
+                unsigned V11 = V01 + Step;
+                // Counter clockwise seen from above
+                unsigned Quad[6] = { V00, V01, V10, V10, V01, V11 };
+                Indices.insert(Indices.end(), Quad, Quad + 6);
+            }
+        }
+        // Skirts face away from the chunk, so the winding flips with the edge side
+        for (unsigned Edge = 0; Edge < 4; ++Edge) {
+            bool Flip = Edge == 1 || Edge == 2;
+            for (unsigned T = 0; T < TERRAIN_CHUNK_CELLS; T += Step) {
+                unsigned SkirtA = GRID_VERTEX_COUNT + Edge * GRID_SIDE + T;
+                appendSkirt(Indices, edgeVertex(Edge, T), edgeVertex(Edge, T + Step), SkirtA, SkirtA + Step, Flip);
+            }
+        }
+        mLodCount[Lod] = Indices.size() - mLodFirst[Lod];
+    }
+
+    // Chunk VAOs bind the index buffer, this one only holds it during the upload
+    GLVertexArray UploadVAO = GLVertexArray::Create();
+    glBindVertexArray(UploadVAO.Get());
+    mIndexBuffer.Upload(Indices, GRID_VERTEX_COUNT + SKIRT_VERTEX_COUNT);
+    glBindVertexArray(0);
+
+    mEvictionCallback = MemoryAccounting::AddEvictionCallback(MEMORY_STREAMING, [this](size_t bytes) {
+        return evictForBudget(bytes);
+    });
+}
+
+Terrain::~Terrain() {
+    MemoryAccounting::RemoveEvictionCallback(mEvictionCallback);
+    mJobs.Wait(mPendingCounter);
+}
+
+void
+Terrain::AddIsland(const glm::vec2& center, float radius, float top) {
+    TerrainIsland Island = { center, radius, top };
+    mIslands.push_back(Island);
+    mMaxHeight = std::max(mMaxHeight, top + DETAIL_AMPLITUDE);
+}
+
+void
+Terrain::Update(const Frustum& frustum, const glm::vec3& cameraPosition, float viewDistance) {
+    ++mFrame;
+    {
+        std::lock_guard<std::mutex> Lock(mReadyMutex);
+        while (!mReady.empty() && mUploads.size() < TERRAIN_UPLOADS_PER_FRAME) {
+            mUploads.push_back(std::move(mReady.back()));
+            mReady.pop_back();
+        }
+    }
+    for (ChunkData& Data : mUploads) {
+        uploadChunk(Data);
+    }
+    mUploads.clear();
+
+    mDraws.clear();
+    mRequests.clear();
+    mTriangleCount = 0;
+    const int RootSize = 1 << TERRAIN_QUADTREE_DEPTH;
+    int RootX = (int)std::floor(cameraPosition.x / mChunkSize) - RootSize / 2;
+    int RootZ = (int)std::floor(cameraPosition.z / mChunkSize) - RootSize / 2;
+    selectNode(frustum, cameraPosition, viewDistance, RootX, RootZ, RootSize);
+
+    std::sort(mRequests.begin(), mRequests.end(), [](const ChunkRequest& a, const ChunkRequest& b) {
+        return a.Distance < b.Distance;
+    });
+    for (const ChunkRequest& Request : mRequests) {
+        if (mPendingCount >= TERRAIN_MAX_PENDING_CHUNKS) {
+            break;
+        }
+
+        Chunk NewChunk = { CHUNK_PENDING, GLVertexArray(), GLBuffer(), 0.0f, 0.0f, mFrame };
+        mChunks[chunkKey(Request.X, Request.Z)] = std::move(NewChunk);
+        ++mPendingCount;
+        int X = Request.X;
+        int Z = Request.Z;
+        mJobs.Run([this, X, Z]() {
+            ChunkData Data = generateChunk(X, Z);
+            std::lock_guard<std::mutex> Lock(mReadyMutex);
+            mReady.push_back(std::move(Data));
+        }, &mPendingCounter);
+    }
+
+    evictChunks();
+}
+
+void
+Terrain::Render(const Shader& shader) const {
+    shader.SetUniform1f("uCellSize", mCellSize);
+    shader.SetUniform1f("uSkirtDepth", SKIRT_DEPTH);
+    shader.SetUniform1f("uTextureScale", TEXTURE_SCALE);
+    for (const ChunkDraw& Draw : mDraws) {
+        shader.SetUniform3f("uChunkOrigin", Draw.Origin);
+        glBindVertexArray(Draw.DrawChunk->VAO.Get());
+        mIndexBuffer.DrawRange(GL_TRIANGLES, mLodFirst[Draw.Lod], mLodCount[Draw.Lod]);
+    }
+    glBindVertexArray(0);
+}
+
+unsigned
+Terrain::GetTriangleCount() const {
+    return mTriangleCount;
+}
+
+unsigned
+Terrain::GetResidentChunkCount() const {
+    return mResidentCount;
+}
+
+void
+Terrain::SampleHeights(const float* x, const float* z, float* heights, unsigned count) const {
+    if (!count) {
+        return;
+    }
+
+    glm::vec2 Min(x[0], z[0]);
+    glm::vec2 Max = Min;
+    for (unsigned Idx = 1; Idx < count; ++Idx) {
+        Min = glm::min(Min, glm::vec2(x[Idx], z[Idx]));
+        Max = glm::max(Max, glm::vec2(x[Idx], z[Idx]));
+    }
+    std::vector<TerrainIsland> Islands;
+    collectIslands(Min, Max, Islands);
+    sampleHeights(x, z, heights, count, Islands);
+}
+
+bool
+Terrain::HasIslands(const glm::vec2& min, const glm::vec2& max) const {
+    std::vector<TerrainIsland> Islands;
+    return collectIslands(min, max, Islands);
+}
+
+float
+Terrain::GetSeaLevel() const {
+    return mSeaLevel;
+}
+
+float
+Terrain::GetMaxHeight() const {
+    return mMaxHeight;
+}
+
+long long
+Terrain::chunkKey(int x, int z) {
+    return (long long)(((unsigned long long)(unsigned)x << 32) | (unsigned)z);
+}
+
+void
+Terrain::selectNode(const Frustum& frustum, const glm::vec3& cameraPosition, float viewDistance, int x, int z, int size) {
+    // Height bounds of nodes that aren't generated yet have to cover anything an island can be
+    glm::vec3 Min(x * mChunkSize, mSeaFloor - SKIRT_DEPTH, z * mChunkSize);
+    glm::vec3 Max((x + size) * mChunkSize, mMaxHeight, (z + size) * mChunkSize);
+    float Distance = glm::length(glm::clamp(cameraPosition, Min, Max) - cameraPosition);
+    if (Distance > viewDistance || !frustum.IsBoxVisible(Min, Max)) {
+        return;
+    }
+
+    if (size == 1) {
+        visitChunk(frustum, x, z, Distance);
+        return;
+    }
+
+    int Half = size / 2;
+    selectNode(frustum, cameraPosition, viewDistance, x, z, Half);
+    selectNode(frustum, cameraPosition, viewDistance, x + Half, z, Half);
+    selectNode(frustum, cameraPosition, viewDistance, x, z + Half, Half);
+    selectNode(frustum, cameraPosition, viewDistance, x + Half, z + Half, Half);
+}
+
+void
+Terrain::visitChunk(const Frustum& frustum, int x, int z, float distance) {
+    glm::vec2 Origin(x * mChunkSize, z * mChunkSize);
+    long long Key = chunkKey(x, z);
+    ChunkMap::iterator It = mChunks.find(Key);
+    if (It == mChunks.end()) {
+        // Most of the sea has no island in reach, those chunks are settled without a job
+        if (!collectIslands(Origin, Origin + glm::vec2(mChunkSize), mCandidateIslands)) {
+            Chunk EmptyChunk = { CHUNK_EMPTY, GLVertexArray(), GLBuffer(), 0.0f, 0.0f, mFrame };
+            mChunks[Key] = std::move(EmptyChunk);
+            return;
+        }
+
+        ChunkRequest Request = { x, z, distance };
+        mRequests.push_back(Request);
+        return;
+    }
+
+    Chunk& VisitedChunk = It->second;
+    VisitedChunk.LastUsedFrame = mFrame;
+    if (VisitedChunk.State != CHUNK_RESIDENT) {
+        return;
+    }
+
+    glm::vec3 Min(Origin.x, VisitedChunk.MinHeight, Origin.y);
+    glm::vec3 Max(Origin.x + mChunkSize, VisitedChunk.MaxHeight, Origin.y + mChunkSize);
+    if (!frustum.IsBoxVisible(Min, Max)) {
+        return;
+    }
+
+    unsigned Lod = 0;
+    float LodRange = mLodDistance;
+    while (distance > LodRange && Lod < TERRAIN_LOD_COUNT - 1) {
+        ++Lod;
+        LodRange *= 2.0f;
+    }
+    ChunkDraw Draw = { &VisitedChunk, glm::vec3(Origin.x, 0.0f, Origin.y), Lod };
+    mDraws.push_back(Draw);
+    mTriangleCount += mLodCount[Lod] / 3;
+}
+
+void
+Terrain::uploadChunk(ChunkData& data) {
+    // Pending chunks are never evicted, so the entry is still there
+    Chunk& UploadedChunk = mChunks[data.Key];
+    --mPendingCount;
+    UploadedChunk.MinHeight = data.MinHeight - SKIRT_DEPTH;
+    UploadedChunk.MaxHeight = data.MaxHeight;
+    if (data.Empty) {
+        UploadedChunk.State = CHUNK_EMPTY;
+        return;
+    }
+
+    UploadedChunk.VAO = GLVertexArray::Create();
+    glBindVertexArray(UploadedChunk.VAO.Get());
+    glBindBuffer(GL_ARRAY_BUFFER, mGridVBO.Get());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    UploadedChunk.VBO = GLBuffer::Create();
+    glBindBuffer(GL_ARRAY_BUFFER, UploadedChunk.VBO.Get());
+    glBufferData(GL_ARRAY_BUFFER, data.Vertices.size() * sizeof(Vertex), data.Vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Height));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    mIndexBuffer.Bind();
+    glBindVertexArray(0);
+    MemoryAccounting::Track(MEMORY_STREAMING, UploadedChunk.VBO.Get(), "Terrain chunk", data.Vertices.size() * sizeof(Vertex));
+    UploadedChunk.State = CHUNK_RESIDENT;
+    ++mResidentCount;
+}
+
+void
+Terrain::evictChunks() {
+    if (mResidentCount <= TERRAIN_MAX_RESIDENT_CHUNKS && mChunks.size() <= TERRAIN_MAX_CACHED_CHUNKS) {
+        return;
+    }
+
+    // Chunks selected this frame are referenced by the draw list, pending ones by their jobs
+    mEvictCandidates.clear();
+    for (const std::pair<const long long, Chunk>& Entry : mChunks) {
+        if (Entry.second.State != CHUNK_PENDING && Entry.second.LastUsedFrame != mFrame) {
+            mEvictCandidates.push_back(std::make_pair(Entry.second.LastUsedFrame, Entry.first));
+        }
+    }
+    std::sort(mEvictCandidates.begin(), mEvictCandidates.end());
+
+    for (const std::pair<unsigned, long long>& Candidate : mEvictCandidates) {
+        bool OverResident = mResidentCount > TERRAIN_MAX_RESIDENT_CHUNKS;
+        bool OverCached = mChunks.size() > TERRAIN_MAX_CACHED_CHUNKS;
+        if (!OverResident && !OverCached) {
+            break;
+        }
+
+        Chunk& EvictedChunk = mChunks[Candidate.second];
+        if (EvictedChunk.State == CHUNK_EMPTY && !OverCached) {
+            continue;
+        }
+        if (EvictedChunk.State == CHUNK_RESIDENT) {
+            freeChunk(EvictedChunk);
+        }
+        mChunks.erase(Candidate.second);
+    }
+}
+
+size_t
+Terrain::evictForBudget(size_t bytes) {
+    // Chunks drawn by the last frame would only be generated again, so those stay even over budget
+    mEvictCandidates.clear();
+    for (const std::pair<const long long, Chunk>& Entry : mChunks) {
+        if (Entry.second.State == CHUNK_RESIDENT && Entry.second.LastUsedFrame != mFrame) {
+            mEvictCandidates.push_back(std::make_pair(Entry.second.LastUsedFrame, Entry.first));
+        }
+    }
+    std::sort(mEvictCandidates.begin(), mEvictCandidates.end());
+
+    const size_t ChunkBytes = (GRID_VERTEX_COUNT + SKIRT_VERTEX_COUNT) * sizeof(Vertex);
+    size_t Freed = 0;
+    for (const std::pair<unsigned, long long>& Candidate : mEvictCandidates) {
+        if (Freed >= bytes) {
+            break;
+        }
+        freeChunk(mChunks[Candidate.second]);
+        mChunks.erase(Candidate.second);
+        Freed += ChunkBytes;
+    }
+    return Freed;
+}
+
+void
+Terrain::freeChunk(Chunk& chunk) {
+    chunk.VBO.Reset();
+    chunk.VAO.Reset();
+    --mResidentCount;
+}
+
+bool
+Terrain::proceduralIsland(int cellX, int cellZ, TerrainIsland& island) const {
+    unsigned Hash = Noise::Hash(cellX, cellZ, mSeed);
+    if ((Hash & 0xffff) / 65536.0f >= ISLAND_PROBABILITY) {
+        return false;
+    }
+
+    unsigned ShapeHash = Noise::Hash(cellX, cellZ, mSeed + 1);
+    float OffsetX = (ShapeHash & 0x3ff) / 1024.0f;
+    float OffsetZ = ((ShapeHash >> 10) & 0x3ff) / 1024.0f;
+    float Size = ((ShapeHash >> 20) & 0x3ff) / 1024.0f;
+    float Height = (Hash >> 16) / 65536.0f;
+    // Centers stay in the middle half of the cell, so neighbors rarely merge into one blob
+    island.Center = glm::vec2(cellX + 0.25f + 0.5f * OffsetX, cellZ + 0.25f + 0.5f * OffsetZ) * ISLAND_SPACING;
+    island.Radius = ISLAND_MIN_RADIUS + (ISLAND_MAX_RADIUS - ISLAND_MIN_RADIUS) * Size;
+    island.Top = mSeaLevel + ISLAND_MIN_HEIGHT + (ISLAND_MAX_HEIGHT - ISLAND_MIN_HEIGHT) * Height;
+
+    for (const TerrainIsland& Fixed : mIslands) {
+        float Clearance = (Fixed.Radius + island.Radius) / WARP_MIN + ISLAND_SPACING * 0.5f;
+        if (glm::length(island.Center - Fixed.Center) < Clearance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+Terrain::collectIslands(const glm::vec2& min, const glm::vec2& max, std::vector<TerrainIsland>& islands) const {
+    islands.clear();
+    for (const TerrainIsland& Fixed : mIslands) {
+        if (glm::length(glm::clamp(Fixed.Center, min, max) - Fixed.Center) < Fixed.Radius / WARP_MIN) {
+            islands.push_back(Fixed);
+        }
+    }
+
+    const float MaxReach = ISLAND_MAX_RADIUS / WARP_MIN;
+    int CellMinX = (int)std::floor((min.x - MaxReach) / ISLAND_SPACING);
+    int CellMinZ = (int)std::floor((min.y - MaxReach) / ISLAND_SPACING);
+    int CellMaxX = (int)std::floor((max.x + MaxReach) / ISLAND_SPACING);
+    int CellMaxZ = (int)std::floor((max.y + MaxReach) / ISLAND_SPACING);
+    for (int CellZ = CellMinZ; CellZ <= CellMaxZ; ++CellZ) {
+        for (int CellX = CellMinX; CellX <= CellMaxX; ++CellX) {
+            TerrainIsland Island;
+            if (proceduralIsland(CellX, CellZ, Island) && glm::length(glm::clamp(Island.Center, min, max) - Island.Center) < Island.Radius / WARP_MIN) {
+                islands.push_back(Island);
+            }
+        }
+    }
+    return !islands.empty();
+}
+
+Terrain::ChunkData
+Terrain::generateChunk(int x, int z) const {
+    ChunkData Data;
+    Data.Key = chunkKey(x, z);
+
+    // One sample apron around the chunk, so border normals match the neighbors. Sample coordinates
+    // come from global cell indices, which gives neighbors bit identical heights along shared edges
+    const unsigned Side = GRID_SIDE + 2;
+    const unsigned RowStride = SimdPadCount(Side);
+    const int FirstCellX = x * TERRAIN_CHUNK_CELLS - 1;
+    const int FirstCellZ = z * TERRAIN_CHUNK_CELLS - 1;
+    std::vector<float> SampleX(Side * RowStride);
+    std::vector<float> SampleZ(Side * RowStride);
+    std::vector<float> Heights(Side * RowStride);
+    for (unsigned Row = 0; Row < Side; ++Row) {
+        for (unsigned Column = 0; Column < RowStride; ++Column) {
+            // Padding repeats the last sample
+            unsigned ClampedColumn = std::min(Column, Side - 1);
+            SampleX[Row * RowStride + Column] = (FirstCellX + (int)ClampedColumn) * mCellSize;
+            SampleZ[Row * RowStride + Column] = (FirstCellZ + (int)Row) * mCellSize;
+        }
+    }
+
+    std::vector<TerrainIsland> Islands;
+    collectIslands(glm::vec2(SampleX[0], SampleZ[0]), glm::vec2(SampleX[Side - 1], SampleZ[(Side - 1) * RowStride]), Islands);
+    sampleHeights(SampleX.data(), SampleZ.data(), Heights.data(), Heights.size(), Islands);
+
+    Data.MinHeight = Heights[RowStride + 1];
+    Data.MaxHeight = Data.MinHeight;
+    for (unsigned Z = 0; Z < GRID_SIDE; ++Z) {
+        for (unsigned X = 0; X < GRID_SIDE; ++X) {
+            float Height = Heights[(Z + 1) * RowStride + X + 1];
+            Data.MinHeight = std::min(Data.MinHeight, Height);
+            Data.MaxHeight = std::max(Data.MaxHeight, Height);
+        }
+    }
+    Data.Empty = Data.MaxHeight < mSeaLevel - EMPTY_DEPTH;
+    if (Data.Empty) {
+        return Data;
+    }
+
+    Data.Vertices.resize(GRID_VERTEX_COUNT + SKIRT_VERTEX_COUNT);
+    for (unsigned Z = 0; Z < GRID_SIDE; ++Z) {
+        for (unsigned X = 0; X < GRID_SIDE; ++X) {
+            const float* Center = &Heights[(Z + 1) * RowStride + X + 1];
+            glm::vec3 Normal = glm::normalize(glm::vec3(Center[-1] - Center[1], 2.0f * mCellSize, Center[-(int)RowStride] - Center[RowStride]));
+            Vertex& GridVertex = Data.Vertices[Z * GRID_SIDE + X];
+            GridVertex.Height = Center[0];
+            GridVertex.Normal[0] = (signed char)std::floor(Normal.x * 127.0f + 0.5f);
+            GridVertex.Normal[1] = (signed char)std::floor(Normal.y * 127.0f + 0.5f);
+            GridVertex.Normal[2] = (signed char)std::floor(Normal.z * 127.0f + 0.5f);
+            GridVertex.Normal[3] = 0;
+        }
+    }
+    for (unsigned Edge = 0; Edge < 4; ++Edge) {
+        for (unsigned T = 0; T < GRID_SIDE; ++T) {
+            Data.Vertices[GRID_VERTEX_COUNT + Edge * GRID_SIDE + T] = Data.Vertices[edgeVertex(Edge, T)];
+        }
+    }
+    return Data;
+}
+
+void
+Terrain::sampleHeights(const float* x, const float* z, float* heights, unsigned count, const std::vector<TerrainIsland>& islands) const {
+    std::vector<float> Warp(count);
+    std::vector<float> Detail(count);
+    Noise::Fractal(x, z, Warp.data(), count, WARP_FREQUENCY, 3, mSeed);
+    Noise::Fractal(x, z, Detail.data(), count, DETAIL_FREQUENCY, 4, mSeed + 16);
+
+    const float PlateauRange = 1.0f - PLATEAU_FRACTION;
+    for (unsigned Idx = 0; Idx < count; ++Idx) {
+        glm::vec2 Position(x[Idx], z[Idx]);
+        float WarpScale = WARP_MIN + WARP_RANGE * Warp[Idx];
+        float Height = mSeaFloor;
+        float Slope = 0.0f;
+        // Overlapping islands take the higher one
+        for (const TerrainIsland& Island : islands) {
+            float Distance = glm::length(Position - Island.Center) * WarpScale;
+            float T = glm::clamp((Island.Radius - Distance) / (Island.Radius * PlateauRange), 0.0f, 1.0f);
+            float Blend = T * T * (3.0f - 2.0f * T);
+            float IslandHeight = mSeaFloor + (Island.Top - mSeaFloor) * Blend;
+            if (IslandHeight > Height) {
+                Height = IslandHeight;
+                Slope = 4.0f * Blend * (1.0f - Blend);
+            }
+        }
+        heights[Idx] = Height + (Detail[Idx] - 0.5f) * 2.0f * DETAIL_AMPLITUDE * Slope;
+    }
+}
+
+void
+Terrain::appendSkirt(std::vector<unsigned>& indices, unsigned a, unsigned b, unsigned skirtA, unsigned skirtB, bool flip) {
+    if (flip) {
+        unsigned Quad[6] = { a, skirtA, b, b, skirtA, skirtB };
+        indices.insert(indices.end(), Quad, Quad + 6);
+    } else {
+        unsigned Quad[6] = { a, b, skirtA, b, skirtB, skirtA };
+        indices.insert(indices.end(), Quad, Quad + 6);
+    }
+}
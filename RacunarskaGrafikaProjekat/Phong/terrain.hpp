@@ -0,0 +1,227 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include "pool_allocator.hpp"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "frustum.hpp"
+#include "index_buffer.hpp"
+#include "gl_handle.hpp"
+#include "job_system.hpp"
+#include "noise.hpp"
+
+// Cells per chunk side. All chunks share one grid layout and one index buffer
+#define TERRAIN_CHUNK_CELLS 32
+// Index ranges for every 2^LOD-th vertex of the grid, LOD 0 is full resolution
+#define TERRAIN_LOD_COUNT 4
+// Chunks with GPU buffers, least recently used ones past this are freed
+#define TERRAIN_MAX_RESIDENT_CHUNKS 256
+// Known chunks including empty ones, which only cost a map entry
+#define TERRAIN_MAX_CACHED_CHUNKS 4096
+// Generation jobs in flight
+#define TERRAIN_MAX_PENDING_CHUNKS 16
+// Finished chunks uploaded per Update, the rest wait for the next frame
+#define TERRAIN_UPLOADS_PER_FRAME 8
+// Selection quadtree root covers 2^depth chunks per side around the camera
+#define TERRAIN_QUADTREE_DEPTH 5
+
+/**
+ * @brief Island shape: a plateau at Top inside half the radius, sloping down to the sea floor at the radius
+ */
+struct TerrainIsland {
+    glm::vec2 Center;
+    float Radius;
+    float Top;
+};
+
+/**
+ * @brief Procedural archipelago streamed in square heightmap chunks around the camera.
+ * Islands come from a few fixed ones plus one optional island per cell of a jittered grid,
+ * coastlines and slopes are shaped with SIMD value noise. Chunks are generated on the job
+ * system as they enter the view and uploaded a few per frame; chunks without land above the
+ * sea never get GPU buffers. A quadtree over the chunk grid culls against the frustum and
+ * view distance, and each visible chunk picks a LOD from its distance to the camera.
+ * Skirts along chunk borders hide the cracks between neighbors of different LODs
+ */
+class Terrain {
+public:
+    /**
+     * @brief Ctor - builds the shared chunk grid and index buffer
+     *
+     * @param chunkSize World units per chunk side
+     * @param seaLevel Water height, chunks entirely below it are skipped
+     * @param seed Archipelago seed
+     * @param jobs Job system chunks are generated on
+     */
+    Terrain(float chunkSize, float seaLevel, unsigned seed, JobSystem& jobs);
+
+    /**
+     * @brief Dtor - waits for generation jobs still writing into the terrain
+     */
+    ~Terrain();
+
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    /**
+     * @brief Adds a fixed island. Procedural islands keep away from it.
+     * Has to be called before the first Update
+     *
+     * @param center World XZ center
+     * @param radius Distance from center to where the island meets the sea floor
+     * @param top Plateau height
+     */
+    void AddIsland(const glm::vec2& center, float radius, float top);
+
+    /**
+     * @brief Uploads finished chunks, selects visible chunks and their LODs, requests missing
+     * chunks nearest first and frees the least recently used ones over budget
+     *
+     * @param frustum World space view frustum
+     * @param cameraPosition World space camera position
+     * @param viewDistance Chunks further than this are neither drawn nor generated
+     */
+    void Update(const Frustum& frustum, const glm::vec3& cameraPosition, float viewDistance);
+
+    /**
+     * @brief Draws chunks selected by the last Update. The shader has to be bound and use terrain.vert
+     *
+     * @param shader Terrain shader, lit or depth only
+     */
+    void Render(const Shader& shader) const;
+
+    /**
+     * @brief Returns number of triangles drawn by Render
+     */
+    unsigned GetTriangleCount() const;
+
+    /**
+     * @brief Returns number of chunks with GPU buffers
+     */
+    unsigned GetResidentChunkCount() const;
+
+    /**
+     * @brief Computes terrain heights at arbitrary points. Safe to call from job threads
+     * once all fixed islands are added
+     *
+     * @param x World X coordinates
+     * @param z World Z coordinates
+     * @param heights Output heights
+     * @param count Number of points, multiple of SIMD_WIDTH
+     */
+    void SampleHeights(const float* x, const float* z, float* heights, unsigned count) const;
+
+    /**
+     * @brief Checks whether any island reaches into an area. Safe to call from job threads
+     *
+     * @param min World XZ minimum of the area
+     * @param max World XZ maximum of the area
+     *
+     * @returns false if the area is certainly sea floor
+     */
+    bool HasIslands(const glm::vec2& min, const glm::vec2& max) const;
+
+    /**
+     * @brief Returns water height
+     */
+    float GetSeaLevel() const;
+
+    /**
+     * @brief Returns highest possible terrain point
+     */
+    float GetMaxHeight() const;
+
+private:
+    enum EChunkState {
+        CHUNK_PENDING = 0,
+        CHUNK_EMPTY = 1,
+        CHUNK_RESIDENT = 2,
+    };
+
+    struct Chunk {
+        EChunkState State;
+        GLVertexArray VAO;
+        GLBuffer VBO;
+        float MinHeight;
+        float MaxHeight;
+        unsigned LastUsedFrame;
+    };
+
+    // Height and packed normal of one chunk vertex, grid position comes from the shared grid buffer
+    struct Vertex {
+        float Height;
+        signed char Normal[4];
+    };
+
+    struct ChunkData {
+        long long Key;
+        bool Empty;
+        float MinHeight;
+        float MaxHeight;
+        std::vector<Vertex> Vertices;
+    };
+
+    struct ChunkDraw {
+        const Chunk* DrawChunk;
+        glm::vec3 Origin;
+        unsigned Lod;
+    };
+
+    struct ChunkRequest {
+        int X;
+        int Z;
+        float Distance;
+    };
+
+    JobSystem& mJobs;
+    float mChunkSize;
+    float mCellSize;
+    float mSeaLevel;
+    float mSeaFloor;
+    // Highest possible terrain point, bounds quadtree nodes that aren't generated yet
+    float mMaxHeight;
+    float mLodDistance;
+    unsigned mSeed;
+    unsigned mFrame;
+    std::vector<TerrainIsland> mIslands;
+
+    GLBuffer mGridVBO;
+    IndexBuffer mIndexBuffer;
+    unsigned mLodFirst[TERRAIN_LOD_COUNT];
+    unsigned mLodCount[TERRAIN_LOD_COUNT];
+
+    // Nodes come from a pool, chunks streaming in and out reuse them instead of hitting the heap
+    typedef std::unordered_map<long long, Chunk, std::hash<long long>, std::equal_to<long long>, PoolAllocator<std::pair<const long long, Chunk>>> ChunkMap;
+    ChunkMap mChunks;
+    unsigned mResidentCount;
+    unsigned mPendingCount;
+    JobCounter mPendingCounter;
+    // Written by generation jobs, drained by Update
+    std::mutex mReadyMutex;
+    std::vector<ChunkData> mReady;
+    // Reused between frames
+    std::vector<ChunkData> mUploads;
+    std::vector<TerrainIsland> mCandidateIslands;
+    std::vector<std::pair<unsigned, long long>> mEvictCandidates;
+    // Frees least recently used chunks when streaming memory is over budget
+    unsigned mEvictionCallback;
+
+    std::vector<ChunkDraw> mDraws;
+    std::vector<ChunkRequest> mRequests;
+    unsigned mTriangleCount;
+
+    static long long chunkKey(int x, int z);
+    void selectNode(const Frustum& frustum, const glm::vec3& cameraPosition, float viewDistance, int x, int z, int size);
+    void visitChunk(const Frustum& frustum, int x, int z, float distance);
+    void uploadChunk(ChunkData& data);
+    void evictChunks();
+    size_t evictForBudget(size_t bytes);
+    void freeChunk(Chunk& chunk);
+    bool proceduralIsland(int cellX, int cellZ, TerrainIsland& island) const;
+    bool collectIslands(const glm::vec2& min, const glm::vec2& max, std::vector<TerrainIsland>& islands) const;
+    ChunkData generateChunk(int x, int z) const;
+    void sampleHeights(const float* x, const float* z, float* heights, unsigned count, const std::vector<TerrainIsland>& islands) const;
+    static void appendSkirt(std::vector<unsigned>& indices, unsigned a, unsigned b, unsigned skirtA, unsigned skirtB, bool flip);
+};
@@ -1,26 +1,58 @@
 #include "texture.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include <algorithm>
+#include "cooked.hpp"
+#include "memory_accounting.hpp"
 
 unsigned
 Texture::LoadImageToTexture(const std::string& filePath) {
-    int TextureWidth;
-    int TextureHeight;
-    int TextureChannels;
+    TextureImage Image = DecodeImage(filePath);
+    return UploadImage(Image, filePath);
+}
+
+TextureImage
+Texture::DecodeImage(const std::string& filePath, int channels) {
+    TextureImage Image;
     std::cout << "Loading texture: " << filePath << std::endl;
-    unsigned char* ImageData = stbi_load(filePath.c_str(), &TextureWidth, &TextureHeight, &TextureChannels, 0);
+    if (readCookedImage(filePath, channels, Image)) {
+        return Image;
+    }
+
+    // Claimed from the IO service if it was prefetched
+    std::vector<unsigned char> Encoded;
+    if (CookedFile::ReadFile(filePath, Encoded)) {
+        Image.Data = stbi_load_from_memory(Encoded.data(), (int)Encoded.size(), &Image.Width, &Image.Height, &Image.Channels, channels);
+    }
 
-    if (!ImageData) {
+    if (!Image.Data) {
         std::cerr << "Failed to load texture: " << filePath << " loading default instead" << std::endl;
-        return LoadImageToTexture(MISSING_TEXTURE_PATH);
+        Image.Data = stbi_load(MISSING_TEXTURE_PATH.c_str(), &Image.Width, &Image.Height, &Image.Channels, channels);
+        if (!Image.Data) {
+            std::cerr << "[Err] Failed to load default texture: " << MISSING_TEXTURE_PATH << std::endl;
+            return Image;
+        }
+    }
+
+    // stbi reports the file's channel count, not the converted one
+    if (channels) {
+        Image.Channels = channels;
     }
 
     // Images should usually flipped vertically as they are loaded "upside-down"
-    stbi__vertical_flip(ImageData, TextureWidth, TextureHeight, TextureChannels);
+    stbi__vertical_flip(Image.Data, Image.Width, Image.Height, Image.Channels);
+    return Image;
+}
+
+unsigned
+Texture::UploadImage(TextureImage& image, const std::string& name) {
+    if (!image.Data) {
+        return 0;
+    }
 
     //Checks or "guesses" the loaded image's format
     GLint InternalFormat = -1;
-    switch (TextureChannels) {
+    switch (image.Channels) {
     case 1: InternalFormat = GL_RED; break;
     case 3: InternalFormat = GL_RGB; break;
     case 4: InternalFormat = GL_RGBA; break;
@@ -30,7 +62,7 @@ Texture::LoadImageToTexture(const std::string& filePath) {
     unsigned Texture;
     glGenTextures(1, &Texture);
     glBindTexture(GL_TEXTURE_2D, Texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, InternalFormat, TextureWidth, TextureHeight, 0, InternalFormat, GL_UNSIGNED_BYTE, ImageData);
+    glTexImage2D(GL_TEXTURE_2D, 0, InternalFormat, image.Width, image.Height, 0, InternalFormat, GL_UNSIGNED_BYTE, image.Data);
     glGenerateMipmap(GL_TEXTURE_2D);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -38,7 +70,189 @@ Texture::LoadImageToTexture(const std::string& filePath) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glBindTexture(GL_TEXTURE_2D, 0);
+    MemoryAccounting::Track(MEMORY_TEXTURE, Texture, name, MemoryAccounting::GetTextureSize(image.Width, image.Height, 1, image.Channels, true));
     //ImageData is no longer necessary in RAM and can be deallocated
-    stbi_image_free(ImageData);
+    FreeImage(image);
+    return Texture;
+}
+
+bool
+Texture::CookImage(const std::string& filePath) {
+    TextureImage Image;
+    Image.Data = stbi_load(filePath.c_str(), &Image.Width, &Image.Height, &Image.Channels, 0);
+    if (!Image.Data) {
+        std::cerr << "[Err] Failed to decode texture: " << filePath << " " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+
+    // Width, height and channel count, then the pixels flipped the way DecodeImage returns them
+    stbi__vertical_flip(Image.Data, Image.Width, Image.Height, Image.Channels);
+    std::ofstream Out;
+    bool Success = CookedFile::OpenWrite(filePath, COOKED_TEXTURE_EXTENSION, COOKED_TEXTURE_MAGIC, Out);
+    if (Success) {
+        CookedFile::Write(Out, Image.Width);
+        CookedFile::Write(Out, Image.Height);
+        CookedFile::Write(Out, Image.Channels);
+        Out.write((const char*)Image.Data, Image.Width * Image.Height * Image.Channels);
+        Success = (bool)Out;
+    }
+    FreeImage(Image);
+    return Success;
+}
+
+void
+Texture::FreeImage(TextureImage& image) {
+    if (image.Mapped) {
+        image.Data = 0;
+        image.Mapped = false;
+    } else if (image.Data) {
+        stbi_image_free(image.Data);
+        image.Data = 0;
+    }
+}
+
+std::vector<unsigned>
+Texture::LoadImagesToTextures(const std::vector<std::string>& filePaths, JobSystem* jobs) {
+    std::vector<TextureImage> Images(filePaths.size());
+    auto DecodeImages = [&filePaths, &Images](unsigned begin, unsigned end) {
+        for (unsigned ImageIdx = begin; ImageIdx < end; ++ImageIdx) {
+            Images[ImageIdx] = DecodeImage(filePaths[ImageIdx]);
+        }
+    };
+    if (jobs) {
+        jobs->ParallelFor(filePaths.size(), 1, DecodeImages);
+    } else {
+        DecodeImages(0, filePaths.size());
+    }
+
+    std::vector<unsigned> Textures(Images.size());
+    for (unsigned ImageIdx = 0; ImageIdx < Images.size(); ++ImageIdx) {
+        Textures[ImageIdx] = UploadImage(Images[ImageIdx], filePaths[ImageIdx]);
+    }
+    return Textures;
+}
+
+unsigned
+Texture::LoadImagesToTextureArray(const std::vector<std::string>& filePaths, int width, int height, JobSystem* jobs) {
+    // Decoding and resizing are the slow part and independent per layer. Only the upload needs the GL context
+    std::vector<std::vector<unsigned char>> Layers(filePaths.size());
+    auto DecodeLayers = [&filePaths, &Layers, width, height](unsigned begin, unsigned end) {
+        for (unsigned Layer = begin; Layer < end; ++Layer) {
+            // All layers share one format, so every image is expanded to RGBA
+            TextureImage Image = DecodeImage(filePaths[Layer], 4);
+            if (!Image.Data) {
+                continue;
+            }
+
+            if (Image.Width == width && Image.Height == height) {
+                Layers[Layer].assign(Image.Data, Image.Data + width * height * 4);
+            } else {
+                Layers[Layer] = resizeImage(Image.Data, Image.Width, Image.Height, 4, width, height);
+            }
+            FreeImage(Image);
+        }
+    };
+    if (jobs) {
+        jobs->ParallelFor(filePaths.size(), 1, DecodeLayers);
+    } else {
+        DecodeLayers(0, filePaths.size());
+    }
+
+    unsigned Texture;
+    glGenTextures(1, &Texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, Texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, width, height, filePaths.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    for (unsigned Layer = 0; Layer < Layers.size(); ++Layer) {
+        if (!Layers[Layer].empty()) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, Layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, Layers[Layer].data());
+        }
+    }
+
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    MemoryAccounting::Track(MEMORY_TEXTURE, Texture, filePaths.empty() ? "Texture array" : filePaths[0] + " array",
+        MemoryAccounting::GetTextureSize(width, height, filePaths.size(), 4, true));
     return Texture;
+}
+
+bool
+Texture::readCookedImage(const std::string& filePath, int channels, TextureImage& image) {
+    CookedReader Reader;
+    if (!CookedFile::OpenRead(filePath, COOKED_TEXTURE_EXTENSION, COOKED_TEXTURE_MAGIC, Reader)) {
+        return false;
+    }
+
+    int Width = 0;
+    int Height = 0;
+    int Channels = 0;
+    if (!Reader.Read(Width) || !Reader.Read(Height) || !Reader.Read(Channels) || Width <= 0 || Height <= 0 || Channels < 1 || Channels > 4) {
+        return false;
+    }
+    const unsigned char* Pixels = Reader.ReadSpan(Width * Height * Channels);
+    if (!Pixels) {
+        std::cerr << "[Err] Truncated cooked texture of " << filePath << std::endl;
+        return false;
+    }
+
+    // Pixels in the asset pack are uploaded straight from the mapping
+    if (Reader.IsMapped() && (!channels || channels == Channels)) {
+        image.Data = (unsigned char*)Pixels;
+        image.Width = Width;
+        image.Height = Height;
+        image.Channels = Channels;
+        image.Mapped = true;
+        return true;
+    }
+
+    // Allocated the way stbi does, so FreeImage can release it
+    unsigned char* Data = (unsigned char*)STBI_MALLOC(Width * Height * Channels);
+    if (!Data) {
+        return false;
+    }
+    memcpy(Data, Pixels, Width * Height * Channels);
+
+    if (channels && channels != Channels) {
+        Data = stbi__convert_format(Data, Channels, channels, Width, Height);
+        if (!Data) {
+            return false;
+        }
+        Channels = channels;
+    }
+
+    image.Data = Data;
+    image.Width = Width;
+    image.Height = Height;
+    image.Channels = Channels;
+    return true;
+}
+
+std::vector<unsigned char>
+Texture::resizeImage(const unsigned char* data, int width, int height, int channels, int newWidth, int newHeight) {
+    std::vector<unsigned char> Result(newWidth * newHeight * channels);
+    float ScaleX = width / (float)newWidth;
+    float ScaleY = height / (float)newHeight;
+
+    for (int Y = 0; Y < newHeight; ++Y) {
+        // Sample at target pixel centers
+        float SourceY = std::max((Y + 0.5f) * ScaleY - 0.5f, 0.0f);
+        int Y0 = std::min((int)SourceY, height - 1);
+        int Y1 = std::min(Y0 + 1, height - 1);
+        float FractionY = SourceY - Y0;
+        for (int X = 0; X < newWidth; ++X) {
+            float SourceX = std::max((X + 0.5f) * ScaleX - 0.5f, 0.0f);
+            int X0 = std::min((int)SourceX, width - 1);
+            int X1 = std::min(X0 + 1, width - 1);
+            float FractionX = SourceX - X0;
+            for (int Channel = 0; Channel < channels; ++Channel) {
+                float Top = data[(Y0 * width + X0) * channels + Channel] * (1.0f - FractionX) + data[(Y0 * width + X1) * channels + Channel] * FractionX;
+                float Bottom = data[(Y1 * width + X0) * channels + Channel] * (1.0f - FractionX) + data[(Y1 * width + X1) * channels + Channel] * FractionX;
+                Result[(Y * newWidth + X) * channels + Channel] = (unsigned char)(Top * (1.0f - FractionY) + Bottom * FractionY + 0.5f);
+            }
+        }
+    }
+    return Result;
 }
\ No newline at end of file
@@ -2,9 +2,21 @@
 #include <string>
 #include <GL/glew.h>
 #include <iostream>
+#include <vector>
+#include "job_system.hpp"
 
 static const std::string MISSING_TEXTURE_PATH = "res/missing_texture";
 
+// Decoded image in RAM, waiting for upload
+struct TextureImage {
+	unsigned char* Data = 0;
+	int Width = 0;
+	int Height = 0;
+	int Channels = 0;
+	// Data points into the mapped asset pack and isn't freed
+	bool Mapped = false;
+};
+
 class Texture {
 public:
 	/**
@@ -17,4 +29,87 @@ public:
 	 * @returns TextureID
 	 */
 	static unsigned LoadImageToTexture(const std::string& filePath);
+
+	/**
+	 * @brief Decodes and vertically flips an image file, falling back to the missing texture.
+	 * Reads the cooked copy instead when there is a current one.
+	 * Doesn't touch OpenGL, so it can run on worker threads
+	 *
+	 * @param filePath Image file path
+	 * @param channels Number of channels to convert to, 0 keeps the file's channel count
+	 * @returns Decoded image, Data is null if neither the file nor the fallback could be loaded
+	 */
+	static TextureImage DecodeImage(const std::string& filePath, int channels = 0);
+
+	/**
+	 * @brief Decodes an image file and writes it as a cooked texture DecodeImage loads
+	 * without decoding. Used by the offline cooker, doesn't touch OpenGL
+	 *
+	 * @param filePath Image file path
+	 * @returns true - Success, false - Failure
+	 */
+	static bool CookImage(const std::string& filePath);
+
+	/**
+	 * @brief Creates an OpenGL texture from a decoded image and frees the image data.
+	 * Has to be called on the thread owning the GL context
+	 *
+	 * @param image Decoded image
+	 * @param name Shown in the memory report
+	 * @returns TextureID, 0 if the image is empty
+	 */
+	static unsigned UploadImage(TextureImage& image, const std::string& name = "Texture");
+
+	/**
+	 * @brief Frees decoded image data
+	 *
+	 * @param image Decoded image
+	 */
+	static void FreeImage(TextureImage& image);
+
+	/**
+	 * @brief Loads several image files into separate textures, decoding them in parallel
+	 *
+	 * @param filePaths Image file paths
+	 * @param jobs Optional job system used for decoding
+	 * @returns TextureIDs in the order of filePaths
+	 */
+	static std::vector<unsigned> LoadImagesToTextures(const std::vector<std::string>& filePaths, JobSystem* jobs = 0);
+
+	/**
+	 * @brief Loads image files into layers of one GL_TEXTURE_2D_ARRAY, so surfaces with
+	 * different textures can be drawn in one batch by selecting the layer per instance.
+	 * Images are converted to RGBA and resized to the array size when needed
+	 *
+	 * @param filePaths Image file paths, layer index is the position in this list
+	 * @param width Layer width
+	 * @param height Layer height
+	 * @param jobs Optional job system used to decode and resize the layers in parallel
+	 * @returns TextureID
+	 */
+	static unsigned LoadImagesToTextureArray(const std::vector<std::string>& filePaths, int width, int height, JobSystem* jobs = 0);
+
+private:
+	/**
+	 * @brief Reads the cooked copy of an image if there is a current one
+	 *
+	 * @param filePath Source image file path
+	 * @param channels Number of channels to convert to, 0 keeps the cooked channel count
+	 * @param image Output image
+	 * @returns false if the source has to be decoded
+	 */
+	static bool readCookedImage(const std::string& filePath, int channels, TextureImage& image);
+
+	/**
+	 * @brief Bilinearly resamples an image
+	 *
+	 * @param data Source pixels
+	 * @param width Source width
+	 * @param height Source height
+	 * @param channels Number of channels
+	 * @param newWidth Target width
+	 * @param newHeight Target height
+	 * @returns Resampled pixels
+	 */
+	static std::vector<unsigned char> resizeImage(const unsigned char* data, int width, int height, int channels, int newWidth, int newHeight);
 };
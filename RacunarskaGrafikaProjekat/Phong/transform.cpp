@@ -0,0 +1,339 @@
+#include "transform.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+TransformBatch::TransformBatch() {
+    mCount = 0;
+    mKernel = SCALAR_KERNEL;
+    SetKernel(AVX_KERNEL);
+}
+
+unsigned
+TransformBatch::Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    mPositionX.push_back(position.x);
+    mPositionY.push_back(position.y);
+    mPositionZ.push_back(position.z);
+    mRotationX.push_back(rotation.x);
+    mRotationY.push_back(rotation.y);
+    mRotationZ.push_back(rotation.z);
+    mRotationW.push_back(rotation.w);
+    mScaleX.push_back(scale.x);
+    mScaleY.push_back(scale.y);
+    mScaleZ.push_back(scale.z);
+    return mCount++;
+}
+
+void
+TransformBatch::SetPosition(unsigned idx, const glm::vec3& position) {
+    mPositionX[idx] = position.x;
+    mPositionY[idx] = position.y;
+    mPositionZ[idx] = position.z;
+}
+
+void
+TransformBatch::SetRotation(unsigned idx, const glm::quat& rotation) {
+    mRotationX[idx] = rotation.x;
+    mRotationY[idx] = rotation.y;
+    mRotationZ[idx] = rotation.z;
+    mRotationW[idx] = rotation.w;
+}
+
+void
+TransformBatch::SetScale(unsigned idx, const glm::vec3& scale) {
+    mScaleX[idx] = scale.x;
+    mScaleY[idx] = scale.y;
+    mScaleZ[idx] = scale.z;
+}
+
+glm::vec3
+TransformBatch::GetPosition(unsigned idx) const {
+    return glm::vec3(mPositionX[idx], mPositionY[idx], mPositionZ[idx]);
+}
+
+glm::quat
+TransformBatch::GetRotation(unsigned idx) const {
+    return glm::quat(mRotationW[idx], mRotationX[idx], mRotationY[idx], mRotationZ[idx]);
+}
+
+glm::vec3
+TransformBatch::GetScale(unsigned idx) const {
+    return glm::vec3(mScaleX[idx], mScaleY[idx], mScaleZ[idx]);
+}
+
+unsigned
+TransformBatch::GetCount() const {
+    return mCount;
+}
+
+void
+TransformBatch::Compose(glm::mat4* out, JobSystem* jobs) const {
+    if (jobs) {
+        jobs->ParallelFor(mCount, TRANSFORM_JOB_BATCH_SIZE, [this, out](unsigned begin, unsigned end) {
+            ComposeRange(begin, end, out);
+        });
+        return;
+    }
+
+    ComposeRange(0, mCount, out);
+}
+
+void
+TransformBatch::ComposeRange(unsigned begin, unsigned end, glm::mat4* out) const {
+    // Vector kernels handle whole groups, the remainder goes through the scalar kernel
+    switch (mKernel) {
+    case AVX_KERNEL: begin = composeAvx(begin, end, out); break;
+    case SSE_KERNEL: begin = composeSse(begin, end, out); break;
+    default: break;
+    }
+    composeScalar(begin, end, out);
+}
+
+void
+TransformBatch::SetKernel(EKernel kernel) {
+    while (!IsKernelSupported(kernel)) {
+        kernel = (EKernel)(kernel - 1);
+    }
+    mKernel = kernel;
+}
+
+TransformBatch::EKernel
+TransformBatch::GetKernel() const {
+    return mKernel;
+}
+
+bool
+TransformBatch::IsKernelSupported(EKernel kernel) {
+    static const bool HasAvx = SimdHasAvx();
+    switch (kernel) {
+    case SCALAR_KERNEL: return true;
+    case SSE_KERNEL: return SIMD_SSE;
+    case AVX_KERNEL: return SIMD_SSE && HasAvx;
+    default: return false;
+    }
+}
+
+const char*
+TransformBatch::GetKernelName(EKernel kernel) {
+    switch (kernel) {
+    case SCALAR_KERNEL: return "scalar";
+    case SSE_KERNEL: return "SSE";
+    case AVX_KERNEL: return "AVX";
+    default: return "unknown";
+    }
+}
+
+void
+TransformBatch::composeScalar(unsigned begin, unsigned end, glm::mat4* out) const {
+    for (unsigned Idx = begin; Idx < end; ++Idx) {
+        float X = mRotationX[Idx];
+        float Y = mRotationY[Idx];
+        float Z = mRotationZ[Idx];
+        float W = mRotationW[Idx];
+        float X2 = X + X;
+        float Y2 = Y + Y;
+        float Z2 = Z + Z;
+        float XX = X * X2, YY = Y * Y2, ZZ = Z * Z2;
+        float XY = X * Y2, XZ = X * Z2, YZ = Y * Z2;
+        float WX = W * X2, WY = W * Y2, WZ = W * Z2;
+
+        // Rotation matrix columns scaled by the matching scale component, translation in the last column
+        glm::mat4& Result = out[Idx];
+        Result[0] = glm::vec4((1.0f - (YY + ZZ)) * mScaleX[Idx], (XY + WZ) * mScaleX[Idx], (XZ - WY) * mScaleX[Idx], 0.0f);
+        Result[1] = glm::vec4((XY - WZ) * mScaleY[Idx], (1.0f - (XX + ZZ)) * mScaleY[Idx], (YZ + WX) * mScaleY[Idx], 0.0f);
+        Result[2] = glm::vec4((XZ + WY) * mScaleZ[Idx], (YZ - WX) * mScaleZ[Idx], (1.0f - (XX + YY)) * mScaleZ[Idx], 0.0f);
+        Result[3] = glm::vec4(mPositionX[Idx], mPositionY[Idx], mPositionZ[Idx], 1.0f);
+    }
+}
+
+unsigned
+TransformBatch::composeSse(unsigned begin, unsigned end, glm::mat4* out) const {
+#if SIMD_SSE
+    const __m128 One = _mm_set1_ps(1.0f);
+    const __m128 Zero = _mm_setzero_ps();
+    for (; begin + SIMD_WIDTH <= end; begin += SIMD_WIDTH) {
+        __m128 X = _mm_loadu_ps(&mRotationX[begin]);
+        __m128 Y = _mm_loadu_ps(&mRotationY[begin]);
+        __m128 Z = _mm_loadu_ps(&mRotationZ[begin]);
+        __m128 W = _mm_loadu_ps(&mRotationW[begin]);
+        __m128 X2 = _mm_add_ps(X, X);
+        __m128 Y2 = _mm_add_ps(Y, Y);
+        __m128 Z2 = _mm_add_ps(Z, Z);
+        __m128 XX = _mm_mul_ps(X, X2), YY = _mm_mul_ps(Y, Y2), ZZ = _mm_mul_ps(Z, Z2);
+        __m128 XY = _mm_mul_ps(X, Y2), XZ = _mm_mul_ps(X, Z2), YZ = _mm_mul_ps(Y, Z2);
+        __m128 WX = _mm_mul_ps(W, X2), WY = _mm_mul_ps(W, Y2), WZ = _mm_mul_ps(W, Z2);
+        __m128 ScaleX = _mm_loadu_ps(&mScaleX[begin]);
+        __m128 ScaleY = _mm_loadu_ps(&mScaleY[begin]);
+        __m128 ScaleZ = _mm_loadu_ps(&mScaleZ[begin]);
+
+        // Element Row of Columns[Column] holds that matrix element for 4 objects
+        __m128 Columns[4][4];
+        Columns[0][0] = _mm_mul_ps(_mm_sub_ps(One, _mm_add_ps(YY, ZZ)), ScaleX);
+        Columns[0][1] = _mm_mul_ps(_mm_add_ps(XY, WZ), ScaleX);
+        Columns[0][2] = _mm_mul_ps(_mm_sub_ps(XZ, WY), ScaleX);
+        Columns[0][3] = Zero;
+        Columns[1][0] = _mm_mul_ps(_mm_sub_ps(XY, WZ), ScaleY);
+        Columns[1][1] = _mm_mul_ps(_mm_sub_ps(One, _mm_add_ps(XX, ZZ)), ScaleY);
+        Columns[1][2] = _mm_mul_ps(_mm_add_ps(YZ, WX), ScaleY);
+        Columns[1][3] = Zero;
+        Columns[2][0] = _mm_mul_ps(_mm_add_ps(XZ, WY), ScaleZ);
+        Columns[2][1] = _mm_mul_ps(_mm_sub_ps(YZ, WX), ScaleZ);
+        Columns[2][2] = _mm_mul_ps(_mm_sub_ps(One, _mm_add_ps(XX, YY)), ScaleZ);
+        Columns[2][3] = Zero;
+        Columns[3][0] = _mm_loadu_ps(&mPositionX[begin]);
+        Columns[3][1] = _mm_loadu_ps(&mPositionY[begin]);
+        Columns[3][2] = _mm_loadu_ps(&mPositionZ[begin]);
+        Columns[3][3] = One;
+
+        // Transposing turns 4 elements of 4 objects into one column of each object
+        for (unsigned Column = 0; Column < 4; ++Column) {
+            __m128* Rows = Columns[Column];
+            _MM_TRANSPOSE4_PS(Rows[0], Rows[1], Rows[2], Rows[3]);
+            for (unsigned Object = 0; Object < SIMD_WIDTH; ++Object) {
+                _mm_storeu_ps(&out[begin + Object][Column][0], Rows[Object]);
+            }
+        }
+    }
+#endif
+    return begin;
+}
+
+#if SIMD_SSE
+/**
+ * @brief Transposes 4x4 blocks within both 128 bit lanes, same as _MM_TRANSPOSE4_PS per lane
+ */
+static SIMD_TARGET_AVX inline void
+transposeLanesAvx(__m256& row0, __m256& row1, __m256& row2, __m256& row3) {
+    __m256 Low01 = _mm256_unpacklo_ps(row0, row1);
+    __m256 Low23 = _mm256_unpacklo_ps(row2, row3);
+    __m256 High01 = _mm256_unpackhi_ps(row0, row1);
+    __m256 High23 = _mm256_unpackhi_ps(row2, row3);
+    row0 = _mm256_shuffle_ps(Low01, Low23, _MM_SHUFFLE(1, 0, 1, 0));
+    row1 = _mm256_shuffle_ps(Low01, Low23, _MM_SHUFFLE(3, 2, 3, 2));
+    row2 = _mm256_shuffle_ps(High01, High23, _MM_SHUFFLE(1, 0, 1, 0));
+    row3 = _mm256_shuffle_ps(High01, High23, _MM_SHUFFLE(3, 2, 3, 2));
+}
+#endif
+
+SIMD_TARGET_AVX unsigned
+TransformBatch::composeAvx(unsigned begin, unsigned end, glm::mat4* out) const {
+#if SIMD_SSE
+    // Only 256 bit instructions are used here. Mixing in legacy SSE encoded instructions
+    // would cost a state transition on every switch
+    const __m256 One = _mm256_set1_ps(1.0f);
+    const __m256 Zero = _mm256_setzero_ps();
+    for (; begin + SIMD_AVX_WIDTH <= end; begin += SIMD_AVX_WIDTH) {
+        __m256 X = _mm256_loadu_ps(&mRotationX[begin]);
+        __m256 Y = _mm256_loadu_ps(&mRotationY[begin]);
+        __m256 Z = _mm256_loadu_ps(&mRotationZ[begin]);
+        __m256 W = _mm256_loadu_ps(&mRotationW[begin]);
+        __m256 X2 = _mm256_add_ps(X, X);
+        __m256 Y2 = _mm256_add_ps(Y, Y);
+        __m256 Z2 = _mm256_add_ps(Z, Z);
+        __m256 XX = _mm256_mul_ps(X, X2), YY = _mm256_mul_ps(Y, Y2), ZZ = _mm256_mul_ps(Z, Z2);
+        __m256 XY = _mm256_mul_ps(X, Y2), XZ = _mm256_mul_ps(X, Z2), YZ = _mm256_mul_ps(Y, Z2);
+        __m256 WX = _mm256_mul_ps(W, X2), WY = _mm256_mul_ps(W, Y2), WZ = _mm256_mul_ps(W, Z2);
+        __m256 ScaleX = _mm256_loadu_ps(&mScaleX[begin]);
+        __m256 ScaleY = _mm256_loadu_ps(&mScaleY[begin]);
+        __m256 ScaleZ = _mm256_loadu_ps(&mScaleZ[begin]);
+
+        __m256 Columns[4][4];
+        Columns[0][0] = _mm256_mul_ps(_mm256_sub_ps(One, _mm256_add_ps(YY, ZZ)), ScaleX);
+        Columns[0][1] = _mm256_mul_ps(_mm256_add_ps(XY, WZ), ScaleX);
+        Columns[0][2] = _mm256_mul_ps(_mm256_sub_ps(XZ, WY), ScaleX);
+        Columns[0][3] = Zero;
+        Columns[1][0] = _mm256_mul_ps(_mm256_sub_ps(XY, WZ), ScaleY);
+        Columns[1][1] = _mm256_mul_ps(_mm256_sub_ps(One, _mm256_add_ps(XX, ZZ)), ScaleY);
+        Columns[1][2] = _mm256_mul_ps(_mm256_add_ps(YZ, WX), ScaleY);
+        Columns[1][3] = Zero;
+        Columns[2][0] = _mm256_mul_ps(_mm256_add_ps(XZ, WY), ScaleZ);
+        Columns[2][1] = _mm256_mul_ps(_mm256_sub_ps(YZ, WX), ScaleZ);
+        Columns[2][2] = _mm256_mul_ps(_mm256_sub_ps(One, _mm256_add_ps(XX, YY)), ScaleZ);
+        Columns[2][3] = Zero;
+        Columns[3][0] = _mm256_loadu_ps(&mPositionX[begin]);
+        Columns[3][1] = _mm256_loadu_ps(&mPositionY[begin]);
+        Columns[3][2] = _mm256_loadu_ps(&mPositionZ[begin]);
+        Columns[3][3] = One;
+
+        // After the in-lane transpose Rows[Object] holds the column of object Object in the
+        // low lane and of object Object + 4 in the high lane. Pairs of adjacent columns are
+        // then recombined so each store writes two whole columns of one object
+        for (unsigned Column = 0; Column < 4; ++Column) {
+            __m256* Rows = Columns[Column];
+            transposeLanesAvx(Rows[0], Rows[1], Rows[2], Rows[3]);
+        }
+        for (unsigned Column = 0; Column < 4; Column += 2) {
+            for (unsigned Object = 0; Object < SIMD_WIDTH; ++Object) {
+                __m256 First = Columns[Column][Object];
+                __m256 Second = Columns[Column + 1][Object];
+                _mm256_storeu_ps(&out[begin + Object][Column][0], _mm256_permute2f128_ps(First, Second, 0x20));
+                _mm256_storeu_ps(&out[begin + Object + SIMD_WIDTH][Column][0], _mm256_permute2f128_ps(First, Second, 0x31));
+            }
+        }
+    }
+    _mm256_zeroupper();
+#endif
+    return begin;
+}
+
+void
+TransformBatch::RunBenchmark(unsigned objectCount, JobSystem& jobs) {
+    const unsigned Iterations = 20;
+    std::mt19937 Random(1234);
+    std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+    TransformBatch Batch;
+    for (unsigned ObjectIdx = 0; ObjectIdx < objectCount; ++ObjectIdx) {
+        glm::vec3 Axis(Unit(Random), Unit(Random), Unit(Random) + 2.0f);
+        glm::quat Rotation = glm::angleAxis(Unit(Random) * 3.14159f, glm::normalize(Axis));
+        Batch.Add(glm::vec3(Unit(Random), Unit(Random), Unit(Random)) * 100.0f, Rotation, glm::vec3(1.0f) + glm::abs(glm::vec3(Unit(Random), Unit(Random), Unit(Random))));
+    }
+
+    std::vector<glm::mat4> Reference(objectCount);
+    std::vector<glm::mat4> Result(objectCount);
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // Same chain main.cpp used per object: translate, then rotate, then scale
+    Clock::time_point Start = Clock::now();
+    for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration) {
+        for (unsigned ObjectIdx = 0; ObjectIdx < objectCount; ++ObjectIdx) {
+            glm::mat4 ModelMatrix = glm::translate(glm::mat4(1.0f), Batch.GetPosition(ObjectIdx));
+            ModelMatrix = ModelMatrix * glm::mat4_cast(Batch.GetRotation(ObjectIdx));
+            Reference[ObjectIdx] = glm::scale(ModelMatrix, Batch.GetScale(ObjectIdx));
+        }
+    }
+    double GlmTime = std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / Iterations;
+    std::cout << "Transform benchmark: " << objectCount << " objects, " << Iterations << " iterations" << std::endl;
+    std::cout << "  glm chain: " << GlmTime << " ms" << std::endl;
+
+    for (unsigned Kernel = 0; Kernel <= KERNEL_COUNT; ++Kernel) {
+        // Last run uses the best kernel on all job system threads
+        bool Threaded = Kernel == KERNEL_COUNT;
+        if (!Threaded && !IsKernelSupported((EKernel)Kernel)) {
+            std::cout << "  " << GetKernelName((EKernel)Kernel) << ": not supported" << std::endl;
+            continue;
+        }
+        Batch.SetKernel(Threaded ? AVX_KERNEL : (EKernel)Kernel);
+
+        Start = Clock::now();
+        for (unsigned Iteration = 0; Iteration < Iterations; ++Iteration) {
+            Batch.Compose(Result.data(), Threaded ? &jobs : 0);
+        }
+        double KernelTime = std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / Iterations;
+
+        float MaxError = 0.0f;
+        for (unsigned ObjectIdx = 0; ObjectIdx < objectCount; ++ObjectIdx) {
+            for (unsigned Column = 0; Column < 4; ++Column) {
+                glm::vec4 Difference = glm::abs(Result[ObjectIdx][Column] - Reference[ObjectIdx][Column]);
+                MaxError = std::max(MaxError, std::max(std::max(Difference.x, Difference.y), std::max(Difference.z, Difference.w)));
+            }
+        }
+
+        std::cout << "  " << GetKernelName(Batch.GetKernel());
+        if (Threaded) {
+            std::cout << " x" << jobs.GetThreadCount() << " threads";
+        }
+        std::cout << ": " << KernelTime << " ms, " << GlmTime / KernelTime << "x, max error " << MaxError << std::endl;
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+#include <iostream>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "simd.hpp"
+#include "job_system.hpp"
+
+// Objects composed per job when Compose gets a job system. Multiple of SIMD_AVX_WIDTH
+#define TRANSFORM_JOB_BATCH_SIZE 4096
+
+/**
+ * @brief Position, rotation and scale of many objects kept in separate arrays per component.
+ * World matrices are composed as T * R * S several objects at a time, which replaces
+ * chains of glm::translate/rotate/scale that do full 4x4 multiplies per object
+ */
+class TransformBatch {
+public:
+    enum EKernel {
+        SCALAR_KERNEL = 0,
+        SSE_KERNEL = 1,
+        AVX_KERNEL = 2,
+        KERNEL_COUNT = 3,
+    };
+
+    /**
+     * @brief Ctor - empty batch using the best kernel supported by the CPU
+     */
+    TransformBatch();
+
+    /**
+     * @brief Adds an object
+     *
+     * @param position Translation
+     * @param rotation Unit quaternion
+     * @param scale Scale along local axes
+     *
+     * @returns Object index used by the setters and in the composed matrix array
+     */
+    unsigned Add(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+    void SetPosition(unsigned idx, const glm::vec3& position);
+    void SetRotation(unsigned idx, const glm::quat& rotation);
+    void SetScale(unsigned idx, const glm::vec3& scale);
+    glm::vec3 GetPosition(unsigned idx) const;
+    glm::quat GetRotation(unsigned idx) const;
+    glm::vec3 GetScale(unsigned idx) const;
+    unsigned GetCount() const;
+
+    /**
+     * @brief Composes world matrices of all objects
+     *
+     * @param out Destination, has to hold GetCount() matrices
+     * @param jobs Optional job system, large batches are split into TRANSFORM_JOB_BATCH_SIZE jobs
+     */
+    void Compose(glm::mat4* out, JobSystem* jobs = 0) const;
+
+    /**
+     * @brief Composes world matrices of objects in [begin, end)
+     *
+     * @param begin First object
+     * @param end One past the last object
+     * @param out Destination array indexed by object index
+     */
+    void ComposeRange(unsigned begin, unsigned end, glm::mat4* out) const;
+
+    /**
+     * @brief Selects the kernel used by Compose. Unsupported kernels fall back to the best supported one
+     *
+     * @param kernel Kernel
+     */
+    void SetKernel(EKernel kernel);
+    EKernel GetKernel() const;
+
+    /**
+     * @brief Returns true if the kernel can run on this CPU
+     */
+    static bool IsKernelSupported(EKernel kernel);
+    static const char* GetKernelName(EKernel kernel);
+
+    /**
+     * @brief Composes matrices of randomly placed objects with the glm chain and every supported kernel
+     * and prints the timings and the largest difference from the glm result
+     *
+     * @param objectCount Number of objects
+     * @param jobs Job system for the multithreaded run
+     */
+    static void RunBenchmark(unsigned objectCount, JobSystem& jobs);
+
+private:
+    unsigned mCount;
+    EKernel mKernel;
+    std::vector<float> mPositionX;
+    std::vector<float> mPositionY;
+    std::vector<float> mPositionZ;
+    std::vector<float> mRotationX;
+    std::vector<float> mRotationY;
+    std::vector<float> mRotationZ;
+    std::vector<float> mRotationW;
+    std::vector<float> mScaleX;
+    std::vector<float> mScaleY;
+    std::vector<float> mScaleZ;
+
+    void composeScalar(unsigned begin, unsigned end, glm::mat4* out) const;
+    unsigned composeSse(unsigned begin, unsigned end, glm::mat4* out) const;
+    unsigned composeAvx(unsigned begin, unsigned end, glm::mat4* out) const;
+};
@@ -0,0 +1,546 @@
+#include "vegetation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include "noise.hpp"
+#include "simd.hpp"
+#include "memory_accounting.hpp"
+
+// Floats per palm mesh vertex: position, normal, UV, texture layer
+static const unsigned MESH_VERTEX_FLOATS = 9;
+static const unsigned VEGETATION_SEED = 0x9a1f;
+// Scattered palms are smaller than the hand placed one, so forests stay readable from the shore
+static const float MIN_SCALE = 0.2f;
+static const float MAX_SCALE = 0.35f;
+// Palms grow from this height above the sea, fully dense once they are a bit higher
+static const float SHORE_START = 0.2f;
+static const float SHORE_END = 0.6f;
+// Height change per unit of distance where palms start thinning out and where none grow
+static const float SLOPE_START = 0.4f;
+static const float SLOPE_END = 0.8f;
+// Clumping noise turns uniform cover into groves and clearings
+static const float CLUMP_FREQUENCY = 1.0f / 8.0f;
+// Trunks are sunk a little, so they don't float on slopes
+static const float SINK_DEPTH = 0.05f;
+static const float TWO_PI = 6.28318531f;
+
+/**
+ * @brief Hermite interpolation between 0 and 1 as x goes from edge0 to edge1, same as GLSL smoothstep
+ */
+static float
+smoothStep(float edge0, float edge1, float x) {
+    float T = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+    return T * T * (3.0f - 2.0f * T);
+}
+
+Vegetation::Vegetation(const Terrain& terrain, JobSystem& jobs, unsigned diffuseArray, float trunkLayer, float leafLayer)
+    : mTerrain(terrain), mJobs(jobs) {
+    mDiffuseArray = diffuseArray;
+    mPendingCount = 0;
+    mNearInstanceCount = 0;
+    mImpostorCount = 0;
+    buildMesh(trunkLayer, leafLayer);
+    bakeImpostors();
+}
+
+Vegetation::~Vegetation() {
+    mJobs.Wait(mPendingCounter);
+}
+
+void
+Vegetation::AddExclusion(const glm::vec2& center, float radius) {
+    Exclusion NewExclusion = { center, radius };
+    mExclusions.push_back(NewExclusion);
+}
+
+void
+Vegetation::AddInstance(const VegetationInstance& instance) {
+    mFixedInstances.push_back(instance);
+}
+
+void
+Vegetation::Update(const Frustum& frustum, const glm::vec3& cameraPosition) {
+    {
+        std::lock_guard<std::mutex> Lock(mReadyMutex);
+        while (!mReady.empty() && mUploads.size() < VEGETATION_UPLOADS_PER_FRAME) {
+            mUploads.push_back(std::move(mReady.back()));
+            mReady.pop_back();
+        }
+    }
+    for (CellData& Data : mUploads) {
+        uploadCell(Data);
+    }
+    mUploads.clear();
+
+    // Cells far behind the camera are cheap to rebuild, so they are freed instead of cached
+    mEvictions.clear();
+    const float EvictDistance = VEGETATION_VIEW_DISTANCE * 1.5f;
+    for (const std::pair<const long long, Cell>& Entry : mCells) {
+        const Cell& EntryCell = Entry.second;
+        glm::vec2 Center = (glm::vec2(EntryCell.X, EntryCell.Z) + 0.5f) * VEGETATION_CELL_SIZE;
+        if (EntryCell.State != CELL_PENDING && glm::length(Center - glm::vec2(cameraPosition.x, cameraPosition.z)) > EvictDistance) {
+            mEvictions.push_back(Entry.first);
+        }
+    }
+    for (long long Key : mEvictions) {
+        mCells.erase(Key);
+    }
+
+    mDraws.clear();
+    mRequests.clear();
+    mNearInstanceCount = 0;
+    mImpostorCount = 0;
+    // Leaves reach past the cell and above the highest trunk base
+    const float Overhang = std::max(std::max(-mMeshMin.x, mMeshMax.x), std::max(-mMeshMin.z, mMeshMax.z)) * MAX_SCALE;
+    const float UnknownTop = mTerrain.GetMaxHeight() + mMeshMax.y * MAX_SCALE;
+    const int Range = (int)std::ceil(VEGETATION_VIEW_DISTANCE / VEGETATION_CELL_SIZE);
+    const int CameraX = (int)std::floor(cameraPosition.x / VEGETATION_CELL_SIZE);
+    const int CameraZ = (int)std::floor(cameraPosition.z / VEGETATION_CELL_SIZE);
+    for (int Z = CameraZ - Range; Z <= CameraZ + Range; ++Z) {
+        for (int X = CameraX - Range; X <= CameraX + Range; ++X) {
+            glm::vec2 CellMin = glm::vec2(X, Z) * VEGETATION_CELL_SIZE;
+            glm::vec2 CellMax = CellMin + glm::vec2(VEGETATION_CELL_SIZE);
+            long long Key = cellKey(X, Z);
+            CellMap::iterator It = mCells.find(Key);
+            float Bottom = It != mCells.end() && It->second.State == CELL_RESIDENT ? It->second.MinHeight : mTerrain.GetSeaLevel();
+            float Top = It != mCells.end() && It->second.State == CELL_RESIDENT ? It->second.MaxHeight : UnknownTop;
+            glm::vec3 Min(CellMin.x - Overhang, Bottom, CellMin.y - Overhang);
+            glm::vec3 Max(CellMax.x + Overhang, Top, CellMax.y + Overhang);
+            float Distance = glm::length(glm::clamp(cameraPosition, Min, Max) - cameraPosition);
+            if (Distance > VEGETATION_VIEW_DISTANCE || !frustum.IsBoxVisible(Min, Max)) {
+                continue;
+            }
+
+            if (It == mCells.end()) {
+                // Open sea is settled without a job
+                if (!mTerrain.HasIslands(CellMin, CellMax)) {
+                    Cell EmptyCell = { CELL_EMPTY, X, Z, GLBuffer(), GLVertexArray(), GLVertexArray(), 0, 0.0f, 0.0f };
+                    mCells[Key] = std::move(EmptyCell);
+                    continue;
+                }
+
+                CellRequest Request = { X, Z, Distance };
+                mRequests.push_back(Request);
+                continue;
+            }
+
+            const Cell& VisibleCell = It->second;
+            if (VisibleCell.State != CELL_RESIDENT) {
+                continue;
+            }
+
+            CellDraw Draw = { &VisibleCell, Distance < VEGETATION_NEAR_DISTANCE };
+            mDraws.push_back(Draw);
+            if (Draw.Near) {
+                mNearInstanceCount += VisibleCell.Count;
+            } else {
+                mImpostorCount += VisibleCell.Count;
+            }
+        }
+    }
+
+    std::sort(mRequests.begin(), mRequests.end(), [](const CellRequest& a, const CellRequest& b) {
+        return a.Distance < b.Distance;
+    });
+    for (const CellRequest& Request : mRequests) {
+        if (mPendingCount >= VEGETATION_MAX_PENDING_CELLS) {
+            break;
+        }
+
+        Cell PendingCell = { CELL_PENDING, Request.X, Request.Z, GLBuffer(), GLVertexArray(), GLVertexArray(), 0, 0.0f, 0.0f };
+        mCells[cellKey(Request.X, Request.Z)] = std::move(PendingCell);
+        ++mPendingCount;
+        int X = Request.X;
+        int Z = Request.Z;
+        mJobs.Run([this, X, Z]() {
+            CellData Data = generateCell(X, Z);
+            std::lock_guard<std::mutex> Lock(mReadyMutex);
+            mReady.push_back(std::move(Data));
+        }, &mPendingCounter);
+    }
+}
+
+void
+Vegetation::Render() const {
+    for (const CellDraw& Draw : mDraws) {
+        if (Draw.Near) {
+            glBindVertexArray(Draw.DrawCell->MeshVAO.Get());
+            glDrawArraysInstanced(GL_TRIANGLES, 0, mMeshVertexCount, Draw.DrawCell->Count);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+void
+Vegetation::RenderImpostors(const Shader& shader) const {
+    const float Radius = std::max(glm::length(glm::vec2(mMeshMin.x, mMeshMin.z)), glm::length(glm::vec2(mMeshMax.x, mMeshMax.z)));
+    shader.SetUniform1f("uImpostorRadius", Radius);
+    shader.SetUniform1f("uImpostorBottom", mMeshMin.y);
+    shader.SetUniform1f("uImpostorTop", mMeshMax.y);
+    shader.SetUniform1i("uImpostorAlbedo", 3);
+    shader.SetUniform1i("uImpostorNormal", 4);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mImpostorAlbedo.Get());
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mImpostorNormal.Get());
+
+    for (const CellDraw& Draw : mDraws) {
+        if (!Draw.Near) {
+            glBindVertexArray(Draw.DrawCell->ImpostorVAO.Get());
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, Draw.DrawCell->Count);
+        }
+    }
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+unsigned
+Vegetation::GetNearInstanceCount() const {
+    return mNearInstanceCount;
+}
+
+unsigned
+Vegetation::GetImpostorCount() const {
+    return mImpostorCount;
+}
+
+long long
+Vegetation::cellKey(int x, int z) {
+    return (long long)(((unsigned long long)(unsigned)x << 32) | (unsigned)z);
+}
+
+void
+Vegetation::buildMesh(float trunkLayer, float leafLayer) {
+    std::vector<float> Vertices;
+    // Trunk base is the instance origin
+    appendBox(Vertices, glm::vec3(0.0f, 1.5f, 0.0f), glm::vec3(0.5f, 3.0f, 0.4f), trunkLayer);
+    // Treetop - four leaves of three cubes each, drooping away from the trunk
+    const glm::vec3 LeafDirections[] = {
+        glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+    };
+    for (const glm::vec3& Direction : LeafDirections) {
+        for (unsigned Segment = 0; Segment < 3; ++Segment) {
+            glm::vec3 Center = Direction * (0.4f + 0.5f * Segment) + glm::vec3(0.0f, 2.85f - 0.15f * Segment, 0.0f);
+            appendBox(Vertices, Center, glm::vec3(0.5f), leafLayer);
+        }
+    }
+
+    mMeshVertexCount = Vertices.size() / MESH_VERTEX_FLOATS;
+    mMeshMin = glm::vec3(Vertices[0], Vertices[1], Vertices[2]);
+    mMeshMax = mMeshMin;
+    for (unsigned VertexIdx = 0; VertexIdx < mMeshVertexCount; ++VertexIdx) {
+        glm::vec3 Position(Vertices[VertexIdx * MESH_VERTEX_FLOATS], Vertices[VertexIdx * MESH_VERTEX_FLOATS + 1], Vertices[VertexIdx * MESH_VERTEX_FLOATS + 2]);
+        mMeshMin = glm::min(mMeshMin, Position);
+        mMeshMax = glm::max(mMeshMax, Position);
+    }
+
+    mMeshVBO = GLBuffer::Create();
+    glBindBuffer(GL_ARRAY_BUFFER, mMeshVBO.Get());
+    glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(float), Vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    MemoryAccounting::Track(MEMORY_MESH, mMeshVBO.Get(), "Palm mesh", Vertices.size() * sizeof(float));
+}
+
+void
+Vegetation::bakeImpostors() {
+    const unsigned Size = VEGETATION_IMPOSTOR_SIZE;
+    GLTexture* const Targets[] = { &mImpostorAlbedo, &mImpostorNormal };
+    for (GLTexture* Target : Targets) {
+        *Target = GLTexture::Create();
+        glBindTexture(GL_TEXTURE_2D_ARRAY, Target->Get());
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, Size, Size, VEGETATION_IMPOSTOR_VIEWS, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        MemoryAccounting::Track(MEMORY_TEXTURE, Target->Get(), "Palm impostors", MemoryAccounting::GetTextureSize(Size, Size, VEGETATION_IMPOSTOR_VIEWS, 4, true));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    GLFramebuffer Framebuffer = GLFramebuffer::Create();
+    unsigned DepthBuffer;
+    glGenRenderbuffers(1, &DepthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, DepthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, Size, Size);
+    glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer.Get());
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, DepthBuffer);
+    const GLenum DrawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, DrawBuffers);
+
+    GLint Viewport[4];
+    glGetIntegerv(GL_VIEWPORT, Viewport);
+    glViewport(0, 0, Size, Size);
+
+    // The bake draws one palm at the origin, instance attributes are left disabled and read as constants
+    Shader BakeShader("shaders/vegetation.vert", "shaders/impostor_bake.frag");
+    glUseProgram(BakeShader.GetId());
+    BakeShader.SetUniform1i("uDiffuseArray", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mDiffuseArray);
+    GLVertexArray BakeVAO = GLVertexArray::Create();
+    glBindVertexArray(BakeVAO.Get());
+    setupMeshAttributes();
+    glVertexAttrib4f(4, 0.0f, 0.0f, 0.0f, 1.0f);
+    glVertexAttrib1f(5, 0.0f);
+
+    const float Radius = std::max(glm::length(glm::vec2(mMeshMin.x, mMeshMin.z)), glm::length(glm::vec2(mMeshMax.x, mMeshMax.z)));
+    const float HalfHeight = (mMeshMax.y - mMeshMin.y) * 0.5f;
+    const glm::vec3 Center(0.0f, mMeshMin.y + HalfHeight, 0.0f);
+    BakeShader.SetProjection(glm::ortho(-Radius, Radius, -HalfHeight, HalfHeight, 0.0f, 4.0f * Radius));
+    const float Clear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (unsigned View = 0; View < VEGETATION_IMPOSTOR_VIEWS; ++View) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mImpostorAlbedo.Get(), 0, View);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, mImpostorNormal.Get(), 0, View);
+        if (View == 0 && glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "[Err] Impostor framebuffer is incomplete" << std::endl;
+            break;
+        }
+
+        // Views go around the palm in the same order impostor.vert picks them
+        float Angle = View * TWO_PI / VEGETATION_IMPOSTOR_VIEWS;
+        glm::vec3 Eye = Center + glm::vec3(std::sin(Angle), 0.0f, std::cos(Angle)) * (2.0f * Radius);
+        BakeShader.SetView(glm::lookAt(Eye, Center, glm::vec3(0.0f, 1.0f, 0.0f)));
+        glClearBufferfv(GL_COLOR, 0, Clear);
+        glClearBufferfv(GL_COLOR, 1, Clear);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glDrawArrays(GL_TRIANGLES, 0, mMeshVertexCount);
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &DepthBuffer);
+    glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+
+    for (GLTexture* Target : Targets) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, Target->Get());
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void
+Vegetation::setupMeshAttributes() const {
+    const unsigned Stride = MESH_VERTEX_FLOATS * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, mMeshVBO.Get());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, Stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, Stride, (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, Stride, (void*)(8 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void
+Vegetation::setupInstanceAttributes(unsigned firstLocation) const {
+    // Position and scale in one vec4, then the yaw. The instance buffer has to be bound
+    glVertexAttribPointer(firstLocation, 4, GL_FLOAT, GL_FALSE, sizeof(VegetationInstance), (void*)0);
+    glEnableVertexAttribArray(firstLocation);
+    glVertexAttribDivisor(firstLocation, 1);
+    glVertexAttribPointer(firstLocation + 1, 1, GL_FLOAT, GL_FALSE, sizeof(VegetationInstance), (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(firstLocation + 1);
+    glVertexAttribDivisor(firstLocation + 1, 1);
+}
+
+void
+Vegetation::uploadCell(CellData& data) {
+    // Pending cells are never evicted, so the entry is still there
+    Cell& UploadedCell = mCells[data.Key];
+    --mPendingCount;
+    if (data.Instances.empty()) {
+        UploadedCell.State = CELL_EMPTY;
+        return;
+    }
+
+    UploadedCell.Count = data.Instances.size();
+    UploadedCell.MinHeight = data.MinHeight;
+    UploadedCell.MaxHeight = data.MaxHeight;
+    UploadedCell.VBO = GLBuffer::Create();
+    glBindBuffer(GL_ARRAY_BUFFER, UploadedCell.VBO.Get());
+    glBufferData(GL_ARRAY_BUFFER, data.Instances.size() * sizeof(VegetationInstance), data.Instances.data(), GL_STATIC_DRAW);
+    MemoryAccounting::Track(MEMORY_STREAMING, UploadedCell.VBO.Get(), "Vegetation cell", data.Instances.size() * sizeof(VegetationInstance));
+
+    UploadedCell.MeshVAO = GLVertexArray::Create();
+    glBindVertexArray(UploadedCell.MeshVAO.Get());
+    setupMeshAttributes();
+    glBindBuffer(GL_ARRAY_BUFFER, UploadedCell.VBO.Get());
+    setupInstanceAttributes(4);
+
+    // Impostor corners come from gl_VertexID, so the instance attributes are all it reads
+    UploadedCell.ImpostorVAO = GLVertexArray::Create();
+    glBindVertexArray(UploadedCell.ImpostorVAO.Get());
+    setupInstanceAttributes(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    UploadedCell.State = CELL_RESIDENT;
+}
+
+Vegetation::CellData
+Vegetation::generateCell(int x, int z) const {
+    CellData Data;
+    Data.Key = cellKey(x, z);
+    Data.MinHeight = 0.0f;
+    Data.MaxHeight = 0.0f;
+    const glm::vec2 CellMin = glm::vec2(x, z) * VEGETATION_CELL_SIZE;
+
+    // Density map over the cell from terrain height, slope and clumping noise
+    const unsigned Side = VEGETATION_DENSITY_RESOLUTION + 1;
+    const float MapSpacing = VEGETATION_CELL_SIZE / VEGETATION_DENSITY_RESOLUTION;
+    const unsigned MapCount = SimdPadCount(Side * Side);
+    std::vector<float> MapX(MapCount);
+    std::vector<float> MapZ(MapCount);
+    std::vector<float> Heights(MapCount);
+    std::vector<float> Clumps(MapCount);
+    for (unsigned Idx = 0; Idx < MapCount; ++Idx) {
+        // Padding repeats the last sample
+        unsigned Sample = std::min(Idx, Side * Side - 1);
+        MapX[Idx] = CellMin.x + (Sample % Side) * MapSpacing;
+        MapZ[Idx] = CellMin.y + (Sample / Side) * MapSpacing;
+    }
+    mTerrain.SampleHeights(MapX.data(), MapZ.data(), Heights.data(), MapCount);
+    Noise::Fractal(MapX.data(), MapZ.data(), Clumps.data(), MapCount, CLUMP_FREQUENCY, 3, VEGETATION_SEED);
+
+    const float SeaLevel = mTerrain.GetSeaLevel();
+    std::vector<float> Density(Side * Side);
+    bool AnyDensity = false;
+    for (unsigned Row = 0; Row < Side; ++Row) {
+        for (unsigned Column = 0; Column < Side; ++Column) {
+            unsigned Left = Row * Side + (Column > 0 ? Column - 1 : Column);
+            unsigned Right = Row * Side + std::min(Column + 1, Side - 1);
+            unsigned Down = (Row > 0 ? Row - 1 : Row) * Side + Column;
+            unsigned Up = std::min(Row + 1, Side - 1) * Side + Column;
+            float SlopeX = (Heights[Right] - Heights[Left]) / (((Right % Side) - (Left % Side)) * MapSpacing);
+            float SlopeZ = (Heights[Up] - Heights[Down]) / (((Up / Side) - (Down / Side)) * MapSpacing);
+            float Slope = std::sqrt(SlopeX * SlopeX + SlopeZ * SlopeZ);
+            unsigned Idx = Row * Side + Column;
+            Density[Idx] = smoothStep(SeaLevel + SHORE_START, SeaLevel + SHORE_END, Heights[Idx])
+                * (1.0f - smoothStep(SLOPE_START, SLOPE_END, Slope))
+                * smoothStep(0.35f, 0.6f, Clumps[Idx]);
+            AnyDensity = AnyDensity || Density[Idx] > 0.0f;
+        }
+    }
+
+    // Jittered candidate grid in global indices, so the pattern doesn't depend on which cell is generated first
+    std::vector<float> PalmX;
+    std::vector<float> PalmZ;
+    const float Step = VEGETATION_CELL_SIZE / VEGETATION_CANDIDATES;
+    for (unsigned Row = 0; Row < VEGETATION_CANDIDATES && AnyDensity; ++Row) {
+        for (unsigned Column = 0; Column < VEGETATION_CANDIDATES; ++Column) {
+            int GlobalX = x * VEGETATION_CANDIDATES + Column;
+            int GlobalZ = z * VEGETATION_CANDIDATES + Row;
+            unsigned Hash = Noise::Hash(GlobalX, GlobalZ, VEGETATION_SEED + 1);
+            float LocalX = (Column + (Hash & 0x3ff) / 1024.0f) * Step;
+            float LocalZ = (Row + ((Hash >> 10) & 0x3ff) / 1024.0f) * Step;
+            float Chance = (Hash >> 20) / 4096.0f;
+
+            float MapU = std::min(LocalX / MapSpacing, VEGETATION_DENSITY_RESOLUTION - 1e-3f);
+            float MapV = std::min(LocalZ / MapSpacing, VEGETATION_DENSITY_RESOLUTION - 1e-3f);
+            unsigned U = (unsigned)MapU;
+            unsigned V = (unsigned)MapV;
+            float FU = MapU - U;
+            float FV = MapV - V;
+            const float* Corner = &Density[V * Side + U];
+            float Near = Corner[0] + (Corner[1] - Corner[0]) * FU;
+            float Far = Corner[Side] + (Corner[Side + 1] - Corner[Side]) * FU;
+            if (Chance >= Near + (Far - Near) * FV) {
+                continue;
+            }
+
+            float WorldX = CellMin.x + LocalX;
+            float WorldZ = CellMin.y + LocalZ;
+            if (isExcluded(WorldX, WorldZ)) {
+                continue;
+            }
+
+            unsigned ShapeHash = Noise::Hash(GlobalX, GlobalZ, VEGETATION_SEED + 2);
+            VegetationInstance Palm;
+            Palm.Position = glm::vec3(WorldX, 0.0f, WorldZ);
+            Palm.Scale = MIN_SCALE + (MAX_SCALE - MIN_SCALE) * ((ShapeHash & 0xffff) / 65536.0f);
+            Palm.Yaw = (ShapeHash >> 16) / 65536.0f * TWO_PI;
+            Data.Instances.push_back(Palm);
+            PalmX.push_back(WorldX);
+            PalmZ.push_back(WorldZ);
+        }
+    }
+
+    // Exact heights for the accepted palms, the density map is too coarse to stand them on
+    if (!Data.Instances.empty()) {
+        unsigned PalmCount = SimdPadCount(PalmX.size());
+        PalmX.resize(PalmCount, PalmX.back());
+        PalmZ.resize(PalmCount, PalmZ.back());
+        std::vector<float> PalmHeights(PalmCount);
+        mTerrain.SampleHeights(PalmX.data(), PalmZ.data(), PalmHeights.data(), PalmCount);
+        // Interpolated density lets a few palms slip into the water on steep shores
+        unsigned Kept = 0;
+        for (unsigned Idx = 0; Idx < Data.Instances.size(); ++Idx) {
+            if (PalmHeights[Idx] >= SeaLevel + SHORE_START) {
+                Data.Instances[Kept] = Data.Instances[Idx];
+                Data.Instances[Kept++].Position.y = PalmHeights[Idx] - SINK_DEPTH;
+            }
+        }
+        Data.Instances.resize(Kept);
+    }
+
+    for (const VegetationInstance& Fixed : mFixedInstances) {
+        if (Fixed.Position.x >= CellMin.x && Fixed.Position.x < CellMin.x + VEGETATION_CELL_SIZE
+            && Fixed.Position.z >= CellMin.y && Fixed.Position.z < CellMin.y + VEGETATION_CELL_SIZE) {
+            Data.Instances.push_back(Fixed);
+        }
+    }
+
+    for (unsigned Idx = 0; Idx < Data.Instances.size(); ++Idx) {
+        const VegetationInstance& Palm = Data.Instances[Idx];
+        float Bottom = Palm.Position.y + mMeshMin.y * Palm.Scale;
+        float Top = Palm.Position.y + mMeshMax.y * Palm.Scale;
+        Data.MinHeight = Idx ? std::min(Data.MinHeight, Bottom) : Bottom;
+        Data.MaxHeight = Idx ? std::max(Data.MaxHeight, Top) : Top;
+    }
+    return Data;
+}
+
+bool
+Vegetation::isExcluded(float x, float z) const {
+    for (const Exclusion& Area : mExclusions) {
+        if (glm::length(glm::vec2(x, z) - Area.Center) < Area.Radius) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+Vegetation::appendBox(std::vector<float>& vertices, const glm::vec3& center, const glm::vec3& size, float layer) {
+    // Normal axis and sign of each face, the two tangent axes are picked so U x V points along the normal
+    static const int Faces[6][4] = {
+        // Axis, sign, U axis, V axis
+        { 0, 1, 1, 2 }, { 0, -1, 2, 1 },
+        { 1, 1, 2, 0 }, { 1, -1, 0, 2 },
+        { 2, 1, 0, 1 }, { 2, -1, 1, 0 },
+    };
+    static const float Corners[6][2] = {
+        { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f },
+        { -1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f },
+    };
+    const glm::vec3 Half = size * 0.5f;
+    for (const int* Face : Faces) {
+        glm::vec3 Normal(0.0f);
+        Normal[Face[0]] = (float)Face[1];
+        for (const float* Corner : Corners) {
+            glm::vec3 Position = center + Normal * Half;
+            Position[Face[2]] += Corner[0] * Half[Face[2]];
+            Position[Face[3]] += Corner[1] * Half[Face[3]];
+            // Texture V runs up the sides
+            bool UIsUp = Face[2] == 1;
+            float U = (UIsUp ? Corner[1] : Corner[0]) * 0.5f + 0.5f;
+            float V = (UIsUp ? Corner[0] : Corner[1]) * 0.5f + 0.5f;
+            float Vertex[MESH_VERTEX_FLOATS] = { Position.x, Position.y, Position.z, Normal.x, Normal.y, Normal.z, U, V, layer };
+            vertices.insert(vertices.end(), Vertex, Vertex + MESH_VERTEX_FLOATS);
+        }
+    }
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include "pool_allocator.hpp"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "gl_handle.hpp"
+#include "frustum.hpp"
+#include "job_system.hpp"
+#include "terrain.hpp"
+
+// World units per cell side. Cells are generated, culled and switched between geometry and impostors as a whole
+#define VEGETATION_CELL_SIZE 16.0f
+// Density map samples per cell side, plus one shared with the neighbor
+#define VEGETATION_DENSITY_RESOLUTION 16
+// Candidate positions per cell side, each becomes a palm with the probability read from the density map
+#define VEGETATION_CANDIDATES 64
+// Cells closer than this draw palm geometry, further ones draw impostors
+#define VEGETATION_NEAR_DISTANCE 20.0f
+// Cells further than this are neither drawn nor generated
+#define VEGETATION_VIEW_DISTANCE 150.0f
+// Directions around the palm the impostor is baked from
+#define VEGETATION_IMPOSTOR_VIEWS 8
+// Impostor texture side per view
+#define VEGETATION_IMPOSTOR_SIZE 256
+// Generation jobs in flight
+#define VEGETATION_MAX_PENDING_CELLS 8
+// Finished cells uploaded per Update, the rest wait for the next frame
+#define VEGETATION_UPLOADS_PER_FRAME 4
+
+/**
+ * @brief One palm. Base of the trunk at Position, turned by Yaw radians around Y
+ */
+struct VegetationInstance {
+    glm::vec3 Position;
+    float Scale;
+    float Yaw;
+};
+
+/**
+ * @brief Palm forests scattered over the terrain islands. Cells of the world grid are filled on
+ * the job system as they come into view: a density map built from terrain height, slope and
+ * clumping noise decides which points of a jittered candidate grid get a palm. Each cell keeps
+ * its instances in one buffer that is read as instanced palm geometry up close and as camera
+ * facing impostors further away. Impostors are baked at startup from VEGETATION_IMPOSTOR_VIEWS
+ * directions into albedo and normal texture arrays, so they are lit like the geometry
+ */
+class Vegetation {
+public:
+    /**
+     * @brief Ctor - builds the palm mesh and bakes its impostors
+     *
+     * @param terrain Terrain palms grow on
+     * @param jobs Job system cells are generated on
+     * @param diffuseArray Diffuse texture array with the trunk and leaf textures
+     * @param trunkLayer Trunk layer of diffuseArray
+     * @param leafLayer Leaf layer of diffuseArray
+     */
+    Vegetation(const Terrain& terrain, JobSystem& jobs, unsigned diffuseArray, float trunkLayer, float leafLayer);
+
+    /**
+     * @brief Dtor - waits for generation jobs still writing into the vegetation. Cell buffers go with the cells
+     */
+    ~Vegetation();
+
+    Vegetation(const Vegetation&) = delete;
+    Vegetation& operator=(const Vegetation&) = delete;
+
+    /**
+     * @brief Keeps scattered palms out of a circle. Has to be called before the first Update
+     *
+     * @param center World XZ center
+     * @param radius Radius
+     */
+    void AddExclusion(const glm::vec2& center, float radius);
+
+    /**
+     * @brief Adds a hand placed palm. Has to be called before the first Update
+     *
+     * @param instance Palm
+     */
+    void AddInstance(const VegetationInstance& instance);
+
+    /**
+     * @brief Uploads finished cells, selects visible cells and requests missing ones nearest first
+     *
+     * @param frustum World space view frustum
+     * @param cameraPosition World space camera position
+     */
+    void Update(const Frustum& frustum, const glm::vec3& cameraPosition);
+
+    /**
+     * @brief Draws palm geometry of near cells. A palm shader using vegetation.vert, lit or depth only, has to be bound
+     */
+    void Render() const;
+
+    /**
+     * @brief Draws impostors of far cells. The shader has to be bound and use impostor.vert and impostor.frag
+     *
+     * @param shader Impostor shader
+     */
+    void RenderImpostors(const Shader& shader) const;
+
+    /**
+     * @brief Returns number of palms drawn as geometry by Render
+     */
+    unsigned GetNearInstanceCount() const;
+
+    /**
+     * @brief Returns number of palms drawn as impostors by RenderImpostors
+     */
+    unsigned GetImpostorCount() const;
+
+private:
+    enum ECellState {
+        CELL_PENDING = 0,
+        CELL_EMPTY = 1,
+        CELL_RESIDENT = 2,
+    };
+
+    struct Cell {
+        ECellState State;
+        int X;
+        int Z;
+        GLBuffer VBO;
+        GLVertexArray MeshVAO;
+        GLVertexArray ImpostorVAO;
+        unsigned Count;
+        float MinHeight;
+        float MaxHeight;
+    };
+
+    struct CellData {
+        long long Key;
+        std::vector<VegetationInstance> Instances;
+        float MinHeight;
+        float MaxHeight;
+    };
+
+    struct CellDraw {
+        const Cell* DrawCell;
+        bool Near;
+    };
+
+    struct CellRequest {
+        int X;
+        int Z;
+        float Distance;
+    };
+
+    struct Exclusion {
+        glm::vec2 Center;
+        float Radius;
+    };
+
+    const Terrain& mTerrain;
+    JobSystem& mJobs;
+    unsigned mDiffuseArray;
+    std::vector<Exclusion> mExclusions;
+    std::vector<VegetationInstance> mFixedInstances;
+
+    // Palm mesh: position, normal, UV, texture layer
+    GLBuffer mMeshVBO;
+    unsigned mMeshVertexCount;
+    glm::vec3 mMeshMin;
+    glm::vec3 mMeshMax;
+    GLTexture mImpostorAlbedo;
+    GLTexture mImpostorNormal;
+
+    // Nodes come from a pool, cells streaming in and out reuse them instead of hitting the heap
+    typedef std::unordered_map<long long, Cell, std::hash<long long>, std::equal_to<long long>, PoolAllocator<std::pair<const long long, Cell>>> CellMap;
+    CellMap mCells;
+    unsigned mPendingCount;
+    JobCounter mPendingCounter;
+    // Written by generation jobs, drained by Update
+    std::mutex mReadyMutex;
+    std::vector<CellData> mReady;
+    // Reused between frames
+    std::vector<CellData> mUploads;
+    std::vector<long long> mEvictions;
+
+    std::vector<CellDraw> mDraws;
+    std::vector<CellRequest> mRequests;
+    unsigned mNearInstanceCount;
+    unsigned mImpostorCount;
+
+    static long long cellKey(int x, int z);
+    void buildMesh(float trunkLayer, float leafLayer);
+    void bakeImpostors();
+    void setupMeshAttributes() const;
+    void setupInstanceAttributes(unsigned firstLocation) const;
+    void uploadCell(CellData& data);
+    CellData generateCell(int x, int z) const;
+    bool isExcluded(float x, float z) const;
+    static void appendBox(std::vector<float>& vertices, const glm::vec3& center, const glm::vec3& size, float layer);
+};